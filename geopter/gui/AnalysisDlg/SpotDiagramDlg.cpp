@@ -64,10 +64,16 @@ void SpotDiagramDlg::updateParentDockContent()
         m_renderer->DrawYaxis();
 
         plotData->Print(oss);
+
+        oss << "Spot Statistics (Field " << fi << ")" << std::endl;
+        spot->Statistics().Print(oss);
+        oss << std::endl;
     }
 
     delete spot;
 
     m_renderer->Update();
 
+    m_parentDock->setText(oss);
+
 }
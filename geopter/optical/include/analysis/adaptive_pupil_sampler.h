@@ -0,0 +1,59 @@
+#ifndef GEOPTER_ADAPTIVE_PUPIL_SAMPLER_H
+#define GEOPTER_ADAPTIVE_PUPIL_SAMPLER_H
+
+#include "analysis/pupil_sampler.h"
+#include "system/optical_system.h"
+
+namespace geopter {
+
+/**
+ * @brief Pupil samples refined where the rays change, e.g. at the vignetting and TIR boundaries
+ *
+ * The pupil square is split into n x n cells, and the rays at the corners and the center of each cell are traced.
+ * A cell is split into four while these rays disagree in the trace status (success, blocked, TIR, missed, or outside
+ * the unit circle), or the image intercept of the center departs from the mean of the corners by more than the tolerance
+ * times the RMS spread of the intercepts of the initial grid, up to the maximum level.
+ *
+ * A leaf cell whose rays all pass is integrated by its center and corners with the rule exact for quadratics, and a leaf
+ * cell on a boundary by its center if it passes. The weights are the areas over the area of the unit circle, so the set
+ * can be given to the analyses which take a PupilSampleSet and its weights sum to the passing fraction of the pupil.
+ *
+ * The center of a cell is a corner of its children, so every ray is traced once and shared by the neighbouring cells.
+ * Rays are traced without the vignetting factors, as the analyses trace the samples.
+ */
+class AdaptivePupilSampler
+{
+public:
+    AdaptivePupilSampler(OpticalSystem* opt_sys);
+    ~AdaptivePupilSampler();
+
+    /** Number of cells per side of the initial grid over [-1, 1], default 32 */
+    void SetInitialGrid(int n);
+
+    /** Maximum number of subdivisions of the initial cells, default 4 */
+    void SetMaxLevel(int n);
+
+    /** Departure of the center intercept from the mean of the corners relative to the spot size, default 0.05. If <= 0, only the status is checked. */
+    void SetTolerance(double tol) { tolerance_ = tol; }
+
+    /** Number of threads. If <= 0, Parallel::NumberOfThreads() is used. */
+    void SetNumberOfThreads(int n) { num_threads_ = n; }
+
+    /** Samples over the pupil of the field, refined by the rays of the wavelength. The boundaries of other wavelengths are not resolved. */
+    PupilSampleSet Create(const Field* fld, double wvl);
+
+    /** Number of rays traced by the last Create() */
+    int NumberOfTracedRays() const { return num_traced_; }
+
+private:
+    OpticalSystem* opt_sys_;
+    int initial_grid_;
+    int max_level_;
+    double tolerance_;
+    int num_threads_;
+    int num_traced_;
+};
+
+} //namespace geopter
+
+#endif //GEOPTER_ADAPTIVE_PUPIL_SAMPLER_H
@@ -1,6 +1,9 @@
 #ifndef GEOPTER_DIFFRACTIVE_MTF_H
 #define GEOPTER_DIFFRACTIVE_MTF_H
 
+#include <complex>
+#include <vector>
+
 #include "analysis/wave_aberration.h"
 
 namespace geopter{
@@ -12,6 +15,28 @@ public:
 
     std::shared_ptr<PlotData> plot(OpticalSystem* opt_sys, int M);
 
+    /**
+     * @brief OTF as the autocorrelation of the pupil function, at the given frequencies only
+     *
+     * The pupil function is taken from the wavefront on nrd x nrd grid. The overlap sums are evaluated at the integer grid shifts
+     * around each frequency and interpolated bilinearly, and the shifts shared by adjacent frequencies are computed once.
+     *
+     * @param freqs spatial frequencies in cycles per system unit
+     * @param azimuth direction of the frequency in radian, 0 for sagittal (x) and pi/2 for tangential (y)
+     * @return OTF normalized to 1 at zero frequency
+     */
+    std::vector< std::complex<double> > ComputeOTF(const Field* fld, double wvl, const std::vector<double>& freqs, double azimuth, int nrd = 64);
+
+    /**
+     * @brief Autocorrelation of the pupil function normalized to 1 at zero shift
+     * @param shifts shifts in grid steps
+     * @param azimuth direction of the shifts in radian
+     */
+    static std::vector< std::complex<double> > PupilAutocorrelation(const Eigen::MatrixXcd& pupil_func, const std::vector<double>& shifts, double azimuth);
+
+    /** Polychromatic sagittal and tangential MTF of all fields by ComputeOTF(), weighted by the wavelength weights */
+    std::shared_ptr<PlotData> PlotByAutocorrelation(int nrd, double max_freq, double freq_step);
+
 protected:
 
 };
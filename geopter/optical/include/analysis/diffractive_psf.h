@@ -17,9 +17,39 @@ public:
 
     void CreateFromSpotData();
 
+    /**
+     * @brief PSF on an arbitrary image window by the matrix Fourier transform
+     *
+     * The pupil function on nrd x nrd grid is transformed directly to ndim x ndim image points at the given pitch,
+     * so the image sampling is independent of the pupil sampling and no zero padding is needed.
+     *
+     * @param cx, cy center of the window relative to the chief ray intercept on the image
+     * @return intensity normalized to its peak
+     */
+    std::shared_ptr<DataGrid> CreateByMatrixFourier(const Field* fld, double wvl, int nrd, int ndim, double pitch, double cx = 0.0, double cy = 0.0);
+
+    /**
+     * @brief Polychromatic PSF on an image window by the matrix Fourier transform
+     *
+     * All the wavelengths share the window, centered relative to the chief ray intercept of the reference wavelength.
+     * The transform frequencies are scaled for each wavelength and the window is shifted by its lateral color.
+     * Each wavelength is normalized to unit power and weighted by the wavelength weight.
+     *
+     * @return intensity normalized to its peak
+     */
+    std::shared_ptr<DataGrid> CreatePolychromatic(const Field* fld, int nrd, int ndim, double pitch, double cx = 0.0, double cy = 0.0);
+
     Eigen::MatrixXd &ConvertToMatrix();
 
 protected:
+    /** Trace the chief ray to the image, nullptr if it fails */
+    RayPtr trace_chief_ray(const Field* fld, double wvl);
+
+    /** Add the intensity of the wavelength, normalized to unit power, on the window centered at (x0, y0) in the local coordinate of the image surface */
+    bool add_mft_intensity(Eigen::MatrixXd& intensity, const Field* fld, double wvl, double weight, int nrd, double pitch, double x0, double y0);
+
+    std::shared_ptr<DataGrid> create_psf_grid(Eigen::MatrixXd& intensity, double pitch, const std::string& desc);
+
     int ndim_;
     Eigen::MatrixXd W_;
     Eigen::MatrixXcd coh_;
@@ -13,6 +13,21 @@ public:
 
     std::shared_ptr<PlotData> plot(OpticalSystem* opt_sys, int nrd, double max_freq= 100.0, double freq_step= 5.0);
 
+    /**
+     * @brief Geometrical MTF of spot points along the azimuth
+     *
+     * The points are projected on the azimuth direction and binned into a line spread function, so the cost of the points is
+     * a single pass regardless of the number of frequencies. The bins are deposited linearly to the two nearest ones and the
+     * resulting sinc^2 roll off is divided out; this is accurate only on average over the point positions within a bin, so the
+     * result carries a discretization error that grows with the frequency times the bin width. Frequencies of the form k*step
+     * from zero are taken from an FFT of the line spread function wrapped at the period 1/step, which adds no aliasing at these
+     * frequencies; other frequencies are summed directly over the bins.
+     *
+     * @param x, y point coordinates on the image, usually relative to the chief ray
+     * @param azimuth direction in radian, 0 for sagittal (x) and pi/2 for tangential (y)
+     */
+    static std::vector<double> ComputeMTF(const std::vector<double>& x, const std::vector<double>& y, const std::vector<double>& freqs, double azimuth);
+
 
 };
 
@@ -0,0 +1,61 @@
+#ifndef GEOPTER_HUYGENS_PSF_H
+#define GEOPTER_HUYGENS_PSF_H
+
+#include "analysis/wave_aberration.h"
+#include "data/data_grid.h"
+
+namespace geopter{
+
+/**
+ * @brief Point spread function by direct summation of Huygens wavelets
+ *
+ * Rays on nrd x nrd grid in the entrance pupil are traced to the exit pupil reference sphere, which is centered at
+ * the chief ray intercept on the image surface. Each ray point on the sphere emits a spherical wavelet with the phase
+ * of its optical path, and the wavelets are summed at every point of the image grid. Unlike the FFT PSF, the image
+ * sampling is independent of the pupil sampling, and neither a planar exit pupil nor a small aperture angle is assumed.
+ * The image grid lies on the image surface in its local coordinate, so a tilted image surface is handled as well.
+ *
+ * The pupil rays are those of the wavefront in WavefrontCache, so the rays are not traced again for the same model and sampling.
+ * Pupil samples are stored as separate arrays and summed in chunks, so the inner loop is vectorized.
+ * Image points are processed in tiles which are distributed over threads; a tile reuses each pupil chunk while it is in cache.
+ * When the system and the field are symmetric about the y-z plane, only half of the image is summed.
+ */
+class HuygensPSF : public WaveAberration
+{
+public:
+    HuygensPSF(OpticalSystem *opt_sys);
+    ~HuygensPSF();
+
+    /** Number of threads. If <= 0, Parallel::NumberOfThreads() is used. */
+    void SetNumberOfThreads(int n) { num_threads_ = n; }
+
+    /** Offset of the image grid center from the chief ray intercept, and shift along the local z of the image surface */
+    void SetImageOffset(double x, double y, double defocus = 0.0);
+
+    /**
+     * @brief Create PSF intensity normalized to its peak
+     * @param nrd pupil sampling
+     * @param ndim image sampling, ndim x ndim points
+     * @param pitch spacing of the image points. If <= 0, a quarter of lambda/NA is used.
+     */
+    std::shared_ptr<DataGrid> Create(const Field* fld, double wvl, int nrd, int ndim, double pitch = 0.0);
+
+    /** Image point spacing of the last PSF */
+    double Pitch() const { return pitch_; }
+
+    /** Whether the last PSF was computed with the y-z plane symmetry */
+    bool Symmetric() const { return symmetric_; }
+
+private:
+    int num_threads_;
+    double offset_x_;
+    double offset_y_;
+    double defocus_;
+
+    double pitch_;
+    bool symmetric_;
+};
+
+}
+
+#endif //GEOPTER_HUYGENS_PSF_H
@@ -0,0 +1,104 @@
+#ifndef GEOPTER_IRRADIANCE_MAP_H
+#define GEOPTER_IRRADIANCE_MAP_H
+
+#include <memory>
+
+#include "system/optical_system.h"
+#include "data/data_grid.h"
+#include "analysis/pupil_sampler.h"
+
+namespace geopter {
+
+/**
+ * @brief Geometric irradiance map at any surface
+ *
+ * Rays on nrd x nrd grid in the entrance pupil are traced for each field and wavelength, and their intercepts
+ * at the surface are binned into a 2D histogram in the local coordinate of the surface.
+ * Each ray carries the field weight times the wavelength weight times the pupil area it samples,
+ * and the bins are divided by their area, so the map is in relative irradiance units independent of nrd and bin size.
+ *
+ * Only rays which pass the whole system are counted. Neither rays nor grid points are retained; each thread fills its own histogram
+ * over a contiguous range of pupil samples and the histograms are summed at the end, so the number of rays is
+ * limited only by the time.
+ */
+class IrradianceMap
+{
+public:
+    IrradianceMap(OpticalSystem* opt_sys);
+    ~IrradianceMap();
+
+    enum Weighting{
+        /** every pupil sample has the same power */
+        Uniform,
+        /**
+         * Lambertian object of constant radiance. Rays from a finite object are weighted by cos^4 of the angle
+         * to the axis in the object space, rays from an infinite object by cos, the projected area of the pupil.
+         */
+        Lambertian
+    };
+
+    /** Surface to be binned. If < 0, the image surface is used (default). */
+    void SetSurfaceIndex(int srf_idx) { srf_idx_ = srf_idx; }
+
+    /**
+     * @brief Set window of the map in the local coordinate of the surface
+     *
+     * If either half width is <= 0, the window is fitted to the footprint of the marginal rays.
+     */
+    void SetWindow(double center_x, double center_y, double half_width_x, double half_width_y);
+
+    void SetWeighting(Weighting w) { weighting_ = w; }
+
+    /** Number of threads. If <= 0, Parallel::NumberOfThreads() is used. */
+    void SetNumberOfThreads(int n) { num_threads_ = n; }
+
+    /** Map of all fields and wavelengths */
+    std::shared_ptr<DataGrid> Create(int nx, int ny, int nrd);
+
+    /** Map of the given field, all wavelengths */
+    std::shared_ptr<DataGrid> Create(const Field* fld, int nx, int ny, int nrd);
+
+    /**
+     * @brief Map of the given field, all wavelengths, over the weighted pupil samples
+     *
+     * Each ray samples the pupil area of its weight times the area of the unit circle, e.g. from AdaptivePupilSampler.
+     */
+    std::shared_ptr<DataGrid> Create(const Field* fld, int nx, int ny, const PupilSampleSet& samples);
+
+    /** Window of the last map */
+    double CenterX() const { return center_x_; }
+    double CenterY() const { return center_y_; }
+    double HalfWidthX() const { return half_width_x_; }
+    double HalfWidthY() const { return half_width_y_; }
+
+    /** Total power in the last map, including the rays which fell outside of the window */
+    double TotalPower() const { return total_power_; }
+
+    /** Number of rays counted in the last map */
+    long long NumberOfRays() const { return num_rays_; }
+
+private:
+    /** Map over the samples, or over nrd x nrd grid whose rows are generated on the fly if samples is null */
+    std::shared_ptr<DataGrid> create(const std::vector<const Field*>& fields, int nx, int ny, int nrd, const PupilSampleSet* samples);
+
+    /** Fit the window to the footprint of the chief and marginal rays */
+    bool fit_window(const std::vector<const Field*>& fields, int srf_idx);
+
+    OpticalSystem* opt_sys_;
+    int srf_idx_;
+    Weighting weighting_;
+    int num_threads_;
+
+    double center_x_;
+    double center_y_;
+    double half_width_x_;
+    double half_width_y_;
+    bool auto_window_;
+
+    double total_power_;
+    long long num_rays_;
+};
+
+} //namespace geopter
+
+#endif //GEOPTER_IRRADIANCE_MAP_H
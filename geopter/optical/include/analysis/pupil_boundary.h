@@ -0,0 +1,77 @@
+#ifndef GEOPTER_PUPIL_BOUNDARY_H
+#define GEOPTER_PUPIL_BOUNDARY_H
+
+#include <memory>
+#include <vector>
+
+#include "Eigen/Core"
+
+namespace geopter {
+
+class OpticalSystem;
+class Field;
+
+/**
+ * @brief Outer boundary of the normalized pupil which the rays of a field and wavelength pass
+ *
+ * The boundary is a polygon star shaped about the pupil center, with vertices at equally spaced azimuths.
+ * Along each azimuth the outermost passing radius is found by a scan inward from the pupil edge and a bisection,
+ * and the vertex is pushed out by the bisection tolerance, a small safety margin and the chord sagitta. An azimuth
+ * on which the scan finds no passing ray is left open at the full pupil. Contains() tests against the larger of the
+ * two vertices of the sector, which also covers the corners where the lens apertures overlap.
+ * The scan samples each azimuth at a few radii only, so the boundary is an estimate: rays outside of it are very likely
+ * blocked, and the analyses skip them rather than trace them through the system.
+ * Tracing the boundary costs up to about 20 rays per vertex and saves only the rays of a vignetted pupil,
+ * so the analyses take it by FindForSamples(), which gives it only for many samples.
+ *
+ * Boundaries are kept in a process wide cache keyed by the system, its model revision, the field position and aim point,
+ * and the wavelength. Rays are traced without the vignetting factors, as the analyses do.
+ */
+class PupilBoundary
+{
+public:
+    /** Vertices at the azimuths 2*pi*k/n of the given radii */
+    PupilBoundary(const std::vector<double>& radii);
+
+    int NumberOfVertices() const { return radii_.size(); }
+
+    Eigen::Vector2d Vertex(int k) const;
+
+    /** Distance to the polygon from the center along the azimuth in radian */
+    double Radius(double azimuth) const;
+
+    /** Whether the ray may pass. Rays outside are very likely blocked and taken so by the analyses. */
+    bool Contains(const Eigen::Vector2d& pupil) const;
+
+    /** Number of rays traced to find the boundary, 0 if it was not traced */
+    int NumberOfTracedRays() const { return num_traced_rays_; }
+
+    /** Trace the boundary of the field and the wavelength */
+    static std::shared_ptr<const PupilBoundary> Trace(OpticalSystem* opt_sys, const Field* fld, double wvl, int num_azimuths = 64);
+
+    /** Cached boundary, traced on the first request. Thread safe. */
+    static std::shared_ptr<const PupilBoundary> Find(OpticalSystem* opt_sys, const Field* fld, double wvl, int num_azimuths = 64);
+
+    /**
+     * @brief Cached boundary for the number of pupil samples to be traced for the field and the wavelength
+     *
+     * nullptr if the samples are too few to pay for the worst case cost of the boundary many times over,
+     * in which case every sample is traced.
+     */
+    static std::shared_ptr<const PupilBoundary> FindForSamples(OpticalSystem* opt_sys, const Field* fld, double wvl, long long num_samples, int num_azimuths = 64);
+
+    /** Maximum number of cached boundaries, default 64 */
+    static void SetCacheCapacity(int n);
+
+    static int NumberOfCachedBoundaries();
+
+    static void ClearCache();
+
+private:
+    std::vector<double> radii_;
+    int num_traced_rays_;
+};
+
+} //namespace geopter
+
+#endif //GEOPTER_PUPIL_BOUNDARY_H
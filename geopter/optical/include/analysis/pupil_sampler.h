@@ -0,0 +1,91 @@
+#ifndef GEOPTER_PUPIL_SAMPLER_H
+#define GEOPTER_PUPIL_SAMPLER_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Eigen/Core"
+
+namespace geopter {
+
+class Field;
+class PupilBoundary;
+
+/** Points on the normalized pupil with their weights for integration over the pupil, which sum to 1 */
+struct PupilSampleSet
+{
+    std::vector<Eigen::Vector2d> points;
+    std::vector<double> weights;
+
+    int Size() const { return points.size(); }
+};
+
+/**
+ * @brief Weighted sample sets of the pupil
+ *
+ * Sets are generated once for each pattern, size and vignetting, and shared by later requests from any thread.
+ * The least recently used sets are dropped when the number of sets exceeds the capacity.
+ * The weights make the weighted sum over the samples approximate the average over the pupil area, so a small Gaussian
+ * quadrature set gives the RMS spot or wavefront of a smooth aberration as accurately as a dense grid.
+ */
+class PupilSampler
+{
+public:
+    enum Pattern{
+        /** n x n cell centers inside the unit circle */
+        Grid,
+
+        /** rings as HexapolarArray(n), 6 points more in each ring, weighted by the ring area */
+        Hexapolar,
+
+        /** n uniformly random points with a fixed seed */
+        Random,
+
+        /** n rings at the Gauss-Legendre nodes in the squared radius, 2n + 1 arms each (G. W. Forbes, JOSA A 5, 1988) */
+        Gaussian,
+
+        /** first n points of the 2D Sobol sequence */
+        Sobol
+    };
+
+    /** Samples over the unit circle */
+    static std::shared_ptr<const PupilSampleSet> Create(Pattern pattern, int n);
+
+    /**
+     * @brief Samples over the vignetted pupil of the field
+     *
+     * The points are mapped by Field::ApplyVignetting, which compresses each half of the pupil,
+     * and the weights are scaled by the area of each quadrant.
+     */
+    static std::shared_ptr<const PupilSampleSet> Create(Pattern pattern, int n, const Field* fld);
+
+    /**
+     * @brief Samples inside the traced pupil boundary
+     *
+     * Each point of the set over the unit circle is pulled in along its azimuth by the boundary radius, clipped to 1,
+     * and its weight is scaled by the squared radius, so every sample falls inside the boundary and the weights sum to
+     * the area of the boundary over the area of the unit circle. The set is not cached.
+     */
+    static PupilSampleSet Create(Pattern pattern, int n, const PupilBoundary& boundary);
+
+    /**
+     * @brief Points [begin, end) of the 2D Sobol sequence with nested uniform scrambling
+     *
+     * Each seed gives an independent randomization which keeps the low discrepancy, so the spread of estimates over
+     * several seeds measures the error. The set is not cached, and its weights are not normalized: each is 1,
+     * or the area of its quadrant if the field is given, so that consecutive ranges can be accumulated.
+     */
+    static PupilSampleSet ScrambledSobol(uint32_t seed, int begin, int end, const Field* fld = nullptr);
+
+    /** Maximum number of cached sets, default 64 */
+    static void SetCacheCapacity(int n);
+
+    static int NumberOfCachedSets();
+
+    static void ClearCache();
+};
+
+} //namespace geopter
+
+#endif //GEOPTER_PUPIL_SAMPLER_H
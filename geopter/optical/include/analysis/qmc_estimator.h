@@ -0,0 +1,94 @@
+#ifndef GEOPTER_QMC_ESTIMATOR_H
+#define GEOPTER_QMC_ESTIMATOR_H
+
+#include <cstdint>
+#include <functional>
+
+#include "analysis/pupil_sampler.h"
+
+namespace geopter {
+
+class Field;
+
+/** Result of the randomized quasi Monte Carlo estimate */
+struct QmcEstimate
+{
+    /** mean of the replicate estimates */
+    double value;
+
+    /** half width of the 95% confidence interval of the value */
+    double error;
+
+    /** number of pupil samples over all replicates */
+    long long num_samples;
+
+    int num_batches;
+
+    /** whether the error met the tolerance before the sample limit */
+    bool converged;
+};
+
+/**
+ * @brief Randomized quasi Monte Carlo over the pupil with a confidence interval and early stopping
+ *
+ * A number of independently scrambled Sobol sequences (replicates) are traced in batches. Every batch doubles the
+ * number of points of each replicate, so each replicate always holds a balanced 2^k prefix of its sequence.
+ * After each batch the replicate estimates are averaged, and the confidence interval is taken from their spread
+ * by the Student t distribution. The estimate stops as soon as the half width is within the tolerance.
+ *
+ * The estimator only drives the sampling; the caller accumulates each replicate, e.g. SpotDiagram::Estimate().
+ */
+class QmcEstimator
+{
+public:
+    QmcEstimator();
+
+    /** Stop when the error <= max(absolute, relative*|value|) */
+    void SetTolerance(double absolute, double relative = 0.0);
+
+    /** Number of the scrambled replicates, at least 2, default 8 */
+    void SetNumberOfReplicates(int n);
+
+    /** Number of points of each replicate in the first batch, rounded up to a power of 2, default 32 */
+    void SetInitialSamples(int n);
+
+    /** Upper limit of the total number of samples over all replicates, default 2^20 */
+    void SetMaxSamples(long long n);
+
+    /** Replicates are accumulated on multiple threads. If <= 0, the default number is used. */
+    void SetNumberOfThreads(int n) { num_threads_ = n; }
+
+    /** Base of the scrambling seeds, so that other seeds give other randomizations */
+    void SetSeed(uint32_t seed) { seed_ = seed; }
+
+    int NumberOfReplicates() const { return num_replicates_; }
+
+    int InitialSamples() const { return initial_samples_; }
+
+    /**
+     * @brief Run batches until the tolerance is met
+     *
+     * @param add_batch accumulates the samples to the replicate, called concurrently for different replicates
+     * @param estimate current estimate of the replicate, NaN if none
+     * @param fld samples are mapped to the vignetted pupil of the field if given
+     */
+    QmcEstimate Run(const std::function<void(int, const PupilSampleSet&)>& add_batch,
+                    const std::function<double(int)>& estimate,
+                    const Field* fld = nullptr) const;
+
+private:
+    /** Two sided 95% quantile of the Student t distribution */
+    static double t_quantile(int dof);
+
+    double abs_tolerance_;
+    double rel_tolerance_;
+    int num_replicates_;
+    int initial_samples_;
+    long long max_samples_;
+    int num_threads_;
+    uint32_t seed_;
+};
+
+} //namespace geopter
+
+#endif //GEOPTER_QMC_ESTIMATOR_H
@@ -0,0 +1,130 @@
+#ifndef GEOPTER_RAY_SURROGATE_H
+#define GEOPTER_RAY_SURROGATE_H
+
+#include <utility>
+#include <vector>
+
+#include "analysis/wave_aberration.h"
+#include "analysis/pupil_sampler.h"
+#include "analysis/spot_statistics.h"
+
+namespace geopter {
+
+/**
+ * @brief Polynomial surrogate of the map from the pupil to the image intercept and OPD
+ *
+ * The intercept relative to the chief ray and the OPD in waves are fitted by polynomials of the normalized pupil (px, py)
+ * to rays traced on a Gaussian pupil set inside the traced pupil boundary. Once fitted, dense spot statistics,
+ * ray fans and intercepts for GeometricalMTF::ComputeMTF() cost a polynomial evaluation per ray instead of a trace.
+ * Every fit is checked against rays traced on an independent scrambled Sobol set, and the largest errors are reported.
+ *
+ * FitFields() fits the maps at a few field heights along +y and interpolates the coefficients in the height,
+ * and a field (hx, hy) in the normalized field is obtained by rotating the map about the axis, so the system must be
+ * rotationally symmetric; otherwise FitFields() fails and each field has to be fitted by Fit(). The normalized field is
+ * radial, i.e. for object angles the angle off the axis is the height times the maximum field.
+ */
+class RaySurrogate : public WaveAberration
+{
+public:
+    RaySurrogate(OpticalSystem* opt_sys);
+    ~RaySurrogate();
+
+    /** Maximum total degree of the polynomials, default 10 */
+    void SetMaxDegree(int n);
+
+    /** Number of threads. If <= 0, Parallel::NumberOfThreads() is used. */
+    void SetNumberOfThreads(int n) { num_threads_ = n; }
+
+    /** Fit the map of the field and wavelength. Returns false if too few rays pass. */
+    bool Fit(const Field* fld, double wvl);
+
+    /**
+     * @brief Fit the maps for the whole field from num_fields heights between the axis and the maximum field
+     *
+     * The heights are at sin(pi/2*i/(n-1)), and with their mirror images below the axis the coefficients are interpolated
+     * by the polynomial through the Chebyshev-Lobatto nodes. The interpolation is validated by the rays of real fields
+     * midway between the fitted heights, off the y axis. Returns false if the system is not rotationally symmetric.
+     */
+    bool FitFields(double wvl, int num_fields = 7);
+
+    /**
+     * @brief Intercept relative to the chief ray (dx, dy) and OPD in waves of each pupil point, of the field of the last Fit()
+     *
+     * Rows of the points outside the pupil boundary are NaN, so ray fans break where the rays are blocked.
+     */
+    Eigen::MatrixX3d Evaluate(const std::vector<Eigen::Vector2d>& pupils) const;
+
+    /** Same as above at the normalized field (hx, hy), after FitFields() */
+    Eigen::MatrixX3d Evaluate(double hx, double hy, const std::vector<Eigen::Vector2d>& pupils) const;
+
+    /** Chief ray intercept on the image at the normalized field, after FitFields() */
+    Eigen::Vector2d ChiefRayIntercept(double hx, double hy) const;
+
+    /** Spot statistics relative to the chief ray over the weighted samples, of the field of the last Fit() */
+    SpotStatistics ComputeStatistics(const PupilSampleSet& samples) const;
+
+    /** Same as above at the normalized field (hx, hy), after FitFields() */
+    SpotStatistics ComputeStatistics(double hx, double hy, const PupilSampleSet& samples) const;
+
+    /** Largest errors of the intercept in system units and of the OPD in waves over the validation rays of the last fit */
+    double MaxInterceptError() const { return max_intercept_error_; }
+    double MaxOpdError() const { return max_opd_error_; }
+
+    /** Number of rays traced by the last fit, including the validation and the pupil boundaries */
+    int NumberOfTracedRays() const { return num_traced_; }
+
+private:
+    /** Coefficients of the terms in columns dx, dy and OPD, the chief ray intercept, and the vertex radii of the pupil boundary */
+    struct RayMap
+    {
+        Eigen::MatrixX3d coefs;
+        Eigen::Vector2d chief;
+        std::vector<double> radii;
+    };
+
+    /** Rays of the pupil points: dx, dy relative to the chief ray and OPD in waves, and whether each passed */
+    bool trace(const Field* fld, double wvl, const std::vector<Eigen::Vector2d>& pupils,
+               Eigen::MatrixX3d& values, Eigen::Array<bool, Eigen::Dynamic, 1>& passed, Eigen::Vector2d& chief);
+
+    /** Pupil boundary of the field, whose rays are counted as traced by the fit even if it was cached */
+    std::shared_ptr<const PupilBoundary> find_boundary(const Field* fld, double wvl);
+
+    bool fit_map(const Field* fld, double wvl, const PupilBoundary& boundary, RayMap& map);
+
+    /** Update the maximum errors by the rays of the field, which the map rotated about the axis by the angle stands for */
+    void validate(const Field* fld, double wvl, const PupilBoundary& boundary, const RayMap& map, double rotation);
+
+    /** Map at the height by the interpolation of the fitted fields */
+    RayMap interpolate(double h) const;
+
+    /** Map of the field mirrored about the x axis */
+    RayMap mirror(const RayMap& map) const;
+
+    /** Map of the field on the y axis rotated by the angle about the axis, i.e. of the field at the angle from the y axis */
+    Eigen::MatrixX3d evaluate(const RayMap& map, double rotation, const std::vector<Eigen::Vector2d>& pupils) const;
+
+    SpotStatistics compute_statistics(const RayMap& map, double rotation, const PupilSampleSet& samples) const;
+
+    /** Field at the normalized field (hx, hy), aimed at the reference wavelength */
+    bool create_field(Field& fld, double hx, double hy);
+
+    int max_degree_;
+    int num_threads_;
+
+    /** exponents of px and py of each term */
+    std::vector< std::pair<int, int> > terms_;
+
+    RayMap map_;
+    bool fitted_;
+
+    std::vector<double> heights_;
+    std::vector<RayMap> field_maps_;
+
+    double max_intercept_error_;
+    double max_opd_error_;
+    int num_traced_;
+};
+
+} //namespace geopter
+
+#endif //GEOPTER_RAY_SURROGATE_H
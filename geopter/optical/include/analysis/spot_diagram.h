@@ -27,10 +27,17 @@
 #define SPOT_DIAGRAM_H
 
 #include "analysis/ray_aberration.h"
+#include "analysis/spot_statistics.h"
+#include "analysis/pupil_sampler.h"
+#include "analysis/qmc_estimator.h"
+#include "analysis/pupil_boundary.h"
 #include "sequential/sequential_path.h"
 
 namespace geopter {
 
+class Ray;
+class SequentialTrace;
+
 class SpotDiagram : RayAberration
 {
 public:
@@ -39,14 +46,56 @@ public:
 
     std::shared_ptr<PlotData> plot(const Field* fld, int pattern, int nrd, double dot_size);
 
+    /** Statistics of the spot of all wavelengths in the last plot, relative to the chief ray */
+    const SpotStatistics& Statistics() const { return statistics_; }
+
+    /** Statistics of the spot of the given wavelength in the last plot */
+    const SpotStatistics& Statistics(int wi) const { return wvl_statistics_[wi]; }
+
+    /**
+     * @brief Compute spot statistics without plot data
+     *
+     * Rays on nrd x nrd grid in the pupil are traced for each wavelength and weighted by the wavelength weight.
+     * Nothing is retained per ray, so nrd can be in the thousands.
+     */
+    SpotStatistics ComputeStatistics(const Field* fld, int nrd, int num_threads = 0);
+
+    /**
+     * @brief Compute spot statistics on the weighted pupil samples, e.g. from PupilSampler
+     *
+     * Each ray is weighted by the sample weight times the wavelength weight. The samples are split into a fixed number
+     * of blocks, each accumulated separately and merged in order, so the result does not depend on the number of threads.
+     */
+    SpotStatistics ComputeStatistics(const Field* fld, const PupilSampleSet& samples, int num_threads = 0);
+
+    /**
+     * @brief Estimate a spot statistic by scrambled Sobol sampling until the estimator's tolerance is met
+     *
+     * Each replicate of the estimator accumulates its own SpotStatistics over all wavelengths, and the statistic,
+     * e.g. RmsRadius() or EncircledEnergy(r), is evaluated on each after every batch. The ray count of the result
+     * is per wavelength.
+     */
+    QmcEstimate Estimate(const Field* fld, const std::function<double(const SpotStatistics&)>& statistic, const QmcEstimator& estimator);
+
     enum SpotRayPattern{
         Grid,
         Hexapolar
     };
 
 private:
+    /** Pupil boundary of the field for each wavelength, nullptr where num_samples are too few for it to pay off */
+    std::vector< std::shared_ptr<const PupilBoundary> > pupil_boundaries(const Field* fld, long long num_samples) const;
+
+    /** Add the rays of samples [begin, end) inside the boundaries for all wavelengths, relative to the chief ray */
+    void accumulate(SequentialTrace& tracer, const Field* fld, const PupilSampleSet& samples, int begin, int end,
+                    const std::shared_ptr<Ray>& chief_ray, const std::vector< std::shared_ptr<const PupilBoundary> >& boundaries,
+                    SpotStatistics& stats) const;
+
     std::vector<double> wvl_weights_;
     std::vector<SequentialPath> seq_paths_;
+
+    std::vector<SpotStatistics> wvl_statistics_;
+    SpotStatistics statistics_;
 };
 
 }
@@ -0,0 +1,107 @@
+#ifndef GEOPTER_SPOT_STATISTICS_H
+#define GEOPTER_SPOT_STATISTICS_H
+
+#include <vector>
+#include <sstream>
+
+#include "Eigen/Core"
+
+namespace geopter {
+
+/**
+ * @brief Streaming accumulator of spot statistics
+ *
+ * Points are given as offsets (dx, dy) from a reference point, usually the chief ray, and are not retained.
+ * Weighted centroid and RMS are accumulated by the weighted Welford update, so they are stable for any number of rays.
+ * Radial distances from the reference are binned into fixed-size histograms for encircled and ensquared energy.
+ * When a point falls beyond the histogram range, the bin width is doubled by merging adjacent bins,
+ * so the range adapts to the spot without storing the points.
+ *
+ * Accumulators are mergeable: each thread can fill its own and combine them with Merge().
+ */
+class SpotStatistics
+{
+public:
+    /**
+     * @param initial_bin_width initial width of the histogram bins
+     * @param num_bins number of bins, must be even
+     *
+     * Accumulators to be merged must be created with the same parameters.
+     */
+    SpotStatistics(double initial_bin_width = 1.0e-4, int num_bins = 256);
+
+    void Clear();
+
+    /** Add a point at (dx, dy) from the reference */
+    void Add(double dx, double dy, double weight = 1.0);
+
+    /** Combine with the other accumulator, as if its points had been added to this one */
+    void Merge(const SpotStatistics& other);
+
+    /** Number of points added */
+    long long NumberOfPoints() const { return num_points_; }
+
+    double TotalWeight() const { return total_weight_; }
+
+    /** Weighted centroid relative to the reference */
+    Eigen::Vector2d Centroid() const { return mean_; }
+
+    /** RMS radius about the centroid */
+    double RmsRadius() const;
+
+    /** RMS radius about the reference */
+    double RmsRadiusFromReference() const;
+
+    /** RMS of x and y about the centroid */
+    double RmsX() const;
+    double RmsY() const;
+
+    /** Maximum distance from the reference, i.e. geometric radius */
+    double MaxRadius() const { return max_radius_; }
+
+    /** Fraction of weight within the circle of the given radius about the reference */
+    double EncircledEnergy(double radius) const;
+
+    /** Fraction of weight within the square of the given half width about the reference */
+    double EnsquaredEnergy(double half_width) const;
+
+    /** Radius about the reference which encloses the given fraction of weight */
+    double EncircledRadius(double fraction) const;
+
+    /** Current width of the histogram bins */
+    double BinWidth() const;
+
+    void Print(std::ostringstream& oss) const;
+
+private:
+    /** Double the bin width until the given distance falls in range */
+    void expand(double distance);
+
+    /** Double the bin width once */
+    void coarsen();
+
+    /** Merge adjacent pairs of bins into the lower half */
+    static void merge_bins(std::vector<double>& hist);
+
+    /** Weight of the histogram below x, interpolated linearly in the bin */
+    double cumulative(const std::vector<double>& hist, double x) const;
+
+    long long num_points_;
+    double total_weight_;
+    Eigen::Vector2d mean_;
+
+    /** weighted sums of squared deviation about the mean, x and y */
+    Eigen::Vector2d m2_;
+
+    double max_radius_;
+
+    /** bin width is initial_bin_width_ * 2^level_ */
+    double initial_bin_width_;
+    int level_;
+    std::vector<double> radial_hist_;
+    std::vector<double> square_hist_;
+};
+
+}
+
+#endif //GEOPTER_SPOT_STATISTICS_H
@@ -0,0 +1,93 @@
+#ifndef GEOPTER_THROUGH_FOCUS_H
+#define GEOPTER_THROUGH_FOCUS_H
+
+#include <complex>
+#include <vector>
+
+#include "analysis/wave_aberration.h"
+#include "data/data_grid.h"
+
+namespace geopter{
+
+/**
+ * @brief Diffraction quality against the focus shift, from a single wavefront trace
+ *
+ * Prepare() traces the pupil once and keeps the OPD with the exit pupil point and the image space direction of every ray.
+ * For a focus shift, the reference sphere is moved to the chief ray intercept on the shifted image plane, and the path
+ * of each ray from the original sphere to the new one is added to its OPD. Since the rays are straight in the image space,
+ * the path is exact and no retrace is required, so the Strehl ratio, MTF and PSF of many planes cost a pupil sized sum or FFT each.
+ * The shift is along the local z of the image surface, positive away from the lens.
+ */
+class ThroughFocus : public WaveAberration
+{
+public:
+    ThroughFocus(OpticalSystem *opt_sys);
+    ~ThroughFocus();
+
+    /** Number of threads over the focus planes. If <= 0, Parallel::NumberOfThreads() is used. */
+    void SetNumberOfThreads(int n) { num_threads_ = n; }
+
+    /** Trace the wavefront on nrd x nrd grid, or take it from WavefrontCache. Returns false if the chief ray fails. */
+    bool Prepare(const Field* fld, double wvl, int nrd = 64);
+
+    /** OPD in waves at the focus shift, nrd x nrd, NaN where no ray passes */
+    Eigen::MatrixXd Opd(double defocus) const;
+
+    /** Strehl ratio at the focus shift, relative to the aberration free pupil of the same shape */
+    double StrehlRatio(double defocus) const;
+
+    /**
+     * @brief OTF at the focus shift by the pupil autocorrelation
+     * @param freqs spatial frequencies in cycles per system unit
+     * @param azimuth direction of the frequency in radian, 0 for sagittal (x) and pi/2 for tangential (y)
+     */
+    std::vector< std::complex<double> > ComputeOTF(double defocus, const std::vector<double>& freqs, double azimuth) const;
+
+    /**
+     * @brief PSF at the focus shift by FFT of the pupil function zero padded to M x M
+     *
+     * The intensity is normalized so that the peak of the aberration free pupil is 1, i.e. the peak equals the Strehl ratio.
+     * The grid extent is M times PsfPitch().
+     */
+    std::shared_ptr<DataGrid> PSF(double defocus, int M) const;
+
+    /** Spacing of the PSF points for the padded size M */
+    double PsfPitch(int M) const;
+
+    /** Strehl ratio of each plane, planes are evaluated in parallel */
+    std::vector<double> StrehlRatios(const std::vector<double>& defocuses) const;
+
+    /** MTF at the frequency and azimuth of each plane, planes are evaluated in parallel */
+    std::vector<double> MTFs(const std::vector<double>& defocuses, double freq, double azimuth) const;
+
+    /** Strehl ratio and sagittal/tangential MTF at the frequency against the focus shift, over num_planes equally spaced planes */
+    std::shared_ptr<PlotData> Plot(double freq, double min_defocus, double max_defocus, int num_planes);
+
+private:
+    /** Complex pupil function at the focus shift, zero where no ray passes */
+    Eigen::MatrixXcd pupil_function(double defocus) const;
+
+    /** OPD in system units of the valid samples at the focus shift */
+    Eigen::ArrayXd shifted_opd(double defocus) const;
+
+    int num_threads_;
+
+    bool prepared_;
+    int nrd_;
+    double wvl_;
+    double n_img_;
+    double shift_per_freq_;
+    Eigen::Vector3d cr_img_pt_;
+    Eigen::Vector3d cr_img_dir_;
+    Eigen::Vector3d cr_exp_pt_;
+
+    /** grid index, OPD, exit pupil point and image space direction of the valid samples */
+    std::vector<int> sample_index_;
+    Eigen::ArrayXd opd_;
+    Eigen::ArrayXd exp_x_, exp_y_, exp_z_;
+    Eigen::ArrayXd dir_x_, dir_y_, dir_z_;
+};
+
+}
+
+#endif //GEOPTER_THROUGH_FOCUS_H
@@ -3,6 +3,7 @@
 
 #include "system/optical_system.h"
 #include "analysis/reference_sphere.h"
+#include "analysis/wavefront_cache.h"
 #include "data/plot_data.h"
 #include "sequential/ray.h"
 
@@ -16,6 +17,17 @@ public:
 
 protected:
 
+    /**
+     * @brief Wavefront of the field and wavelength on the pupil sampling
+     *
+     * The result is taken from WavefrontCache if the same model has been sampled in the same way,
+     * otherwise the rays are traced on multiple threads and the result is cached.
+     */
+    std::shared_ptr<const PupilWavefront> pupil_wavefront(const Field* fld, double wvl, const PupilSampling& sampling);
+
+    /** Shift of the pupil function in x grid steps for unit spatial frequency on the image, by the paraxial exit pupil */
+    double pupil_shift_per_frequency(const PupilWavefront& wf);
+
     double wave_abr_full_calc(const std::shared_ptr<Ray>& ray, const std::shared_ptr<Ray>& chief_ray);
 
     double wave_abr_full_calc(const std::shared_ptr<Ray>& ray, const std::shared_ptr<Ray>& chief_ray, const Field* fld, ReferenceSphere& ref_sphere);
@@ -31,6 +43,12 @@ protected:
 
     void get_chief_ray_exp_segment(Eigen::Vector3d& cr_exp_pt, double& cr_exp_dist, const std::shared_ptr<Ray> chief_ray);
 
+    /** Symmetry about the axis, i.e. no decenter, as the profiles and the apertures are all round */
+    bool is_rotationally_symmetric() const;
+
+    /** Mirror symmetry about the y-z plane, i.e. no decenter and the field on the y axis */
+    bool is_symmetric(const Field* fld) const;
+
     OpticalSystem* opt_sys_;
 };
 
@@ -27,6 +27,8 @@
 #define WAVEFRONT_H
 
 #include "analysis/wave_aberration.h"
+#include "analysis/pupil_sampler.h"
+#include "analysis/qmc_estimator.h"
 #include "data/data_grid.h"
 
 namespace geopter{
@@ -43,9 +45,38 @@ public:
     /** create by tracing multiple rays */
     std::shared_ptr<DataGrid> Create(const Field* fld, double wvl, int ndim);
 
+    /**
+     * @brief Create by resampling Zernike terms fitted to a coarse trace
+     *
+     * The wavefront is traced on coarse_ndim x coarse_ndim grid, fitted by the Noll terms up to max_degree and evaluated on ndim x ndim grid.
+     * The error is estimated at a subset of the coarse samples left out of a trial fit. When it exceeds the tolerance, or when the coarse
+     * pupil is clipped by vignetting, the map is traced densely by Create() instead.
+     *
+     * @param tolerance maximum RMS error at the left out samples, in waves
+     */
+    std::shared_ptr<DataGrid> CreateByReconstruction(const Field* fld, double wvl, int ndim, int coarse_ndim = 32, int max_degree = 10, double tolerance = 0.01);
+
+    /**
+     * @brief RMS wavefront error in waves over the weighted pupil samples, e.g. from PupilSampler
+     *
+     * The OPD is taken about its weighted mean. Samples whose rays fail are left out and the rest are renormalized.
+     */
+    double RmsWavefront(const Field* fld, double wvl, const PupilSampleSet& samples);
+
+    /** RMS wavefront error in waves by scrambled Sobol sampling until the estimator's tolerance is met */
+    QmcEstimate EstimateRmsWavefront(const Field* fld, double wvl, const QmcEstimator& estimator);
+
+    /** Whether the last CreateByReconstruction() resampled the fit, rather than traced densely */
+    bool Reconstructed() const { return reconstructed_; }
+
+    /** Estimated RMS error of the last reconstruction in waves */
+    double ReconstructionError() const { return reconstruction_error_; }
+
 protected:
     int ndim_;
     double wvl_;
+    bool reconstructed_;
+    double reconstruction_error_;
 };
 
 } //namespace geopter
@@ -0,0 +1,107 @@
+#ifndef GEOPTER_WAVEFRONT_CACHE_H
+#define GEOPTER_WAVEFRONT_CACHE_H
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "Eigen/Core"
+#include "analysis/reference_sphere.h"
+#include "sequential/ray.h"
+
+namespace geopter {
+
+class OpticalSystem;
+class Field;
+
+/** Rectangular sampling of the normalized pupil, the coordinate of (row i, column j) is (start_x + step_x*j, start_y + step_y*i) */
+struct PupilSampling
+{
+    int nx;
+    int ny;
+    double start_x;
+    double step_x;
+    double start_y;
+    double step_y;
+
+    /** n x n grid over [-1, 1] including the edges */
+    static PupilSampling Grid(int n);
+
+    /** n points over [-1, 1] on the y axis, as a single column */
+    static PupilSampling FanY(int n);
+
+    Eigen::Vector2d PupilCoordinate(int i, int j) const { return Eigen::Vector2d(start_x + step_x*j, start_y + step_y*i); }
+};
+
+/** Wavefront on the pupil sampling, referenced to the sphere centered at the chief ray intercept on the image */
+struct PupilWavefront
+{
+    PupilSampling sampling;
+    double wvl;
+
+    /** false if the chief ray could not be traced, in which case the mask is all false */
+    bool valid;
+
+    /** optical path difference in system units, ny x nx, NaN where no ray passes */
+    Eigen::MatrixXd opd;
+
+    /** true where the ray passes the system */
+    Eigen::Array<bool, Eigen::Dynamic, Eigen::Dynamic> mask;
+
+    /** ray intercepts and directions on the image surface in its local coordinate, at index i*nx + j, valid where the mask is true */
+    std::vector<Eigen::Vector3d> image_pts;
+    std::vector<Eigen::Vector3d> image_dirs;
+
+    RayPtr chief_ray;
+    ReferenceSphere ref_sphere;
+};
+
+/**
+ * @brief Process wide cache of pupil wavefronts
+ *
+ * Entries are keyed by the system, its model revision, the field and its aiming and vignetting state,
+ * the wavelength and the sampling. Any UpdateModel() call gives a new revision, so outdated entries are never
+ * returned; they are dropped when the number of entries exceeds the capacity, least recently used first.
+ * All the methods are thread safe.
+ */
+class WavefrontCache
+{
+public:
+    struct Key
+    {
+        const OpticalSystem* opt_sys;
+        unsigned long long revision;
+        const Field* fld;
+
+        /** position, vignetting factors and aim point */
+        std::array<double, 8> fld_state;
+
+        double wvl;
+        int nx;
+        int ny;
+
+        /** start_x, step_x, start_y, step_y */
+        std::array<double, 4> grid;
+
+        bool operator<(const Key& other) const;
+    };
+
+    static Key MakeKey(const OpticalSystem* opt_sys, const Field* fld, double wvl, const PupilSampling& sampling);
+
+    /** Returns the entry, or null if not cached */
+    static std::shared_ptr<const PupilWavefront> Find(const Key& key);
+
+    /** Insert the entry unless the key is already cached, and returns the cached one */
+    static std::shared_ptr<const PupilWavefront> Insert(const Key& key, std::shared_ptr<const PupilWavefront> wavefront);
+
+    /** Maximum number of entries, default 64 */
+    static void SetCapacity(int n);
+
+    static int NumberOfEntries();
+
+    static void Clear();
+};
+
+} //namespace geopter
+
+#endif //GEOPTER_WAVEFRONT_CACHE_H
@@ -0,0 +1,95 @@
+#ifndef GEOPTER_ZERNIKE_FIT_H
+#define GEOPTER_ZERNIKE_FIT_H
+
+#include <vector>
+
+#include "analysis/wave_aberration.h"
+
+namespace geopter{
+
+/** Zernike polynomials on the unit circle, with x = rho*cos(theta) and y = rho*sin(theta) */
+class Zernike
+{
+public:
+    /**
+     * Fringe: University of Arizona ordering, unnormalized.
+     * Noll: standard ordering, normalized to unit RMS over the unit circle.
+     */
+    enum Ordering{
+        Fringe,
+        Noll
+    };
+
+    /**
+     * Radial degree n and azimuthal frequency m of the term j, which starts at 1. m is negative for the sine terms.
+     * Fringe defines the terms 1 to 37 only; returns false for j out of the ordering.
+     */
+    static bool Index(int j, Ordering ordering, int& n, int& m);
+
+    /** NaN for j out of the ordering */
+    static double Value(int j, Ordering ordering, double rho, double theta);
+};
+
+/** Zernike coefficients of a wavefront with its statistics, all in waves */
+struct ZernikeCoefficients
+{
+    Zernike::Ordering ordering;
+
+    /** coefs[j-1] is the coefficient of the term j */
+    std::vector<double> coefs;
+
+    /** RMS about the mean and peak to valley of the sampled wavefront */
+    double rms;
+    double pv;
+
+    /** RMS of the residual of the fit */
+    double fit_rms;
+
+    /** number of the pupil samples, 0 if the fit failed */
+    int num_samples;
+};
+
+/**
+ * @brief Least squares Zernike fit of the wavefront over the valid pupil samples
+ *
+ * The fit solves the QR factorization of the basis sampled on the pupil points which rays pass.
+ * The factorization depends only on the sampling, the mask, the ordering and the number of terms, so it is kept in
+ * a process wide cache and fitting other fields and wavelengths of the same pupil costs a solve only.
+ */
+class ZernikeFit : public WaveAberration
+{
+public:
+    ZernikeFit(OpticalSystem *opt_sys);
+    ~ZernikeFit();
+
+    void SetOrdering(Zernike::Ordering ordering) { ordering_ = ordering; }
+
+    /** Number of terms from the term 1, default 37, which is also the maximum for Fringe */
+    void SetNumberOfTerms(int n) { num_terms_ = n; }
+
+    /** Fit the wavefront on nrd x nrd grid over the normalized pupil */
+    ZernikeCoefficients Fit(const Field* fld, double wvl, int nrd = 64);
+
+    /** Fit the OPD in waves on a square grid over [-1, 1] including the edges, rows along y, NaN where no ray passes */
+    ZernikeCoefficients Fit(const Eigen::MatrixXd& opd) const;
+
+    /** Wavefront of the coefficients on the pupil sampling, NaN outside the unit circle */
+    static Eigen::MatrixXd Evaluate(const ZernikeCoefficients& coefs, const PupilSampling& sampling);
+
+    /** Maximum number of cached factorizations, default 32 */
+    static void SetCacheCapacity(int n);
+
+    static int NumberOfCachedBases();
+
+    static void ClearCache();
+
+private:
+    ZernikeCoefficients fit(const PupilSampling& sampling, const Eigen::Array<bool, Eigen::Dynamic, Eigen::Dynamic>& mask, const Eigen::MatrixXd& opd) const;
+
+    Zernike::Ordering ordering_;
+    int num_terms_;
+};
+
+}
+
+#endif //GEOPTER_ZERNIKE_FIT_H
@@ -53,12 +53,14 @@ class Gap
 public:
     Gap();
     Gap(double t, std::shared_ptr<Material> m =nullptr);
+    Gap(const Gap& other);
     ~Gap();
 
     double Thickness() const { return thi_; }
     void SetThickness(double t) { thi_ = t; }
 
     Material* GetMaterial() const { return material_.get();}
+    std::shared_ptr<Material> GetSharedMaterial() const { return material_; }
     void SetMaterial(std::shared_ptr<Material> m);
 
     template <class T>
@@ -52,17 +52,23 @@ public:
     template<typename ... A>
     void SetupFromText(A... args);
 
-    int NumberOfSurfaces() { return num_surfs_;}
+    int NumberOfSurfaces() const { return num_surfs_;}
 
-    /** Get surface at the given index */
-    Surface* GetSurface(int i) const { return interfaces_[i].get();}
+    /** Get surface at the given index for modification. A surface shared with other systems is copied first. */
+    Surface* GetSurface(int i) { return detach(interfaces_[i]); }
 
-    /** Get gap at the given index */
-    Gap* GetGap(int i) const {return gaps_[i].get();}
+    /** Get surface at the given index for reading */
+    const Surface* GetSurface(int i) const { return interfaces_[i].get(); }
 
-    Surface* CurrentSurface() const {return interfaces_[current_surface_index_].get();}
+    /** Get gap at the given index for modification. A gap shared with other systems is copied first. */
+    Gap* GetGap(int i) { return detach(gaps_[i]); }
 
-    Gap* CurrentGap() const {return gaps_[current_surface_index_].get();}
+    /** Get gap at the given index for reading */
+    const Gap* GetGap(int i) const { return gaps_[i].get(); }
+
+    Surface* CurrentSurface() { return GetSurface(current_surface_index_); }
+
+    Gap* CurrentGap() { return GetGap(current_surface_index_); }
 
 
     /** Returns number of gaps */
@@ -72,16 +78,30 @@ public:
     int StopIndex() const { return stop_index_;}
 
     /** Returns surface at the stop index */
-    Surface* StopSurface() const { return interfaces_[stop_index_].get();}
+    Surface* StopSurface() { return GetSurface(stop_index_); }
+    const Surface* StopSurface() const { return GetSurface(stop_index_); }
 
     /** Returns the index of the image surface */
     int ImageIndex() const {return interfaces_.size()-1;}
 
     /** Returns image surface pointer */
-    Surface* ImageSurface() const {return interfaces_[interfaces_.size()-1].get();}
+    Surface* ImageSurface() { return GetSurface(ImageIndex()); }
+    const Surface* ImageSurface() const { return GetSurface(ImageIndex()); }
 
     /** Returns the last gap */
-    Gap* ImageSpaceGap() const;
+    Gap* ImageSpaceGap();
+    const Gap* ImageSpaceGap() const;
+
+    /**
+     * @brief Make this assembly a copy of the other
+     *
+     * Surfaces and gaps are shared with the other assembly rather than duplicated, and copied on the first
+     * modifying access from either side. Derived data such as transforms and semi-diameters are shared as well.
+     */
+    void CopyFrom(const OpticalAssembly& other);
+
+    /** Returns number of surfaces and gaps still shared with other assemblies */
+    int NumberOfSharedComponents() const;
 
     /** Set the given surface as stop */
     void SetStop(int i) { stop_index_ = i;}
@@ -109,7 +129,7 @@ public:
     void UpdateSemiDiameters();
 
     /** Returns overall length from start to end */
-    double OverallLength(int start, int end);
+    double OverallLength(int start, int end) const;
 
 
     /** List up model properties */
@@ -117,16 +137,32 @@ public:
     void Print() const;
 
 private:
+    /**
+     * @brief Copy the component if it is shared, and returns the pointer for modification
+     *
+     * The use count is not synchronized, so a system must not be modified while other threads access it.
+     * Reading through the const accessors never comes here.
+     */
+    template<class T>
+    static T* detach(std::shared_ptr<T>& component){
+        if(component.use_count() > 1){
+            component = std::make_shared<T>(*component);
+        }
+        return component.get();
+    }
+
+    /** Set global transform, leaving the surface shared if unchanged */
+    void set_global_transform(int i, const Transformation& tfrm);
+
     OpticalSystem* parent_;
 
-    std::vector< std::unique_ptr<Surface> > interfaces_;
-    std::vector< std::unique_ptr<Gap> > gaps_;
+    std::vector< std::shared_ptr<Surface> > interfaces_;
+    std::vector< std::shared_ptr<Gap> > gaps_;
 
     int stop_index_;
     int current_surface_index_;
 
     int num_surfs_;
-    int num_gaps_;
 
 };
 
@@ -48,6 +48,7 @@ class Surface
 {
 public:
     Surface();
+    Surface(const Surface& other);
     ~Surface();
 
     std::string InteractMode() const { return interact_mode_;}
@@ -70,7 +71,7 @@ public:
         std::visit([&](auto &p){ p.SetRadius(r);}, profile_);
     }
 
-    bool Intersect(Eigen::Vector3d& pt, double& distance, const Eigen::Vector3d& p0, const Eigen::Vector3d& dir){
+    bool Intersect(Eigen::Vector3d& pt, double& distance, const Eigen::Vector3d& p0, const Eigen::Vector3d& dir) const{
         return std::visit([&](auto p){ return p.Intersect(pt, distance, p0, dir);}, profile_);
     }
 
@@ -78,7 +79,7 @@ public:
         return std::visit([&](auto p){ return p.Normal(pt);}, profile_);
     }
 
-    double Sag(double x, double y){
+    double Sag(double x, double y) const{
         return std::visit([&](auto p){ return p.Sag(x,y);}, profile_);
     }
 
@@ -88,7 +89,12 @@ public:
     }
 
     template<class P>
-    bool IsProfile(){
+    auto Profile() const{
+        return std::get_if< SurfaceProfile<P> >(&profile_);
+    }
+
+    template<class P>
+    bool IsProfile() const{
         if(std::get_if< SurfaceProfile<P> >(&profile_)){
             return true;
         }else{
@@ -97,7 +103,7 @@ public:
     }
 
     template<class Shape>
-    bool IsAperture(){
+    bool IsAperture() const{
         if(std::get_if< Aperture<Shape> >(&clear_aperture_)){
             return true;
         }else{
@@ -110,6 +116,11 @@ public:
         return std::get_if< Aperture<Shape> >(&clear_aperture_);
     }
 
+    template<class Shape>
+    auto GetClearAperture() const{
+        return std::get_if< Aperture<Shape> >(&clear_aperture_);
+    }
+
     /** Return aperture shape name. If no aperture is set, returns "None" */
     std::string ApertureShape() const;
 
@@ -0,0 +1,168 @@
+#ifndef GEOPTER_DUAL_H
+#define GEOPTER_DUAL_H
+
+#include <cmath>
+#include <limits>
+
+#include "Eigen/Core"
+
+namespace geopter {
+
+/** Dual number type and its arithmetic live in a nested namespace so that the math overloads are found
+ *  only through ADL and do not hide the standard ones for double inside geopter.
+ */
+namespace ad {
+
+/** Forward-mode dual number (jet) carrying N partial derivatives
+ *
+ *  a is the value and v holds the derivatives with respect to N seeded parameters.
+ *  Trace kernels templated on the scalar type can be evaluated on Dual<N> to obtain
+ *  exact gradients in a single pass.
+ */
+template<int N>
+struct Dual
+{
+    using Gradient = Eigen::Matrix<double, N, 1>;
+
+    Dual() : a(0.0) { v.setZero(); }
+    Dual(double value) : a(value) { v.setZero(); }
+    Dual(double value, const Gradient& grad) : a(value), v(grad) {}
+
+    /** Create a variable seeded at the k-th derivative slot */
+    static Dual Variable(double value, int k){
+        Dual d(value);
+        d.v(k) = 1.0;
+        return d;
+    }
+
+    Dual& operator+=(const Dual& y){ a += y.a; v += y.v; return *this; }
+    Dual& operator-=(const Dual& y){ a -= y.a; v -= y.v; return *this; }
+    Dual& operator*=(const Dual& y){ v = v*y.a + a*y.v; a *= y.a; return *this; }
+    Dual& operator/=(const Dual& y){ const double inv = 1.0/y.a; a *= inv; v = (v - a*y.v)*inv; return *this; }
+
+    Dual& operator+=(double s){ a += s; return *this; }
+    Dual& operator-=(double s){ a -= s; return *this; }
+    Dual& operator*=(double s){ a *= s; v *= s; return *this; }
+    Dual& operator/=(double s){ a /= s; v /= s; return *this; }
+
+    double a;
+    Gradient v;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+template<int N> inline Dual<N> operator+(const Dual<N>& x) { return x; }
+template<int N> inline Dual<N> operator-(const Dual<N>& x) { return Dual<N>(-x.a, -x.v); }
+
+template<int N> inline Dual<N> operator+(const Dual<N>& x, const Dual<N>& y) { return Dual<N>(x.a + y.a, x.v + y.v); }
+template<int N> inline Dual<N> operator+(const Dual<N>& x, double s)         { return Dual<N>(x.a + s, x.v); }
+template<int N> inline Dual<N> operator+(double s, const Dual<N>& x)         { return Dual<N>(s + x.a, x.v); }
+
+template<int N> inline Dual<N> operator-(const Dual<N>& x, const Dual<N>& y) { return Dual<N>(x.a - y.a, x.v - y.v); }
+template<int N> inline Dual<N> operator-(const Dual<N>& x, double s)         { return Dual<N>(x.a - s, x.v); }
+template<int N> inline Dual<N> operator-(double s, const Dual<N>& x)         { return Dual<N>(s - x.a, -x.v); }
+
+template<int N> inline Dual<N> operator*(const Dual<N>& x, const Dual<N>& y) { return Dual<N>(x.a*y.a, x.a*y.v + x.v*y.a); }
+template<int N> inline Dual<N> operator*(const Dual<N>& x, double s)         { return Dual<N>(x.a*s, x.v*s); }
+template<int N> inline Dual<N> operator*(double s, const Dual<N>& x)         { return Dual<N>(s*x.a, s*x.v); }
+
+template<int N> inline Dual<N> operator/(const Dual<N>& x, const Dual<N>& y) {
+    const double inv = 1.0/y.a;
+    const double q = x.a*inv;
+    return Dual<N>(q, (x.v - q*y.v)*inv);
+}
+template<int N> inline Dual<N> operator/(const Dual<N>& x, double s) { return Dual<N>(x.a/s, x.v/s); }
+template<int N> inline Dual<N> operator/(double s, const Dual<N>& x) {
+    const double inv = 1.0/x.a;
+    return Dual<N>(s*inv, -s*inv*inv*x.v);
+}
+
+// comparisons act on the value part only
+template<int N> inline bool operator< (const Dual<N>& x, const Dual<N>& y) { return x.a <  y.a; }
+template<int N> inline bool operator<=(const Dual<N>& x, const Dual<N>& y) { return x.a <= y.a; }
+template<int N> inline bool operator> (const Dual<N>& x, const Dual<N>& y) { return x.a >  y.a; }
+template<int N> inline bool operator>=(const Dual<N>& x, const Dual<N>& y) { return x.a >= y.a; }
+template<int N> inline bool operator==(const Dual<N>& x, const Dual<N>& y) { return x.a == y.a; }
+template<int N> inline bool operator!=(const Dual<N>& x, const Dual<N>& y) { return x.a != y.a; }
+template<int N> inline bool operator< (const Dual<N>& x, double s) { return x.a <  s; }
+template<int N> inline bool operator<=(const Dual<N>& x, double s) { return x.a <= s; }
+template<int N> inline bool operator> (const Dual<N>& x, double s) { return x.a >  s; }
+template<int N> inline bool operator>=(const Dual<N>& x, double s) { return x.a >= s; }
+template<int N> inline bool operator< (double s, const Dual<N>& x) { return s <  x.a; }
+template<int N> inline bool operator> (double s, const Dual<N>& x) { return s >  x.a; }
+
+// elementary functions, found by ADL from the templated kernels
+template<int N> inline Dual<N> sqrt(const Dual<N>& x) {
+    const double s = std::sqrt(x.a);
+    return Dual<N>(s, x.v*(0.5/s));
+}
+template<int N> inline Dual<N> abs(const Dual<N>& x)  { return (x.a < 0.0) ? -x : x; }
+template<int N> inline Dual<N> fabs(const Dual<N>& x) { return abs(x); }
+template<int N> inline Dual<N> sin(const Dual<N>& x)  { return Dual<N>(std::sin(x.a),  std::cos(x.a)*x.v); }
+template<int N> inline Dual<N> cos(const Dual<N>& x)  { return Dual<N>(std::cos(x.a), -std::sin(x.a)*x.v); }
+template<int N> inline Dual<N> tan(const Dual<N>& x)  {
+    const double t = std::tan(x.a);
+    return Dual<N>(t, (1.0 + t*t)*x.v);
+}
+template<int N> inline Dual<N> atan(const Dual<N>& x) { return Dual<N>(std::atan(x.a), x.v/(1.0 + x.a*x.a)); }
+template<int N> inline Dual<N> asin(const Dual<N>& x) { return Dual<N>(std::asin(x.a), x.v/std::sqrt(1.0 - x.a*x.a)); }
+template<int N> inline Dual<N> exp(const Dual<N>& x)  {
+    const double e = std::exp(x.a);
+    return Dual<N>(e, e*x.v);
+}
+template<int N> inline Dual<N> log(const Dual<N>& x)  { return Dual<N>(std::log(x.a), x.v/x.a); }
+template<int N> inline Dual<N> pow(const Dual<N>& x, double p) {
+    const double xp = std::pow(x.a, p - 1.0);
+    return Dual<N>(xp*x.a, p*xp*x.v);
+}
+template<int N> inline bool isnan(const Dual<N>& x) { return std::isnan(x.a); }
+template<int N> inline bool isinf(const Dual<N>& x) { return std::isinf(x.a); }
+
+} // namespace ad
+
+using ad::Dual;
+
+
+/** Returns the value part of a scalar, whether it is a plain double or a dual number */
+inline double ScalarValue(double x) { return x; }
+
+template<int N>
+inline double ScalarValue(const ad::Dual<N>& x) { return x.a; }
+
+} // namespace geopter
+
+
+namespace Eigen {
+
+template<int N>
+struct NumTraits< geopter::Dual<N> > : NumTraits<double>
+{
+    typedef geopter::Dual<N> Real;
+    typedef geopter::Dual<N> NonInteger;
+    typedef geopter::Dual<N> Nested;
+    typedef geopter::Dual<N> Literal;
+
+    static inline Real dummy_precision() { return Real(NumTraits<double>::dummy_precision()); }
+    static inline Real epsilon() { return Real(std::numeric_limits<double>::epsilon()); }
+    static inline int digits10() { return NumTraits<double>::digits10(); }
+
+    enum {
+        IsComplex = 0,
+        IsInteger = 0,
+        IsSigned = 1,
+        RequireInitialization = 1,
+        ReadCost = 1,
+        AddCost = 1 + N,
+        MulCost = 1 + 2*N
+    };
+};
+
+template<int N, typename BinaryOp>
+struct ScalarBinaryOpTraits<geopter::Dual<N>, double, BinaryOp> { typedef geopter::Dual<N> ReturnType; };
+
+template<int N, typename BinaryOp>
+struct ScalarBinaryOpTraits<double, geopter::Dual<N>, BinaryOp> { typedef geopter::Dual<N> ReturnType; };
+
+} // namespace Eigen
+
+#endif //GEOPTER_DUAL_H
@@ -0,0 +1,66 @@
+#ifndef GEOPTER_FOURIER_TRANSFORM_H
+#define GEOPTER_FOURIER_TRANSFORM_H
+
+#include <complex>
+
+#include "Eigen/Core"
+
+namespace geopter {
+
+/**
+ * @brief Discrete Fourier transforms with cached plans
+ *
+ * Power of two sizes are transformed in place by the radix-2 algorithm. The bit reversal table and the twiddle
+ * factors of each size are computed once and kept for the following calls, which may come from any thread.
+ * Other sizes are passed to Eigen::FFT.
+ *
+ * 2D transforms run the column and row passes on multiple threads. Sign and normalization follow MatrixTool::fft2/ifft2,
+ * i.e. the forward transform is not scaled and the inverse transform is scaled by 1/(rows*cols).
+ */
+class FourierTransform
+{
+public:
+    /** 1D forward transform in place */
+    static void Forward(std::complex<double>* data, int n);
+
+    /** 1D inverse transform in place, scaled by 1/n */
+    static void Inverse(std::complex<double>* data, int n);
+
+    /**
+     * @brief 2D forward transform in place
+     * @param num_threads number of threads. If <= 0, Parallel::NumberOfThreads() is used for large matrices.
+     */
+    static void Forward2(Eigen::MatrixXcd& mat, int num_threads = 0);
+
+    /** 2D inverse transform in place */
+    static void Inverse2(Eigen::MatrixXcd& mat, int num_threads = 0);
+
+    /**
+     * @brief 2D forward transform of real input
+     *
+     * Pairs of real columns are packed into one complex column for the first pass, which halves its cost.
+     * The full spectrum is returned.
+     */
+    static void Forward2(Eigen::MatrixXcd& out, const Eigen::MatrixXd& in, int num_threads = 0);
+
+    /**
+     * @brief 2D forward transform at arbitrary frequencies by matrix products
+     *
+     * out(m, n) = sum of in(i, j)*exp(-2*pi*i*(freq_y(m)*(i - ci) + freq_x(n)*(j - cj))), where (ci, cj) is the center of the input.
+     * The output frequencies are independent of the input size, so a small window of the spectrum can be sampled as finely as
+     * required without zero padding. The cost is proportional to the input size times the output size along each axis.
+     *
+     * @param freq_x frequencies of the output columns in cycles per sample
+     * @param freq_y frequencies of the output rows in cycles per sample
+     */
+    static void Matrix2(Eigen::MatrixXcd& out, const Eigen::MatrixXcd& in, const Eigen::VectorXd& freq_x, const Eigen::VectorXd& freq_y, int num_threads = 0);
+
+    static bool IsPowerOfTwo(int n) { return n > 0 && (n & (n - 1)) == 0; }
+
+    /** Release all the cached plans */
+    static void ClearPlans();
+};
+
+} //namespace geopter
+
+#endif //GEOPTER_FOURIER_TRANSFORM_H
@@ -0,0 +1,28 @@
+#ifndef GEOPTER_PARALLEL_H
+#define GEOPTER_PARALLEL_H
+
+#include <functional>
+
+namespace geopter {
+
+/** Minimal thread pool helpers built on std::thread */
+class Parallel
+{
+public:
+    /** Returns number of hardware threads, at least 1 */
+    static int NumberOfThreads();
+
+    /**
+     * @brief Call func(i) for i in [begin, end) on multiple threads
+     *
+     * Indices are handed out one by one from a shared counter, so uneven work items are balanced.
+     * The function returns after all calls have finished.
+     *
+     * @param num_threads number of worker threads. If <= 0, NumberOfThreads() is used.
+     */
+    static void For(int begin, int end, const std::function<void(int)>& func, int num_threads = 0);
+};
+
+} //namespace geopter
+
+#endif //GEOPTER_PARALLEL_H
@@ -0,0 +1,74 @@
+#ifndef GEOPTER_PROCESS_SHARD_H
+#define GEOPTER_PROCESS_SHARD_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace geopter {
+
+/**
+ * @brief Run independent jobs on several worker processes of the local machine
+ *
+ * The workers are forked from the calling process, so each of them starts with a copy of the whole
+ * process state, including the optical system, and nothing has to be serialized on the way in.
+ * Each worker takes a contiguous range of the pending jobs and sends the results back through a pipe.
+ *
+ * If a checkpoint file is set, every completed result is appended to it, and the jobs already recorded
+ * there are skipped when the run is started again, e.g. after an interruption or a crashed worker.
+ * The file is resumed only if its header matches the number of jobs, the result size and the fingerprint,
+ * which the caller derives from everything that determines the results.
+ *
+ * Jobs left to the calling process, including all jobs with a single process, run on threads.
+ *
+ * Multiple processes are available only on Linux. Elsewhere the jobs run in the calling process.
+ */
+class ProcessShard
+{
+public:
+    /** job(job_index, result) fills result_size values of the job. Must be thread safe. */
+    using Job = std::function<void(int, double*)>;
+
+    ProcessShard(int result_size);
+    ~ProcessShard();
+
+    /** Number of worker processes. If <= 0, Parallel::NumberOfThreads() is used. */
+    void SetNumberOfProcesses(int n) { num_processes_ = n; }
+
+    /** Number of threads for the jobs run in the calling process. If <= 0, Parallel::NumberOfThreads() is used. */
+    void SetNumberOfThreads(int n) { num_threads_ = n; }
+
+    /** Set checkpoint file, empty for no checkpoint */
+    void SetCheckpointFile(const std::string& path) { checkpoint_path_ = path; }
+
+    /** Identity of the run recorded in the checkpoint, a single token without white space */
+    void SetFingerprint(const std::string& fingerprint) { fingerprint_ = fingerprint; }
+
+    /**
+     * @brief Run jobs in [0, num_jobs)
+     * @param results num_jobs x result_size values, NaN for the jobs which have not been completed
+     * @return number of completed jobs, including the ones restored from the checkpoint
+     */
+    int Run(std::vector<double>& results, int num_jobs, const Job& job);
+
+    /** Whether the job was completed by the last Run(), as opposed to lost with a crashed worker */
+    bool IsCompleted(int job_index) const { return done_[job_index]; }
+
+private:
+    std::string header(int num_jobs) const;
+
+    bool read_checkpoint(std::vector<double>& results, std::vector<bool>& done, int num_jobs) const;
+    void write_record(std::ostream& os, int job_index, const double* result) const;
+
+    int result_size_;
+    int num_processes_;
+    int num_threads_;
+    std::string checkpoint_path_;
+    std::string fingerprint_;
+
+    std::vector<bool> done_;
+};
+
+} //namespace geopter
+
+#endif //GEOPTER_PROCESS_SHARD_H
@@ -0,0 +1,38 @@
+#ifndef GEOPTER_PERTURBED_MATERIAL_H
+#define GEOPTER_PERTURBED_MATERIAL_H
+
+#include <memory>
+
+#include "material.h"
+
+namespace geopter {
+
+/** Material with index and dispersion offsets applied on top of a base material
+ *
+ *  The refractive index at d-line is shifted by delta_nd, and the dispersion around d-line is divided by
+ *  abbe_scale, so that the Abbe number is approximately scaled by abbe_scale. Used in tolerancing.
+ */
+class PerturbedMaterial : public Material
+{
+public:
+    PerturbedMaterial(std::shared_ptr<Material> base, double delta_nd, double abbe_scale = 1.0);
+    ~PerturbedMaterial();
+
+    double RefractiveIndex(double wv_nm) const override;
+
+    /** Returns name of the base material */
+    std::string Name() const override;
+
+    std::shared_ptr<Material> Base() const { return base_; }
+    double DeltaNd() const { return delta_nd_; }
+    double AbbeScale() const { return abbe_scale_; }
+
+private:
+    std::shared_ptr<Material> base_;
+    double delta_nd_;
+    double abbe_scale_;
+};
+
+}
+
+#endif //GEOPTER_PERTURBED_MATERIAL_H
@@ -40,12 +40,23 @@
 #include "analysis/spherochromatism.h"
 #include "analysis/chromatic_focus_shift.h"
 #include "analysis/spot_diagram.h"
+#include "analysis/spot_statistics.h"
+#include "analysis/irradiance_map.h"
 #include "analysis/transverse_ray_fan.h"
 #include "analysis/opd_fan.h"
 #include "analysis/wavefront.h"
+#include "analysis/wavefront_cache.h"
 #include "analysis/diffractive_psf.h"
+#include "analysis/huygens_psf.h"
 #include "analysis/geometrical_mtf.h"
 #include "analysis/diffractive_mtf.h"
+#include "analysis/through_focus.h"
+#include "analysis/zernike_fit.h"
+#include "analysis/pupil_sampler.h"
+#include "analysis/qmc_estimator.h"
+#include "analysis/adaptive_pupil_sampler.h"
+#include "analysis/pupil_boundary.h"
+#include "analysis/ray_surrogate.h"
 
 #include "assembly/optical_assembly.h"
 
@@ -56,6 +67,7 @@
 
 #include "material/material_library.h"
 #include "material/buchdahl_glass.h"
+#include "material/perturbed_material.h"
 
 #include "spec/optical_spec.h"
 #include "spec/spectral_line.h"
@@ -63,7 +75,10 @@
 #include "paraxial/paraxial_trace.h"
 
 #include "sequential/sequential_trace.h"
+#include "sequential/differentiable_trace.h"
+#include "sequential/batched_trace.h"
 #include "sequential/ray.h"
+#include "sequential/ray_snapshot.h"
 #include "sequential/trace_error.h"
 
 #include "element/lens.h"
@@ -77,6 +92,18 @@
 //#include "renderer/renderer_gnuplot.h"
 #include "renderer/rgb.h"
 
+#include "optimization/spot_merit_function.h"
+#include "optimization/operand_merit_function.h"
+#include "optimization/operands.h"
+#include "optimization/local_optimizer.h"
+#include "optimization/global_optimizer.h"
+#include "optimization/glass_substitution.h"
+#include "optimization/wavefront_merit_function.h"
+#include "optimization/mtf_merit_function.h"
+
+#include "tolerance/tolerance_operand.h"
+#include "tolerance/tolerance_analysis.h"
+
 #include "common/string_tool.h"
 
 #include "environment/environment.h"
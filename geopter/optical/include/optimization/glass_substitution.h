@@ -0,0 +1,100 @@
+#ifndef GEOPTER_GLASS_SUBSTITUTION_H
+#define GEOPTER_GLASS_SUBSTITUTION_H
+
+#include <vector>
+#include <string>
+#include <memory>
+
+#include "optimization/merit_function.h"
+#include "optimization/local_optimizer.h"
+#include "material/material.h"
+
+namespace geopter {
+
+class OpticalSystem;
+
+/** Result of a single glass trial */
+struct GlassTrial
+{
+    int gap_index;
+    std::shared_ptr<Material> material;
+
+    /** distance from the original glass on (nd, vd) */
+    double distance;
+
+    /** merit value after refocus/re-optimization. Infinity if rejected or failed. */
+    double merit;
+
+    /** true if rejected by the paraxial screening */
+    bool rejected;
+};
+
+
+/**
+ * @brief Glass substitution search over the loaded catalogs
+ *
+ * For each substitutable gap, catalog glasses are ranked by their distance to the current glass on the
+ * (nd, vd) plane and the nearest candidates are tried one by one, each on its own clone of the system.
+ * A trial is first screened with paraxial estimates (focal length change and axial color) and only the
+ * survivors are refocused, optionally re-optimized, and scored by the merit function. Trials are evaluated
+ * in parallel.
+ */
+class GlassSubstitution
+{
+public:
+    GlassSubstitution(const MeritFunction* merit, const LocalOptimizer* local_optimizer = nullptr);
+
+    void AddSubstitutableGap(int gap_index);
+
+    /** Number of candidates per gap */
+    void SetMaxCandidates(int n) { max_candidates_ = n; }
+
+    /** Scales of nd and vd for the candidate distance */
+    void SetDistanceScale(double nd_scale, double vd_scale) { nd_scale_ = nd_scale; vd_scale_ = vd_scale; }
+
+    /** Reject the trial if |efl/efl0 - 1| exceeds the limit */
+    void SetFocalLengthTolerance(double rel) { efl_tolerance_ = rel; }
+
+    /** Reject the trial if the paraxial axial color grows by more than the limit */
+    void SetAxialColorTolerance(double val) { axial_color_tolerance_ = val; }
+
+    /** Move the image surface to the paraxial focus before the evaluation */
+    void SetRefocus(bool state) { do_refocus_ = state; }
+
+    void SetNumberOfThreads(int n) { num_threads_ = n; }
+
+    /** Returns candidates for the gap sorted by distance */
+    std::vector<GlassTrial> Candidates(const OpticalSystem* opt_sys, int gap_index) const;
+
+    /** Evaluate all trials. Results are sorted by merit. */
+    std::vector<GlassTrial> Run(const OpticalSystem* opt_sys) const;
+
+    /** Apply the trial to the system, including refocus and re-optimization */
+    void Apply(OpticalSystem* opt_sys, const GlassTrial& trial) const;
+
+    /** Paraxial axial color; image side focus difference between the shortest and the longest wavelengths */
+    static double AxialColor(OpticalSystem* opt_sys);
+
+    /** Set image distance to the paraxial focus of the reference wavelength */
+    static void Refocus(OpticalSystem* opt_sys);
+
+private:
+    bool screen(OpticalSystem* opt_sys, double efl0, double axial_color0) const;
+    void evaluate(GlassTrial& trial, const OpticalSystem* opt_sys, double efl0, double axial_color0) const;
+
+    const MeritFunction* merit_;
+    const LocalOptimizer* local_optimizer_;
+    std::vector<int> gaps_;
+
+    int max_candidates_;
+    double nd_scale_;
+    double vd_scale_;
+    double efl_tolerance_;
+    double axial_color_tolerance_;
+    bool do_refocus_;
+    int num_threads_;
+};
+
+}
+
+#endif //GEOPTER_GLASS_SUBSTITUTION_H
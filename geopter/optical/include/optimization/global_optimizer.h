@@ -0,0 +1,107 @@
+#ifndef GEOPTER_GLOBAL_OPTIMIZER_H
+#define GEOPTER_GLOBAL_OPTIMIZER_H
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <random>
+
+#include "Eigen/Core"
+
+#include "optimization/local_optimizer.h"
+
+namespace geopter {
+
+/** A solution found by GlobalOptimizer */
+struct OptimizationResult
+{
+    /** merit value */
+    double merit;
+
+    /** values of the local optimizer variables */
+    Eigen::VectorXd values;
+
+    /** material names of the glass variables */
+    std::vector<std::string> glasses;
+
+    /** rounded prescription used to identify duplicated solutions */
+    std::string fingerprint;
+
+    /** index of the start which found this solution */
+    int start_index;
+};
+
+
+/**
+ * @brief Multi-start basin hopping optimizer
+ *
+ * Each start clones the system, perturbs the variables (and model glasses, if glass variables are given)
+ * and runs a local optimization, followed by a number of hops which perturb the current solution, re-optimize
+ * and accept the result by Metropolis criterion. Starts are independent and run in parallel. Each start has its
+ * own random generator seeded from (seed, start index), so the results do not depend on the number of threads
+ * or on the scheduling order.
+ *
+ * Solutions are collected in a shared store of best results, where duplicates are pruned by the fingerprint
+ * of the rounded prescription.
+ */
+class GlobalOptimizer
+{
+public:
+    GlobalOptimizer(const LocalOptimizer* local_optimizer);
+
+    void SetSeed(unsigned int seed) { seed_ = seed; }
+    void SetNumberOfStarts(int n) { num_starts_ = n; }
+    void SetNumberOfHops(int n) { num_hops_ = n; }
+
+    /** Perturbation size relative to the variable magnitude */
+    void SetStepSize(double step) { step_ = step; }
+
+    /** Metropolis temperature, relative to the current merit value */
+    void SetTemperature(double t) { temperature_ = t; }
+
+    /** Number of worker threads. If <= 0, all hardware threads are used. */
+    void SetNumberOfThreads(int n) { num_threads_ = n; }
+
+    /** Maximum number of results kept in the store */
+    void SetMaxResults(int n) { max_results_ = n; }
+
+    /** Allow the material of the gap to be replaced with a perturbed model glass (nd:vd) */
+    void AddGlassVariable(int gap_index);
+
+    /** Run the search from the given system. The system is not modified. */
+    void Run(const OpticalSystem* opt_sys);
+
+    /** Returns best solution found so far. Can be called while Run() is in progress. */
+    OptimizationResult Best() const;
+
+    /** Returns all stored solutions sorted by merit */
+    std::vector<OptimizationResult> Results() const;
+
+    /** Apply the solution to the system */
+    void Apply(OpticalSystem* opt_sys, const OptimizationResult& result) const;
+
+private:
+    void run_start(const OpticalSystem* opt_sys, int start_index);
+    void perturb(OpticalSystem* opt_sys, std::mt19937_64& rng) const;
+    OptimizationResult make_result(OpticalSystem* opt_sys, double merit, int start_index) const;
+    std::string fingerprint(const Eigen::VectorXd& values, const std::vector<std::string>& glasses) const;
+    void submit(const OptimizationResult& result);
+
+    const LocalOptimizer* local_optimizer_;
+    std::vector<int> glass_gaps_;
+
+    unsigned int seed_;
+    int num_starts_;
+    int num_hops_;
+    double step_;
+    double temperature_;
+    int num_threads_;
+    int max_results_;
+
+    std::vector<OptimizationResult> results_;
+    mutable std::mutex mutex_;
+};
+
+}
+
+#endif //GEOPTER_GLOBAL_OPTIMIZER_H
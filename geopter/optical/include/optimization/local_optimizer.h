@@ -0,0 +1,54 @@
+#ifndef GEOPTER_LOCAL_OPTIMIZER_H
+#define GEOPTER_LOCAL_OPTIMIZER_H
+
+#include <vector>
+
+#include "Eigen/Core"
+
+#include "system/system_parameter.h"
+#include "optimization/merit_function.h"
+
+namespace geopter {
+
+/**
+ * @brief Damped least squares (Levenberg-Marquardt) optimizer
+ *
+ * The Jacobian is computed by finite differences. Run() keeps all its state on the stack,
+ * so one optimizer can be used from several threads on different systems.
+ */
+class LocalOptimizer
+{
+public:
+    LocalOptimizer(const MeritFunction* merit, const std::vector<SystemParameter>& variables);
+
+    const std::vector<SystemParameter>& Variables() const { return variables_; }
+
+    void SetMaxIterations(int n) { max_iter_ = n; }
+
+    /** Set lower/upper limit of the i-th variable. Thicknesses are bounded at zero by default. */
+    void SetBounds(int i, double lower, double upper);
+    double LowerBound(int i) const { return lower_[i]; }
+    double UpperBound(int i) const { return upper_[i]; }
+
+    /** Optimize the system in place and return the final merit value */
+    double Run(OpticalSystem* opt_sys) const;
+
+    /** Returns current variable values */
+    Eigen::VectorXd GetValues(const OpticalSystem* opt_sys) const;
+
+    /** Set variable values and update the model */
+    void SetValues(OpticalSystem* opt_sys, const Eigen::VectorXd& x) const;
+
+private:
+    bool compute_jacobian(Eigen::MatrixXd& J, OpticalSystem* opt_sys, const Eigen::VectorXd& x, const Eigen::VectorXd& r) const;
+
+    const MeritFunction* merit_;
+    std::vector<SystemParameter> variables_;
+    std::vector<double> lower_;
+    std::vector<double> upper_;
+    int max_iter_;
+};
+
+}
+
+#endif //GEOPTER_LOCAL_OPTIMIZER_H
@@ -0,0 +1,33 @@
+#ifndef GEOPTER_MERIT_FUNCTION_H
+#define GEOPTER_MERIT_FUNCTION_H
+
+#include "Eigen/Core"
+
+namespace geopter {
+
+class OpticalSystem;
+
+/**
+ * @brief Base class of merit functions for least squares optimization
+ *
+ * Evaluate() must not modify the merit function object. One instance is shared by optimizers
+ * running concurrently on their own clones of the system.
+ */
+class MeritFunction
+{
+public:
+    virtual ~MeritFunction(){}
+
+    /**
+     * @brief Compute weighted residuals of the given system. The merit value is the sum of squares.
+     * @return false if the system could not be evaluated, e.g. ray trace failure
+     */
+    virtual bool Evaluate(Eigen::VectorXd& residuals, OpticalSystem* opt_sys) const = 0;
+
+    /** Returns sum of squared residuals, or infinity if the evaluation failed */
+    double Value(OpticalSystem* opt_sys) const;
+};
+
+}
+
+#endif //GEOPTER_MERIT_FUNCTION_H
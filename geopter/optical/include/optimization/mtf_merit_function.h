@@ -0,0 +1,32 @@
+#ifndef GEOPTER_MTF_MERIT_FUNCTION_H
+#define GEOPTER_MTF_MERIT_FUNCTION_H
+
+#include <vector>
+
+#include "optimization/merit_function.h"
+
+namespace geopter {
+
+/**
+ * @brief MTF loss merit function
+ *
+ * The diffraction MTF is computed by DiffractiveMTF::ComputeOTF at the given frequencies, in the sagittal and
+ * tangential directions, for every field and wavelength. Residuals are 1 - MTF weighted by field and wavelength
+ * weights so that the square root of the merit value is the weighted RMS loss of contrast.
+ */
+class MtfMeritFunction : public MeritFunction
+{
+public:
+    /** @param freqs spatial frequencies in cycles per system unit */
+    MtfMeritFunction(const std::vector<double>& freqs, int nrd = 32);
+
+    bool Evaluate(Eigen::VectorXd& residuals, OpticalSystem* opt_sys) const override;
+
+private:
+    std::vector<double> freqs_;
+    int nrd_;
+};
+
+}
+
+#endif //GEOPTER_MTF_MERIT_FUNCTION_H
@@ -0,0 +1,104 @@
+#ifndef GEOPTER_OPERAND_H
+#define GEOPTER_OPERAND_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <memory>
+
+#include "Eigen/Core"
+
+#include "sequential/ray.h"
+#include "paraxial/paraxial_ray.h"
+
+namespace geopter {
+
+class OpticalSystem;
+
+/** Real ray required by an operand */
+struct RayRequest
+{
+    RayRequest(int fi, int wi, const Eigen::Vector2d& pupil_crd) :
+        field_index(fi), wvl_index(wi), pupil(pupil_crd) {}
+
+    int field_index;
+    int wvl_index;
+    Eigen::Vector2d pupil;
+};
+
+
+/**
+ * @brief Shared trace results for a merit function evaluation
+ *
+ * Rays are stored once for each unique (field, wavelength, pupil) and looked up by the operands.
+ */
+class OperandContext
+{
+public:
+    OperandContext(OpticalSystem* opt_sys);
+
+    OpticalSystem* GetOpticalSystem() const { return opt_sys_; }
+
+    /** Returns the traced ray for the request. nullptr if the ray was not requested or the trace failed. */
+    const Ray* GetRay(const RayRequest& request) const;
+
+    /** Paraxial marginal ray at the reference wavelength */
+    ParaxialRay* GetParaxialMarginalRay() const { return ax_ray_.get(); }
+
+    /** Paraxial chief ray of the maximum field at the reference wavelength */
+    ParaxialRay* GetParaxialChiefRay() const { return pr_ray_.get(); }
+
+    using RayKey = std::tuple<int, int, double, double>;
+
+    static RayKey MakeKey(const RayRequest& request) {
+        return RayKey(request.field_index, request.wvl_index, request.pupil(0), request.pupil(1));
+    }
+
+private:
+    friend class OperandMeritFunction;
+
+    OpticalSystem* opt_sys_;
+    const std::map<RayKey, int>* ray_index_;
+    std::vector<RayPtr> rays_;
+    std::vector<bool> ray_valid_;
+    std::shared_ptr<ParaxialRay> ax_ray_;
+    std::shared_ptr<ParaxialRay> pr_ray_;
+};
+
+
+/** Base class of merit function operands */
+class Operand
+{
+public:
+    Operand(double target = 0.0, double weight = 1.0) :
+        target_(target), weight_(weight) {}
+    virtual ~Operand(){}
+
+    virtual std::string Name() const = 0;
+
+    /** Append the real rays this operand needs */
+    virtual void RequestRays(std::vector<RayRequest>& /*requests*/) const {}
+
+    /** Returns true if the operand uses the paraxial rays in the context */
+    virtual bool NeedsParaxialTrace() const { return false; }
+
+    /** Compute the operand value from the shared trace results */
+    virtual bool Compute(double& value, const OperandContext& ctx) const = 0;
+
+    double Target() const { return target_; }
+    double Weight() const { return weight_; }
+
+    void SetTarget(double val) { target_ = val; }
+    void SetWeight(double w) { weight_ = w; }
+
+protected:
+    double target_;
+    double weight_;
+};
+
+using OperandPtr = std::shared_ptr<Operand>;
+
+}
+
+#endif //GEOPTER_OPERAND_H
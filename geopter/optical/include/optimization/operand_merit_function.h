@@ -0,0 +1,60 @@
+#ifndef GEOPTER_OPERAND_MERIT_FUNCTION_H
+#define GEOPTER_OPERAND_MERIT_FUNCTION_H
+
+#include <vector>
+
+#include "optimization/merit_function.h"
+#include "optimization/operand.h"
+
+namespace geopter {
+
+/**
+ * @brief Merit function composed of operands
+ *
+ * When operands are added, the rays they request are merged into a plan in which each unique
+ * (field, wavelength, pupil) appears once, grouped by field and wavelength. An evaluation traces the
+ * plan once, runs the paraxial trace only if some operand needs it, and then computes every operand
+ * from the shared results. The cost is therefore proportional to the number of distinct rays rather than
+ * to the number of operands.
+ */
+class OperandMeritFunction : public MeritFunction
+{
+public:
+    OperandMeritFunction();
+
+    void AddOperand(OperandPtr op);
+    void Clear();
+
+    int NumberOfOperands() const { return operands_.size(); }
+    Operand* GetOperand(int i) const { return operands_[i].get(); }
+
+    /** Returns number of unique rays traced in one evaluation */
+    int NumberOfRays() const { return ray_index_.size(); }
+
+    /** Compute weighted residuals, weight*(value - target) */
+    bool Evaluate(Eigen::VectorXd& residuals, OpticalSystem* opt_sys) const override;
+
+    /** Compute raw operand values */
+    bool ComputeValues(std::vector<double>& values, OpticalSystem* opt_sys) const;
+
+private:
+    struct RayGroup
+    {
+        int field_index;
+        int wvl_index;
+        std::vector<Eigen::Vector2d> pupils;
+        std::vector<int> ray_indices;
+    };
+
+    void build_plan();
+    bool trace_plan(OperandContext& ctx) const;
+
+    std::vector<OperandPtr> operands_;
+    std::vector<RayGroup> groups_;
+    std::map<OperandContext::RayKey, int> ray_index_;
+    bool needs_paraxial_;
+};
+
+}
+
+#endif //GEOPTER_OPERAND_MERIT_FUNCTION_H
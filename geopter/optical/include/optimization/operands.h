@@ -0,0 +1,91 @@
+#ifndef GEOPTER_OPERANDS_H
+#define GEOPTER_OPERANDS_H
+
+#include "optimization/operand.h"
+
+namespace geopter {
+
+/** Effective focal length from first order data */
+class EffectiveFocalLengthOperand : public Operand
+{
+public:
+    EffectiveFocalLengthOperand(double target, double weight = 1.0);
+
+    std::string Name() const override { return "EFL"; }
+    bool Compute(double& value, const OperandContext& ctx) const override;
+};
+
+
+/** RMS spot radius about the centroid, sampled on hexapolar rings */
+class SpotRmsOperand : public Operand
+{
+public:
+    SpotRmsOperand(int fi, int wi, int num_rings = 3, double target = 0.0, double weight = 1.0);
+
+    std::string Name() const override { return "RMS"; }
+    void RequestRays(std::vector<RayRequest>& requests) const override;
+    bool Compute(double& value, const OperandContext& ctx) const override;
+
+private:
+    int field_index_;
+    int wvl_index_;
+    std::vector<Eigen::Vector2d> pupils_;
+};
+
+
+/** Real ray intercept coordinate at the given surface */
+class RayHeightOperand : public Operand
+{
+public:
+    /**
+     * @param axis 0: x, 1: y
+     */
+    RayHeightOperand(int srf, int fi, int wi, const Eigen::Vector2d& pupil, int axis = 1, double target = 0.0, double weight = 1.0);
+
+    std::string Name() const override { return "RAY"; }
+    void RequestRays(std::vector<RayRequest>& requests) const override;
+    bool Compute(double& value, const OperandContext& ctx) const override;
+
+private:
+    int surface_index_;
+    int field_index_;
+    int wvl_index_;
+    Eigen::Vector2d pupil_;
+    int axis_;
+};
+
+
+/** Distortion (%) of the real chief ray against the paraxial image height. wi is normally the reference wavelength index. */
+class DistortionOperand : public Operand
+{
+public:
+    DistortionOperand(int fi, int wi, double target = 0.0, double weight = 1.0);
+
+    std::string Name() const override { return "DIST"; }
+    void RequestRays(std::vector<RayRequest>& requests) const override;
+    bool NeedsParaxialTrace() const override { return true; }
+    bool Compute(double& value, const OperandContext& ctx) const override;
+
+private:
+    int field_index_;
+    int wvl_index_;
+};
+
+
+/** Edge thickness of the gap at the given radial height. If height < 0, the larger semi-diameter of both surfaces is used. */
+class EdgeThicknessOperand : public Operand
+{
+public:
+    EdgeThicknessOperand(int gi, double height = -1.0, double target = 0.0, double weight = 1.0);
+
+    std::string Name() const override { return "ET"; }
+    bool Compute(double& value, const OperandContext& ctx) const override;
+
+private:
+    int gap_index_;
+    double height_;
+};
+
+}
+
+#endif //GEOPTER_OPERANDS_H
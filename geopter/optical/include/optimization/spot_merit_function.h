@@ -0,0 +1,34 @@
+#ifndef GEOPTER_SPOT_MERIT_FUNCTION_H
+#define GEOPTER_SPOT_MERIT_FUNCTION_H
+
+#include "optimization/merit_function.h"
+
+namespace geopter {
+
+/**
+ * @brief Transverse ray error merit function
+ *
+ * Rays are sampled on hexapolar rings for every field and wavelength, and their image intercepts are
+ * measured from the chief ray of the reference wavelength. Residuals are weighted by field and wavelength
+ * weights so that the merit value is the weighted mean square spot size. An optional focal length target
+ * can be added.
+ */
+class SpotMeritFunction : public MeritFunction
+{
+public:
+    SpotMeritFunction(int num_rings = 3);
+
+    void SetFocalLengthTarget(double efl, double weight = 1.0);
+
+    bool Evaluate(Eigen::VectorXd& residuals, OpticalSystem* opt_sys) const override;
+
+private:
+    int num_rings_;
+    bool use_efl_target_;
+    double efl_target_;
+    double efl_weight_;
+};
+
+}
+
+#endif //GEOPTER_SPOT_MERIT_FUNCTION_H
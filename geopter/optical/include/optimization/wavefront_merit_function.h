@@ -0,0 +1,28 @@
+#ifndef GEOPTER_WAVEFRONT_MERIT_FUNCTION_H
+#define GEOPTER_WAVEFRONT_MERIT_FUNCTION_H
+
+#include "optimization/merit_function.h"
+
+namespace geopter {
+
+/**
+ * @brief RMS wavefront error merit function
+ *
+ * The wavefront map is sampled on a square grid for every field and wavelength, and the RMS about the
+ * mean is taken in waves. Residuals are weighted by field and wavelength weights so that the square root
+ * of the merit value is the weighted composite RMS wavefront error.
+ */
+class WavefrontMeritFunction : public MeritFunction
+{
+public:
+    WavefrontMeritFunction(int ndim = 16);
+
+    bool Evaluate(Eigen::VectorXd& residuals, OpticalSystem* opt_sys) const override;
+
+private:
+    int ndim_;
+};
+
+}
+
+#endif //GEOPTER_WAVEFRONT_MERIT_FUNCTION_H
@@ -41,6 +41,9 @@ struct FirstOrderData
 
     void Update();
 
+    /** Copy the data from the other, keeping the parent system */
+    void CopyFrom(const FirstOrderData& other);
+
     void Print(std::ostringstream& oss);
 
 private:
@@ -65,6 +65,22 @@ public:
 
     static Eigen::Matrix2d SystemMatrix(OpticalSystem* opt_sys, int s1, int s2, double wvl);
 
+    /**
+     * @brief Scalar-generic paraxial ray kernel, used for both double and Dual evaluation
+     * @param y ray height at each surface
+     * @param u_prime slope of outgoing ray at each surface
+     * @param i incident angle at each surface
+     * @param c curvature of each surface
+     * @param t thickness of the gap following each surface
+     * @param n refractive index of the gap following each surface
+     * @param y0 paraxial ray height at starting point
+     * @param u0 slope of outgoing ray at starting point
+     */
+    template<typename T>
+    static void TraceParaxialRay(std::vector<T>& y, std::vector<T>& u_prime, std::vector<T>& i,
+                                 const std::vector<T>& c, const std::vector<T>& t, const std::vector<T>& n,
+                                 const T& y0, const T& u0);
+
 private:
     ParaxialPath CreateForwardParaxialPath(int start, int end, double wvl) const;
     ParaxialPath CreateReverseParaxialPath(int start, int end, double wvl) const;
@@ -72,6 +88,46 @@ private:
     const OpticalSystem* opt_sys_;
 };
 
+
+template<typename T>
+void ParaxialTrace::TraceParaxialRay(std::vector<T>& y, std::vector<T>& u_prime, std::vector<T>& i,
+                                     const std::vector<T>& c, const std::vector<T>& t, const std::vector<T>& n,
+                                     const T& y0, const T& u0)
+{
+    const int path_size = c.size();
+
+    y.resize(path_size);
+    u_prime.resize(path_size);
+    i.resize(path_size);
+
+    if(path_size == 0) {
+        return;
+    }
+
+    // object surface
+    y[0]       = y0;
+    u_prime[0] = u0;
+    i[0]       = y0*c[0] + u0;
+
+    // trace the rest
+    T y_cur = y0 + t[0]*u0;
+    T u = u0;
+
+    for(int k = 1; k < path_size; k++) {
+        T i_k = u + y_cur*c[k];
+        T i_prime = i_k*(n[k-1]/n[k]);
+        T u_prime_k = i_prime - y_cur*c[k];
+
+        y[k]       = y_cur;
+        u_prime[k] = u_prime_k;
+        i[k]       = i_k;
+
+        // transfer to next
+        y_cur = y_cur + t[k]*u_prime_k;
+        u = u_prime_k;
+    }
+}
+
 } // namespace geopter
 
 #endif // PARAXIALTRACE_H
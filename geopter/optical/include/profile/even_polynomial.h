@@ -29,6 +29,7 @@
 #include <vector>
 #include <string>
 #include "Eigen/Core"
+#include "common/dual.h"
 
 namespace geopter {
 
@@ -50,6 +51,11 @@ public:
         return conic_;
     }
 
+    /** Returns convergence tolerance of the intersection iteration */
+    double Tolerance() const {
+        return eps_;
+    }
+
     /** Returns aspherical coefficient at the specified index */
     double GetNthTerm(int i) const;
 
@@ -70,6 +76,19 @@ public:
 
     bool Intersect(Eigen::Vector3d& pt, double& distance, const Eigen::Vector3d& p0, const Eigen::Vector3d& dir);
 
+    /** Scalar-generic kernels taking the profile parameters explicitly, used for both double and Dual evaluation */
+    template<typename T>
+    static T Sag(const T& x, const T& y, const T& cv, const T& k, const std::vector<T>& terms);
+
+    template<typename T>
+    static T f(const Eigen::Matrix<T,3,1>& p, const T& cv, const T& k, const std::vector<T>& terms);
+
+    template<typename T>
+    static Eigen::Matrix<T,3,1> df(const Eigen::Matrix<T,3,1>& p, const T& cv, const T& k, const std::vector<T>& terms);
+
+    template<typename T>
+    static bool Intersect(Eigen::Matrix<T,3,1>& pt, T& distance, const Eigen::Matrix<T,3,1>& p0, const Eigen::Matrix<T,3,1>& dir, const T& cv, const T& k, const std::vector<T>& terms, double eps);
+
     void Print(std::ostringstream& oss);
 
 protected:
@@ -80,6 +99,101 @@ protected:
     int num_terms_;
 };
 
+template<typename T>
+T EvenPolynomial::Sag(const T& x, const T& y, const T& cv, const T& k, const std::vector<T>& terms)
+{
+    using std::sqrt;
+
+    T r2 = x*x + y*y;
+
+    // sphere + conic contribution
+    T inside_sqrt = 1.0 - (k+1.0)*cv*cv*r2;
+    if(inside_sqrt < 0.0){
+        return T(NAN);
+    }
+    T z = cv*r2 / ( 1.0 + sqrt( inside_sqrt ) );
+
+    // polynomial contribution
+    T z_asp = T(0.0);
+    T r_pow = r2;
+
+    //Ar4 + Br6 + Cr8...
+    for(size_t i = 0; i < terms.size(); i++){
+        r_pow *= r2;
+        z_asp += terms[i]*r_pow;
+    }
+
+    return (z + z_asp);
+}
+
+template<typename T>
+T EvenPolynomial::f(const Eigen::Matrix<T,3,1>& p, const T& cv, const T& k, const std::vector<T>& terms)
+{
+    return ( p(2) - Sag<T>(p(0), p(1), cv, k, terms) );
+}
+
+template<typename T>
+Eigen::Matrix<T,3,1> EvenPolynomial::df(const Eigen::Matrix<T,3,1>& p, const T& cv, const T& k, const std::vector<T>& terms)
+{
+    using std::sqrt;
+
+    //sphere + conic contribution
+    T r2 = p(0)*p(0) + p(1)*p(1);
+    T ec = k + 1.0;
+
+    T e = cv / sqrt( 1.0 - ec*cv*cv*r2 );
+
+    //polynomial asphere contribution
+    T r_pow = r2;
+    T e_asp = T(0.0);
+    double c_coef = 4.0;
+
+    for(size_t i = 0; i < terms.size(); i++){
+        e_asp += c_coef*terms[i]*r_pow;
+        c_coef += 2.0;
+        r_pow *= r2;
+    }
+
+    T e_tot = e + e_asp;
+
+    Eigen::Matrix<T,3,1> df;
+    df << -e_tot*p(0), -e_tot*p(1), T(1.0);
+    return df;
+}
+
+template<typename T>
+bool EvenPolynomial::Intersect(Eigen::Matrix<T,3,1>& pt, T& distance, const Eigen::Matrix<T,3,1>& p0, const Eigen::Matrix<T,3,1>& dir, const T& cv, const T& k, const std::vector<T>& terms, double eps)
+{
+    // Spencer's method
+
+    Eigen::Matrix<T,3,1> p = p0;
+    T s1 = -f<T>(p, cv, k, terms)/dir.dot(df<T>(p, cv, k, terms));
+    T s2;
+    double delta = std::fabs(ScalarValue(s1));
+    constexpr int max_iter = 50;
+    int iter = 0;
+
+    while(delta > eps)
+    {
+        p = p0 + s1*dir;
+        s2 = s1 - f<T>(p, cv, k, terms)/dir.dot(df<T>(p, cv, k, terms));
+        delta = std::fabs(ScalarValue(s2) - ScalarValue(s1));
+        s1 = s2;
+        iter++;
+
+        if(iter > max_iter){
+            pt = p;
+            distance = s1;
+            return false;
+        }
+    }
+
+    pt = p;
+    distance = s1;
+
+    return true;
+}
+
 } //namespace
 
 #endif // EVENPOLYNOMIAL_H
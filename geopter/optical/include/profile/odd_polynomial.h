@@ -29,6 +29,7 @@
 #include <vector>
 #include <string>
 #include "Eigen/Core"
+#include "common/dual.h"
 
 namespace geopter {
 
@@ -46,6 +47,11 @@ public:
         return conic_;
     }
 
+    /** Returns convergence tolerance of the intersection iteration */
+    double Tolerance() const {
+        return eps_;
+    }
+
     /** Returns aspherical coefficient at the specified index */
     double GetNthTerm(int i) const;
 
@@ -66,6 +72,19 @@ public:
 
     bool Intersect(Eigen::Vector3d& pt, double& distance, const Eigen::Vector3d& p0, const Eigen::Vector3d& dir);
 
+    /** Scalar-generic kernels taking the profile parameters explicitly, used for both double and Dual evaluation */
+    template<typename T>
+    static T Sag(const T& x, const T& y, const T& cv, const T& k, const std::vector<T>& terms);
+
+    template<typename T>
+    static T f(const Eigen::Matrix<T,3,1>& p, const T& cv, const T& k, const std::vector<T>& terms);
+
+    template<typename T>
+    static Eigen::Matrix<T,3,1> df(const Eigen::Matrix<T,3,1>& p, const T& cv, const T& k, const std::vector<T>& terms);
+
+    template<typename T>
+    static bool Intersect(Eigen::Matrix<T,3,1>& pt, T& distance, const Eigen::Matrix<T,3,1>& p0, const Eigen::Matrix<T,3,1>& dir, const T& cv, const T& k, const std::vector<T>& terms, double eps);
+
     void Print(std::ostringstream& oss);
 
 protected:
@@ -76,6 +95,99 @@ protected:
     int num_terms_;
 };
 
+template<typename T>
+T OddPolynomial::Sag(const T& x, const T& y, const T& cv, const T& k, const std::vector<T>& terms)
+{
+    using std::sqrt;
+
+    T r2 = x*x + y*y;
+    T r = sqrt(r2);
+
+    // conic contribution
+    T z_conic = cv*r2/( 1.0 + sqrt( 1.0 - cv*cv*r2*(k+1.0) ) );
+
+    // polynomial contribution
+    T z_pol = T(0.0);
+    T r_pow = r2*r;
+
+    for(size_t i = 0; i < terms.size(); i++) {
+        z_pol += terms[i] * r_pow;
+        r_pow *= r;
+    }
+
+    return (z_conic + z_pol);
+}
+
+template<typename T>
+T OddPolynomial::f(const Eigen::Matrix<T,3,1>& p, const T& cv, const T& k, const std::vector<T>& terms)
+{
+    return ( p(2) - Sag<T>(p(0), p(1), cv, k, terms) );
+}
+
+template<typename T>
+Eigen::Matrix<T,3,1> OddPolynomial::df(const Eigen::Matrix<T,3,1>& p, const T& cv, const T& k, const std::vector<T>& terms)
+{
+    using std::sqrt;
+
+    T r2 = p(0)*p(0) + p(1)*p(1);
+    T r = sqrt(r2);
+    T t = sqrt( 1.0 - cv*cv*r2*(k + 1.0) ); // common sqrt
+
+    // conic contribution
+    T conic_contrib_1 = 2.0*cv/(t + 1.0);
+    T conic_contrib_2 = cv*cv*cv*r2*(k+1.0)/( t*(t+1.0)*(t+1.0) );
+
+    // polynomial contribution
+    T pol_contrib = T(0.0);
+
+    T r_pow = r;
+    double num = 3.0;
+    for(size_t i = 0; i < terms.size(); i++){
+        pol_contrib += num*terms[i]*r_pow;
+        num += 1.0;
+        r_pow *= r;
+    }
+
+    T e_tot = conic_contrib_1 + conic_contrib_2 + pol_contrib;
+
+    Eigen::Matrix<T,3,1> df_ret;
+    df_ret << -e_tot*p(0), -e_tot*p(1), T(1.0);
+    return df_ret;
+}
+
+template<typename T>
+bool OddPolynomial::Intersect(Eigen::Matrix<T,3,1>& pt, T& distance, const Eigen::Matrix<T,3,1>& p0, const Eigen::Matrix<T,3,1>& dir, const T& cv, const T& k, const std::vector<T>& terms, double eps)
+{
+    // Spencer's method
+
+    Eigen::Matrix<T,3,1> p = p0;
+    T s1 = -f<T>(p, cv, k, terms)/dir.dot(df<T>(p, cv, k, terms));
+    T s2;
+    double delta = std::fabs(ScalarValue(s1));
+    constexpr int max_iter = 30;
+    int iter = 0;
+
+    while(delta > eps)
+    {
+        p = p0 + s1*dir;
+        s2 = s1 - f<T>(p, cv, k, terms)/dir.dot(df<T>(p, cv, k, terms));
+        delta = std::fabs(ScalarValue(s2) - ScalarValue(s1));
+        s1 = s2;
+        iter++;
+
+        if(iter > max_iter){
+            pt = p;
+            distance = s1;
+            return false;
+        }
+    }
+
+    pt = p;
+    distance = s1;
+
+    return true;
+}
+
 }
 
 #endif //ODDPOLYNOMIAL_H
@@ -28,6 +28,7 @@
 #define SPHERICAL_H
 
 #include "surface_profile.h"
+#include "common/dual.h"
 
 namespace geopter {
 
@@ -47,18 +48,27 @@ public:
     }
 
     double f(const Eigen::Vector3d& p) const {
-        return p(2) - 0.5*cv_*(p.dot(p));
+        return f<double>(p, cv_);
     }
 
     Eigen::Vector3d df(const Eigen::Vector3d& p) const{
-        Eigen::Vector3d df({-cv_*p(0), -cv_*p(1), 1.0 - cv_*p(2)} );
-        return df;
+        return df<double>(p, cv_);
     }
 
     double Sag(double x, double y) const;
 
     bool Intersect(Eigen::Vector3d& pt, double& distance, const Eigen::Vector3d& p0, const Eigen::Vector3d& dir);
 
+    /** Scalar-generic kernels taking the curvature explicitly, used for both double and Dual evaluation */
+    template<typename T>
+    static T f(const Eigen::Matrix<T,3,1>& p, const T& cv);
+
+    template<typename T>
+    static Eigen::Matrix<T,3,1> df(const Eigen::Matrix<T,3,1>& p, const T& cv);
+
+    template<typename T>
+    static bool Intersect(Eigen::Matrix<T,3,1>& pt, T& distance, const Eigen::Matrix<T,3,1>& p0, const Eigen::Matrix<T,3,1>& dir, const T& cv);
+
     void print(std::ostringstream& oss){};
 
 protected:
@@ -66,6 +76,45 @@ protected:
 };
 
 
+template<typename T>
+T Spherical::f(const Eigen::Matrix<T,3,1>& p, const T& cv)
+{
+    return p(2) - 0.5*cv*(p.dot(p));
+}
+
+template<typename T>
+Eigen::Matrix<T,3,1> Spherical::df(const Eigen::Matrix<T,3,1>& p, const T& cv)
+{
+    Eigen::Matrix<T,3,1> df;
+    df << -cv*p(0), -cv*p(1), 1.0 - cv*p(2);
+    return df;
+}
+
+template<typename T>
+bool Spherical::Intersect(Eigen::Matrix<T,3,1>& pt, T& distance, const Eigen::Matrix<T,3,1>& p0, const Eigen::Matrix<T,3,1>& dir, const T& cv)
+{
+    using std::sqrt;
+
+    constexpr double z_dir = 1.0; // z direction, currently reflection is not supported
+
+    T ax2 = cv;
+    T cx2 = cv*(p0.dot(p0)) - 2.0*p0(2);
+    T b = cv*(dir.dot(p0)) - dir(2);
+
+    T inside_sqrt = b*b - ax2*cx2;
+
+    if(inside_sqrt < 0.0){
+        return false;
+    }
+    else{
+        distance = cx2/(z_dir*sqrt(inside_sqrt) - b);
+        pt = p0 + distance*dir;
+    }
+
+    return true;
+}
+
+
 
 
 } //namespace geopter
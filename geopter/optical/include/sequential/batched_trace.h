@@ -0,0 +1,163 @@
+#ifndef GEOPTER_BATCHED_TRACE_H
+#define GEOPTER_BATCHED_TRACE_H
+
+#include <memory>
+#include <vector>
+
+#include "Eigen/Core"
+
+#include "system/optical_system.h"
+#include "sequential/trace_error.h"
+
+namespace geopter {
+
+/** Small change of a single path parameter, applied on top of the nominal system */
+struct PathPerturbation
+{
+    enum Type{
+        Curvature,       // surface index
+        Thickness,       // gap index
+        Conic,           // surface index
+        RefractiveIndex  // gap index
+    };
+
+    PathPerturbation(Type t, int i, double d) : type(t), index(i), delta(d) {}
+
+    Type type;
+    int index;
+    double delta;
+};
+
+
+/** Image side data of the rays in a bundle, lane index is (variant*number of rays + ray) */
+struct BundleResult
+{
+    int num_rays;
+    int num_variants;
+
+    std::vector<Eigen::Vector3d> intersect_pts;
+    std::vector<Eigen::Vector3d> directions;
+
+    /** optical path length, counted as Ray::OpticalPathLength() */
+    std::vector<double> opls;
+
+    std::vector<TraceError> status;
+
+    int Lane(int ray, int variant) const { return variant*num_rays + ray; }
+};
+
+
+/**
+ * @brief Sequential trace of a ray bundle through several variants of the system at once
+ *
+ * Variant 0 is the nominal system, and each added variant is the nominal one with some parameters perturbed.
+ * The compiled path keeps the nominal surface data plus alternative data only for the perturbed surfaces.
+ * The bundle is swept surface by surface. Every lane carries its variant index, and the lanes of
+ * a perturbed variant are forked from the nominal lane of the same ray just before the first
+ * surface affected by the perturbation, so the unperturbed prefix is traced only once.
+ *
+ * Pupil rays are launched from each variant's own first order data, since a perturbation ahead of the stop moves
+ * the entrance pupil and a change of the object gap moves the object. Variants whose launch differs from the nominal
+ * are traced from the object rather than forked. The aim point of the given field is used for all variants.
+ *
+ * Decenter is not supported, as in the rest of the sequential trace.
+ */
+class BatchedTrace
+{
+public:
+    BatchedTrace(OpticalSystem* opt_sys);
+    ~BatchedTrace();
+
+    /** Add a variant and returns its index */
+    int AddVariant(const std::vector<PathPerturbation>& perturbations);
+
+    /** Remove all variants except for the nominal */
+    void ClearVariants();
+
+    int NumberOfVariants() const { return variants_.size() + 1; }
+
+    /**
+     * @brief Create surface records for the wavelength. Must be called after the system or the variants are changed.
+     *
+     * A perturbed clone of the system is also updated for each variant, for the launch of pupil rays.
+     */
+    void Compile(double wvl);
+
+    /** Trace the launch rays through all variants */
+    void TraceBundle(BundleResult& result, const std::vector<Eigen::Vector3d>& pt0, const std::vector<Eigen::Vector3d>& dir0) const;
+
+    /** Trace rays at the given pupil coordinates through all variants, each launched from its perturbed system */
+    void TracePupilBundle(BundleResult& result, const std::vector<Eigen::Vector2d>& pupil_crds, const Field* fld) const;
+
+    void SetApertureCheck(bool state) { do_aperture_check_ = state; }
+
+private:
+    /** Surface and following gap data */
+    struct SurfaceRecord
+    {
+        int profile; // 0: spherical, 1: even polynomial, 2: odd polynomial
+        double eps;
+        double cv;
+        double conic;
+        std::vector<double> terms;
+        double thickness;
+        double refractive_index;
+    };
+
+    /** Nominal record and the alternatives for the variants perturbing this surface */
+    struct CompiledSurface
+    {
+        SurfaceRecord nominal;
+        std::vector<SurfaceRecord> perturbed;
+
+        /** index to perturbed for each variant, -1 for nominal. Empty if no variant perturbs this surface. */
+        std::vector<int> slot;
+
+        const SurfaceRecord& Record(int variant) const {
+            if(slot.empty() || slot[variant] < 0) return nominal;
+            return perturbed[slot[variant]];
+        }
+    };
+
+    /** State of a ray in a lane, between surfaces */
+    struct LaneState
+    {
+        Eigen::Vector3d pt;
+        Eigen::Vector3d dir;
+        double n_in;
+        double opl;
+        TraceError status;
+    };
+
+    bool step(LaneState& lane, int srf_idx, int variant) const;
+
+    /**
+     * @brief Trace the nominal launch rays, and the own launch rays of the variants which have them
+     *
+     * variant_pt0/variant_dir0 are indexed by variant, and empty for a variant launched as the nominal.
+     */
+    void trace(BundleResult& result, const std::vector<Eigen::Vector3d>& pt0, const std::vector<Eigen::Vector3d>& dir0,
+               const std::vector< std::vector<Eigen::Vector3d> >& variant_pt0, const std::vector< std::vector<Eigen::Vector3d> >& variant_dir0) const;
+
+    static void apply(SurfaceRecord& rec, const PathPerturbation& p);
+
+    /** Apply the perturbation to the system. The model is not updated. */
+    static void apply(OpticalSystem* opt_sys, const PathPerturbation& p);
+
+    OpticalSystem* opt_sys_;
+    std::vector< std::vector<PathPerturbation> > variants_;
+
+    std::vector<CompiledSurface> path_;
+
+    /** first surface where each variant differs from the nominal */
+    std::vector<int> fork_index_;
+
+    /** perturbed systems of the variants, null for the nominal */
+    std::vector< std::unique_ptr<OpticalSystem> > variant_systems_;
+
+    bool do_aperture_check_;
+};
+
+}
+
+#endif //GEOPTER_BATCHED_TRACE_H
@@ -0,0 +1,97 @@
+#ifndef GEOPTER_DIFFERENTIABLE_TRACE_H
+#define GEOPTER_DIFFERENTIABLE_TRACE_H
+
+#include <vector>
+
+#include "Eigen/Core"
+
+#include "system/optical_system.h"
+#include "system/system_parameter.h"
+#include "sequential/trace_error.h"
+#include "common/dual.h"
+
+namespace geopter {
+
+/** Image side ray data and its derivatives with respect to the traced parameters */
+struct RayDerivative
+{
+    /** intersect point at the image surface */
+    Eigen::Vector3d intersect_pt;
+
+    /** d(intersect_pt)/d(parameters), 3 x number of parameters */
+    Eigen::Matrix3Xd intersect_pt_grad;
+
+    /** ray direction in image space */
+    Eigen::Vector3d direction;
+
+    /** d(direction)/d(parameters) */
+    Eigen::Matrix3Xd direction_grad;
+
+    /** optical path length, counted as Ray::OpticalPathLength() */
+    double opl;
+
+    /** d(opl)/d(parameters) */
+    Eigen::RowVectorXd opl_grad;
+};
+
+
+/**
+ * @brief Sequential ray trace evaluated on dual numbers
+ *
+ * The trace kernels are instantiated on Dual<ChunkSize>, so the derivatives with respect to
+ * ChunkSize parameters are obtained together with the values in a single pass. More parameters are
+ * processed chunk by chunk. The launch ray (object point and initial direction) is held fixed,
+ * i.e. ray aiming and pupil location are not differentiated.
+ */
+class DifferentiableTrace
+{
+public:
+    static constexpr int ChunkSize = 4;
+    using Scalar = Dual<ChunkSize>;
+    using Vector3 = Eigen::Matrix<Scalar, 3, 1>;
+
+    DifferentiableTrace(OpticalSystem* opt_sys, const std::vector<SystemParameter>& params);
+    ~DifferentiableTrace();
+
+    int NumberOfParameters() const { return params_.size(); }
+
+    /** Trace a ray from the given launch point and direction */
+    TraceError TraceRay(RayDerivative& result, const Eigen::Vector3d& pt0, const Eigen::Vector3d& dir0, double wvl);
+
+    /** Trace a ray at the given pupil coordinate */
+    TraceError TracePupilRay(RayDerivative& result, const Eigen::Vector2d& pupil_crd, const Field* fld, double wvl);
+
+    /** Compute wavefront aberration in the same manner as WaveAberration, with its gradient */
+    TraceError WavefrontAberration(double& opd, Eigen::RowVectorXd& opd_grad, const Eigen::Vector2d& pupil_crd, const Field* fld, double wvl);
+
+    /** Effective focal length at the reference wavelength and its gradient */
+    bool EffectiveFocalLength(double& efl, Eigen::RowVectorXd& efl_grad);
+
+private:
+    /** Surface and following gap data in the trace scalar */
+    struct PathRecord
+    {
+        int profile; // 0: spherical, 1: even polynomial, 2: odd polynomial
+        double eps;
+        Scalar cv;
+        Scalar conic;
+        std::vector<Scalar> terms;
+        Scalar thickness;
+        Scalar refractive_index;
+    };
+
+    /** Create path records for the given wavelength, with parameters in the chunk seeded */
+    std::vector<PathRecord> compile_path(int chunk, double wvl) const;
+
+    TraceError trace_path(std::vector<Vector3>& pts, std::vector<Vector3>& dirs, std::vector<Scalar>& opls,
+                          const std::vector<PathRecord>& path, const Eigen::Vector3d& pt0, const Eigen::Vector3d& dir0) const;
+
+    int number_of_chunks() const;
+
+    OpticalSystem* opt_sys_;
+    std::vector<SystemParameter> params_;
+};
+
+}
+
+#endif //GEOPTER_DIFFERENTIABLE_TRACE_H
@@ -61,7 +61,7 @@ public:
 
     int GetReachedSurfaceIndex() const { return reached_surface_index_; }
 
-    RaySegment* GetSegmentAt(int i) { return segments_[i].get(); }
+    RaySegment* GetSegmentAt(int i) const { return segments_[i].get(); }
     RaySegment* GetFront() const { return segments_.front().get();}
     RaySegment* GetBack() const { return segments_.back().get();}
     RaySegment* GetLensBack() const { int len = segments_.size(); return segments_[len-2].get();}
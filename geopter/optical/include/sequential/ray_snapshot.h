@@ -0,0 +1,73 @@
+#ifndef GEOPTER_RAY_SNAPSHOT_H
+#define GEOPTER_RAY_SNAPSHOT_H
+
+#include <vector>
+
+#include "Eigen/Core"
+
+#include "sequential/ray.h"
+#include "sequential/trace_error.h"
+
+namespace geopter {
+
+/** Ray state right after the interaction with a surface, from which the trace can be resumed */
+struct RayState
+{
+    /** intersect point in the local coordinate of the surface */
+    Eigen::Vector3d intersect_pt;
+
+    /** direction after the surface */
+    Eigen::Vector3d direction;
+
+    /** optical path length up to the surface, counted in the same range as Ray::OpticalPathLength() */
+    double opl;
+
+    /** refractive index after the surface */
+    double refractive_index;
+
+    TraceError status;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+
+/**
+ * @brief Ray states of a pupil sample set at an intermediate surface
+ *
+ * Created by SequentialTrace::CaptureSnapshot() and consumed by SequentialTrace::ResumeFromSnapshot().
+ * The upstream segments are kept as well, so that the resumed rays are complete from the object to the image.
+ */
+class RaySnapshot
+{
+public:
+    RaySnapshot();
+    ~RaySnapshot();
+
+    /** Surface index where the states were captured */
+    int SurfaceIndex() const { return surface_index_; }
+
+    double Wavelength() const { return wvl_; }
+
+    int NumberOfRays() const { return states_.size(); }
+
+    const RayState& StateAt(int i) const { return states_[i]; }
+
+    /** Ray traced from the object to the snapshot surface */
+    const Ray* UpstreamRay(int i) const { return upstream_rays_[i].get(); }
+
+    const Eigen::Vector2d& PupilCoordinate(int i) const { return upstream_rays_[i]->PupilCoordinate(); }
+
+    void Clear();
+
+private:
+    friend class SequentialTrace;
+
+    int surface_index_;
+    double wvl_;
+    std::vector<RayState, Eigen::aligned_allocator<RayState>> states_;
+    std::vector<RayPtr> upstream_rays_;
+};
+
+}
+
+#endif //GEOPTER_RAY_SNAPSHOT_H
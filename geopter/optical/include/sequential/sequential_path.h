@@ -41,7 +41,7 @@ struct SequentialPathComponent
         distance         = 0.0;
         refractive_index = 1.0;
     }
-    SequentialPathComponent(Surface* s, double thi, double n){
+    SequentialPathComponent(const Surface* s, double thi, double n){
         surface          = s;
         distance         = thi;
         refractive_index = n;
@@ -50,7 +50,7 @@ struct SequentialPathComponent
         surface = nullptr;
     }
 
-    Surface* surface;
+    const Surface* surface;
     double distance;
     double refractive_index;
 };
@@ -78,7 +78,7 @@ public:
     void Append(SequentialPathComponent seq_path_comp);
 
     /** Append a new path component */
-    void Append(Surface* s, double thi, double n);
+    void Append(const Surface* s, double thi, double n);
 
     /** Set wavelength value used to calculate refractive index */
     void SetWavelength(double wvl);
@@ -30,7 +30,9 @@
 #include "system/optical_system.h"
 #include "sequential/sequential_path.h"
 #include "sequential/ray.h"
+#include "sequential/ray_snapshot.h"
 #include "sequential/trace_error.h"
+#include "common/dual.h"
 
 namespace geopter {
 
@@ -48,6 +50,26 @@ public:
 
     RayPtr CreatePupilRay(const Eigen::Vector2d& pupil_crd, const Field* fld, double wvl);
 
+    /**
+     * @brief Trace pupil rays from the object to the given surface and keep their states there
+     * @param snapshot captured states
+     * @param srf_idx surface index at which the states are captured
+     */
+    void CaptureSnapshot(RaySnapshot& snapshot, int srf_idx, const std::vector<Eigen::Vector2d>& pupils, const Field* fld, double wvl);
+
+    /**
+     * @brief Resume a snapshot ray through the downstream path
+     *
+     * The path must start at the snapshot surface, as created by CreateSequentialPath(snapshot.SurfaceIndex(), img, wvl).
+     * The result is valid as long as nothing up to the refraction at the snapshot surface has changed since
+     * the capture, i.e. the following gap thickness and any downstream parameter may differ.
+     * The resulting ray has the upstream segments copied from the snapshot.
+     */
+    TraceError ResumeRay(RayPtr ray, const SequentialPath& downstream_path, const RaySnapshot& snapshot, int i);
+
+    /** Resume all the snapshot rays through the current system up to the image */
+    void ResumeFromSnapshot(std::vector<RayPtr>& rays, const RaySnapshot& snapshot);
+
     /** Trace reference rays(chief, meridional upper/lower, sagittal upper/lower */
     bool TraceReferenceRays(std::vector<std::shared_ptr<Ray>>& ref_rays, const Field* fld, double wvl);
 
@@ -67,6 +89,13 @@ public:
     /**  Refract incoming direction, d_in, about normal */
     bool Bend(Eigen::Vector3d& d_out, const Eigen::Vector3d& d_in, const Eigen::Vector3d& normal, double n_in, double n_out);
 
+    /** Scalar-generic refraction kernel, used for both double and Dual evaluation */
+    template<typename T>
+    static bool Bend(Eigen::Matrix<T,3,1>& d_out, const Eigen::Matrix<T,3,1>& d_in, const Eigen::Matrix<T,3,1>& normal, const T& n_in, const T& n_out);
+
+    /** Compute launch point and direction of the ray at the given pupil coordinate */
+    void ConvertCoordinatePupilToObj(Eigen::Vector3d& pt0, Eigen::Vector3d& dir0, const Eigen::Vector2d& pupil_crd, const Field* fld);
+
     /** Get object coordinate for the given field */
     Eigen::Vector3d GetDefaultObjectPt(const Field* fld);
 
@@ -88,8 +117,12 @@ public:
     bool ApplyVigStatus() const { return do_apply_vig_;}
 
 private:
-    void ConvertCoordinatePupilToObj(Eigen::Vector3d& pt0, Eigen::Vector3d& dir0, const Eigen::Vector2d& pupil_crd, const Field* fld);
-    
+    /** Read only access to the assembly, so that the components shared with cloned systems are not copied */
+    const OpticalAssembly* assembly() const { return opt_sys_->GetOpticalAssembly(); }
+
+    /** Trace from the first surface of the path, with the ray segments written from the given offset */
+    TraceError trace_from(RayPtr ray, const SequentialPath& seq_path, int seg_offset, const Eigen::Vector3d& pt, const Eigen::Vector3d& dir);
+
     OpticalSystem *opt_sys_;
 
     bool do_aperture_check_;
@@ -97,6 +130,29 @@ private:
 };
 
 
+template<typename T>
+bool SequentialTrace::Bend(Eigen::Matrix<T,3,1>& d_out, const Eigen::Matrix<T,3,1>& d_in, const Eigen::Matrix<T,3,1>& normal, const T& n_in, const T& n_out)
+{
+    using std::sqrt;
+
+    T normal_len = sqrt(normal.dot(normal));
+    T cosI = d_in.dot(normal)/normal_len;
+    T sinI_sqr = 1.0 - cosI*cosI;
+
+    T inside_sqrt = n_out*n_out - n_in*n_in*sinI_sqr;
+    if(inside_sqrt < 0.0){
+        return false;
+    }
+
+    double cosI_sgn = (cosI > 0.0) - (cosI < 0.0);
+    T n_cosIp = sqrt( inside_sqrt ) * cosI_sgn;
+    T alpha = n_cosIp - n_in*cosI;
+    d_out = (n_in*d_in + alpha*normal)/n_out;
+
+    return true;
+}
+
+
 
 
 }
@@ -32,6 +32,7 @@ public:
     std::string GetSolveTypeStr() const override { return "E"; }
     void SetParameters(double param1, double param2, double param3, double param4) override;
     void GetParameters(double *param1, double *param2, double *param3, double *param4) override;
+    std::unique_ptr<Solve> Clone() const override { return std::make_unique<EdgeThicknessSolve>(*this); }
 
 private:
     int gap_index_;
@@ -36,6 +36,7 @@ public:
         param3 = nullptr;
         param4 = nullptr;
     }
+    std::unique_ptr<Solve> Clone() const override { return std::make_unique<FixedSolve>(*this); }
 
 };
 
@@ -41,6 +41,7 @@ public:
     std::string GetSolveTypeStr() const override{ return "O";}
     void SetParameters(double param1, double param2, double param3, double param4) override;
     void GetParameters(double *param1=nullptr, double *param2=nullptr, double *param3=nullptr, double *param4=nullptr) override;
+    std::unique_ptr<Solve> Clone() const override { return std::make_unique<OverallLengthSolve>(*this); }
 
 private:
     int surface1_;
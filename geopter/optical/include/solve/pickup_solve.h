@@ -19,17 +19,17 @@ If not, see <https://www.gnu.org/licenses/>.
 
 namespace geopter {
 
-class Gap;
-
+/** Thickness of the gap picked up from another gap, as thickness*scale + offset */
 class PickupSolve : public Solve
 {
-    PickupSolve(Gap* gap);
+public:
+    PickupSolve(int gi);
     void Apply(OpticalSystem* opt_sys) override;
     void SetParameters(double param1, double param2, double param3=0, double param4=0) override;
     void GetParameters(double *param1, double *param2, double *param3, double *param4) override;
+    std::unique_ptr<Solve> Clone() const override { return std::make_unique<PickupSolve>(*this); }
 
 private:
-    Gap* gap_;
     int from_gap_index_;
     double scale_;
     double offset_;
@@ -28,6 +28,7 @@
 #define GEOPTER_SOLVE_H
 
 #include <string>
+#include <memory>
 
 namespace geopter{
 
@@ -62,6 +63,9 @@ public:
     virtual void SetParameters(double param1, double param2=0.0, double param3=0.0, double param4=0.0) = 0;
     virtual void GetParameters(double *param1=nullptr, double *param2=nullptr, double *param3=nullptr, double *param4=nullptr) = 0;
 
+    /** Returns a copy of this solve */
+    virtual std::unique_ptr<Solve> Clone() const = 0;
+
     void SetGapIndex(int gi) { gap_index_ = gi; }
 
 protected:
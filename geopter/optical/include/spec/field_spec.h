@@ -74,6 +74,9 @@ public:
 
     void clear();
 
+    /** Make this spec a copy of the other, including object and aim points */
+    void CopyFrom(const FieldSpec& other);
+
     void print();
     void print(std::ostringstream& oss);
 
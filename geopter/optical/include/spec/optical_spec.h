@@ -48,6 +48,9 @@ public:
 
     void Clear();
 
+    /** Make this spec a copy of the other */
+    void CopyFrom(const OpticalSpec& other);
+
     void CreateMinimumSpec();
 
     void update();
@@ -77,6 +77,9 @@ public:
 
     void clear();
 
+    /** Make this spec a copy of the other */
+    void CopyFrom(const WavelengthSpec& other);
+
     void print();
     void print(std::ostringstream& oss);
 
@@ -66,13 +66,29 @@ public:
     /** Optical specifications; pupil, field, wavelength */
     OpticalSpec* GetOpticalSpec() const { return opt_spec_.get(); }
 
-    /** sequential assembly of surfaces and gaps filled with material */
-    OpticalAssembly* GetOpticalAssembly() const { return opt_assembly_.get(); }
+    /**
+     * @brief Sequential assembly of surfaces and gaps filled with material, for modification
+     *
+     * Surfaces and gaps obtained through it are copied first if shared with a cloned system, which is a write.
+     * Read through the const overload, which never copies and is safe from several threads.
+     */
+    OpticalAssembly* GetOpticalAssembly() { return opt_assembly_.get(); }
+
+    /** Sequential assembly of surfaces and gaps filled with material, for reading */
+    const OpticalAssembly* GetOpticalAssembly() const { return opt_assembly_.get(); }
 
     MaterialLibrary* GetMaterialLib() const { return material_lib_.get(); }
 
     FirstOrderData* GetFirstOrderData() const { return fod_.get(); }
 
+    /**
+     * @brief Create a copy of the system
+     *
+     * Surfaces and gaps are shared with the copy and duplicated only when either system modifies them,
+     * so cloning does not require model update. Material objects are always shared between the copies.
+     */
+    std::unique_ptr<OpticalSystem> Clone() const;
+
     void LoadFile(const std::string& filepath);
     void SaveToFile(const std::string& filepath);
 
@@ -85,6 +101,13 @@ public:
 
     void UpdateModel();
 
+    /**
+     * @brief Revision of the model, renewed by every UpdateModel()
+     *
+     * Revisions are unique over all the systems in the process, so derived data can be cached by the revision alone.
+     */
+    unsigned long long ModelRevision() const { return revision_; }
+
     void Clear();
 
     void Print(std::ostringstream& oss);
@@ -98,6 +121,8 @@ protected:
 
     std::string title_;
     std::string note_;
+
+    unsigned long long revision_;
 };
 
 
@@ -0,0 +1,45 @@
+#ifndef GEOPTER_SYSTEM_PARAMETER_H
+#define GEOPTER_SYSTEM_PARAMETER_H
+
+#include <string>
+
+namespace geopter {
+
+class OpticalSystem;
+
+/** Reference to a single scalar lens parameter, used as a variable in differentiation and optimization */
+class SystemParameter
+{
+public:
+    enum Type{
+        Curvature,
+        Thickness,
+        Conic
+    };
+
+    /**
+     * @param type parameter type
+     * @param index surface index for Curvature/Conic, gap index for Thickness
+     */
+    SystemParameter(Type type, int index);
+
+    Type GetType() const { return type_; }
+    int Index() const { return index_; }
+
+    /** Returns current value of the parameter in the given system */
+    double Value(const OpticalSystem* opt_sys) const;
+
+    /** Set the value to the given system. The model is not updated. */
+    void SetValue(OpticalSystem* opt_sys, double val) const;
+
+    /** Returns label such as "C3", "T5", "K2" */
+    std::string Name() const;
+
+private:
+    Type type_;
+    int index_;
+};
+
+}
+
+#endif //GEOPTER_SYSTEM_PARAMETER_H
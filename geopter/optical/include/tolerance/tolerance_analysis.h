@@ -0,0 +1,145 @@
+#ifndef GEOPTER_TOLERANCE_ANALYSIS_H
+#define GEOPTER_TOLERANCE_ANALYSIS_H
+
+#include <vector>
+#include <memory>
+#include <string>
+
+#include "tolerance/tolerance_operand.h"
+#include "optimization/merit_function.h"
+#include "optimization/local_optimizer.h"
+#include "system/system_parameter.h"
+
+namespace geopter {
+
+/** Criterion change by a single operand at one of its limits */
+struct SensitivityResult
+{
+    int operand_index;
+    double value;
+    double criterion;
+    double change;
+};
+
+/** Outcome of a Monte Carlo trial */
+struct ToleranceTrial
+{
+    int trial_index;
+    std::vector<double> values;
+    double criterion;
+
+    /** false if the trial was lost with a crashed worker process, whose criterion is NaN but not a failed design */
+    bool completed;
+};
+
+/** Summary of Monte Carlo trials */
+struct ToleranceStatistics
+{
+    int num_trials;
+
+    /** trials whose criterion could not be evaluated, counted as the worst */
+    int num_failed;
+
+    /** trials lost with crashed worker processes, excluded from the statistics */
+    int num_incomplete;
+
+    double nominal;
+    double mean;
+    double std_dev;
+    double min;
+    double max;
+
+    /** criterion at 50, 80, 90, 95, 98 % */
+    std::vector<double> percentiles;
+
+    /** fraction of the completed trials whose criterion is not greater than the threshold */
+    double yield;
+};
+
+
+/**
+ * @brief Sensitivity and Monte Carlo tolerance analysis
+ *
+ * The criterion is the square root of the merit value, i.e. the weighted RMS of the residuals, so the statistics are
+ * those of the composite RMS wavefront with WavefrontMeritFunction, or of the RMS MTF loss with MtfMeritFunction.
+ * Each trial perturbs its own clone of the system, applies the compensators and evaluates the criterion.
+ * Trials run in parallel. The random numbers of a trial depend only on the seed and the trial index, so results are
+ * reproducible regardless of the number of threads.
+ *
+ * For very large runs the Monte Carlo trials can be sharded over worker processes with ProcessShard, optionally
+ * with a checkpoint file so that an interrupted run is resumed rather than restarted. The sensitivity runs are sharded
+ * likewise, without checkpoint. Every worker evaluates the same criterion as the threads, e.g. the RMS wavefront
+ * or the MTF loss. The checkpoint is resumed only
+ * by a run with the same seed, operands, compensators and prescription of the system.
+ */
+class ToleranceAnalysis
+{
+public:
+    ToleranceAnalysis(const MeritFunction* criterion);
+    ~ToleranceAnalysis();
+
+    void AddOperand(const ToleranceOperand& op);
+    int NumberOfOperands() const { return operands_.size(); }
+    const ToleranceOperand& GetOperand(int i) const { return operands_[i]; }
+
+    /** Move the image surface to the paraxial focus, like a back focus solve */
+    void SetParaxialRefocus(bool state) { do_refocus_ = state; }
+
+    /** Add a compensator which is optimized against the criterion in every trial */
+    void AddCompensator(const SystemParameter& prm);
+
+    /** Maximum iterations of the compensator optimization, default 10 */
+    void SetCompensatorIterations(int n);
+
+    void SetSeed(unsigned int seed) { seed_ = seed; }
+    void SetNumberOfThreads(int n) { num_threads_ = n; }
+
+    /** Run Monte Carlo trials and sensitivity runs on the given number of worker processes instead of threads. 1 for in-process. */
+    void SetNumberOfProcesses(int n) { num_processes_ = n; }
+
+    /** Record Monte Carlo trials in the file and resume from it. Empty for no checkpoint. */
+    void SetCheckpointFile(const std::string& path) { checkpoint_path_ = path; }
+
+    /** Criterion limit for the yield */
+    void SetYieldThreshold(double val) { yield_threshold_ = val; }
+
+    /** Evaluate the nominal system with compensators applied */
+    double Nominal(const OpticalSystem* opt_sys) const;
+
+    /** Evaluate each operand at its min and max */
+    std::vector<SensitivityResult> Sensitivity(const OpticalSystem* opt_sys) const;
+
+    /** Run Monte Carlo trials and returns the statistics. Trials can be obtained by Trials() afterwards. */
+    ToleranceStatistics MonteCarlo(const OpticalSystem* opt_sys, int num_trials);
+
+    const std::vector<ToleranceTrial>& Trials() const { return trials_; }
+
+    /** Apply perturbations of a trial and compensate */
+    void Apply(OpticalSystem* opt_sys, const std::vector<double>& values) const;
+
+private:
+    double evaluate(const OpticalSystem* opt_sys, const std::vector<double>& values) const;
+
+    /** Hash of everything that determines the trials of the system, to identify a checkpoint */
+    std::string fingerprint(const OpticalSystem* opt_sys, int num_trials) const;
+    void compensate(OpticalSystem* opt_sys) const;
+
+    const MeritFunction* criterion_;
+    std::vector<ToleranceOperand> operands_;
+    std::vector<SystemParameter> compensators_;
+    std::unique_ptr<LocalOptimizer> comp_optimizer_;
+
+    bool do_refocus_;
+    int comp_iterations_;
+    unsigned int seed_;
+    int num_threads_;
+    int num_processes_;
+    std::string checkpoint_path_;
+    double yield_threshold_;
+
+    std::vector<ToleranceTrial> trials_;
+};
+
+}
+
+#endif //GEOPTER_TOLERANCE_ANALYSIS_H
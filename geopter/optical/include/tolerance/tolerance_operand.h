@@ -0,0 +1,65 @@
+#ifndef GEOPTER_TOLERANCE_OPERAND_H
+#define GEOPTER_TOLERANCE_OPERAND_H
+
+#include <string>
+#include <random>
+
+namespace geopter {
+
+class OpticalSystem;
+
+/**
+ * @brief Single manufacturing tolerance
+ *
+ * The perturbation is drawn from [min, max] according to the distribution and applied to the system.
+ * Units are mm for Radius and Thickness, absolute index difference for RefractiveIndex, and relative change
+ * (e.g. 0.008 for 0.8%) for Abbe. Plane surfaces are not perturbed by Radius.
+ *
+ * Surface decenter, tilt and element wedge are not available until the assembly supports decenter.
+ */
+class ToleranceOperand
+{
+public:
+    enum Type{
+        Radius,          // surface index
+        Thickness,       // gap index
+        RefractiveIndex, // gap index
+        Abbe             // gap index
+    };
+
+    enum Distribution{
+        Uniform,
+        Normal,     // mean at the center, 2 sigma at the limits, truncated
+        EndPoint    // either limit with equal probability
+    };
+
+    ToleranceOperand(Type type, int index, double min, double max, Distribution dist = Uniform);
+
+    Type GetType() const { return type_; }
+    int Index() const { return index_; }
+    double Min() const { return min_; }
+    double Max() const { return max_; }
+    Distribution GetDistribution() const { return dist_; }
+
+    void SetDistribution(Distribution dist) { dist_ = dist; }
+
+    /** Returns label such as "TRAD 3" */
+    std::string Name() const;
+
+    /** Draw a perturbation */
+    double Sample(std::mt19937_64& rng) const;
+
+    /** Apply the perturbation to the system. The model is not updated. */
+    void Apply(OpticalSystem* opt_sys, double value) const;
+
+private:
+    Type type_;
+    int index_;
+    double min_;
+    double max_;
+    Distribution dist_;
+};
+
+}
+
+#endif //GEOPTER_TOLERANCE_OPERAND_H
@@ -0,0 +1,211 @@
+#define _USE_MATH_DEFINES
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+#include "analysis/adaptive_pupil_sampler.h"
+#include "common/parallel.h"
+#include "sequential/sequential_trace.h"
+#include "sequential/trace_error.h"
+
+using namespace geopter;
+
+namespace {
+
+/** status of the points outside of the unit circle, which are not traced */
+constexpr TraceError outside_status = 0xFFFFFFFF;
+
+struct RayResult
+{
+    TraceError status;
+
+    /** intercept at the image surface */
+    Eigen::Vector2d intercept;
+};
+
+/** Square cell on the lattice, with the lower left corner (i, j) and the side length in lattice steps */
+struct Cell
+{
+    long long i;
+    long long j;
+    long long size;
+};
+
+}
+
+AdaptivePupilSampler::AdaptivePupilSampler(OpticalSystem *opt_sys) :
+    opt_sys_(opt_sys),
+    initial_grid_(32),
+    max_level_(4),
+    tolerance_(0.05),
+    num_threads_(0),
+    num_traced_(0)
+{
+
+}
+
+AdaptivePupilSampler::~AdaptivePupilSampler()
+{
+
+}
+
+void AdaptivePupilSampler::SetInitialGrid(int n)
+{
+    initial_grid_ = std::max(1, n);
+}
+
+void AdaptivePupilSampler::SetMaxLevel(int n)
+{
+    max_level_ = std::min(std::max(0, n), 20);
+}
+
+PupilSampleSet AdaptivePupilSampler::Create(const Field *fld, double wvl)
+{
+    PupilSampleSet set;
+    num_traced_ = 0;
+
+    SequentialTrace tracer(opt_sys_);
+    const SequentialPath seq_path = tracer.CreateSequentialPath(wvl);
+
+    // lattice fine enough for the centers of the cells at the maximum level
+    const long long N = (long long)initial_grid_ << (max_level_ + 1);
+    const double step = 2.0/N;
+
+    auto key = [N](long long i, long long j){ return i*(N + 1) + j; };
+    auto pupil = [step](long long i, long long j){ return Eigen::Vector2d(-1.0 + step*j, -1.0 + step*i); };
+
+    std::map<long long, RayResult> results;
+    double abs_tolerance = 0.0;
+
+    // weight of each sample point, in the pupil area
+    std::map<long long, double> weights;
+
+    std::vector<Cell> cells;
+    const long long initial_size = N/initial_grid_;
+    for(int ci = 0; ci < initial_grid_; ci++){
+        for(int cj = 0; cj < initial_grid_; cj++){
+            cells.push_back(Cell{ci*initial_size, cj*initial_size, initial_size});
+        }
+    }
+
+    for(int level = 0; level <= max_level_ && !cells.empty(); level++){
+        // rays of this level which have not been traced
+        std::vector<std::pair<long long, long long> > pending;
+        std::vector<RayResult*> pending_results;
+
+        for(const Cell& cell : cells){
+            const long long h = cell.size/2;
+            const long long pts[5][2] = { {cell.i, cell.j}, {cell.i, cell.j + cell.size}, {cell.i + cell.size, cell.j},
+                                          {cell.i + cell.size, cell.j + cell.size}, {cell.i + h, cell.j + h} };
+            for(auto& p : pts){
+                auto inserted = results.emplace(key(p[0], p[1]), RayResult{TRACE_SUCCESS, Eigen::Vector2d::Zero()});
+                if(inserted.second){
+                    pending.emplace_back(p[0], p[1]);
+                    pending_results.push_back(&inserted.first->second);
+                }
+            }
+        }
+
+        // the map is not modified while the rays are traced, so each ray writes its own entry
+        const int num_pending = pending.size();
+        constexpr int block_size = 64;
+        const int num_blocks = (num_pending + block_size - 1)/block_size;
+
+        Parallel::For(0, num_blocks, [&](int bi){
+            SequentialTrace block_tracer(opt_sys_);
+            block_tracer.SetApertureCheck(true);
+            block_tracer.SetApplyVig(false);
+
+            auto ray = std::make_shared<Ray>(seq_path.Size());
+
+            const int end = std::min(num_pending, (bi + 1)*block_size);
+            for(int k = bi*block_size; k < end; k++){
+                const Eigen::Vector2d pt = pupil(pending[k].first, pending[k].second);
+                RayResult* result = pending_results[k];
+
+                if(pt.norm() > 1.0){
+                    result->status = outside_status;
+                    continue;
+                }
+
+                result->status = block_tracer.TracePupilRay(ray, seq_path, pt, fld, wvl);
+                if(TRACE_SUCCESS == result->status){
+                    result->intercept = Eigen::Vector2d(ray->GetBack()->X(), ray->GetBack()->Y());
+                }
+            }
+        }, num_threads_);
+
+        num_traced_ += num_pending;
+
+        if(level == 0){
+            // scale of the tolerance, RMS spread of the intercepts of the initial grid
+            Eigen::Vector2d sum = Eigen::Vector2d::Zero();
+            double sum_sq = 0.0;
+            int count = 0;
+            for(auto& r : results){
+                if(TRACE_SUCCESS == r.second.status){
+                    sum += r.second.intercept;
+                    sum_sq += r.second.intercept.squaredNorm();
+                    count++;
+                }
+            }
+            if(count > 0){
+                const Eigen::Vector2d mean = sum/count;
+                abs_tolerance = tolerance_*sqrt(std::max(0.0, sum_sq/count - mean.squaredNorm()));
+            }
+        }
+
+        std::vector<Cell> next_cells;
+        for(const Cell& cell : cells){
+            const long long h = cell.size/2;
+            const RayResult& center = results[key(cell.i + h, cell.j + h)];
+            const RayResult* corners[4] = { &results[key(cell.i, cell.j)], &results[key(cell.i, cell.j + cell.size)],
+                                            &results[key(cell.i + cell.size, cell.j)], &results[key(cell.i + cell.size, cell.j + cell.size)] };
+
+            bool mixed = false;
+            for(auto corner : corners){
+                mixed |= (corner->status != center.status);
+            }
+
+            bool refine = mixed;
+            if( !mixed && tolerance_ > 0.0 && TRACE_SUCCESS == center.status ){
+                // departure of the center from the mean of the corners, which measures the curvature of the map to the image
+                Eigen::Vector2d mean = Eigen::Vector2d::Zero();
+                for(auto corner : corners){
+                    mean += 0.25*corner->intercept;
+                }
+                refine = ((center.intercept - mean).norm() > abs_tolerance);
+            }
+
+            const double area = (step*cell.size)*(step*cell.size);
+
+            if(refine && level < max_level_){
+                for(int q = 0; q < 4; q++){
+                    next_cells.push_back(Cell{cell.i + (q/2)*h, cell.j + (q%2)*h, h});
+                }
+            }else if(mixed){
+                // boundary at the finest level, the center alone
+                if(TRACE_SUCCESS == center.status){
+                    weights[key(cell.i + h, cell.j + h)] += area;
+                }
+            }else if(TRACE_SUCCESS == center.status){
+                // 2/3 of the midpoint and 1/3 of the trapezoid rule, exact for quadratics. Corners are shared with the neighbours.
+                weights[key(cell.i + h, cell.j + h)] += area*2.0/3.0;
+                weights[key(cell.i, cell.j)] += area/12.0;
+                weights[key(cell.i, cell.j + cell.size)] += area/12.0;
+                weights[key(cell.i + cell.size, cell.j)] += area/12.0;
+                weights[key(cell.i + cell.size, cell.j + cell.size)] += area/12.0;
+            }
+        }
+
+        cells.swap(next_cells);
+    }
+
+    // relative to the unit circle, so the weights sum to the passing fraction of the pupil
+    for(auto& w : weights){
+        set.points.push_back(pupil(w.first/(N + 1), w.first%(N + 1)));
+        set.weights.push_back(w.second/M_PI);
+    }
+
+    return set;
+}
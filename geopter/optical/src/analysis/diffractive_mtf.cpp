@@ -1,8 +1,13 @@
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <iostream>
+#include <map>
 #include <numeric>
 #include "analysis/diffractive_mtf.h"
 #include "analysis/diffractive_psf.h"
 #include "common/circ_shift.h"
 #include "common/matrix_tool.h"
+#include "common/fourier_transform.h"
 #include "renderer/renderer.h"
 
 using namespace geopter;
@@ -61,9 +66,9 @@ std::shared_ptr<PlotData> DiffractiveMTF::plot(OpticalSystem* opt_sys, int M)
 
         //Eigen::MatrixXcd psf2_c = (psf.array().pow(2)). template cast<std::complex<double>>();
 
-        Eigen::MatrixXcd temp = Eigen::MatrixXcd::Zero(2*M, 2*M);
+        Eigen::MatrixXd temp = Eigen::MatrixXd::Zero(2*M, 2*M);
         //temp.block(M, M,M,M) = psf2_c;
-        temp.block(M, M,M,M) = (psf.array().pow(2)). template cast<std::complex<double>>();
+        temp.block(M, M,M,M) = psf.array().pow(2);
 
         //Eigen::MatrixXcd temp1 = fftshift(temp);
         //Eigen::MatrixXcd temp2 = MatrixTool::fft2(fftshift(temp));
@@ -72,7 +77,10 @@ std::shared_ptr<PlotData> DiffractiveMTF::plot(OpticalSystem* opt_sys, int M)
         //double mtf0 = temp3(0,0);
         //Eigen::MatrixXd mtf = temp3.array()/mtf0;
 
-        Eigen::MatrixXd mtf = (MatrixTool::fft2(fftshift(temp))).array().abs();
+        // the input is real, so the half cost transform is used
+        Eigen::MatrixXcd spectrum;
+        FourierTransform::Forward2(spectrum, Eigen::MatrixXd(fftshift(temp)));
+        Eigen::MatrixXd mtf = spectrum.array().abs();
         double mtf0 = mtf(0,0);
         mtf = mtf.array()/mtf0;
 
@@ -102,3 +110,160 @@ std::shared_ptr<PlotData> DiffractiveMTF::plot(OpticalSystem* opt_sys, int M)
     return plot_data;
 }
 
+
+std::vector< std::complex<double> > DiffractiveMTF::ComputeOTF(const Field *fld, double wvl, const std::vector<double> &freqs, double azimuth, int nrd)
+{
+    std::vector< std::complex<double> > otf(freqs.size(), 0.0);
+
+    const PupilSampling sampling = PupilSampling::Grid(nrd);
+    auto wf = pupil_wavefront(fld, wvl, sampling);
+    if( !wf->valid ){
+        std::cerr << "Failed to trace chief ray" << std::endl;
+        return otf;
+    }
+
+    // complex pupil function, zero where no ray passes
+    const double k = 2.0*M_PI/(wvl*1.0e-6);
+    Eigen::MatrixXcd pupil_func = Eigen::MatrixXcd::Zero(nrd, nrd);
+    for(int i = 0; i < nrd; i++){
+        for(int j = 0; j < nrd; j++){
+            if(wf->mask(i,j)){
+                pupil_func(i,j) = std::polar(1.0, -k*wf->opd(i,j));
+            }
+        }
+    }
+
+    std::vector<double> shifts(freqs.size());
+    const double shift_per_freq = pupil_shift_per_frequency(*wf);
+    for(size_t fi = 0; fi < freqs.size(); fi++){
+        shifts[fi] = freqs[fi]*shift_per_freq;
+    }
+
+    return PupilAutocorrelation(pupil_func, shifts, azimuth);
+}
+
+std::vector< std::complex<double> > DiffractiveMTF::PupilAutocorrelation(const Eigen::MatrixXcd &pupil_func, const std::vector<double> &shifts, double azimuth)
+{
+    std::vector< std::complex<double> > otf(shifts.size(), 0.0);
+
+    const double otf0 = pupil_func.squaredNorm();
+    if(otf0 <= 0.0){
+        return otf;
+    }
+
+    const int nx = pupil_func.cols();
+    const int ny = pupil_func.rows();
+
+    // sum of P(p)*conj(P(p - s)) for the integer shift s = (dx, dy)
+    std::map<std::pair<int,int>, std::complex<double> > overlaps;
+    auto overlap = [&](int dx, int dy){
+        if(abs(dx) >= nx || abs(dy) >= ny){
+            return std::complex<double>(0.0, 0.0);
+        }
+
+        auto it = overlaps.find({dx, dy});
+        if(it != overlaps.end()){
+            return it->second;
+        }
+
+        const int w = nx - abs(dx);
+        const int h = ny - abs(dy);
+        std::complex<double> sum = (pupil_func.block(std::max(0, dy), std::max(0, dx), h, w).array() *
+                                    pupil_func.block(std::max(0, -dy), std::max(0, -dx), h, w).array().conjugate()).sum();
+
+        overlaps[{dx, dy}] = sum;
+        return sum;
+    };
+
+    // fractional parts this close to an integer are taken as exact, e.g. cos(pi/2)
+    constexpr double snap = 1.0e-9;
+
+    for(size_t fi = 0; fi < shifts.size(); fi++){
+        double sx = shifts[fi]*cos(azimuth);
+        double sy = shifts[fi]*sin(azimuth);
+        if(fabs(sx - round(sx)) < snap) sx = round(sx);
+        if(fabs(sy - round(sy)) < snap) sy = round(sy);
+
+        const int x0 = (int)floor(sx);
+        const int y0 = (int)floor(sy);
+        const double fx = sx - x0;
+        const double fy = sy - y0;
+
+        std::complex<double> val = (1.0 - fx)*(1.0 - fy)*overlap(x0, y0);
+        if(fx > 0.0){
+            val += fx*(1.0 - fy)*overlap(x0 + 1, y0);
+        }
+        if(fy > 0.0){
+            val += (1.0 - fx)*fy*overlap(x0, y0 + 1);
+        }
+        if(fx > 0.0 && fy > 0.0){
+            val += fx*fy*overlap(x0 + 1, y0 + 1);
+        }
+
+        otf[fi] = val/otf0;
+    }
+
+    return otf;
+}
+
+std::shared_ptr<PlotData> DiffractiveMTF::PlotByAutocorrelation(int nrd, double max_freq, double freq_step)
+{
+    const int num_flds = opt_sys_->GetOpticalSpec()->GetFieldSpec()->NumberOfFields();
+    const int num_wvls = opt_sys_->GetOpticalSpec()->GetWavelengthSpec()->NumberOfWavelengths();
+    std::vector<double> wvl_list = opt_sys_->GetOpticalSpec()->GetWavelengthSpec()->GetWavelengthList();
+    std::vector<double> wt_list = opt_sys_->GetOpticalSpec()->GetWavelengthSpec()->GetWeightList();
+
+    const double sum_wt = std::accumulate(wt_list.begin(), wt_list.end(), 0.0);
+
+    std::vector<double> freqs;
+    for(double freq = 0.0; freq < max_freq; freq += freq_step){
+        freqs.push_back(freq);
+    }
+
+    const int num_freqs = freqs.size();
+
+    auto plot_data = std::make_shared<PlotData>();
+    plot_data->SetPlotStyle(Renderer::PlotStyle::Curve);
+    plot_data->SetTitle("Diffraction MTF");
+    plot_data->SetXLabel("Spatial Frequency");
+    plot_data->SetYLabel("MTF");
+
+    for(int fi = 0; fi < num_flds; fi++){
+        Field* fld = opt_sys_->GetOpticalSpec()->GetFieldSpec()->GetField(fi);
+
+        std::vector< std::complex<double> > otf_sag(num_freqs, 0.0);
+        std::vector< std::complex<double> > otf_tan(num_freqs, 0.0);
+
+        for(int wi = 0; wi < num_wvls; wi++){
+            auto sag = ComputeOTF(fld, wvl_list[wi], freqs, 0.0, nrd);
+            auto tan = ComputeOTF(fld, wvl_list[wi], freqs, M_PI/2.0, nrd);
+            for(int k = 0; k < num_freqs; k++){
+                otf_sag[k] += wt_list[wi]*sag[k];
+                otf_tan[k] += wt_list[wi]*tan[k];
+            }
+        }
+
+        std::vector<double> mtf_sag(num_freqs), mtf_tan(num_freqs);
+        for(int k = 0; k < num_freqs; k++){
+            mtf_sag[k] = std::abs(otf_sag[k])/sum_wt;
+            mtf_tan[k] = std::abs(otf_tan[k])/sum_wt;
+        }
+
+        auto graph_sag = std::make_shared<Graph2d>();
+        graph_sag->SetData(freqs, mtf_sag);
+        graph_sag->SetLineStyle(Renderer::LineStyle::Solid);
+        graph_sag->SetRenderColor(fld->RenderColor());
+        graph_sag->SetName("MTF_S F" + std::to_string(fi));
+
+        auto graph_tan = std::make_shared<Graph2d>();
+        graph_tan->SetData(freqs, mtf_tan);
+        graph_tan->SetLineStyle(Renderer::LineStyle::Dots);
+        graph_tan->SetRenderColor(fld->RenderColor());
+        graph_tan->SetName("MTF_T F" + std::to_string(fi));
+
+        plot_data->AddGraph(graph_sag);
+        plot_data->AddGraph(graph_tan);
+    }
+
+    return plot_data;
+}
@@ -3,6 +3,7 @@
 #include <complex>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include "Eigen/Dense"
 #include "unsupported/Eigen/MatrixFunctions"
 #include "unsupported/Eigen/FFT"
@@ -10,6 +11,7 @@
 #include "sequential/sequential_trace.h"
 #include "sequential/trace_error.h"
 #include "common/matrix_tool.h"
+#include "common/fourier_transform.h"
 #include "common/circ_shift.h"
 
 using namespace geopter;
@@ -51,7 +53,9 @@ std::shared_ptr<DataGrid> DiffractivePSF::Create(const Field *fld, double wvl, i
     double k = M_PI;
     Eigen::MatrixXcd H = O.array() * ((-k*im*O).array().exp());
     //Eigen::MatrixXcd H = O;
-    Eigen::MatrixXd psf = ((fftshift( MatrixTool::fft2(ifftshift(H)).matrix() )).array().abs() ).block(ndim/2, ndim/2, ndim, ndim) ;
+    Eigen::MatrixXcd spectrum = ifftshift(H);
+    FourierTransform::Forward2(spectrum);
+    Eigen::MatrixXd psf = ((fftshift(spectrum)).array().abs() ).block(ndim/2, ndim/2, ndim, ndim) ;
     //Eigen::MatrixXd psf = ((fftshift( MatrixTool::fft2(ifftshift(O)).matrix() )).array().abs() ).block(ndim/2, ndim/2, ndim, ndim);
 
     psf /= psf.array().maxCoeff();
@@ -70,16 +74,11 @@ void DiffractivePSF::CreateFromOpdTrace(OpticalSystem* opt_sys, const Field* fld
      *
      */
 
-    SequentialTrace *tracer = new SequentialTrace(opt_sys);
-    tracer->SetApertureCheck(true);
-    tracer->SetApplyVig(false);
-
-    SequentialPath seq_path = tracer->CreateSequentialPath(wvl);
-
-    auto chief_ray = std::make_shared<Ray>();
-    chief_ray->Allocate(seq_path.Size());
-    if( TRACE_SUCCESS != tracer->TracePupilRay(chief_ray, seq_path, Eigen::Vector2d({0.0, 0.0}), fld, wvl) ){
+    // the chief ray alone, to determine the sampling
+    auto chief_ray = trace_chief_ray(fld, wvl);
+    if( !chief_ray ){
         std::cerr << "Trace error" << std::endl;
+        return;
     }
 
     double du = L/static_cast<double>(M);
@@ -102,39 +101,23 @@ void DiffractivePSF::CreateFromOpdTrace(OpticalSystem* opt_sys, const Field* fld
     }
     fv = fu;
 
-
+    // pupil coordinates are fu*lz/wxp on both axes
+    const double pupil_start = fu[0]*lz/wxp;
+    const double pupil_step = (1.0/L)*lz/wxp;
+    auto wf = pupil_wavefront(fld, wvl, PupilSampling{M, M, pupil_start, pupil_step, pupil_start, pupil_step});
 
     W_ = Eigen::MatrixXd::Zero(M, M);
     Eigen::MatrixXcd A = Eigen::MatrixXcd::Zero(M, M);
-    Eigen::Vector2d pupil;
-    RayPtr ray = std::make_shared<Ray>(seq_path.Size());
 
     for(int i = 0; i < M; i++){
         for(int j = 0; j < M; j++){
-            pupil(0) = fu[j] * lz/wxp;
-            pupil(1) = fv[i] * lz/wxp;
-
-            if(pupil.norm() <= 1.0){
-                tracer->TracePupilRay(ray, seq_path, pupil, fld, wvl);
-
-                if(ray->Status() == TRACE_SUCCESS){
-                    double opd = wave_abr_full_calc(ray, chief_ray);
-                    W_(i,j) = opd;
-                    A(i,j) = 1.0;
-                }else{
-                    W_(i,j) = 0.0;
-                    A(i,j) = 0.0;
-                }
-            }else{
-                W_(i,j) = 0.0;
-                A(i,j) = 0.0;
+            if(wf->mask(i,j)){
+                W_(i,j) = wf->opd(i,j);
+                A(i,j) = 1.0;
             }
-
         }
     }
 
-    delete tracer;
-
     std::complex<double> im(0.0, 1.0);
 
     Eigen::MatrixXcd H = A.array() * ((-k*im*W_).array().exp());
@@ -146,8 +129,156 @@ void DiffractivePSF::CreateFromOpdTrace(OpticalSystem* opt_sys, const Field* fld
     //Eigen::MatrixXcd psf3 = fftshift(psf2);
     //Eigen::MatrixXcd psf3 = fftshift( MatrixTool::fft2(ifftshift(H)).matrix() );
     //psf_ = psf3.array().abs();
-    psf_ = (fftshift( MatrixTool::fft2(ifftshift(H)).matrix() )).array().abs();
+    Eigen::MatrixXcd spectrum = ifftshift(H);
+    FourierTransform::Forward2(spectrum);
+    psf_ = (fftshift(spectrum)).array().abs();
+
+}
+
+std::shared_ptr<DataGrid> DiffractivePSF::CreateByMatrixFourier(const Field *fld, double wvl, int nrd, int ndim, double pitch, double cx, double cy)
+{
+    auto chief_ray = trace_chief_ray(fld, wvl);
+    if( !chief_ray ){
+        std::cerr << "Failed to trace chief ray" << std::endl;
+        return std::make_shared<DataGrid>(ndim, ndim, 0.0, 0.0);
+    }
+
+    const Eigen::Vector3d cr_img_pt = chief_ray->GetBack()->IntersectPt();
+
+    Eigen::MatrixXd intensity = Eigen::MatrixXd::Zero(ndim, ndim);
+    add_mft_intensity(intensity, fld, wvl, 1.0, nrd, pitch, cr_img_pt(0) + cx, cr_img_pt(1) + cy);
+
+    std::ostringstream oss;
+    oss << "MFT PSF, wavelength " << wvl << ", pitch " << pitch;
+    return create_psf_grid(intensity, pitch, oss.str());
+}
 
+std::shared_ptr<DataGrid> DiffractivePSF::CreatePolychromatic(const Field *fld, int nrd, int ndim, double pitch, double cx, double cy)
+{
+    WavelengthSpec* wvl_spec = opt_sys_->GetOpticalSpec()->GetWavelengthSpec();
+    const int num_wvls = wvl_spec->NumberOfWavelengths();
+
+    auto chief_ray = trace_chief_ray(fld, wvl_spec->ReferenceWavelength());
+    if( !chief_ray ){
+        std::cerr << "Failed to trace chief ray" << std::endl;
+        return std::make_shared<DataGrid>(ndim, ndim, 0.0, 0.0);
+    }
+
+    const Eigen::Vector3d cr_img_pt = chief_ray->GetBack()->IntersectPt();
+
+    Eigen::MatrixXd intensity = Eigen::MatrixXd::Zero(ndim, ndim);
+    for(int wi = 0; wi < num_wvls; wi++){
+        const Wavelength* wvl = wvl_spec->GetWavelength(wi);
+        add_mft_intensity(intensity, fld, wvl->Value(), wvl->Weight(), nrd, pitch, cr_img_pt(0) + cx, cr_img_pt(1) + cy);
+    }
+
+    std::ostringstream oss;
+    oss << "Polychromatic MFT PSF, pitch " << pitch;
+    return create_psf_grid(intensity, pitch, oss.str());
 }
 
+RayPtr DiffractivePSF::trace_chief_ray(const Field *fld, double wvl)
+{
+    SequentialTrace tracer(opt_sys_);
+    tracer.SetApertureCheck(true);
+    tracer.SetApplyVig(false);
+
+    const SequentialPath seq_path = tracer.CreateSequentialPath(wvl);
+
+    auto chief_ray = std::make_shared<Ray>(seq_path.Size());
+    if(TRACE_SUCCESS != tracer.TracePupilRay(chief_ray, seq_path, Eigen::Vector2d({0.0, 0.0}), fld, wvl)){
+        return nullptr;
+    }
 
+    return chief_ray;
+}
+
+bool DiffractivePSF::add_mft_intensity(Eigen::MatrixXd &intensity, const Field *fld, double wvl, double weight, int nrd, double pitch, double x0, double y0)
+{
+    const PupilSampling sampling = PupilSampling::Grid(nrd);
+    auto wf = pupil_wavefront(fld, wvl, sampling);
+    if( !wf->valid ){
+        std::cerr << "Failed to trace chief ray, wavelength " << wvl << std::endl;
+        return false;
+    }
+
+    const double k = 2.0*M_PI/(wvl*1.0e-6);
+    Eigen::MatrixXcd pupil_func = Eigen::MatrixXcd::Zero(nrd, nrd);
+    int num_samples = 0;
+    for(int i = 0; i < nrd; i++){
+        for(int j = 0; j < nrd; j++){
+            if(wf->mask(i,j)){
+                pupil_func(i,j) = std::polar(1.0, -k*wf->opd(i,j));
+                num_samples++;
+            }
+        }
+    }
+
+    if(num_samples == 0){
+        return false;
+    }
+
+    // the phase of the plane wave of a pupil sample at the image point x is k*n*(d - d_chief).x, where d is the ray direction.
+    // the direction cosines are fitted linearly to the grid index on each axis, which keeps the transform separable and
+    // includes the obliquity of off axis beams that the paraxial exit pupil lacks
+    const OpticalAssembly* assembly = opt_sys_->GetOpticalAssembly();
+    const double n_img = fabs(assembly->ImageSpaceGap()->GetMaterial()->RefractiveIndex(wvl));
+    const Eigen::Vector3d cr_img_pt = wf->chief_ray->GetBack()->IntersectPt();
+    const Eigen::Vector3d cr_img_dir = wf->chief_ray->GetBack()->Direction();
+    const double center = 0.5*(nrd - 1);
+
+    double sxx = 0.0, sxd = 0.0, syy = 0.0, syd = 0.0;
+    for(int i = 0; i < nrd; i++){
+        for(int j = 0; j < nrd; j++){
+            if(wf->mask(i,j)){
+                const Eigen::Vector3d& dir = wf->image_dirs[i*nrd + j];
+                sxx += (j - center)*(j - center);
+                sxd += (j - center)*(dir(0) - cr_img_dir(0));
+                syy += (i - center)*(i - center);
+                syd += (i - center)*(dir(1) - cr_img_dir(1));
+            }
+        }
+    }
+
+    // cycles per pupil sample for unit image distance, with the sign of the forward transform
+    const double lambda = wvl*1.0e-6;
+    const double cycles_x = (sxx > 0.0) ? -n_img*(sxd/sxx)/lambda : 0.0;
+    const double cycles_y = (syy > 0.0) ? -n_img*(syd/syy)/lambda : 0.0;
+
+    // the OPD is referenced to the chief ray intercept of this wavelength, so the window is shifted by its lateral color
+    const int ndim = intensity.rows();
+    const double half = 0.5*(ndim - 1);
+
+    Eigen::VectorXd freq_x(ndim), freq_y(ndim);
+    for(int n = 0; n < ndim; n++){
+        freq_x(n) = (x0 - cr_img_pt(0) + (n - half)*pitch)*cycles_x;
+        freq_y(n) = (y0 - cr_img_pt(1) + (n - half)*pitch)*cycles_y;
+    }
+
+    Eigen::MatrixXcd field;
+    FourierTransform::Matrix2(field, pupil_func, freq_x, freq_y);
+
+    // the intensity integrates to the number of samples over one period of the transform
+    intensity += (weight*fabs(cycles_x*cycles_y)/num_samples)*field.cwiseAbs2();
+
+    return true;
+}
+
+std::shared_ptr<DataGrid> DiffractivePSF::create_psf_grid(Eigen::MatrixXd &intensity, double pitch, const std::string &desc)
+{
+    const int ndim = intensity.rows();
+
+    const double peak = intensity.maxCoeff();
+    if(peak > 0.0){
+        intensity /= peak;
+    }
+
+    auto psf_grid = std::make_shared<DataGrid>(ndim, ndim, ndim*pitch, ndim*pitch);
+    psf_grid->SetValueMatrix(intensity);
+    psf_grid->SetDescription(desc);
+    psf_grid->SetXLabel("X");
+    psf_grid->SetYLabel("Y");
+    psf_grid->SetValueLabel("Relative Intensity");
+
+    return psf_grid;
+}
@@ -1,35 +1,52 @@
 #define _USE_MATH_DEFINES
+#include <algorithm>
+#include <cassert>
 #include <cmath>
+#include <complex>
 
 #include "analysis/geometrical_mtf.h"
 #include "sequential/sequential_trace.h"
 #include "renderer/renderer.h"
+#include "common/fourier_transform.h"
+#include "analysis/pupil_sampler.h"
 
 
 namespace  {
 
-
-double CalculateGeometricalMtf(double s, double t, const std::vector<double>& x, const std::vector<double>& y)
+/** Deposit the weight at the fractional bin position u to the two nearest bins, wrapped to the size */
+inline void deposit(std::vector<double>& bins, double u)
 {
-    assert(x.size() == y.size());
+    const int num_bins = bins.size();
+    const double fl = floor(u);
+    const double frac = u - fl;
 
-    const int N = x.size();
-
-    double Rc = 0.0;
-    double Rs = 0.0;
-    for(int i= 0; i < N; i++){
-        Rc += cos( 2.0*M_PI*(s*x[i] + t*y[i]) );
-        Rs += sin( 2.0*M_PI*(s*x[i] + t*y[i]) );
+    int i0 = static_cast<int>(fl) % num_bins;
+    if(i0 < 0){
+        i0 += num_bins;
     }
+    const int i1 = (i0 + 1 == num_bins) ? 0 : i0 + 1;
 
-    Rc /= static_cast<double>(N);
-    Rs /= static_cast<double>(N);
-
-    double mtf = sqrt(Rc*Rc + Rs*Rs);
+    bins[i0] += 1.0 - frac;
+    bins[i1] += frac;
+}
 
-    return mtf;
+/** Spectrum of the linear deposit of a point, divided out from the binned transform */
+inline double deposit_response(double f_times_width)
+{
+    if(f_times_width == 0.0){
+        return 1.0;
+    }
+    const double x = M_PI*f_times_width;
+    const double sinc = sin(x)/x;
+    return sinc*sinc;
 }
 
+/** Minimum number of bins per period of the highest frequency */
+constexpr int bins_per_period = 16;
+
+/** Upper bound of the number of bins of the direct sum */
+constexpr int max_direct_bins = 1 << 16;
+
 }
 
 using namespace geopter;
@@ -60,8 +77,6 @@ std::shared_ptr<PlotData> GeometricalMTF::plot(OpticalSystem* opt_sys, int nrd,
         }
     }
 
-    const int num_freqs = freqs.size();
-
     std::shared_ptr<PlotData> plot_data = std::make_shared<PlotData>();
     plot_data->SetPlotStyle(0);
     plot_data->SetTitle("Geometrical MTF");
@@ -105,50 +120,25 @@ std::shared_ptr<PlotData> GeometricalMTF::plot(OpticalSystem* opt_sys, int nrd,
         us.reserve(nrd*nrd);
         vs.reserve(nrd*nrd);
 
-        Eigen::Vector2d pupil;
-        const double step = 2.0/static_cast<double>(nrd-1);
+        auto samples = PupilSampler::Create(PupilSampler::Grid, nrd);
 
         for(int wi = 0; wi < num_wvls; wi++){
             double wvl = opt_sys->GetOpticalSpec()->GetWavelengthSpec()->GetWavelength(wi)->Value();
 
-            for (int pi = 0; pi < nrd; pi++){
-                for(int pj = 0; pj < nrd; pj++){
-                    pupil(0) = -1.0 + static_cast<double>(pj)*step;
-                    pupil(1) = -1.0 + static_cast<double>(pi)*step;
+            for(const Eigen::Vector2d& pupil : samples->points){
+                ray->SetStatus(TRACE_SUCCESS);
+                if(TRACE_SUCCESS == tracer->TracePupilRay(ray,seq_paths[wi], pupil, fld, wvl)){
+                    double dx = ray->GetBack()->X() - chief_ray_x;
+                    double dy = ray->GetBack()->Y() - chief_ray_y;
 
-                    if(pupil.norm() <= 1.00){
-                        ray->SetStatus(TRACE_SUCCESS);
-                        if(TRACE_SUCCESS == tracer->TracePupilRay(ray,seq_paths[wi], pupil, fld, wvl)){
-                            double ray_x = ray->GetBack()->X();
-                            double ray_y = ray->GetBack()->Y();
-
-                            double dx = ray_x - chief_ray_x;
-                            double dy = ray_y - chief_ray_y;
-
-                            us.push_back(dx);
-                            vs.push_back(dy);
-                        }
-                    }
+                    us.push_back(dx);
+                    vs.push_back(dy);
                 }
-
-
             }
-
-
-
         }
 
-        std::vector<double> mtf_tan_list(num_freqs, 0.0);
-        std::vector<double> mtf_sag_list(num_freqs, 0.0);
-
-        for(int fk=0; fk < num_freqs; fk++){
-            double freq = freqs[fk];
-            double mtf_sag = CalculateGeometricalMtf(freq, 0.0, us, vs);
-            double mtf_tan = CalculateGeometricalMtf(0.0, freq, us, vs);
-
-            mtf_sag_list[fk] = mtf_sag;
-            mtf_tan_list[fk] = mtf_tan;
-        }
+        std::vector<double> mtf_sag_list = ComputeMTF(us, vs, freqs, 0.0);
+        std::vector<double> mtf_tan_list = ComputeMTF(us, vs, freqs, M_PI/2.0);
 
         std::shared_ptr<Graph2d> graph_tan = std::make_shared<Graph2d>();
         graph_tan->SetData(freqs, mtf_tan_list);
@@ -170,3 +160,92 @@ std::shared_ptr<PlotData> GeometricalMTF::plot(OpticalSystem* opt_sys, int nrd,
 
     return plot_data;
 }
+
+std::vector<double> GeometricalMTF::ComputeMTF(const std::vector<double> &x, const std::vector<double> &y, const std::vector<double> &freqs, double azimuth)
+{
+    assert(x.size() == y.size());
+
+    const int num_points = x.size();
+    const int num_freqs = freqs.size();
+
+    std::vector<double> mtf(num_freqs, 0.0);
+    if(num_points == 0 || num_freqs == 0){
+        return mtf;
+    }
+
+    const double c = cos(azimuth);
+    const double s = sin(azimuth);
+
+    std::vector<double> proj(num_points);
+    for(int i = 0; i < num_points; i++){
+        proj[i] = c*x[i] + s*y[i];
+    }
+
+    double max_freq = 0.0;
+    for(int k = 0; k < num_freqs; k++){
+        max_freq = std::max(max_freq, fabs(freqs[k]));
+    }
+
+    if(max_freq == 0.0){
+        std::fill(mtf.begin(), mtf.end(), 1.0);
+        return mtf;
+    }
+
+    // frequencies k*step from zero
+    const double step = (num_freqs > 1) ? freqs[1] - freqs[0] : freqs[0];
+    bool harmonic = (step > 0.0);
+    for(int k = 0; k < num_freqs && harmonic; k++){
+        const double multiple = freqs[k]/step;
+        harmonic = (multiple >= 0.0) && (fabs(multiple - round(multiple)) < 1.0e-9*std::max(1.0, multiple));
+    }
+
+    if(harmonic){
+        const int max_harmonic = static_cast<int>(round(max_freq/step));
+        int num_bins = 64;
+        while(num_bins < bins_per_period*max_harmonic){
+            num_bins <<= 1;
+        }
+
+        // exp(-2*pi*i*k*step*p) has the period 1/step in p, so the points are wrapped into one period
+        const double bin_width = 1.0/(step*num_bins);
+        std::vector<double> bins(num_bins, 0.0);
+        for(int i = 0; i < num_points; i++){
+            deposit(bins, proj[i]/bin_width);
+        }
+
+        std::vector< std::complex<double> > spectrum(bins.begin(), bins.end());
+        FourierTransform::Forward(spectrum.data(), num_bins);
+
+        for(int k = 0; k < num_freqs; k++){
+            const int h = static_cast<int>(round(freqs[k]/step));
+            mtf[k] = std::abs(spectrum[h])/(num_points*deposit_response(static_cast<double>(h)/num_bins));
+        }
+    }
+    else{
+        const double p_min = *std::min_element(proj.begin(), proj.end());
+        const double p_max = *std::max_element(proj.begin(), proj.end());
+
+        double bin_width = 1.0/(bins_per_period*max_freq);
+        if((p_max - p_min)/bin_width + 2 > max_direct_bins){
+            bin_width = (p_max - p_min)/(max_direct_bins - 2);
+        }
+        const int num_bins = static_cast<int>((p_max - p_min)/bin_width) + 2;
+
+        std::vector<double> bins(num_bins, 0.0);
+        for(int i = 0; i < num_points; i++){
+            deposit(bins, (proj[i] - p_min)/bin_width);
+        }
+
+        for(int k = 0; k < num_freqs; k++){
+            const double phi = -2.0*M_PI*freqs[k]*bin_width;
+            double re = 0.0, im = 0.0;
+            for(int b = 0; b < num_bins; b++){
+                re += bins[b]*cos(phi*b);
+                im += bins[b]*sin(phi*b);
+            }
+            mtf[k] = sqrt(re*re + im*im)/(num_points*deposit_response(freqs[k]*bin_width));
+        }
+    }
+
+    return mtf;
+}
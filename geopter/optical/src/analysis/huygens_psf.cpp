@@ -0,0 +1,296 @@
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+#include "analysis/huygens_psf.h"
+#include "common/parallel.h"
+
+using namespace geopter;
+
+namespace {
+
+/** A ray point on the exit pupil reference sphere */
+struct PupilSample
+{
+    Eigen::Vector3d pt;
+    Eigen::Vector3d dir;
+    double opl;
+    bool valid = false;
+};
+
+}
+
+HuygensPSF::HuygensPSF(OpticalSystem *opt_sys) :
+    WaveAberration(opt_sys),
+    num_threads_(0),
+    offset_x_(0.0),
+    offset_y_(0.0),
+    defocus_(0.0),
+    pitch_(0.0),
+    symmetric_(false)
+{
+
+}
+
+HuygensPSF::~HuygensPSF()
+{
+
+}
+
+void HuygensPSF::SetImageOffset(double x, double y, double defocus)
+{
+    offset_x_ = x;
+    offset_y_ = y;
+    defocus_ = defocus;
+}
+
+std::shared_ptr<DataGrid> HuygensPSF::Create(const Field *fld, double wvl, int nrd, int ndim, double pitch)
+{
+    symmetric_ = is_symmetric(fld) && (offset_x_ == 0.0);
+
+    // pupil sampled at the cell centers of nrd x nrd grid
+    const double step = 2.0/(double)nrd;
+    const double start = -1.0 + step/2;
+
+    auto wf = pupil_wavefront(fld, wvl, PupilSampling{nrd, nrd, start, step, start, step});
+    if( !wf->valid ){
+        std::cerr << "HuygensPSF: failed to trace chief ray" << std::endl;
+        return std::make_shared<DataGrid>(ndim, ndim, 0.0, 0.0);
+    }
+
+    const RayPtr& chief_ray = wf->chief_ray;
+
+    double cr_exp_dist;
+    Eigen::Vector3d cr_exp_pt;
+    get_chief_ray_exp_segment(cr_exp_pt, cr_exp_dist, chief_ray);
+
+    // reference sphere centered at the chief ray intercept, in the local coordinate of the image surface
+    const RaySegment* cr_img_seg = chief_ray->GetBack();
+    const Eigen::Vector3d ref_center = cr_img_seg->IntersectPt();
+    const double ref_radius = cr_img_seg->PathLength() - cr_exp_dist;
+
+    if(ref_radius <= 0.0){
+        std::cerr << "HuygensPSF: exit pupil is not in front of the image" << std::endl;
+        return std::make_shared<DataGrid>(ndim, ndim, 0.0, 0.0);
+    }
+
+    const OpticalAssembly* assembly = opt_sys_->GetOpticalAssembly();
+    const double n_img = fabs(assembly->ImageSpaceGap()->GetMaterial()->RefractiveIndex(wvl));
+
+    // ---> pupil rays on the reference sphere
+    // The optical path to the sphere relative to the chief ray is the negative OPD of the wavefront
+
+    std::vector<PupilSample> samples(nrd*nrd);
+
+    for(int i = 0; i < nrd; i++){
+        for(int j = 0; j < nrd; j++){
+            if( !wf->mask(i, j) ){
+                continue;
+            }
+
+            const Eigen::Vector3d& pt  = wf->image_pts[i*nrd + j];
+            const Eigen::Vector3d& dir = wf->image_dirs[i*nrd + j];
+
+            // go back along the ray to the reference sphere
+            const Eigen::Vector3d delta = pt - ref_center;
+            const double b = dir.dot(delta);
+            const double c = delta.squaredNorm() - ref_radius*ref_radius;
+            const double disc = b*b - c;
+            if(disc < 0.0){
+                continue;
+            }
+            const double s = b + sqrt(disc);
+
+            PupilSample& smp = samples[i*nrd + j];
+            smp.pt = pt - s*dir;
+            smp.dir = dir;
+            smp.opl = -wf->opd(i, j);
+            smp.valid = true;
+        }
+    }
+
+    // <---
+
+    // ---> amplitudes
+    // Each ray carries the same power, so the field on the sphere is proportional to 1/sqrt(area)
+    // and the wavelet weight, field times area, to sqrt(area). The area is taken from the neighbors on the grid.
+
+    auto valid_at = [&](int i, int j){
+        return (i >= 0 && i < nrd && j >= 0 && j < nrd && samples[i*nrd + j].valid);
+    };
+
+    auto gradient = [&](Eigen::Vector3d& g, int i, int j, int di, int dj){
+        const bool fwd = valid_at(i + di, j + dj);
+        const bool bwd = valid_at(i - di, j - dj);
+        if(fwd && bwd){
+            g = 0.5*(samples[(i+di)*nrd + j+dj].pt - samples[(i-di)*nrd + j-dj].pt);
+        }else if(fwd){
+            g = samples[(i+di)*nrd + j+dj].pt - samples[i*nrd + j].pt;
+        }else if(bwd){
+            g = samples[i*nrd + j].pt - samples[(i-di)*nrd + j-dj].pt;
+        }else{
+            return false;
+        }
+        return true;
+    };
+
+    std::vector<double> areas(nrd*nrd, -1.0);
+    double area_sum = 0.0;
+    int area_count = 0;
+    int num_samples = 0;
+    Eigen::Vector3d gu, gv;
+
+    for(int i = 0; i < nrd; i++){
+        for(int j = 0; j < nrd; j++){
+            if( !samples[i*nrd + j].valid ){
+                continue;
+            }
+            num_samples++;
+            if(gradient(gu, i, j, 0, 1) && gradient(gv, i, j, 1, 0)){
+                areas[i*nrd + j] = gu.cross(gv).norm();
+                area_sum += areas[i*nrd + j];
+                area_count++;
+            }
+        }
+    }
+
+    if(num_samples == 0){
+        std::cerr << "HuygensPSF: no ray reached the image" << std::endl;
+        return std::make_shared<DataGrid>(ndim, ndim, 0.0, 0.0);
+    }
+
+    // isolated samples take the mean area
+    const double mean_area = (area_count > 0) ? area_sum/area_count : 1.0;
+
+    // <---
+
+    // ---> pupil samples as separate arrays for the vectorized summation
+
+    const double k0 = 2.0*M_PI/(wvl*1.0e-6);
+    const double kn = k0*n_img;
+
+    Eigen::ArrayXd qx(num_samples), qy(num_samples), qz(num_samples);
+    Eigen::ArrayXd dx(num_samples), dy(num_samples), dz(num_samples);
+    Eigen::ArrayXd phi(num_samples), amp(num_samples);
+
+    const Eigen::Vector3d cr_dir = cr_img_seg->Direction();
+    double max_sin = 0.0;
+
+    int si = 0;
+    for(int k = 0; k < nrd*nrd; k++){
+        const PupilSample& smp = samples[k];
+        if( !smp.valid ){
+            continue;
+        }
+        qx(si) = smp.pt(0);
+        qy(si) = smp.pt(1);
+        qz(si) = smp.pt(2);
+        dx(si) = smp.dir(0);
+        dy(si) = smp.dir(1);
+        dz(si) = smp.dir(2);
+        phi(si) = k0*smp.opl;
+        amp(si) = sqrt( (areas[k] < 0.0) ? mean_area : areas[k] );
+        max_sin = std::max(max_sin, smp.dir.cross(cr_dir).norm());
+        si++;
+    }
+
+    if(pitch <= 0.0){
+        const double na = std::max(n_img*max_sin, 1.0e-6);
+        pitch = 0.25*wvl*1.0e-6/na;
+    }
+    pitch_ = pitch;
+
+    // <---
+
+    // ---> sum the wavelets on the image grid
+
+    const double cx = ref_center(0) + offset_x_;
+    const double cy = ref_center(1) + offset_y_;
+    const double cz = ref_center(2) + defocus_;
+    const double half = 0.5*(ndim - 1);
+
+    // columns on the +x side, mirrored to the others
+    const int img_col_begin = symmetric_ ? ndim/2 : 0;
+
+    constexpr int tile_size = 8;
+    constexpr int chunk_size = 256;
+
+    const int tile_rows = (ndim + tile_size - 1)/tile_size;
+    const int tile_cols = (ndim - img_col_begin + tile_size - 1)/tile_size;
+
+    Eigen::MatrixXd intensity = Eigen::MatrixXd::Zero(ndim, ndim);
+
+    Parallel::For(0, tile_rows*tile_cols, [&](int ti){
+        const int row_begin = (ti / tile_cols)*tile_size;
+        const int col_begin = img_col_begin + (ti % tile_cols)*tile_size;
+        const int row_end = std::min(ndim, row_begin + tile_size);
+        const int col_end = std::min(ndim, col_begin + tile_size);
+        const int num_cols = col_end - col_begin;
+
+        Eigen::ArrayXd vx(chunk_size), vy(chunk_size), vz(chunk_size);
+        Eigen::ArrayXd r(chunk_size), w(chunk_size), phase(chunk_size);
+
+        Eigen::ArrayXXd acc_re = Eigen::ArrayXXd::Zero(tile_size, tile_size);
+        Eigen::ArrayXXd acc_im = Eigen::ArrayXXd::Zero(tile_size, tile_size);
+
+        for(int b = 0; b < num_samples; b += chunk_size){
+            const int n = std::min(chunk_size, num_samples - b);
+
+            for(int row = row_begin; row < row_end; row++){
+                const double py = cy + (row - half)*pitch;
+
+                for(int col = col_begin; col < col_end; col++){
+                    const double px = cx + (col - half)*pitch;
+
+                    vx.head(n) = px - qx.segment(b, n);
+                    vy.head(n) = py - qy.segment(b, n);
+                    vz.head(n) = cz - qz.segment(b, n);
+
+                    r.head(n) = (vx.head(n).square() + vy.head(n).square() + vz.head(n).square()).sqrt();
+
+                    // obliquity cos(theta) over distance
+                    w.head(n) = amp.segment(b, n)*(dx.segment(b, n)*vx.head(n) + dy.segment(b, n)*vy.head(n) + dz.segment(b, n)*vz.head(n))/r.head(n).square();
+
+                    phase.head(n) = phi.segment(b, n) + kn*(r.head(n) - ref_radius);
+
+                    acc_re(row - row_begin, col - col_begin) += (w.head(n)*phase.head(n).cos()).sum();
+                    acc_im(row - row_begin, col - col_begin) += (w.head(n)*phase.head(n).sin()).sum();
+                }
+            }
+        }
+
+        for(int row = row_begin; row < row_end; row++){
+            for(int c = 0; c < num_cols; c++){
+                const double re = acc_re(row - row_begin, c);
+                const double im = acc_im(row - row_begin, c);
+                intensity(row, col_begin + c) = re*re + im*im;
+            }
+        }
+    }, num_threads_);
+
+    if(symmetric_){
+        for(int col = img_col_begin; col < ndim; col++){
+            intensity.col(ndim - 1 - col) = intensity.col(col);
+        }
+    }
+
+    // <---
+
+    const double peak = intensity.maxCoeff();
+    if(peak > 0.0){
+        intensity /= peak;
+    }
+
+    auto psf_grid = std::make_shared<DataGrid>(ndim, ndim, ndim*pitch, ndim*pitch);
+    psf_grid->SetValueMatrix(intensity);
+
+    std::ostringstream oss;
+    oss << "Huygens PSF, center (" << cx << ", " << cy << "), pitch " << pitch;
+    psf_grid->SetDescription(oss.str());
+    psf_grid->SetXLabel("X");
+    psf_grid->SetYLabel("Y");
+    psf_grid->SetValueLabel("Relative Intensity");
+
+    return psf_grid;
+}
@@ -0,0 +1,273 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+#include "analysis/irradiance_map.h"
+#include "analysis/pupil_boundary.h"
+#include "sequential/sequential_trace.h"
+#include "sequential/trace_error.h"
+#include "common/parallel.h"
+
+using namespace geopter;
+
+IrradianceMap::IrradianceMap(OpticalSystem* opt_sys) :
+    opt_sys_(opt_sys),
+    srf_idx_(-1),
+    weighting_(Uniform),
+    num_threads_(0),
+    center_x_(0.0),
+    center_y_(0.0),
+    half_width_x_(0.0),
+    half_width_y_(0.0),
+    auto_window_(true),
+    total_power_(0.0),
+    num_rays_(0)
+{
+
+}
+
+IrradianceMap::~IrradianceMap()
+{
+
+}
+
+void IrradianceMap::SetWindow(double center_x, double center_y, double half_width_x, double half_width_y)
+{
+    center_x_ = center_x;
+    center_y_ = center_y;
+    half_width_x_ = half_width_x;
+    half_width_y_ = half_width_y;
+    auto_window_ = (half_width_x <= 0.0 || half_width_y <= 0.0);
+}
+
+std::shared_ptr<DataGrid> IrradianceMap::Create(int nx, int ny, int nrd)
+{
+    FieldSpec* fld_spec = opt_sys_->GetOpticalSpec()->GetFieldSpec();
+
+    std::vector<const Field*> fields;
+    for(int fi = 0; fi < fld_spec->NumberOfFields(); fi++){
+        fields.push_back(fld_spec->GetField(fi));
+    }
+
+    return create(fields, nx, ny, nrd, nullptr);
+}
+
+std::shared_ptr<DataGrid> IrradianceMap::Create(const Field *fld, int nx, int ny, int nrd)
+{
+    return create(std::vector<const Field*>({fld}), nx, ny, nrd, nullptr);
+}
+
+std::shared_ptr<DataGrid> IrradianceMap::Create(const Field *fld, int nx, int ny, const PupilSampleSet &samples)
+{
+    return create(std::vector<const Field*>({fld}), nx, ny, 0, &samples);
+}
+
+bool IrradianceMap::fit_window(const std::vector<const Field *> &fields, int srf_idx)
+{
+    SequentialTrace tracer(opt_sys_);
+    tracer.SetApertureCheck(true);
+    tracer.SetApplyVig(false);
+
+    const std::vector<Eigen::Vector2d> pupils({ {0.0, 0.0}, {1.0, 0.0}, {-1.0, 0.0}, {0.0, 1.0}, {0.0, -1.0},
+                                                {M_SQRT1_2, M_SQRT1_2}, {-M_SQRT1_2, M_SQRT1_2}, {M_SQRT1_2, -M_SQRT1_2}, {-M_SQRT1_2, -M_SQRT1_2} });
+
+    WavelengthSpec* wvl_spec = opt_sys_->GetOpticalSpec()->GetWavelengthSpec();
+
+    double x_min = INFINITY, x_max = -INFINITY;
+    double y_min = INFINITY, y_max = -INFINITY;
+
+    for(int wi = 0; wi < wvl_spec->NumberOfWavelengths(); wi++){
+        const double wvl = wvl_spec->GetWavelength(wi)->Value();
+        SequentialPath seq_path = tracer.CreateSequentialPath(wvl);
+        auto ray = std::make_shared<Ray>(seq_path.Size());
+
+        for(auto fld : fields){
+            for(auto& pupil : pupils){
+                if(TRACE_SUCCESS != tracer.TracePupilRay(ray, seq_path, pupil, fld, wvl)){
+                    continue;
+                }
+                const RaySegment* seg = ray->GetSegmentAt(srf_idx);
+                x_min = std::min(x_min, seg->X());
+                x_max = std::max(x_max, seg->X());
+                y_min = std::min(y_min, seg->Y());
+                y_max = std::max(y_max, seg->Y());
+            }
+        }
+    }
+
+    if(x_min > x_max){
+        return false;
+    }
+
+    // margin for the rays inside the pupil which land outside of the marginal rays, e.g. by coma
+    constexpr double margin = 1.1;
+    const double half_width = margin*0.5*std::max({x_max - x_min, y_max - y_min, 1.0e-3});
+
+    center_x_ = 0.5*(x_min + x_max);
+    center_y_ = 0.5*(y_min + y_max);
+    half_width_x_ = half_width;
+    half_width_y_ = half_width;
+
+    return true;
+}
+
+std::shared_ptr<DataGrid> IrradianceMap::create(const std::vector<const Field *> &fields, int nx, int ny, int nrd, const PupilSampleSet *samples)
+{
+    total_power_ = 0.0;
+    num_rays_ = 0;
+
+    const int num_srfs = opt_sys_->GetOpticalAssembly()->NumberOfSurfaces();
+    const int srf_idx = (srf_idx_ < 0) ? num_srfs - 1 : srf_idx_;
+    if(srf_idx >= num_srfs){
+        std::cerr << "IrradianceMap: surface index out of range: " << srf_idx << std::endl;
+        return std::make_shared<DataGrid>(nx, ny, 0.0, 0.0);
+    }
+
+    if(auto_window_ && !fit_window(fields, srf_idx)){
+        std::cerr << "IrradianceMap: no ray reached the surface" << std::endl;
+        return std::make_shared<DataGrid>(nx, ny, 0.0, 0.0);
+    }
+
+    SequentialTrace tracer(opt_sys_);
+    WavelengthSpec* wvl_spec = opt_sys_->GetOpticalSpec()->GetWavelengthSpec();
+    const int num_wvl = wvl_spec->NumberOfWavelengths();
+
+    std::vector<double> wvls(num_wvl);
+    std::vector<double> wvl_weights(num_wvl);
+    std::vector<SequentialPath> seq_paths(num_wvl);
+    for(int wi = 0; wi < num_wvl; wi++){
+        wvls[wi] = wvl_spec->GetWavelength(wi)->Value();
+        wvl_weights[wi] = wvl_spec->GetWavelength(wi)->Weight();
+        seq_paths[wi] = tracer.CreateSequentialPath(wvls[wi]);
+    }
+
+    const bool infinite_object = std::isinf(seq_paths[0].At(0).distance);
+
+    // the weights are fractions of the unit circle
+    const double pupil_area = M_PI;
+
+    const double x0 = center_x_ - half_width_x_;
+    const double y0 = center_y_ - half_width_y_;
+    const double bin_w = 2.0*half_width_x_/nx;
+    const double bin_h = 2.0*half_width_y_/ny;
+
+    // grid cells, as fractions of the unit circle
+    const double step = 2.0/(double)nrd;
+    const double start = -1.0 + step/2;
+    const double cell_weight = step*step/pupil_area;
+
+    // jobs are blocks of pupil samples of every field and wavelength, split into a contiguous range per thread.
+    // Without a sample set a block is a grid row, so no more than a row is stored at a time.
+    constexpr int block_size = 256;
+    const int num_sample_blocks = samples ? (samples->Size() + block_size - 1)/block_size : nrd;
+    const int num_fields = fields.size();
+    const long long num_jobs = (long long)num_fields*num_wvl*num_sample_blocks;
+
+    // rays outside of the traced boundaries would be blocked
+    const long long num_samples = samples ? samples->Size() : (long long)nrd*nrd;
+    std::vector< std::shared_ptr<const PupilBoundary> > boundaries(num_fields*num_wvl);
+    for(int fi = 0; fi < num_fields; fi++){
+        for(int wi = 0; wi < num_wvl; wi++){
+            boundaries[fi*num_wvl + wi] = PupilBoundary::FindForSamples(opt_sys_, fields[fi], wvls[wi], num_samples);
+        }
+    }
+
+    const int num_threads = std::max(1, (int)std::min<long long>(num_jobs, (num_threads_ <= 0) ? Parallel::NumberOfThreads() : num_threads_));
+
+    std::vector<Eigen::MatrixXd> hists(num_threads);
+    std::vector<double> powers(num_threads, 0.0);
+    std::vector<long long> counts(num_threads, 0);
+
+    Parallel::For(0, num_threads, [&](int ti){
+        SequentialTrace thread_tracer(opt_sys_);
+        thread_tracer.SetApertureCheck(true);
+        thread_tracer.SetApplyVig(false);
+
+        Eigen::MatrixXd& hist = hists[ti];
+        hist = Eigen::MatrixXd::Zero(ny, nx);
+
+        auto ray = std::make_shared<Ray>(seq_paths[0].Size());
+        PupilSampleSet grid_row;
+
+        const long long job_begin = num_jobs*ti/num_threads;
+        const long long job_end   = num_jobs*(ti+1)/num_threads;
+
+        for(long long job = job_begin; job < job_end; job++){
+            const int bi = job % num_sample_blocks;
+            const int wi = (job/num_sample_blocks) % num_wvl;
+            const int fi = job/((long long)num_sample_blocks*num_wvl);
+
+            const Field* fld = fields[fi];
+            const double wt = fld->Weight()*wvl_weights[wi]*pupil_area;
+
+            const PupilBoundary* boundary = boundaries[fi*num_wvl + wi].get();
+
+            const PupilSampleSet* block = samples;
+            int sample_begin, sample_end;
+            if(samples){
+                sample_begin = bi*block_size;
+                sample_end = std::min(samples->Size(), (bi + 1)*block_size);
+            }else{
+                grid_row.points.clear();
+                grid_row.weights.clear();
+                const double py = start + step*static_cast<double>(bi);
+                for(int j = 0; j < nrd; j++){
+                    const Eigen::Vector2d pupil(start + step*static_cast<double>(j), py);
+                    if(pupil.norm() <= 1.0){
+                        grid_row.points.push_back(pupil);
+                        grid_row.weights.push_back(cell_weight);
+                    }
+                }
+                block = &grid_row;
+                sample_begin = 0;
+                sample_end = grid_row.Size();
+            }
+
+            for(int k = sample_begin; k < sample_end; k++){
+                if(boundary && !boundary->Contains(block->points[k])){
+                    continue;
+                }
+                if(TRACE_SUCCESS != thread_tracer.TracePupilRay(ray, seq_paths[wi], block->points[k], fld, wvls[wi])){
+                    continue;
+                }
+
+                double w = wt*block->weights[k];
+                if(weighting_ == Lambertian){
+                    const double cos_obj = fabs(ray->GetFront()->N());
+                    w *= infinite_object ? cos_obj : cos_obj*cos_obj*cos_obj*cos_obj;
+                }
+
+                powers[ti] += w;
+                counts[ti]++;
+
+                const RaySegment* seg = ray->GetSegmentAt(srf_idx);
+                const double col = floor((seg->X() - x0)/bin_w);
+                const double row = floor((seg->Y() - y0)/bin_h);
+                if(col >= 0.0 && col < nx && row >= 0.0 && row < ny){
+                    hist((int)row, (int)col) += w;
+                }
+            }
+        }
+    }, num_threads);
+
+    Eigen::MatrixXd irradiance = Eigen::MatrixXd::Zero(ny, nx);
+    for(int ti = 0; ti < num_threads; ti++){
+        irradiance += hists[ti];
+        total_power_ += powers[ti];
+        num_rays_ += counts[ti];
+    }
+    irradiance /= (bin_w*bin_h);
+
+    auto data_grid = std::make_shared<DataGrid>(nx, ny, 2.0*half_width_x_, 2.0*half_width_y_);
+    data_grid->SetValueMatrix(irradiance);
+
+    std::ostringstream oss;
+    oss << "Irradiance at surface " << srf_idx << ", center (" << center_x_ << ", " << center_y_ << ")";
+    data_grid->SetDescription(oss.str());
+    data_grid->SetXLabel("X");
+    data_grid->SetYLabel("Y");
+    data_grid->SetValueLabel("Relative Irradiance");
+
+    return data_grid;
+}
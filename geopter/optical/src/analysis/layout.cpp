@@ -367,13 +367,15 @@ void Layout::DrawSurface(Surface* srf, double max_y, const Rgb& color)
 
 void Layout::DrawSingleRay(const std::shared_ptr<Ray>& ray, const Rgb& color)
 {
+    const OpticalAssembly* assembly = opt_sys_->GetOpticalAssembly();
+
     for(int i = 1; i <= ray->GetReachedSurfaceIndex(); i++)
     {
         Eigen::Vector3d pt_to = ray->GetSegmentAt(i)->IntersectPt();
         Eigen::Vector3d pt_from = ray->GetSegmentAt(i-1)->IntersectPt();
 
-        Surface* cur_srf = opt_sys_->GetOpticalAssembly()->GetSurface(i);
-        Surface* prev_srf = opt_sys_->GetOpticalAssembly()->GetSurface(i-1);
+        const Surface* cur_srf = assembly->GetSurface(i);
+        const Surface* prev_srf = assembly->GetSurface(i-1);
 
         Eigen::Vector2d endpt1;
         endpt1(0) = pt_from(2) + prev_srf->GlobalTransform().transfer(2);
@@ -0,0 +1,245 @@
+#define _USE_MATH_DEFINES
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+#include "analysis/pupil_boundary.h"
+#include "common/parallel.h"
+#include "sequential/sequential_trace.h"
+#include "sequential/trace_error.h"
+#include "system/optical_system.h"
+
+using namespace geopter;
+
+namespace {
+
+struct BoundaryKey
+{
+    const OpticalSystem* opt_sys;
+    unsigned long long revision;
+    const Field* fld;
+
+    /** position and aim point */
+    std::array<double, 4> fld_state;
+
+    double wvl;
+    int num_azimuths;
+
+    bool operator<(const BoundaryKey& other) const {
+        return std::tie(opt_sys, revision, fld, fld_state, wvl, num_azimuths) <
+               std::tie(other.opt_sys, other.revision, other.fld, other.fld_state, other.wvl, other.num_azimuths);
+    }
+};
+
+struct BoundaryEntry
+{
+    std::shared_ptr<const PupilBoundary> boundary;
+    unsigned long long last_access;
+};
+
+std::mutex boundary_mutex;
+std::map<BoundaryKey, BoundaryEntry> boundary_entries;
+unsigned long long access_count = 0;
+int capacity = 64;
+
+/** Drop least recently used entries over the capacity. The mutex must be held. */
+void evict()
+{
+    while((int)boundary_entries.size() > capacity){
+        auto oldest = boundary_entries.begin();
+        for(auto it = boundary_entries.begin(); it != boundary_entries.end(); it++){
+            if(it->second.last_access < oldest->second.last_access){
+                oldest = it;
+            }
+        }
+        boundary_entries.erase(oldest);
+    }
+}
+
+/** steps of the inward scan, and the bisection tolerance in the normalized pupil */
+constexpr int num_scan_steps = 8;
+constexpr double bisection_tolerance = 1.0e-4;
+
+/** outward margin of the vertices in the normalized pupil, for the edge curving between the azimuths */
+constexpr double safety_margin = 1.0e-2;
+
+/** samples of a field and wavelength per vertex over which the boundary is used, about 16 times its worst case cost */
+constexpr long long min_samples_per_vertex = 320;
+
+}
+
+PupilBoundary::PupilBoundary(const std::vector<double> &radii) :
+    radii_(radii),
+    num_traced_rays_(0)
+{
+
+}
+
+Eigen::Vector2d PupilBoundary::Vertex(int k) const
+{
+    const double ang = 2.0*M_PI*k/radii_.size();
+    return radii_[k]*Eigen::Vector2d(cos(ang), sin(ang));
+}
+
+double PupilBoundary::Radius(double azimuth) const
+{
+    const int n = radii_.size();
+    const double delta = 2.0*M_PI/n;
+
+    double t = azimuth/delta;
+    t -= n*floor(t/n);
+    const int k = std::min(static_cast<int>(t), n - 1);
+    const double phi = (t - k)*delta;
+
+    // intersection of the ray from the center with the edge between the vertices k and k+1
+    const double a = radii_[k];
+    const double b = radii_[(k + 1) % n];
+    const double denom = a*sin(phi) + b*sin(delta - phi);
+
+    return (denom > 0.0) ? a*b*sin(delta)/denom : 0.0;
+}
+
+bool PupilBoundary::Contains(const Eigen::Vector2d &pupil) const
+{
+    const int n = radii_.size();
+    const double r = pupil.norm();
+
+    // the boundary may bulge beyond the edge at a corner of the apertures, so the sector of the larger vertex is taken
+    double t = atan2(pupil(1), pupil(0))/(2.0*M_PI/n);
+    t -= n*floor(t/n);
+    const int k = std::min(static_cast<int>(t), n - 1);
+
+    return r <= std::max(radii_[k], radii_[(k + 1) % n]);
+}
+
+std::shared_ptr<const PupilBoundary> PupilBoundary::Trace(OpticalSystem *opt_sys, const Field *fld, double wvl, int num_azimuths)
+{
+    SequentialTrace tracer(opt_sys);
+    const SequentialPath seq_path = tracer.CreateSequentialPath(wvl);
+
+    // the polygon circumscribes the circle through its vertices
+    const double margin = 1.0/cos(M_PI/num_azimuths);
+
+    std::vector<double> radii(num_azimuths, 0.0);
+    std::vector<int> num_rays(num_azimuths, 0);
+
+    Parallel::For(0, num_azimuths, [&](int k){
+        SequentialTrace azimuth_tracer(opt_sys);
+        azimuth_tracer.SetApertureCheck(true);
+        azimuth_tracer.SetApplyVig(false);
+
+        auto ray = std::make_shared<Ray>(seq_path.Size());
+
+        const double ang = 2.0*M_PI*k/num_azimuths;
+        const Eigen::Vector2d dir(cos(ang), sin(ang));
+
+        auto passes = [&](double r){
+            num_rays[k]++;
+            return TRACE_SUCCESS == azimuth_tracer.TracePupilRay(ray, seq_path, r*dir, fld, wvl);
+        };
+
+        if(passes(1.0)){
+            radii[k] = margin;
+            return;
+        }
+
+        // the outermost passing radius of the scan, then bisect toward the failing one
+        double r_fail = 1.0;
+        double r_pass = -1.0;
+        for(int i = 1; i <= num_scan_steps; i++){
+            const double r = 1.0 - static_cast<double>(i)/num_scan_steps;
+            if(passes(r)){
+                r_pass = r;
+                break;
+            }
+            r_fail = r;
+        }
+
+        // the scan may step over a narrow passing band, so the azimuth is left open rather than closed
+        if(r_pass < 0.0){
+            radii[k] = margin;
+            return;
+        }
+
+        while(r_fail - r_pass > bisection_tolerance){
+            const double r = 0.5*(r_pass + r_fail);
+            if(passes(r)){
+                r_pass = r;
+            }else{
+                r_fail = r;
+            }
+        }
+
+        radii[k] = std::min(1.0, r_fail + safety_margin)*margin;
+    });
+
+    auto boundary = std::make_shared<PupilBoundary>(radii);
+    for(int n : num_rays){
+        boundary->num_traced_rays_ += n;
+    }
+
+    return boundary;
+}
+
+std::shared_ptr<const PupilBoundary> PupilBoundary::Find(OpticalSystem *opt_sys, const Field *fld, double wvl, int num_azimuths)
+{
+    BoundaryKey key;
+    key.opt_sys = opt_sys;
+    key.revision = opt_sys->ModelRevision();
+    key.fld = fld;
+    key.fld_state = {fld->X(), fld->Y(), fld->AimPt()(0), fld->AimPt()(1)};
+    key.wvl = wvl;
+    key.num_azimuths = num_azimuths;
+
+    {
+        std::lock_guard<std::mutex> lock(boundary_mutex);
+        auto it = boundary_entries.find(key);
+        if(it != boundary_entries.end()){
+            it->second.last_access = ++access_count;
+            return it->second.boundary;
+        }
+    }
+
+    auto boundary = Trace(opt_sys, fld, wvl, num_azimuths);
+
+    std::lock_guard<std::mutex> lock(boundary_mutex);
+
+    // another thread may have traced the same boundary in the meantime
+    auto inserted = boundary_entries.emplace(key, BoundaryEntry{boundary, 0});
+    inserted.first->second.last_access = ++access_count;
+    boundary = inserted.first->second.boundary;
+    evict();
+
+    return boundary;
+}
+
+std::shared_ptr<const PupilBoundary> PupilBoundary::FindForSamples(OpticalSystem *opt_sys, const Field *fld, double wvl, long long num_samples, int num_azimuths)
+{
+    if(num_samples < min_samples_per_vertex*num_azimuths){
+        return nullptr;
+    }
+
+    return Find(opt_sys, fld, wvl, num_azimuths);
+}
+
+void PupilBoundary::SetCacheCapacity(int n)
+{
+    std::lock_guard<std::mutex> lock(boundary_mutex);
+    capacity = std::max(0, n);
+    evict();
+}
+
+int PupilBoundary::NumberOfCachedBoundaries()
+{
+    std::lock_guard<std::mutex> lock(boundary_mutex);
+    return boundary_entries.size();
+}
+
+void PupilBoundary::ClearCache()
+{
+    std::lock_guard<std::mutex> lock(boundary_mutex);
+    boundary_entries.clear();
+}
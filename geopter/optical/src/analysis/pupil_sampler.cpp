@@ -0,0 +1,377 @@
+#define _USE_MATH_DEFINES
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <random>
+#include <tuple>
+
+#include "analysis/pupil_sampler.h"
+#include "analysis/pupil_boundary.h"
+#include "data/hexapolar_array.h"
+#include "spec/field.h"
+
+using namespace geopter;
+
+namespace {
+
+struct SetKey
+{
+    int pattern;
+    int n;
+
+    /** VUX, VLX, VUY, VLY */
+    std::array<double, 4> vig;
+
+    bool operator<(const SetKey& other) const {
+        return std::tie(pattern, n, vig) < std::tie(other.pattern, other.n, other.vig);
+    }
+};
+
+struct SetEntry
+{
+    std::shared_ptr<const PupilSampleSet> set;
+    unsigned long long last_access;
+};
+
+std::mutex set_mutex;
+std::map<SetKey, SetEntry> sample_sets;
+unsigned long long access_count = 0;
+int capacity = 64;
+
+/** Drop least recently used sets over the capacity. The mutex must be held. */
+void evict()
+{
+    while((int)sample_sets.size() > capacity){
+        auto oldest = sample_sets.begin();
+        for(auto it = sample_sets.begin(); it != sample_sets.end(); it++){
+            if(it->second.last_access < oldest->second.last_access){
+                oldest = it;
+            }
+        }
+        sample_sets.erase(oldest);
+    }
+}
+
+/** Area preserving map of the unit square to the unit circle (P. Shirley and K. Chiu, 1997) */
+Eigen::Vector2d concentric_map(double u, double v)
+{
+    const double a = 2.0*u - 1.0;
+    const double b = 2.0*v - 1.0;
+
+    if(a == 0.0 && b == 0.0){
+        return Eigen::Vector2d(0.0, 0.0);
+    }
+
+    double r, phi;
+    if(fabs(a) > fabs(b)){
+        r = a;
+        phi = (M_PI/4.0)*(b/a);
+    }else{
+        r = b;
+        phi = M_PI/2.0 - (M_PI/4.0)*(a/b);
+    }
+
+    return Eigen::Vector2d(r*cos(phi), r*sin(phi));
+}
+
+/** Gauss-Legendre nodes and weights on [-1, 1] by Newton iteration */
+void gauss_legendre(int n, std::vector<double>& nodes, std::vector<double>& weights)
+{
+    nodes.resize(n);
+    weights.resize(n);
+
+    for(int i = 0; i < n; i++){
+        double x = cos(M_PI*(i + 0.75)/(n + 0.5));
+        double dp = 1.0;
+
+        for(int iter = 0; iter < 100; iter++){
+            // P_n(x) and its derivative by the three term recurrence
+            double p0 = 1.0, p1 = x;
+            for(int k = 2; k <= n; k++){
+                const double p2 = ((2.0*k - 1.0)*x*p1 - (k - 1.0)*p0)/k;
+                p0 = p1;
+                p1 = p2;
+            }
+            dp = n*(x*p1 - p0)/(x*x - 1.0);
+
+            const double dx = p1/dp;
+            x -= dx;
+            if(fabs(dx) < 1.0e-15){
+                break;
+            }
+        }
+
+        nodes[i] = x;
+        weights[i] = 2.0/((1.0 - x*x)*dp*dp);
+    }
+}
+
+/** 2D Sobol point of the index, the first dimension is the base 2 van der Corput sequence */
+Eigen::Vector2d sobol_point(uint32_t index)
+{
+    uint32_t x = 0, y = 0;
+    uint32_t v = 1u << 31;
+
+    for(int b = 0; b < 32; b++){
+        if(index & (1u << b)){
+            x ^= 1u << (31 - b);
+            y ^= v;
+        }
+        // direction numbers of the primitive polynomial x + 1
+        v ^= v >> 1;
+    }
+
+    constexpr double scale = 1.0/4294967296.0;
+    return Eigen::Vector2d(x*scale, y*scale);
+}
+
+uint32_t reverse_bits(uint32_t x)
+{
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+/** Owen scrambling by a hash, in which each bit is flipped depending on the higher bits (B. Burley, JCGT 9, 2020) */
+uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed)
+{
+    x = reverse_bits(x);
+    x += seed;
+    x ^= x*0x6c50b47cu;
+    x ^= x*0xb82f1e52u;
+    x ^= x*0xc7afe638u;
+    x ^= x*0x8d22f6e6u;
+    return reverse_bits(x);
+}
+
+uint32_t hash_seed(uint32_t seed)
+{
+    seed ^= seed >> 16;
+    seed *= 0x7feb352du;
+    seed ^= seed >> 15;
+    seed *= 0x846ca68bu;
+    seed ^= seed >> 16;
+    return seed;
+}
+
+/** Quadrant weight of the vignetted pupil and the mapped point */
+double apply_vignetting(Eigen::Vector2d& pt, const Field* fld)
+{
+    const double sx = (pt(0) < 0.0) ? 1.0 - fld->VLX() : 1.0 - fld->VUX();
+    const double sy = (pt(1) < 0.0) ? 1.0 - fld->VLY() : 1.0 - fld->VUY();
+    pt = fld->ApplyVignetting(pt);
+    return sx*sy;
+}
+
+void add(PupilSampleSet& set, const Eigen::Vector2d& pt, double weight)
+{
+    set.points.push_back(pt);
+    set.weights.push_back(weight);
+}
+
+std::shared_ptr<PupilSampleSet> generate(PupilSampler::Pattern pattern, int n)
+{
+    auto set = std::make_shared<PupilSampleSet>();
+
+    switch (pattern) {
+    case PupilSampler::Grid:
+    {
+        const double step = 2.0/n;
+        const double start = -1.0 + step/2.0;
+        for(int i = 0; i < n; i++){
+            for(int j = 0; j < n; j++){
+                const Eigen::Vector2d pt(start + step*j, start + step*i);
+                if(pt.norm() <= 1.0){
+                    add(*set, pt, 1.0);
+                }
+            }
+        }
+        break;
+    }
+    case PupilSampler::Hexapolar:
+    {
+        const int num_rings = (n % 2 == 0) ? n/2 : (n - 1)/2;
+        if(num_rings == 0){
+            add(*set, Eigen::Vector2d(0.0, 0.0), 1.0);
+            break;
+        }
+
+        for(int ri = 0; ri <= num_rings; ri++){
+            // the annulus half way to the neighbouring rings
+            const double r_in = std::max(0.0, (ri - 0.5)/num_rings);
+            const double r_out = std::min(1.0, (ri + 0.5)/num_rings);
+            const int num_pts = HexapolarArray<double>::PointsInRing(ri);
+            const double weight = (r_out*r_out - r_in*r_in)/num_pts;
+
+            const double r = static_cast<double>(ri)/num_rings;
+            for(int ai = 0; ai < num_pts; ai++){
+                const double ang = 2.0*M_PI*ai/num_pts;
+                add(*set, Eigen::Vector2d(r*cos(ang), r*sin(ang)), weight);
+            }
+        }
+        break;
+    }
+    case PupilSampler::Random:
+    {
+        std::mt19937 engine(5489u);
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+        for(int k = 0; k < n; k++){
+            const double u = dist(engine);
+            const double v = dist(engine);
+            add(*set, concentric_map(u, v), 1.0);
+        }
+        break;
+    }
+    case PupilSampler::Gaussian:
+    {
+        // the area element is d(rho^2)/2 dtheta, so Gauss-Legendre in rho^2 integrates polynomials of rho^2 exactly
+        std::vector<double> nodes, gl_weights;
+        gauss_legendre(n, nodes, gl_weights);
+
+        const int num_arms = 2*n + 1;
+        for(int ri = 0; ri < n; ri++){
+            const double r = sqrt(0.5*(1.0 + nodes[ri]));
+            for(int ai = 0; ai < num_arms; ai++){
+                const double ang = 2.0*M_PI*(ai + 0.5)/num_arms;
+                add(*set, Eigen::Vector2d(r*cos(ang), r*sin(ang)), gl_weights[ri]);
+            }
+        }
+        break;
+    }
+    case PupilSampler::Sobol:
+    {
+        for(int k = 0; k < n; k++){
+            const Eigen::Vector2d uv = sobol_point(k);
+            add(*set, concentric_map(uv(0), uv(1)), 1.0);
+        }
+        break;
+    }
+    }
+
+    double sum = 0.0;
+    for(double w : set->weights){
+        sum += w;
+    }
+    if(sum > 0.0){
+        for(double& w : set->weights){
+            w /= sum;
+        }
+    }
+
+    return set;
+}
+
+std::shared_ptr<const PupilSampleSet> find_or_create(const SetKey& key, const Field* fld)
+{
+    {
+        std::lock_guard<std::mutex> lock(set_mutex);
+        auto it = sample_sets.find(key);
+        if(it != sample_sets.end()){
+            it->second.last_access = ++access_count;
+            return it->second.set;
+        }
+    }
+
+    auto set = generate(static_cast<PupilSampler::Pattern>(key.pattern), key.n);
+
+    if(fld){
+        // each quadrant is compressed by the vignetting factors of its sides
+        double sum = 0.0;
+        for(int k = 0; k < set->Size(); k++){
+            set->weights[k] *= apply_vignetting(set->points[k], fld);
+            sum += set->weights[k];
+        }
+        if(sum > 0.0){
+            for(double& w : set->weights){
+                w /= sum;
+            }
+        }
+    }
+
+    std::shared_ptr<const PupilSampleSet> shared_set = set;
+
+    std::lock_guard<std::mutex> lock(set_mutex);
+
+    // another thread may have generated the same set in the meantime
+    auto inserted = sample_sets.emplace(key, SetEntry{shared_set, 0});
+    inserted.first->second.last_access = ++access_count;
+    shared_set = inserted.first->second.set;
+    evict();
+
+    return shared_set;
+}
+
+}
+
+std::shared_ptr<const PupilSampleSet> PupilSampler::Create(Pattern pattern, int n)
+{
+    return find_or_create(SetKey{pattern, n, {0.0, 0.0, 0.0, 0.0}}, nullptr);
+}
+
+std::shared_ptr<const PupilSampleSet> PupilSampler::Create(Pattern pattern, int n, const Field *fld)
+{
+    return find_or_create(SetKey{pattern, n, {fld->VUX(), fld->VLX(), fld->VUY(), fld->VLY()}}, fld);
+}
+
+PupilSampleSet PupilSampler::Create(Pattern pattern, int n, const PupilBoundary &boundary)
+{
+    PupilSampleSet set = *Create(pattern, n);
+
+    // polar area element r dr dtheta of the radially scaled pupil
+    for(int k = 0; k < set.Size(); k++){
+        Eigen::Vector2d& pt = set.points[k];
+        const double radius = std::min(1.0, boundary.Radius(atan2(pt(1), pt(0))));
+        pt *= radius;
+        set.weights[k] *= radius*radius;
+    }
+
+    return set;
+}
+
+PupilSampleSet PupilSampler::ScrambledSobol(uint32_t seed, int begin, int end, const Field *fld)
+{
+    PupilSampleSet set;
+    set.points.reserve(end - begin);
+    set.weights.reserve(end - begin);
+
+    const uint32_t seed_x = hash_seed(2*seed);
+    const uint32_t seed_y = hash_seed(2*seed + 1);
+    constexpr double scale = 1.0/4294967296.0;
+
+    for(int k = begin; k < end; k++){
+        const Eigen::Vector2d uv = sobol_point(k);
+        const uint32_t x = nested_uniform_scramble(static_cast<uint32_t>(uv(0)*4294967296.0), seed_x);
+        const uint32_t y = nested_uniform_scramble(static_cast<uint32_t>(uv(1)*4294967296.0), seed_y);
+
+        // the half bin offset keeps the points off the edges of the square
+        Eigen::Vector2d pt = concentric_map((x + 0.5)*scale, (y + 0.5)*scale);
+        const double weight = fld ? apply_vignetting(pt, fld) : 1.0;
+        add(set, pt, weight);
+    }
+
+    return set;
+}
+
+void PupilSampler::SetCacheCapacity(int n)
+{
+    std::lock_guard<std::mutex> lock(set_mutex);
+    capacity = std::max(0, n);
+    evict();
+}
+
+int PupilSampler::NumberOfCachedSets()
+{
+    std::lock_guard<std::mutex> lock(set_mutex);
+    return sample_sets.size();
+}
+
+void PupilSampler::ClearCache()
+{
+    std::lock_guard<std::mutex> lock(set_mutex);
+    sample_sets.clear();
+}
@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "analysis/qmc_estimator.h"
+#include "common/parallel.h"
+
+using namespace geopter;
+
+QmcEstimator::QmcEstimator() :
+    abs_tolerance_(0.0),
+    rel_tolerance_(0.01),
+    num_replicates_(8),
+    initial_samples_(32),
+    max_samples_(1 << 20),
+    num_threads_(0),
+    seed_(0)
+{
+
+}
+
+void QmcEstimator::SetTolerance(double absolute, double relative)
+{
+    abs_tolerance_ = std::max(0.0, absolute);
+    rel_tolerance_ = std::max(0.0, relative);
+}
+
+void QmcEstimator::SetNumberOfReplicates(int n)
+{
+    num_replicates_ = std::max(2, n);
+}
+
+void QmcEstimator::SetInitialSamples(int n)
+{
+    initial_samples_ = 1;
+    while(initial_samples_ < n && initial_samples_ < (1 << 30)){
+        initial_samples_ *= 2;
+    }
+}
+
+void QmcEstimator::SetMaxSamples(long long n)
+{
+    max_samples_ = n;
+}
+
+QmcEstimate QmcEstimator::Run(const std::function<void (int, const PupilSampleSet &)> &add_batch, const std::function<double (int)> &estimate, const Field *fld) const
+{
+    QmcEstimate result;
+    result.value = NAN;
+    result.error = INFINITY;
+    result.num_samples = 0;
+    result.num_batches = 0;
+    result.converged = false;
+
+    const int R = num_replicates_;
+    std::vector<double> estimates(R);
+
+    // each replicate holds [0, n) of its sequence and the batch adds [n, next), the first batch is always traced
+    int n = 0;
+    int next = initial_samples_;
+
+    while(true){
+        Parallel::For(0, R, [&](int r){
+            add_batch(r, PupilSampler::ScrambledSobol(seed_ + r, n, next, fld));
+            estimates[r] = estimate(r);
+        }, num_threads_);
+
+        result.num_samples += (long long)R*(next - n);
+        result.num_batches++;
+        n = next;
+
+        double mean = 0.0;
+        for(double e : estimates){
+            mean += e;
+        }
+        mean /= R;
+
+        double var = 0.0;
+        for(double e : estimates){
+            var += (e - mean)*(e - mean);
+        }
+        var /= (R - 1);
+
+        result.value = mean;
+        result.error = std::isfinite(var) ? t_quantile(R - 1)*sqrt(var/R) : INFINITY;
+
+        if(result.error <= std::max(abs_tolerance_, rel_tolerance_*fabs(mean))){
+            result.converged = true;
+            break;
+        }
+
+        if(n >= (1 << 30) || result.num_samples + (long long)R*n > max_samples_){
+            break;
+        }
+        next = 2*n;
+    }
+
+    return result;
+}
+
+double QmcEstimator::t_quantile(int dof)
+{
+    static const double table[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+
+    if(dof < 1){
+        return INFINITY;
+    }else if(dof <= 30){
+        return table[dof - 1];
+    }else{
+        // Cornish-Fisher expansion about the normal quantile
+        const double z = 1.959964;
+        return z + (z*z*z + z)/(4.0*dof);
+    }
+}
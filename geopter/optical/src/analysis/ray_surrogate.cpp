@@ -0,0 +1,501 @@
+#define _USE_MATH_DEFINES
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "Eigen/QR"
+#include "analysis/ray_surrogate.h"
+#include "analysis/pupil_boundary.h"
+#include "common/parallel.h"
+#include "sequential/sequential_trace.h"
+#include "sequential/trace_error.h"
+
+using namespace geopter;
+
+namespace {
+
+/** number of the validation rays of each field */
+constexpr int num_validation_rays = 256;
+
+/** Pupil points pulled in along their azimuths into the boundary */
+void map_into_boundary(std::vector<Eigen::Vector2d>& pupils, const PupilBoundary& boundary)
+{
+    for(auto& pt : pupils){
+        pt *= std::min(1.0, boundary.Radius(atan2(pt(1), pt(0))));
+    }
+}
+
+}
+
+RaySurrogate::RaySurrogate(OpticalSystem *opt_sys) :
+    WaveAberration(opt_sys),
+    num_threads_(0),
+    fitted_(false),
+    max_intercept_error_(0.0),
+    max_opd_error_(0.0),
+    num_traced_(0)
+{
+    SetMaxDegree(10);
+}
+
+RaySurrogate::~RaySurrogate()
+{
+
+}
+
+void RaySurrogate::SetMaxDegree(int n)
+{
+    max_degree_ = std::max(1, n);
+
+    terms_.clear();
+    for(int d = 0; d <= max_degree_; d++){
+        for(int b = 0; b <= d; b++){
+            terms_.emplace_back(d - b, b);
+        }
+    }
+
+    fitted_ = false;
+    heights_.clear();
+    field_maps_.clear();
+}
+
+bool RaySurrogate::trace(const Field *fld, double wvl, const std::vector<Eigen::Vector2d> &pupils, Eigen::MatrixX3d &values, Eigen::Array<bool, Eigen::Dynamic, 1> &passed, Eigen::Vector2d &chief)
+{
+    const int num_pupils = pupils.size();
+    values = Eigen::MatrixX3d::Zero(num_pupils, 3);
+    passed = Eigen::Array<bool, Eigen::Dynamic, 1>::Constant(num_pupils, false);
+
+    SequentialTrace tracer(opt_sys_);
+    tracer.SetApertureCheck(true);
+    tracer.SetApplyVig(false);
+
+    const SequentialPath seq_path = tracer.CreateSequentialPath(wvl);
+
+    auto chief_ray = std::make_shared<Ray>(seq_path.Size());
+    num_traced_++;
+    if(TRACE_SUCCESS != tracer.TracePupilRay(chief_ray, seq_path, Eigen::Vector2d({0.0, 0.0}), fld, wvl)){
+        std::cerr << "RaySurrogate: failed to trace chief ray" << std::endl;
+        return false;
+    }
+
+    chief = Eigen::Vector2d(chief_ray->GetBack()->X(), chief_ray->GetBack()->Y());
+
+    double cr_exp_dist;
+    Eigen::Vector3d cr_exp_pt;
+    get_chief_ray_exp_segment(cr_exp_pt, cr_exp_dist, chief_ray);
+    const ReferenceSphere ref_sphere = setup_reference_sphere(chief_ray, cr_exp_pt);
+
+    const double convert_to_waves = 1.0/(1.0e-6*wvl);
+
+    constexpr int block_size = 64;
+    const int num_blocks = (num_pupils + block_size - 1)/block_size;
+
+    Parallel::For(0, num_blocks, [&](int bi){
+        SequentialTrace block_tracer(opt_sys_);
+        block_tracer.SetApertureCheck(true);
+        block_tracer.SetApplyVig(false);
+
+        auto ray = std::make_shared<Ray>(seq_path.Size());
+        ReferenceSphere block_ref_sphere = ref_sphere;
+
+        const int end = std::min(num_pupils, (bi + 1)*block_size);
+        for(int k = bi*block_size; k < end; k++){
+            if(TRACE_SUCCESS == block_tracer.TracePupilRay(ray, seq_path, pupils[k], fld, wvl)){
+                values(k, 0) = ray->GetBack()->X() - chief(0);
+                values(k, 1) = ray->GetBack()->Y() - chief(1);
+                values(k, 2) = wave_abr_full_calc(ray, chief_ray, fld, block_ref_sphere)*convert_to_waves;
+                passed(k) = true;
+            }
+        }
+    }, num_threads_);
+
+    num_traced_ += num_pupils;
+
+    return true;
+}
+
+std::shared_ptr<const PupilBoundary> RaySurrogate::find_boundary(const Field *fld, double wvl)
+{
+    // the surrogate is confined to the boundary, so it is taken regardless of the number of rays
+    auto boundary = PupilBoundary::Find(opt_sys_, fld, wvl);
+    num_traced_ += boundary->NumberOfTracedRays();
+
+    return boundary;
+}
+
+bool RaySurrogate::fit_map(const Field *fld, double wvl, const PupilBoundary &boundary, RayMap &map)
+{
+    const PupilSampleSet samples = PupilSampler::Create(PupilSampler::Gaussian, max_degree_ + 1, boundary);
+
+    Eigen::MatrixX3d values;
+    Eigen::Array<bool, Eigen::Dynamic, 1> passed;
+    if( !trace(fld, wvl, samples.points, values, passed, map.chief) ){
+        return false;
+    }
+
+    const int num_terms = terms_.size();
+    const int num_passed = passed.count();
+    if(num_passed < num_terms){
+        std::cerr << "RaySurrogate: " << num_passed << " rays are too few for " << num_terms << " terms" << std::endl;
+        return false;
+    }
+
+    std::vector<Eigen::Vector2d> pupils;
+    Eigen::MatrixX3d rhs(num_passed, 3);
+    for(int k = 0; k < samples.Size(); k++){
+        if(passed(k)){
+            rhs.row(pupils.size()) = values.row(k);
+            pupils.push_back(samples.points[k]);
+        }
+    }
+
+    // the design matrix is the map of unit coefficients of each term
+    Eigen::MatrixXd mat(num_passed, num_terms);
+    std::vector<double> px_pow(max_degree_ + 1), py_pow(max_degree_ + 1);
+    for(int s = 0; s < num_passed; s++){
+        px_pow[0] = py_pow[0] = 1.0;
+        for(int p = 1; p <= max_degree_; p++){
+            px_pow[p] = px_pow[p - 1]*pupils[s](0);
+            py_pow[p] = py_pow[p - 1]*pupils[s](1);
+        }
+        for(int t = 0; t < num_terms; t++){
+            mat(s, t) = px_pow[terms_[t].first]*py_pow[terms_[t].second];
+        }
+    }
+
+    map.coefs = mat.colPivHouseholderQr().solve(rhs);
+
+    map.radii.resize(boundary.NumberOfVertices());
+    for(int k = 0; k < boundary.NumberOfVertices(); k++){
+        map.radii[k] = boundary.Vertex(k).norm();
+    }
+
+    return true;
+}
+
+void RaySurrogate::validate(const Field *fld, double wvl, const PupilBoundary &boundary, const RayMap &map, double rotation)
+{
+    std::vector<Eigen::Vector2d> pupils = PupilSampler::ScrambledSobol(1, 0, num_validation_rays).points;
+    map_into_boundary(pupils, boundary);
+
+    Eigen::MatrixX3d values;
+    Eigen::Array<bool, Eigen::Dynamic, 1> passed;
+    Eigen::Vector2d chief;
+    if( !trace(fld, wvl, pupils, values, passed, chief) ){
+        max_intercept_error_ = max_opd_error_ = INFINITY;
+        return;
+    }
+
+    const Eigen::MatrixX3d approx = evaluate(map, rotation, pupils);
+
+    // intercepts are compared on the image, so the error of the interpolated chief ray is included
+    const double c = cos(rotation);
+    const double s = sin(rotation);
+    const Eigen::Vector2d approx_chief(c*map.chief(0) + s*map.chief(1), -s*map.chief(0) + c*map.chief(1));
+
+    for(int k = 0; k < (int)pupils.size(); k++){
+        if( !passed(k) || std::isnan(approx(k, 0)) ){
+            continue;
+        }
+        const Eigen::Vector2d traced = chief + values.row(k).head<2>().transpose();
+        const Eigen::Vector2d fitted = approx_chief + approx.row(k).head<2>().transpose();
+        max_intercept_error_ = std::max(max_intercept_error_, (traced - fitted).norm());
+        max_opd_error_ = std::max(max_opd_error_, fabs(values(k, 2) - approx(k, 2)));
+    }
+}
+
+bool RaySurrogate::Fit(const Field *fld, double wvl)
+{
+    max_intercept_error_ = 0.0;
+    max_opd_error_ = 0.0;
+    num_traced_ = 0;
+
+    auto boundary = find_boundary(fld, wvl);
+    fitted_ = fit_map(fld, wvl, *boundary, map_);
+    if(fitted_){
+        validate(fld, wvl, *boundary, map_, 0.0);
+    }
+
+    return fitted_;
+}
+
+bool RaySurrogate::FitFields(double wvl, int num_fields)
+{
+    max_intercept_error_ = 0.0;
+    max_opd_error_ = 0.0;
+    num_traced_ = 0;
+
+    heights_.clear();
+    field_maps_.clear();
+
+    if( !is_rotationally_symmetric() ){
+        std::cerr << "RaySurrogate: fields cannot be interpolated in a system which is not rotationally symmetric" << std::endl;
+        return false;
+    }
+
+    num_fields = std::max(2, num_fields);
+    std::vector<double> heights(num_fields);
+    std::vector<RayMap> maps(num_fields);
+
+    for(int fi = 0; fi < num_fields; fi++){
+        // with the mirror images, the Chebyshev-Lobatto nodes over [-1, 1] which keep the interpolation from oscillating
+        heights[fi] = sin(0.5*M_PI*fi/(num_fields - 1));
+
+        Field fld;
+        if( !create_field(fld, 0.0, heights[fi]) || !fit_map(&fld, wvl, *find_boundary(&fld, wvl), maps[fi]) ){
+            return false;
+        }
+    }
+
+    // the fields below the axis are the mirror images, which keeps the parity of each coefficient in the height
+    for(int fi = num_fields - 1; fi > 0; fi--){
+        heights_.push_back(-heights[fi]);
+        field_maps_.push_back(mirror(maps[fi]));
+    }
+    heights_.insert(heights_.end(), heights.begin(), heights.end());
+    field_maps_.insert(field_maps_.end(), maps.begin(), maps.end());
+
+    // real fields midway between the heights, 45 degrees off the y axis to check the rotation as well
+    for(int fi = 0; fi + 1 < num_fields; fi++){
+        const double h = 0.5*(heights[fi] + heights[fi + 1]);
+
+        Field fld;
+        if(create_field(fld, h*M_SQRT1_2, h*M_SQRT1_2)){
+            validate(&fld, wvl, *find_boundary(&fld, wvl), interpolate(h), M_PI/4.0);
+        }
+    }
+
+    return true;
+}
+
+RaySurrogate::RayMap RaySurrogate::mirror(const RayMap &map) const
+{
+    // px^a py^b changes the sign with odd b when the pupil is flipped in y, and so does dy with even b
+    RayMap mirrored = map;
+    for(int t = 0; t < (int)terms_.size(); t++){
+        const double sign = (terms_[t].second % 2 == 0) ? 1.0 : -1.0;
+        mirrored.coefs(t, 0) *= sign;
+        mirrored.coefs(t, 1) *= -sign;
+        mirrored.coefs(t, 2) *= sign;
+    }
+
+    mirrored.chief(1) = -map.chief(1);
+
+    const int n = map.radii.size();
+    for(int k = 0; k < n; k++){
+        mirrored.radii[k] = map.radii[(n - k) % n];
+    }
+
+    return mirrored;
+}
+
+bool RaySurrogate::create_field(Field &fld, double hx, double hy)
+{
+    const double h = sqrt(hx*hx + hy*hy);
+    const double phi = (h > 0.0) ? atan2(hx, hy) : 0.0;
+
+    // the chief ray is aimed only in y, so the field at the same height on the y axis is aimed and rotated by the azimuth
+    Field y_fld;
+    y_fld.SetX(0.0);
+    y_fld.SetY(h*opt_sys_->GetOpticalSpec()->GetFieldSpec()->MaxField());
+
+    SequentialTrace tracer(opt_sys_);
+    tracer.SetApplyVig(true);
+    tracer.SetApertureCheck(false);
+
+    Eigen::Vector2d aim_pt;
+    Eigen::Vector3d obj_pt;
+    const double ref_wvl = opt_sys_->GetOpticalSpec()->GetWavelengthSpec()->ReferenceWavelength();
+    if( !tracer.AimChiefRay(aim_pt, obj_pt, &y_fld, ref_wvl) ){
+        std::cerr << "RaySurrogate: aim chief ray error at field (" << hx << ", " << hy << ")" << std::endl;
+        return false;
+    }
+
+    const double c = cos(phi);
+    const double s = sin(phi);
+
+    if(FieldType::OBJ_ANG == opt_sys_->GetOpticalSpec()->GetFieldSpec()->FieldType()){
+        // the object point is along the tangents of the angles
+        const double radial_tan = tan(y_fld.Y()*M_PI/180.0);
+        fld.SetX(atan(radial_tan*s)*180.0/M_PI);
+        fld.SetY(atan(radial_tan*c)*180.0/M_PI);
+    }else{
+        fld.SetX(y_fld.Y()*s);
+        fld.SetY(y_fld.Y()*c);
+    }
+
+    fld.SetAimPt(Eigen::Vector2d(aim_pt(1)*s, aim_pt(1)*c));
+    fld.SetObjectPt(Eigen::Vector3d(obj_pt(1)*s, obj_pt(1)*c, obj_pt(2)));
+
+    return true;
+}
+
+RaySurrogate::RayMap RaySurrogate::interpolate(double h) const
+{
+    // Lagrange interpolation over the fitted heights
+    const int n = heights_.size();
+
+    RayMap map;
+    map.coefs = Eigen::MatrixX3d::Zero(terms_.size(), 3);
+    map.chief = Eigen::Vector2d::Zero();
+    map.radii.assign(field_maps_[0].radii.size(), 0.0);
+
+    for(int i = 0; i < n; i++){
+        double l = 1.0;
+        for(int j = 0; j < n; j++){
+            if(j != i){
+                l *= (h - heights_[j])/(heights_[i] - heights_[j]);
+            }
+        }
+        map.coefs += l*field_maps_[i].coefs;
+        map.chief += l*field_maps_[i].chief;
+        for(int k = 0; k < (int)map.radii.size(); k++){
+            map.radii[k] += l*field_maps_[i].radii[k];
+        }
+    }
+
+    for(auto& r : map.radii){
+        r = std::max(0.0, r);
+    }
+
+    return map;
+}
+
+Eigen::MatrixX3d RaySurrogate::evaluate(const RayMap &map, double rotation, const std::vector<Eigen::Vector2d> &pupils) const
+{
+    const int num_pupils = pupils.size();
+    const int num_terms = terms_.size();
+    Eigen::MatrixX3d values(num_pupils, 3);
+
+    const PupilBoundary boundary(map.radii);
+
+    const double c = cos(rotation);
+    const double s = sin(rotation);
+
+    constexpr int block_size = 4096;
+    const int num_blocks = (num_pupils + block_size - 1)/block_size;
+
+    Parallel::For(0, num_blocks, [&](int bi){
+        std::vector<double> px_pow(max_degree_ + 1), py_pow(max_degree_ + 1);
+
+        const int end = std::min(num_pupils, (bi + 1)*block_size);
+        for(int k = bi*block_size; k < end; k++){
+            // the pupil in the frame of the field on the y axis
+            const double px = c*pupils[k](0) - s*pupils[k](1);
+            const double py = s*pupils[k](0) + c*pupils[k](1);
+
+            if(px*px + py*py > pow(boundary.Radius(atan2(py, px)), 2)){
+                values.row(k).setConstant(NAN);
+                continue;
+            }
+
+            px_pow[0] = py_pow[0] = 1.0;
+            for(int p = 1; p <= max_degree_; p++){
+                px_pow[p] = px_pow[p - 1]*px;
+                py_pow[p] = py_pow[p - 1]*py;
+            }
+
+            double dx = 0.0, dy = 0.0, opd = 0.0;
+            for(int t = 0; t < num_terms; t++){
+                const double m = px_pow[terms_[t].first]*py_pow[terms_[t].second];
+                dx += m*map.coefs(t, 0);
+                dy += m*map.coefs(t, 1);
+                opd += m*map.coefs(t, 2);
+            }
+
+            // back to the frame of the field
+            values(k, 0) = c*dx + s*dy;
+            values(k, 1) = -s*dx + c*dy;
+            values(k, 2) = opd;
+        }
+    }, num_threads_);
+
+    return values;
+}
+
+Eigen::MatrixX3d RaySurrogate::Evaluate(const std::vector<Eigen::Vector2d> &pupils) const
+{
+    if( !fitted_ ){
+        return Eigen::MatrixX3d::Constant(pupils.size(), 3, NAN);
+    }
+
+    return evaluate(map_, 0.0, pupils);
+}
+
+Eigen::MatrixX3d RaySurrogate::Evaluate(double hx, double hy, const std::vector<Eigen::Vector2d> &pupils) const
+{
+    if(field_maps_.empty()){
+        return Eigen::MatrixX3d::Constant(pupils.size(), 3, NAN);
+    }
+
+    const double h = sqrt(hx*hx + hy*hy);
+    const double rotation = (h > 0.0) ? atan2(hx, hy) : 0.0;
+
+    return evaluate(interpolate(h), rotation, pupils);
+}
+
+Eigen::Vector2d RaySurrogate::ChiefRayIntercept(double hx, double hy) const
+{
+    if(field_maps_.empty()){
+        return Eigen::Vector2d(NAN, NAN);
+    }
+
+    const double h = sqrt(hx*hx + hy*hy);
+    const double rotation = (h > 0.0) ? atan2(hx, hy) : 0.0;
+    const Eigen::Vector2d chief = interpolate(h).chief;
+
+    const double c = cos(rotation);
+    const double s = sin(rotation);
+    return Eigen::Vector2d(c*chief(0) + s*chief(1), -s*chief(0) + c*chief(1));
+}
+
+SpotStatistics RaySurrogate::compute_statistics(const RayMap &map, double rotation, const PupilSampleSet &samples) const
+{
+    const int num_samples = samples.Size();
+
+    constexpr int num_blocks = 64;
+    std::vector<SpotStatistics> block_stats(num_blocks);
+
+    for(int bi = 0; bi < num_blocks; bi++){
+        const int begin = (long long)num_samples*bi/num_blocks;
+        const int end   = (long long)num_samples*(bi+1)/num_blocks;
+
+        const std::vector<Eigen::Vector2d> pupils(samples.points.begin() + begin, samples.points.begin() + end);
+        const Eigen::MatrixX3d values = evaluate(map, rotation, pupils);
+
+        for(int k = begin; k < end; k++){
+            if(std::isnan(values(k - begin, 0))){
+                continue;
+            }
+            block_stats[bi].Add(values(k - begin, 0), values(k - begin, 1), samples.weights[k]);
+        }
+    }
+
+    SpotStatistics stats;
+    for(auto& b : block_stats){
+        stats.Merge(b);
+    }
+
+    return stats;
+}
+
+SpotStatistics RaySurrogate::ComputeStatistics(const PupilSampleSet &samples) const
+{
+    if( !fitted_ ){
+        return SpotStatistics();
+    }
+
+    return compute_statistics(map_, 0.0, samples);
+}
+
+SpotStatistics RaySurrogate::ComputeStatistics(double hx, double hy, const PupilSampleSet &samples) const
+{
+    if(field_maps_.empty()){
+        return SpotStatistics();
+    }
+
+    const double h = sqrt(hx*hx + hy*hy);
+    const double rotation = (h > 0.0) ? atan2(hx, hy) : 0.0;
+
+    return compute_statistics(interpolate(h), rotation, samples);
+}
@@ -5,7 +5,7 @@
 #include "sequential/sequential_trace.h"
 #include "sequential/trace_error.h"
 #include "renderer/renderer.h"
-#include "data/hexapolar_array.h"
+#include "common/parallel.h"
 
 
 using namespace geopter;
@@ -30,6 +30,171 @@ SpotDiagram::~SpotDiagram()
     seq_paths_.clear();
 }
 
+SpotStatistics SpotDiagram::ComputeStatistics(const Field *fld, int nrd, int num_threads)
+{
+    SpotStatistics stats;
+
+    SequentialTrace tracer(opt_sys_);
+    tracer.SetApertureCheck(true);
+    tracer.SetApplyVig(false);
+
+    auto chief_ray = std::make_shared<Ray>(seq_paths_[ref_wvl_idx_].Size());
+    if(TRACE_SUCCESS != tracer.TracePupilRay(chief_ray, seq_paths_[ref_wvl_idx_], Eigen::Vector2d({0.0,0.0}), fld, ref_wvl_val_) ){
+        std::cerr << "Failed to trace chief ray" << std::endl;
+        return stats;
+    }
+
+    const double chief_ray_x = chief_ray->GetBack()->X();
+    const double chief_ray_y = chief_ray->GetBack()->Y();
+
+    const auto boundaries = pupil_boundaries(fld, (long long)nrd*nrd);
+
+    // grid points are generated in each block, as the grid may be too large to be stored
+    const double step = 2.0/(double)nrd;
+    const double start = -1.0 + step/2;
+
+    constexpr int num_blocks = 64;
+    std::vector<SpotStatistics> block_stats(num_blocks);
+
+    Parallel::For(0, num_blocks, [&](int bi){
+        SequentialTrace block_tracer(opt_sys_);
+        block_tracer.SetApertureCheck(true);
+        block_tracer.SetApplyVig(false);
+
+        auto ray = std::make_shared<Ray>(chief_ray->NumberOfSegments());
+        Eigen::Vector2d pupil;
+
+        const int row_begin = nrd*bi/num_blocks;
+        const int row_end   = nrd*(bi+1)/num_blocks;
+
+        for(int wi = 0; wi < num_wvl_; wi++){
+            const double wvl = opt_sys_->GetOpticalSpec()->GetWavelengthSpec()->GetWavelength(wi)->Value();
+
+            for(int i = row_begin; i < row_end; i++){
+                pupil(1) = start + step*static_cast<double>(i);
+                for(int j = 0; j < nrd; j++){
+                    pupil(0) = start + step*static_cast<double>(j);
+                    if(pupil.norm() > 1.0 || (boundaries[wi] && !boundaries[wi]->Contains(pupil))){
+                        continue;
+                    }
+
+                    if(TRACE_SUCCESS == block_tracer.TracePupilRay(ray, seq_paths_[wi], pupil, fld, wvl)){
+                        double dx = ray->GetBack()->X() - chief_ray_x;
+                        double dy = ray->GetBack()->Y() - chief_ray_y;
+                        block_stats[bi].Add(dx, dy, wvl_weights_[wi]);
+                    }
+                }
+            }
+        }
+    }, num_threads);
+
+    for(auto& b : block_stats){
+        stats.Merge(b);
+    }
+
+    return stats;
+}
+
+SpotStatistics SpotDiagram::ComputeStatistics(const Field *fld, const PupilSampleSet &samples, int num_threads)
+{
+    SpotStatistics stats;
+
+    SequentialTrace tracer(opt_sys_);
+    tracer.SetApertureCheck(true);
+    tracer.SetApplyVig(false);
+
+    auto chief_ray = std::make_shared<Ray>(seq_paths_[ref_wvl_idx_].Size());
+    if(TRACE_SUCCESS != tracer.TracePupilRay(chief_ray, seq_paths_[ref_wvl_idx_], Eigen::Vector2d({0.0,0.0}), fld, ref_wvl_val_) ){
+        std::cerr << "Failed to trace chief ray" << std::endl;
+        return stats;
+    }
+
+    const int num_samples = samples.Size();
+    const auto boundaries = pupil_boundaries(fld, num_samples);
+
+    constexpr int num_blocks = 64;
+    std::vector<SpotStatistics> block_stats(num_blocks);
+
+    Parallel::For(0, num_blocks, [&](int bi){
+        SequentialTrace block_tracer(opt_sys_);
+        block_tracer.SetApertureCheck(true);
+        block_tracer.SetApplyVig(false);
+
+        accumulate(block_tracer, fld, samples, num_samples*bi/num_blocks, num_samples*(bi+1)/num_blocks, chief_ray, boundaries, block_stats[bi]);
+    }, num_threads);
+
+    for(auto& b : block_stats){
+        stats.Merge(b);
+    }
+
+    return stats;
+}
+
+QmcEstimate SpotDiagram::Estimate(const Field *fld, const std::function<double (const SpotStatistics &)> &statistic, const QmcEstimator &estimator)
+{
+    SequentialTrace tracer(opt_sys_);
+    tracer.SetApertureCheck(true);
+    tracer.SetApplyVig(false);
+
+    auto chief_ray = std::make_shared<Ray>(seq_paths_[ref_wvl_idx_].Size());
+    if(TRACE_SUCCESS != tracer.TracePupilRay(chief_ray, seq_paths_[ref_wvl_idx_], Eigen::Vector2d({0.0,0.0}), fld, ref_wvl_val_) ){
+        std::cerr << "Failed to trace chief ray" << std::endl;
+        return QmcEstimate{NAN, INFINITY, 0, 0, false};
+    }
+
+    // the first batch, as the number of later ones depends on the tolerance
+    const auto boundaries = pupil_boundaries(fld, (long long)estimator.NumberOfReplicates()*estimator.InitialSamples());
+    std::vector<SpotStatistics> replicate_stats(estimator.NumberOfReplicates());
+
+    auto add_batch = [&](int r, const PupilSampleSet& samples){
+        SequentialTrace replicate_tracer(opt_sys_);
+        replicate_tracer.SetApertureCheck(true);
+        replicate_tracer.SetApplyVig(false);
+
+        accumulate(replicate_tracer, fld, samples, 0, samples.Size(), chief_ray, boundaries, replicate_stats[r]);
+    };
+
+    auto estimate = [&](int r) -> double {
+        return (replicate_stats[r].TotalWeight() > 0.0) ? statistic(replicate_stats[r]) : NAN;
+    };
+
+    return estimator.Run(add_batch, estimate, fld);
+}
+
+std::vector<std::shared_ptr<const PupilBoundary> > SpotDiagram::pupil_boundaries(const Field *fld, long long num_samples) const
+{
+    std::vector< std::shared_ptr<const PupilBoundary> > boundaries(num_wvl_);
+    for(int wi = 0; wi < num_wvl_; wi++){
+        const double wvl = opt_sys_->GetOpticalSpec()->GetWavelengthSpec()->GetWavelength(wi)->Value();
+        boundaries[wi] = PupilBoundary::FindForSamples(opt_sys_, fld, wvl, num_samples);
+    }
+
+    return boundaries;
+}
+
+void SpotDiagram::accumulate(SequentialTrace &tracer, const Field *fld, const PupilSampleSet &samples, int begin, int end, const std::shared_ptr<Ray> &chief_ray, const std::vector<std::shared_ptr<const PupilBoundary> > &boundaries, SpotStatistics &stats) const
+{
+    const double chief_ray_x = chief_ray->GetBack()->X();
+    const double chief_ray_y = chief_ray->GetBack()->Y();
+
+    auto ray = std::make_shared<Ray>(chief_ray->NumberOfSegments());
+
+    for(int wi = 0; wi < num_wvl_; wi++){
+        const double wvl = opt_sys_->GetOpticalSpec()->GetWavelengthSpec()->GetWavelength(wi)->Value();
+
+        for(int k = begin; k < end; k++){
+            if(boundaries[wi] && !boundaries[wi]->Contains(samples.points[k])){
+                continue;
+            }
+            if(TRACE_SUCCESS == tracer.TracePupilRay(ray, seq_paths_[wi], samples.points[k], fld, wvl)){
+                double dx = ray->GetBack()->X() - chief_ray_x;
+                double dy = ray->GetBack()->Y() - chief_ray_y;
+                stats.Add(dx, dy, samples.weights[k]*wvl_weights_[wi]);
+            }
+        }
+    }
+}
+
 std::shared_ptr<PlotData> SpotDiagram::plot(const Field* fld, int pattern, int max_nrd, double dot_size)
 {
     SequentialTrace *tracer = new SequentialTrace(opt_sys_);
@@ -45,6 +210,9 @@ std::shared_ptr<PlotData> SpotDiagram::plot(const Field* fld, int pattern, int m
 
     double max_wt = *std::max_element(wvl_weights_.begin(), wvl_weights_.end());
 
+    statistics_.Clear();
+    wvl_statistics_.assign(num_wvl_, SpotStatistics());
+
     SequentialPath ref_seq_path = seq_paths_[ref_wvl_idx_];
     // trace chief ray
     auto chief_ray = std::make_shared<Ray>();
@@ -60,8 +228,6 @@ std::shared_ptr<PlotData> SpotDiagram::plot(const Field* fld, int pattern, int m
 
 
     // trace patterned rays for all wavelengths
-    Eigen::Vector2d pupil;
-
     auto ray = std::make_shared<Ray>();
     ray->Allocate(chief_ray->NumberOfSegments());
 
@@ -80,97 +246,37 @@ std::shared_ptr<PlotData> SpotDiagram::plot(const Field* fld, int pattern, int m
         // calculate nrd for current wvl
         int nrd = (wvl_weights_[wi]/max_wt)*max_nrd;
 
-        const double step = 2.0/(double)nrd;
-        const double start = -1.0 + step/2;
-
-        if(SpotDiagram::SpotRayPattern::Grid == pattern)
-        {            
-            graph->Resize(nrd*nrd);
-
-            int valid_ray_count = 0;
-
-            for(int i = 0; i < nrd; i++){
-                for(int j = 0; j < nrd; j++){
-                    pupil(0) = start + step*static_cast<double>(j);
-                    pupil(1) = start + step*static_cast<double>(i);
-
-                    if(pupil.norm() <= 1.0){
-                        ray->SetStatus(TRACE_SUCCESS);
-                        tracer->TracePupilRay(ray, seq_paths_[wi], pupil, fld, wvl);
-
-                        if(TRACE_SUCCESS == ray->Status()){
-
-                            double ray_x = ray->GetBack()->X();
-                            double ray_y = ray->GetBack()->Y();
-
-                            double dx = ray_x - chief_ray_x;
-                            double dy = ray_y - chief_ray_y;
-
-                            graph->SetData(valid_ray_count, dx, dy);
-
-                            valid_ray_count++;
-                        }
-                    }
-                }
-
-            }
-
-            graph->Resize(valid_ray_count);
-
+        std::shared_ptr<const PupilSampleSet> samples;
+        if(SpotDiagram::SpotRayPattern::Grid == pattern){
+            samples = PupilSampler::Create(PupilSampler::Grid, nrd);
         }else if(SpotDiagram::SpotRayPattern::Hexapolar == pattern){
+            samples = PupilSampler::Create(PupilSampler::Hexapolar, nrd);
+        }else{
+            std::cerr << "Undefined spot pattern" << std::endl;
+            samples = std::make_shared<PupilSampleSet>();
+        }
 
-            graph->Resize( HexapolarArray<double>(nrd).TotalNumberOfPoints() );
-            int valid_ray_count = 0;
-
-            int half_num_rings = nrd/2;
-            for (int r = 0; r < nrd/2; r++)
-            {
-                int num_rays_in_ring = 6*r;
-
-                // center of hexapolar
-                if(num_rays_in_ring == 0){
-                    pupil(0) = 0.0;
-                    pupil(1) = 0.0;
-
-                    ray->SetStatus(TRACE_SUCCESS);
-                    tracer->TracePupilRay(ray, seq_paths_[wi], pupil, fld, wvl);
-
-                    double dx = ray->GetBack()->X() - chief_ray_x;
-                    double dy = ray->GetBack()->Y() - chief_ray_y;
-
-                    graph->SetData(valid_ray_count, dx, dy);
-                    valid_ray_count++;
-
-                    continue;
-                }
-
-                double ang_step = 2*M_PI/(double)num_rays_in_ring;
-
-                for(int ai = 0; ai < num_rays_in_ring; ai++){
-                    pupil(0) = (double)r * 1.0/(half_num_rings) * cos((double)ai*ang_step);
-                    pupil(1) = (double)r * 1.0/(half_num_rings) * sin((double)ai*ang_step);
+        graph->Resize(samples->Size());
+        int valid_ray_count = 0;
 
-                    //ray->set_status(RayStatus::PassThrough);
-                    tracer->TracePupilRay(ray, seq_paths_[wi], pupil, fld, wvl);
+        for(int k = 0; k < samples->Size(); k++){
+            ray->SetStatus(TRACE_SUCCESS);
+            tracer->TracePupilRay(ray, seq_paths_[wi], samples->points[k], fld, wvl);
 
-                    if(TRACE_SUCCESS == ray->Status()){
-                        double dx = ray->GetBack()->X() - chief_ray_x;
-                        double dy = ray->GetBack()->Y() - chief_ray_y;
+            if(TRACE_SUCCESS == ray->Status()){
+                double dx = ray->GetBack()->X() - chief_ray_x;
+                double dy = ray->GetBack()->Y() - chief_ray_y;
 
-                        graph->SetData(valid_ray_count, dx, dy);
-                        valid_ray_count++;
-                    }
-                }
+                graph->SetData(valid_ray_count, dx, dy);
+                wvl_statistics_[wi].Add(dx, dy, samples->weights[k]*wvl_weights_[wi]);
+                valid_ray_count++;
             }
-
-            graph->Resize(valid_ray_count);
-
-        }else{
-            std::cerr << "Undefined spot pattern" << std::endl;
         }
 
-        // TODO: calculate RMS, Max diameter, etc
+        graph->Resize(valid_ray_count);
 
+        // sample weights sum to 1 for each wavelength, so the wavelength weight is applied to each ray
+        statistics_.Merge(wvl_statistics_[wi]);
 
         plot_data->AddGraph(graph);
     }
@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+#include "analysis/spot_statistics.h"
+
+using namespace geopter;
+
+SpotStatistics::SpotStatistics(double initial_bin_width, int num_bins) :
+    initial_bin_width_(initial_bin_width)
+{
+    radial_hist_.resize(num_bins + num_bins % 2);
+    square_hist_.resize(radial_hist_.size());
+    Clear();
+}
+
+void SpotStatistics::Clear()
+{
+    num_points_ = 0;
+    total_weight_ = 0.0;
+    mean_ = Eigen::Vector2d::Zero();
+    m2_ = Eigen::Vector2d::Zero();
+    max_radius_ = 0.0;
+    level_ = 0;
+    std::fill(radial_hist_.begin(), radial_hist_.end(), 0.0);
+    std::fill(square_hist_.begin(), square_hist_.end(), 0.0);
+}
+
+double SpotStatistics::BinWidth() const
+{
+    return std::ldexp(initial_bin_width_, level_);
+}
+
+void SpotStatistics::merge_bins(std::vector<double> &hist)
+{
+    const int half = hist.size()/2;
+    for(int i = 0; i < half; i++){
+        hist[i] = hist[2*i] + hist[2*i + 1];
+    }
+    std::fill(hist.begin() + half, hist.end(), 0.0);
+}
+
+void SpotStatistics::coarsen()
+{
+    merge_bins(radial_hist_);
+    merge_bins(square_hist_);
+    level_++;
+}
+
+void SpotStatistics::expand(double distance)
+{
+    // the same quotient as the bin index, as distance/width may round up to num_bins for distance just below width*num_bins
+    const int num_bins = radial_hist_.size();
+    while(floor(distance/BinWidth()) >= num_bins){
+        coarsen();
+    }
+}
+
+void SpotStatistics::Add(double dx, double dy, double weight)
+{
+    if(weight <= 0.0 || !std::isfinite(dx) || !std::isfinite(dy)){
+        return;
+    }
+
+    num_points_++;
+
+    // weighted Welford update
+    total_weight_ += weight;
+    const Eigen::Vector2d p(dx, dy);
+    const Eigen::Vector2d delta = p - mean_;
+    mean_ += delta*(weight/total_weight_);
+    m2_ += weight*delta.cwiseProduct(p - mean_);
+
+    const double r = sqrt(dx*dx + dy*dy);
+    const double s = std::max(fabs(dx), fabs(dy));
+    max_radius_ = std::max(max_radius_, r);
+
+    expand(r);
+
+    const double bin_width = BinWidth();
+    radial_hist_[(int)(r/bin_width)] += weight;
+    square_hist_[(int)(s/bin_width)] += weight;
+}
+
+void SpotStatistics::Merge(const SpotStatistics &other)
+{
+    if(other.num_points_ == 0){
+        return;
+    }
+
+    // histograms are combined at the coarser bin width
+    while(level_ < other.level_){
+        coarsen();
+    }
+
+    std::vector<double> other_radial = other.radial_hist_;
+    std::vector<double> other_square = other.square_hist_;
+    for(int lv = other.level_; lv < level_; lv++){
+        merge_bins(other_radial);
+        merge_bins(other_square);
+    }
+
+    const int num_bins = radial_hist_.size();
+
+    for(int i = 0; i < num_bins; i++){
+        radial_hist_[i] += other_radial[i];
+        square_hist_[i] += other_square[i];
+    }
+
+    // parallel combination of the moments (Chan et al.)
+    const double w = total_weight_ + other.total_weight_;
+    const Eigen::Vector2d delta = other.mean_ - mean_;
+    mean_ += delta*(other.total_weight_/w);
+    m2_ += other.m2_ + delta.cwiseProduct(delta)*(total_weight_*other.total_weight_/w);
+    total_weight_ = w;
+
+    num_points_ += other.num_points_;
+    max_radius_ = std::max(max_radius_, other.max_radius_);
+}
+
+double SpotStatistics::RmsRadius() const
+{
+    if(total_weight_ <= 0.0){
+        return NAN;
+    }
+    return sqrt(m2_.sum()/total_weight_);
+}
+
+double SpotStatistics::RmsRadiusFromReference() const
+{
+    if(total_weight_ <= 0.0){
+        return NAN;
+    }
+    return sqrt(m2_.sum()/total_weight_ + mean_.squaredNorm());
+}
+
+double SpotStatistics::RmsX() const
+{
+    if(total_weight_ <= 0.0){
+        return NAN;
+    }
+    return sqrt(m2_(0)/total_weight_);
+}
+
+double SpotStatistics::RmsY() const
+{
+    if(total_weight_ <= 0.0){
+        return NAN;
+    }
+    return sqrt(m2_(1)/total_weight_);
+}
+
+double SpotStatistics::cumulative(const std::vector<double> &hist, double x) const
+{
+    if(total_weight_ <= 0.0){
+        return NAN;
+    }
+
+    const double bin_width = BinWidth();
+    const int num_bins = hist.size();
+
+    double sum = 0.0;
+    for(int i = 0; i < num_bins; i++){
+        const double upper = (i+1)*bin_width;
+        if(x >= upper){
+            sum += hist[i];
+        }else{
+            sum += hist[i]*std::max(0.0, x - i*bin_width)/bin_width;
+            break;
+        }
+    }
+
+    return std::min(1.0, sum/total_weight_);
+}
+
+double SpotStatistics::EncircledEnergy(double radius) const
+{
+    return cumulative(radial_hist_, radius);
+}
+
+double SpotStatistics::EnsquaredEnergy(double half_width) const
+{
+    return cumulative(square_hist_, half_width);
+}
+
+double SpotStatistics::EncircledRadius(double fraction) const
+{
+    if(total_weight_ <= 0.0){
+        return NAN;
+    }
+
+    const double bin_width = BinWidth();
+    const int num_bins = radial_hist_.size();
+    const double target = fraction*total_weight_;
+
+    double sum = 0.0;
+    for(int i = 0; i < num_bins; i++){
+        if(sum + radial_hist_[i] >= target && radial_hist_[i] > 0.0){
+            const double r = (i + (target - sum)/radial_hist_[i])*bin_width;
+            return std::min(r, max_radius_);
+        }
+        sum += radial_hist_[i];
+    }
+
+    return max_radius_;
+}
+
+void SpotStatistics::Print(std::ostringstream &oss) const
+{
+    constexpr int label_w = 24;
+    constexpr int val_w = 14;
+    constexpr int prec = 6;
+
+    oss << std::setw(label_w) << std::left << "Number of Rays" << std::setw(val_w) << std::right << num_points_ << std::endl;
+    oss << std::setw(label_w) << std::left << "Centroid X" << std::setw(val_w) << std::right << std::fixed << std::setprecision(prec) << mean_(0) << std::endl;
+    oss << std::setw(label_w) << std::left << "Centroid Y" << std::setw(val_w) << std::right << std::fixed << std::setprecision(prec) << mean_(1) << std::endl;
+    oss << std::setw(label_w) << std::left << "RMS Radius" << std::setw(val_w) << std::right << std::fixed << std::setprecision(prec) << RmsRadius() << std::endl;
+    oss << std::setw(label_w) << std::left << "RMS Radius (Ref)" << std::setw(val_w) << std::right << std::fixed << std::setprecision(prec) << RmsRadiusFromReference() << std::endl;
+    oss << std::setw(label_w) << std::left << "Geometric Radius" << std::setw(val_w) << std::right << std::fixed << std::setprecision(prec) << max_radius_ << std::endl;
+    oss << std::setw(label_w) << std::left << "80% Encircled Radius" << std::setw(val_w) << std::right << std::fixed << std::setprecision(prec) << EncircledRadius(0.8) << std::endl;
+}
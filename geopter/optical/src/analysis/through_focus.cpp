@@ -0,0 +1,268 @@
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+#include "analysis/through_focus.h"
+#include "analysis/diffractive_mtf.h"
+#include "common/circ_shift.h"
+#include "common/fourier_transform.h"
+#include "common/parallel.h"
+#include "renderer/renderer.h"
+
+using namespace geopter;
+
+ThroughFocus::ThroughFocus(OpticalSystem *opt_sys) :
+    WaveAberration(opt_sys),
+    num_threads_(0),
+    prepared_(false),
+    nrd_(0),
+    wvl_(0.0),
+    n_img_(1.0),
+    shift_per_freq_(0.0)
+{
+
+}
+
+ThroughFocus::~ThroughFocus()
+{
+
+}
+
+bool ThroughFocus::Prepare(const Field *fld, double wvl, int nrd)
+{
+    prepared_ = false;
+    nrd_ = nrd;
+    wvl_ = wvl;
+    sample_index_.clear();
+
+    auto wf = pupil_wavefront(fld, wvl, PupilSampling::Grid(nrd));
+    if( !wf->valid ){
+        std::cerr << "ThroughFocus: failed to trace chief ray" << std::endl;
+        return false;
+    }
+
+    const OpticalAssembly* assembly = opt_sys_->GetOpticalAssembly();
+    n_img_ = fabs(assembly->ImageSpaceGap()->GetMaterial()->RefractiveIndex(wvl));
+    shift_per_freq_ = pupil_shift_per_frequency(*wf);
+
+    // the reference sphere of the wavefront is centered at the chief ray intercept, in the local coordinate of the image surface
+    cr_img_pt_ = wf->chief_ray->GetBack()->IntersectPt();
+    cr_img_dir_ = wf->chief_ray->GetBack()->Direction();
+    const double ref_radius = wf->ref_sphere.Radius();
+    cr_exp_pt_ = cr_img_pt_ - ref_radius*cr_img_dir_;
+
+    for(int i = 0; i < nrd; i++){
+        for(int j = 0; j < nrd; j++){
+            if(wf->mask(i, j)){
+                sample_index_.push_back(i*nrd + j);
+            }
+        }
+    }
+
+    const int num_samples = sample_index_.size();
+    opd_.resize(num_samples);
+    exp_x_.resize(num_samples);
+    exp_y_.resize(num_samples);
+    exp_z_.resize(num_samples);
+    dir_x_.resize(num_samples);
+    dir_y_.resize(num_samples);
+    dir_z_.resize(num_samples);
+
+    for(int s = 0; s < num_samples; s++){
+        const int idx = sample_index_[s];
+        const Eigen::Vector3d& pt = wf->image_pts[idx];
+        const Eigen::Vector3d& dir = wf->image_dirs[idx];
+
+        // back along the ray to the reference sphere, the root near the radius
+        const Eigen::Vector3d rel = pt - cr_img_pt_;
+        const double b = dir.dot(rel);
+        const double c = rel.squaredNorm() - ref_radius*ref_radius;
+        const double dist = b + sqrt(std::max(0.0, b*b - c));
+        const Eigen::Vector3d exp_pt = pt - dist*dir;
+
+        opd_(s) = wf->opd(idx/nrd, idx%nrd);
+        exp_x_(s) = exp_pt(0);
+        exp_y_(s) = exp_pt(1);
+        exp_z_(s) = exp_pt(2);
+        dir_x_(s) = dir(0);
+        dir_y_(s) = dir(1);
+        dir_z_(s) = dir(2);
+    }
+
+    prepared_ = (num_samples > 0);
+
+    return prepared_;
+}
+
+Eigen::ArrayXd ThroughFocus::shifted_opd(double defocus) const
+{
+    // new reference sphere centered at the chief ray intercept on the shifted plane, through the same exit pupil point
+    const Eigen::Vector3d center = cr_img_pt_ + (defocus/cr_img_dir_(2))*cr_img_dir_;
+    const double radius = (cr_exp_pt_ - center).norm();
+
+    // distance t along each ray from the original sphere to the new one, the root of t^2 + 2bt + c = 0 near zero
+    const Eigen::ArrayXd rel_x = exp_x_ - center(0);
+    const Eigen::ArrayXd rel_y = exp_y_ - center(1);
+    const Eigen::ArrayXd rel_z = exp_z_ - center(2);
+    const Eigen::ArrayXd b = dir_x_*rel_x + dir_y_*rel_y + dir_z_*rel_z;
+    const Eigen::ArrayXd c = rel_x.square() + rel_y.square() + rel_z.square() - radius*radius;
+    const Eigen::ArrayXd sq = (b.square() - c).max(0.0).sqrt();
+    const Eigen::ArrayXd q = (b < 0.0).select(sq - b, -b - sq);
+    const Eigen::ArrayXd t = (q != 0.0).select(c/q, 0.0);
+
+    // the chief ray has t = 0, so a longer path of the ray is a smaller OPD
+    return opd_ - n_img_*t;
+}
+
+Eigen::MatrixXd ThroughFocus::Opd(double defocus) const
+{
+    Eigen::MatrixXd opd = Eigen::MatrixXd::Constant(nrd_, nrd_, NAN);
+    if( !prepared_ ){
+        return opd;
+    }
+
+    const Eigen::ArrayXd shifted = shifted_opd(defocus)/(wvl_*1.0e-6);
+    for(size_t s = 0; s < sample_index_.size(); s++){
+        opd(sample_index_[s]/nrd_, sample_index_[s]%nrd_) = shifted(s);
+    }
+
+    return opd;
+}
+
+Eigen::MatrixXcd ThroughFocus::pupil_function(double defocus) const
+{
+    Eigen::MatrixXcd pupil_func = Eigen::MatrixXcd::Zero(nrd_, nrd_);
+    if( !prepared_ ){
+        return pupil_func;
+    }
+
+    const double k = 2.0*M_PI/(wvl_*1.0e-6);
+    const Eigen::ArrayXd phase = -k*shifted_opd(defocus);
+    for(size_t s = 0; s < sample_index_.size(); s++){
+        pupil_func(sample_index_[s]/nrd_, sample_index_[s]%nrd_) = std::polar(1.0, phase(s));
+    }
+
+    return pupil_func;
+}
+
+double ThroughFocus::StrehlRatio(double defocus) const
+{
+    if( !prepared_ ){
+        return 0.0;
+    }
+
+    const double k = 2.0*M_PI/(wvl_*1.0e-6);
+    const Eigen::ArrayXd phase = -k*shifted_opd(defocus);
+
+    const double re = phase.cos().mean();
+    const double im = phase.sin().mean();
+
+    return re*re + im*im;
+}
+
+std::vector< std::complex<double> > ThroughFocus::ComputeOTF(double defocus, const std::vector<double> &freqs, double azimuth) const
+{
+    std::vector<double> shifts(freqs.size());
+    for(size_t fi = 0; fi < freqs.size(); fi++){
+        shifts[fi] = freqs[fi]*shift_per_freq_;
+    }
+
+    return DiffractiveMTF::PupilAutocorrelation(pupil_function(defocus), shifts, azimuth);
+}
+
+double ThroughFocus::PsfPitch(int M) const
+{
+    return shift_per_freq_/static_cast<double>(M);
+}
+
+std::shared_ptr<DataGrid> ThroughFocus::PSF(double defocus, int M) const
+{
+    if( !prepared_ || M < nrd_ ){
+        std::cerr << "ThroughFocus: not prepared, or padded size smaller than the pupil sampling" << std::endl;
+        return std::make_shared<DataGrid>(M, M, 0.0, 0.0);
+    }
+
+    Eigen::MatrixXcd padded = Eigen::MatrixXcd::Zero(M, M);
+    padded.block((M - nrd_)/2, (M - nrd_)/2, nrd_, nrd_) = pupil_function(defocus);
+
+    Eigen::MatrixXcd spectrum = ifftshift(padded);
+    FourierTransform::Forward2(spectrum);
+
+    // the aberration free peak is the squared number of samples
+    const double num_samples = sample_index_.size();
+    Eigen::MatrixXd intensity = fftshift(spectrum).array().abs2()/(num_samples*num_samples);
+
+    const double pitch = PsfPitch(M);
+    auto psf_grid = std::make_shared<DataGrid>(M, M, M*pitch, M*pitch);
+    psf_grid->SetValueMatrix(intensity);
+
+    std::ostringstream oss;
+    oss << "FFT PSF, focus shift " << defocus << ", pitch " << pitch;
+    psf_grid->SetDescription(oss.str());
+    psf_grid->SetXLabel("X");
+    psf_grid->SetYLabel("Y");
+    psf_grid->SetValueLabel("Relative Intensity");
+
+    return psf_grid;
+}
+
+std::vector<double> ThroughFocus::StrehlRatios(const std::vector<double> &defocuses) const
+{
+    std::vector<double> strehls(defocuses.size(), 0.0);
+
+    Parallel::For(0, defocuses.size(), [&](int i){
+        strehls[i] = StrehlRatio(defocuses[i]);
+    }, num_threads_);
+
+    return strehls;
+}
+
+std::vector<double> ThroughFocus::MTFs(const std::vector<double> &defocuses, double freq, double azimuth) const
+{
+    std::vector<double> mtfs(defocuses.size(), 0.0);
+
+    Parallel::For(0, defocuses.size(), [&](int i){
+        mtfs[i] = std::abs(ComputeOTF(defocuses[i], {freq}, azimuth)[0]);
+    }, num_threads_);
+
+    return mtfs;
+}
+
+std::shared_ptr<PlotData> ThroughFocus::Plot(double freq, double min_defocus, double max_defocus, int num_planes)
+{
+    std::vector<double> defocuses(num_planes);
+    for(int i = 0; i < num_planes; i++){
+        defocuses[i] = (num_planes > 1) ? min_defocus + (max_defocus - min_defocus)*i/(num_planes - 1) : min_defocus;
+    }
+
+    auto plot_data = std::make_shared<PlotData>();
+    plot_data->SetPlotStyle(Renderer::PlotStyle::Curve);
+    plot_data->SetTitle("Through Focus");
+    plot_data->SetXLabel("Focus Shift");
+    plot_data->SetYLabel("Strehl Ratio / MTF");
+
+    auto graph_strehl = std::make_shared<Graph2d>();
+    graph_strehl->SetData(defocuses, StrehlRatios(defocuses));
+    graph_strehl->SetLineStyle(Renderer::LineStyle::Solid);
+    graph_strehl->SetRenderColor(rgb_black);
+    graph_strehl->SetName("Strehl");
+
+    auto graph_sag = std::make_shared<Graph2d>();
+    graph_sag->SetData(defocuses, MTFs(defocuses, freq, 0.0));
+    graph_sag->SetLineStyle(Renderer::LineStyle::Solid);
+    graph_sag->SetRenderColor(rgb_blue);
+    graph_sag->SetName("MTF_S");
+
+    auto graph_tan = std::make_shared<Graph2d>();
+    graph_tan->SetData(defocuses, MTFs(defocuses, freq, M_PI/2.0));
+    graph_tan->SetLineStyle(Renderer::LineStyle::Dots);
+    graph_tan->SetRenderColor(rgb_blue);
+    graph_tan->SetName("MTF_T");
+
+    plot_data->AddGraph(graph_strehl);
+    plot_data->AddGraph(graph_sag);
+    plot_data->AddGraph(graph_tan);
+
+    return plot_data;
+}
@@ -1,10 +1,14 @@
 
 #include "analysis/wave_aberration.h"
 
+#include <cmath>
 #include <iostream>
 
 #include "sequential/sequential_trace.h"
 #include "assembly/optical_assembly.h"
+#include "sequential/trace_error.h"
+#include "common/parallel.h"
+#include "analysis/pupil_boundary.h"
 
 using namespace geopter;
 
@@ -21,8 +25,9 @@ WaveAberration::~WaveAberration()
 
 double WaveAberration::wave_abr_full_calc(const std::shared_ptr<Ray>& ray, const std::shared_ptr<Ray>& chief_ray, const Field* fld, ReferenceSphere& ref_sphere)
 {
-    int k = opt_sys_->GetOpticalAssembly()->ImageIndex() - 1;
-    Surface* srf = opt_sys_->GetOpticalAssembly()->GetSurface(k);
+    const OpticalAssembly* assembly = opt_sys_->GetOpticalAssembly();
+    int k = assembly->ImageIndex() - 1;
+    const Surface* srf = assembly->GetSurface(k);
     //double exp_dist_parax = opt_sys_->paraxial_data()->exit_pupil_distance();
 
     double cr_exp_dist;
@@ -62,8 +67,8 @@ double WaveAberration::wave_abr_full_calc(const std::shared_ptr<Ray>& ray, const
     double chief_ray_op = chief_ray->OpticalPathLength();
 
     double wvl = chief_ray->Wavelength();
-    double n_img = opt_sys_->GetOpticalAssembly()->ImageSpaceGap()->GetMaterial()->RefractiveIndex(wvl);
-    double n_obj = opt_sys_->GetOpticalAssembly()->GetGap(0)->GetMaterial()->RefractiveIndex(wvl);
+    double n_img = assembly->ImageSpaceGap()->GetMaterial()->RefractiveIndex(wvl);
+    double n_obj = assembly->GetGap(0)->GetMaterial()->RefractiveIndex(wvl);
 
     n_img = fabs(n_img);
     n_obj = fabs(n_obj);
@@ -85,8 +90,9 @@ double WaveAberration::wave_abr_full_calc(const std::shared_ptr<Ray>& ray, const
 
     // ---> 1. calculate chief ray intersection with exit pupil
 
-    int k = opt_sys_->GetOpticalAssembly()->ImageIndex() - 1;
-    Surface* srf = opt_sys_->GetOpticalAssembly()->GetSurface(k);
+    const OpticalAssembly* assembly = opt_sys_->GetOpticalAssembly();
+    int k = assembly->ImageIndex() - 1;
+    const Surface* srf = assembly->GetSurface(k);
     //double exp_dist_parax = opt_sys_->paraxial_data()->exit_pupil_distance();
 
     double cr_exp_dist;
@@ -135,8 +141,8 @@ double WaveAberration::wave_abr_full_calc(const std::shared_ptr<Ray>& ray, const
     double chief_ray_op = chief_ray->OpticalPathLength();
 
     double ref_wvl_val = opt_sys_->GetOpticalSpec()->GetWavelengthSpec()->ReferenceWavelength();
-    double n_img = opt_sys_->GetOpticalAssembly()->ImageSpaceGap()->GetMaterial()->RefractiveIndex(ref_wvl_val);
-    double n_obj = opt_sys_->GetOpticalAssembly()->GetGap(0)->GetMaterial()->RefractiveIndex(ref_wvl_val);
+    double n_img = assembly->ImageSpaceGap()->GetMaterial()->RefractiveIndex(ref_wvl_val);
+    double n_obj = assembly->GetGap(0)->GetMaterial()->RefractiveIndex(ref_wvl_val);
 
     n_img = fabs(n_img);
     n_obj = fabs(n_obj);
@@ -207,10 +213,32 @@ ReferenceSphere WaveAberration::setup_reference_sphere(const std::shared_ptr<Ray
     return ReferenceSphere(image_pt, ref_dir, ref_sphere_radius, exp_dist_parax);
 }
 
+bool WaveAberration::is_rotationally_symmetric() const
+{
+    const OpticalAssembly* assembly = opt_sys_->GetOpticalAssembly();
+    for(int i = 0; i < assembly->NumberOfSurfaces(); i++){
+        if(assembly->GetSurface(i)->Decenter()){
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool WaveAberration::is_symmetric(const Field *fld) const
+{
+    if(fld->X() != 0.0 || fld->AimPt()(0) != 0.0 || fld->VUX() != fld->VLX()){
+        return false;
+    }
+
+    return is_rotationally_symmetric();
+}
+
 void WaveAberration::get_chief_ray_exp_segment(Eigen::Vector3d& cr_exp_pt, double& cr_exp_dist, const std::shared_ptr<Ray> chief_ray)
 {
-    int k = opt_sys_->GetOpticalAssembly()->ImageIndex() - 1;
-    Surface* srf = opt_sys_->GetOpticalAssembly()->GetSurface(k);
+    const OpticalAssembly* assembly = opt_sys_->GetOpticalAssembly();
+    int k = assembly->ImageIndex() - 1;
+    const Surface* srf = assembly->GetSurface(k);
     double exp_dist_parax = opt_sys_->GetFirstOrderData()->exit_pupil_distance;
 
     Eigen::Vector3d cr_inc_pt_before_img;
@@ -231,3 +259,76 @@ void WaveAberration::get_chief_ray_exp_segment(Eigen::Vector3d& cr_exp_pt, doubl
     cr_exp_pt = cr_inc_pt_before_img + cr_exp_dist*cr_dir_before_img;
 }
 
+
+std::shared_ptr<const PupilWavefront> WaveAberration::pupil_wavefront(const Field *fld, double wvl, const PupilSampling &sampling)
+{
+    const WavefrontCache::Key key = WavefrontCache::MakeKey(opt_sys_, fld, wvl, sampling);
+
+    auto cached = WavefrontCache::Find(key);
+    if(cached){
+        return cached;
+    }
+
+    auto wf = std::make_shared<PupilWavefront>();
+    wf->sampling = sampling;
+    wf->wvl = wvl;
+    wf->opd = Eigen::MatrixXd::Constant(sampling.ny, sampling.nx, NAN);
+    wf->mask = Eigen::Array<bool, Eigen::Dynamic, Eigen::Dynamic>::Constant(sampling.ny, sampling.nx, false);
+    wf->image_pts.resize(sampling.nx*sampling.ny);
+    wf->image_dirs.resize(sampling.nx*sampling.ny);
+
+    SequentialTrace tracer(opt_sys_);
+    tracer.SetApertureCheck(true);
+    tracer.SetApplyVig(false);
+
+    const SequentialPath seq_path = tracer.CreateSequentialPath(wvl);
+
+    wf->chief_ray = std::make_shared<Ray>(seq_path.Size());
+    wf->valid = (TRACE_SUCCESS == tracer.TracePupilRay(wf->chief_ray, seq_path, Eigen::Vector2d({0.0, 0.0}), fld, wvl));
+
+    if(wf->valid){
+        double cr_exp_dist;
+        Eigen::Vector3d cr_exp_pt;
+        get_chief_ray_exp_segment(cr_exp_pt, cr_exp_dist, wf->chief_ray);
+        wf->ref_sphere = setup_reference_sphere(wf->chief_ray, cr_exp_pt);
+
+        // rays outside of the traced boundary would be blocked
+        auto boundary = PupilBoundary::FindForSamples(opt_sys_, fld, wvl, (long long)sampling.nx*sampling.ny);
+
+        Parallel::For(0, sampling.ny, [&](int i){
+            SequentialTrace row_tracer(opt_sys_);
+            row_tracer.SetApertureCheck(true);
+            row_tracer.SetApplyVig(false);
+
+            auto ray = std::make_shared<Ray>(seq_path.Size());
+            ReferenceSphere ref_sphere = wf->ref_sphere;
+
+            for(int j = 0; j < sampling.nx; j++){
+                const Eigen::Vector2d pupil = sampling.PupilCoordinate(i, j);
+                if(pupil.norm() > 1.0 || (boundary && !boundary->Contains(pupil))){
+                    continue;
+                }
+
+                if(TRACE_SUCCESS == row_tracer.TracePupilRay(ray, seq_path, pupil, fld, wvl)){
+                    wf->opd(i, j) = wave_abr_full_calc(ray, wf->chief_ray, fld, ref_sphere);
+                    wf->mask(i, j) = true;
+                    wf->image_pts[i*sampling.nx + j] = ray->GetBack()->IntersectPt();
+                    wf->image_dirs[i*sampling.nx + j] = ray->GetBack()->Direction();
+                }
+            }
+        });
+    }
+
+    return WavefrontCache::Insert(key, wf);
+}
+
+double WaveAberration::pupil_shift_per_frequency(const PupilWavefront &wf)
+{
+    const FirstOrderData* fod = opt_sys_->GetFirstOrderData();
+    const double img_ht = wf.chief_ray->GetBack()->Height();
+    const double zxp = fod->image_distance - fod->exit_pupil_distance;
+    const double dxp = sqrt(zxp*zxp + img_ht*img_ht);
+    const double wxp = fabs(fod->exit_pupil_radius);
+
+    return wf.wvl*1.0e-6*dxp/wxp/wf.sampling.step_x;
+}
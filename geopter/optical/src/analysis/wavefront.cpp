@@ -22,15 +22,20 @@
 **          Contact: heterophyllus.work@gmail.com
 **             Date: November 11th, 2021
 ********************************************************************************/
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include "analysis/wavefront.h"
+#include "analysis/zernike_fit.h"
 #include "sequential/sequential_trace.h"
 #include "sequential/trace_error.h"
 
 using namespace geopter;
 
 WavefrontMap::WavefrontMap(OpticalSystem* opt_sys)
-    :WaveAberration(opt_sys)
+    :WaveAberration(opt_sys),
+    reconstructed_(false),
+    reconstruction_error_(0.0)
 {
     opt_sys_ = opt_sys;
 }
@@ -44,61 +49,191 @@ std::shared_ptr<DataGrid> WavefrontMap::Create(const Field *fld, double wvl, int
     const double nm_to_mm = 1.0e-6;
     const double convert_to_waves = 1.0/(nm_to_mm*wvl);
 
-    SequentialTrace *tracer = new SequentialTrace(opt_sys_);
-    tracer->SetApertureCheck(true);
-    tracer->SetApplyVig(false);
-
-    SequentialPath seq_path = tracer->CreateSequentialPath(wvl);
-
-    const auto chief_ray = std::make_shared<Ray>();
-    chief_ray->Allocate(seq_path.Size());
-    int trace_result = tracer->TracePupilRay(chief_ray, seq_path, Eigen::Vector2d({0.0, 0.0}), fld, wvl);
-
-    const double step = 2.0/static_cast<double>(ndim-1);
-    const double start = -1.0;
-
-    Eigen::Vector2d pupil;
+    auto wf = pupil_wavefront(fld, wvl, PupilSampling::Grid(ndim));
 
     double epd = 2.0*opt_sys_->GetFirstOrderData()->entrance_pupil_radius;
-    RayPtr ray = std::make_shared<Ray>();
-    ray->Allocate(seq_path.Size());
 
     auto data_grid = std::make_shared<DataGrid>(ndim, ndim, epd, epd);
 
-    double cr_exp_dist;
-    Eigen::Vector3d cr_exp_pt;
-    get_chief_ray_exp_segment(cr_exp_pt, cr_exp_dist, chief_ray);
-    auto ref_sphere = setup_reference_sphere(chief_ray,cr_exp_pt);
-
-
     for(int i = 0; i < ndim; i++)
     {
         for(int j = 0 ; j < ndim; j++)
         {
-            pupil(0) = start + step*static_cast<double>(j);
-            pupil(1) = start + step*static_cast<double>(i);
-
-            if(pupil.norm() < 1.0){
-                trace_result = tracer->TracePupilRay(ray, seq_path, pupil, fld, wvl);
-                if(TRACE_SUCCESS == trace_result){
-                    double opd = wave_abr_full_calc(ray, chief_ray, fld, ref_sphere);
-                    opd *= convert_to_waves;
-                    data_grid->SetValueAt(i, j, opd);
-                }else{
-                    data_grid->SetValueAt(i, j, NAN);
-                }
+            if(wf->mask(i, j)){
+                data_grid->SetValueAt(i, j, wf->opd(i, j)*convert_to_waves);
             }else{
                 data_grid->SetValueAt(i, j, NAN);
             }
+        }
+    }
+
+    return data_grid;
+}
+
+std::shared_ptr<DataGrid> WavefrontMap::CreateByReconstruction(const Field *fld, double wvl, int ndim, int coarse_ndim, int max_degree, double tolerance)
+{
+    reconstructed_ = false;
+    reconstruction_error_ = 0.0;
+
+    const double convert_to_waves = 1.0/(1.0e-6*wvl);
+    const PupilSampling coarse_sampling = PupilSampling::Grid(coarse_ndim);
+
+    auto wf = pupil_wavefront(fld, wvl, coarse_sampling);
+    if( !wf->valid ){
+        return Create(fld, wvl, ndim);
+    }
 
+    // a pupil clipped inside the unit circle has an edge which the fit can not follow
+    Eigen::MatrixXd coarse_opd = wf->opd*convert_to_waves;
+    Eigen::MatrixXd trial_opd = coarse_opd;
+    Eigen::Array<bool, Eigen::Dynamic, Eigen::Dynamic> held_out = Eigen::Array<bool, Eigen::Dynamic, Eigen::Dynamic>::Constant(coarse_ndim, coarse_ndim, false);
+
+    for(int i = 0; i < coarse_ndim; i++){
+        for(int j = 0; j < coarse_ndim; j++){
+            if(coarse_sampling.PupilCoordinate(i, j).norm() > 1.0){
+                continue;
+            }
+            if( !wf->mask(i, j) ){
+                return Create(fld, wvl, ndim);
+            }
+            if(i % 3 == 1 && j % 3 == 1){
+                held_out(i, j) = true;
+                trial_opd(i, j) = NAN;
+            }
+        }
+    }
+
+    ZernikeFit zernike(opt_sys_);
+    zernike.SetOrdering(Zernike::Noll);
+    zernike.SetNumberOfTerms((max_degree + 1)*(max_degree + 2)/2);
+
+    auto trial = zernike.Fit(trial_opd);
+    if(trial.num_samples == 0){
+        return Create(fld, wvl, ndim);
+    }
+
+    const Eigen::MatrixXd trial_fitted = ZernikeFit::Evaluate(trial, coarse_sampling);
+
+    double sum_sq = 0.0;
+    int num_held_out = 0;
+    for(int i = 0; i < coarse_ndim; i++){
+        for(int j = 0; j < coarse_ndim; j++){
+            if(held_out(i, j)){
+                sum_sq += pow(trial_fitted(i, j) - coarse_opd(i, j), 2);
+                num_held_out++;
+            }
         }
+    }
 
+    reconstruction_error_ = (num_held_out > 0) ? sqrt(sum_sq/num_held_out) : 0.0;
+    if(reconstruction_error_ > tolerance){
+        return Create(fld, wvl, ndim);
     }
 
-    delete tracer;
+    // the final fit uses all the coarse samples
+    auto coefs = zernike.Fit(coarse_opd);
+
+    ndim_ = ndim;
+    wvl_ = wvl;
+    reconstructed_ = true;
+
+    double epd = 2.0*opt_sys_->GetFirstOrderData()->entrance_pupil_radius;
+
+    auto data_grid = std::make_shared<DataGrid>(ndim, ndim, epd, epd);
+    Eigen::MatrixXd opd = ZernikeFit::Evaluate(coefs, PupilSampling::Grid(ndim));
+    data_grid->SetValueMatrix(opd);
 
     return data_grid;
 }
 
+double WavefrontMap::RmsWavefront(const Field *fld, double wvl, const PupilSampleSet &samples)
+{
+    SequentialTrace tracer(opt_sys_);
+    tracer.SetApertureCheck(true);
+    tracer.SetApplyVig(false);
+
+    const SequentialPath seq_path = tracer.CreateSequentialPath(wvl);
+
+    auto chief_ray = std::make_shared<Ray>(seq_path.Size());
+    if(TRACE_SUCCESS != tracer.TracePupilRay(chief_ray, seq_path, Eigen::Vector2d({0.0, 0.0}), fld, wvl)){
+        std::cerr << "Failed to trace chief ray" << std::endl;
+        return NAN;
+    }
+
+    double cr_exp_dist;
+    Eigen::Vector3d cr_exp_pt;
+    get_chief_ray_exp_segment(cr_exp_pt, cr_exp_dist, chief_ray);
+    ReferenceSphere ref_sphere = setup_reference_sphere(chief_ray, cr_exp_pt);
 
+    const double convert_to_waves = 1.0/(1.0e-6*wvl);
 
+    auto ray = std::make_shared<Ray>(seq_path.Size());
+
+    double sum_w = 0.0, sum_opd = 0.0, sum_sq = 0.0;
+    for(int k = 0; k < samples.Size(); k++){
+        if(TRACE_SUCCESS == tracer.TracePupilRay(ray, seq_path, samples.points[k], fld, wvl)){
+            const double opd = wave_abr_full_calc(ray, chief_ray, fld, ref_sphere)*convert_to_waves;
+            const double w = samples.weights[k];
+            sum_w += w;
+            sum_opd += w*opd;
+            sum_sq += w*opd*opd;
+        }
+    }
+
+    if(sum_w <= 0.0){
+        return NAN;
+    }
+
+    const double mean = sum_opd/sum_w;
+    return sqrt(std::max(0.0, sum_sq/sum_w - mean*mean));
+}
+
+QmcEstimate WavefrontMap::EstimateRmsWavefront(const Field *fld, double wvl, const QmcEstimator &estimator)
+{
+    SequentialTrace tracer(opt_sys_);
+    tracer.SetApertureCheck(true);
+    tracer.SetApplyVig(false);
+
+    const SequentialPath seq_path = tracer.CreateSequentialPath(wvl);
+
+    auto chief_ray = std::make_shared<Ray>(seq_path.Size());
+    if(TRACE_SUCCESS != tracer.TracePupilRay(chief_ray, seq_path, Eigen::Vector2d({0.0, 0.0}), fld, wvl)){
+        std::cerr << "Failed to trace chief ray" << std::endl;
+        return QmcEstimate{NAN, INFINITY, 0, 0, false};
+    }
+
+    double cr_exp_dist;
+    Eigen::Vector3d cr_exp_pt;
+    get_chief_ray_exp_segment(cr_exp_pt, cr_exp_dist, chief_ray);
+    ReferenceSphere ref_sphere = setup_reference_sphere(chief_ray, cr_exp_pt);
+
+    const double convert_to_waves = 1.0/(1.0e-6*wvl);
+
+    // weighted sums of 1, OPD and squared OPD of each replicate
+    std::vector<Eigen::Vector3d> sums(estimator.NumberOfReplicates(), Eigen::Vector3d::Zero());
+
+    auto add_batch = [&](int r, const PupilSampleSet& samples){
+        SequentialTrace replicate_tracer(opt_sys_);
+        replicate_tracer.SetApertureCheck(true);
+        replicate_tracer.SetApplyVig(false);
+
+        auto ray = std::make_shared<Ray>(seq_path.Size());
+
+        for(int k = 0; k < samples.Size(); k++){
+            if(TRACE_SUCCESS == replicate_tracer.TracePupilRay(ray, seq_path, samples.points[k], fld, wvl)){
+                const double opd = wave_abr_full_calc(ray, chief_ray, fld, ref_sphere)*convert_to_waves;
+                sums[r] += samples.weights[k]*Eigen::Vector3d(1.0, opd, opd*opd);
+            }
+        }
+    };
+
+    auto estimate = [&](int r) -> double {
+        if(sums[r](0) <= 0.0){
+            return NAN;
+        }
+        const double mean = sums[r](1)/sums[r](0);
+        return sqrt(std::max(0.0, sums[r](2)/sums[r](0) - mean*mean));
+    };
+
+    return estimator.Run(add_batch, estimate, fld);
+}
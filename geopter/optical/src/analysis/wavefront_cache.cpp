@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+#include "analysis/wavefront_cache.h"
+#include "system/optical_system.h"
+
+using namespace geopter;
+
+namespace {
+
+struct CacheEntry
+{
+    std::shared_ptr<const PupilWavefront> wavefront;
+    unsigned long long last_access;
+};
+
+std::mutex cache_mutex;
+std::map<WavefrontCache::Key, CacheEntry> cache_entries;
+unsigned long long access_count = 0;
+int capacity = 64;
+
+/** Drop least recently used entries over the capacity. The mutex must be held. */
+void evict()
+{
+    while((int)cache_entries.size() > capacity){
+        auto oldest = cache_entries.begin();
+        for(auto it = cache_entries.begin(); it != cache_entries.end(); it++){
+            if(it->second.last_access < oldest->second.last_access){
+                oldest = it;
+            }
+        }
+        cache_entries.erase(oldest);
+    }
+}
+
+}
+
+PupilSampling PupilSampling::Grid(int n)
+{
+    const double step = 2.0/static_cast<double>(n-1);
+    return PupilSampling{n, n, -1.0, step, -1.0, step};
+}
+
+PupilSampling PupilSampling::FanY(int n)
+{
+    return PupilSampling{1, n, 0.0, 0.0, -1.0, 2.0/static_cast<double>(n-1)};
+}
+
+bool WavefrontCache::Key::operator<(const Key &other) const
+{
+    return std::tie(opt_sys, revision, fld, fld_state, wvl, nx, ny, grid) <
+           std::tie(other.opt_sys, other.revision, other.fld, other.fld_state, other.wvl, other.nx, other.ny, other.grid);
+}
+
+WavefrontCache::Key WavefrontCache::MakeKey(const OpticalSystem *opt_sys, const Field *fld, double wvl, const PupilSampling &sampling)
+{
+    Key key;
+    key.opt_sys = opt_sys;
+    key.revision = opt_sys->ModelRevision();
+    key.fld = fld;
+    key.fld_state = {fld->X(), fld->Y(), fld->VUY(), fld->VLY(), fld->VUX(), fld->VLX(), fld->AimPt()(0), fld->AimPt()(1)};
+    key.wvl = wvl;
+    key.nx = sampling.nx;
+    key.ny = sampling.ny;
+    key.grid = {sampling.start_x, sampling.step_x, sampling.start_y, sampling.step_y};
+
+    return key;
+}
+
+std::shared_ptr<const PupilWavefront> WavefrontCache::Find(const Key &key)
+{
+    std::lock_guard<std::mutex> lock(cache_mutex);
+
+    auto it = cache_entries.find(key);
+    if(it == cache_entries.end()){
+        return nullptr;
+    }
+
+    it->second.last_access = ++access_count;
+    return it->second.wavefront;
+}
+
+std::shared_ptr<const PupilWavefront> WavefrontCache::Insert(const Key &key, std::shared_ptr<const PupilWavefront> wavefront)
+{
+    std::lock_guard<std::mutex> lock(cache_mutex);
+
+    // another thread may have computed the same entry in the meantime
+    auto result = cache_entries.emplace(key, CacheEntry{wavefront, 0});
+    result.first->second.last_access = ++access_count;
+    std::shared_ptr<const PupilWavefront> cached = result.first->second.wavefront;
+
+    evict();
+
+    return cached;
+}
+
+void WavefrontCache::SetCapacity(int n)
+{
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    capacity = std::max(0, n);
+    evict();
+}
+
+int WavefrontCache::NumberOfEntries()
+{
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    return cache_entries.size();
+}
+
+void WavefrontCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    cache_entries.clear();
+}
@@ -0,0 +1,402 @@
+#define _USE_MATH_DEFINES
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+#include "Eigen/QR"
+#include "analysis/zernike_fit.h"
+#include "common/parallel.h"
+
+using namespace geopter;
+
+namespace {
+
+/** Sampled basis and its factorization */
+struct Basis
+{
+    /** column major indices of the samples */
+    std::vector<int> sample_index;
+
+    /** values of the terms at the samples, one column per term */
+    Eigen::MatrixXd mat;
+
+    Eigen::ColPivHouseholderQR<Eigen::MatrixXd> qr;
+};
+
+struct BasisKey
+{
+    int ordering;
+    int num_terms;
+    int nx;
+    int ny;
+    std::array<double, 4> grid;
+    std::vector<bool> mask;
+
+    bool operator<(const BasisKey& other) const {
+        return std::tie(ordering, num_terms, nx, ny, grid, mask) <
+               std::tie(other.ordering, other.num_terms, other.nx, other.ny, other.grid, other.mask);
+    }
+};
+
+struct BasisEntry
+{
+    std::shared_ptr<const Basis> basis;
+    unsigned long long last_access;
+};
+
+std::mutex basis_mutex;
+std::map<BasisKey, BasisEntry> basis_entries;
+unsigned long long access_count = 0;
+int capacity = 32;
+
+/** Drop least recently used entries over the capacity. The mutex must be held. */
+void evict()
+{
+    while((int)basis_entries.size() > capacity){
+        auto oldest = basis_entries.begin();
+        for(auto it = basis_entries.begin(); it != basis_entries.end(); it++){
+            if(it->second.last_access < oldest->second.last_access){
+                oldest = it;
+            }
+        }
+        basis_entries.erase(oldest);
+    }
+}
+
+double factorial(int n)
+{
+    double f = 1.0;
+    for(int i = 2; i <= n; i++){
+        f *= i;
+    }
+    return f;
+}
+
+double radial(int n, int m, double rho)
+{
+    double val = 0.0;
+    for(int s = 0; s <= (n - m)/2; s++){
+        const double c = factorial(n - s)/(factorial(s)*factorial((n + m)/2 - s)*factorial((n - m)/2 - s));
+        val += ((s % 2 == 0) ? c : -c)*pow(rho, n - 2*s);
+    }
+    return val;
+}
+
+/** Term with the coefficients of its radial polynomial, including the normalization */
+struct Term
+{
+    int n;
+    int abs_m;
+    int sign_m;
+
+    /** of rho^n, rho^(n-2), ... */
+    std::vector<double> radial_coefs;
+};
+
+Term make_term(int j, Zernike::Ordering ordering)
+{
+    int n, m;
+    Zernike::Index(j, ordering, n, m);
+
+    Term term;
+    term.n = n;
+    term.abs_m = std::abs(m);
+    term.sign_m = (m > 0) - (m < 0);
+
+    double norm = 1.0;
+    if(ordering == Zernike::Noll){
+        norm = (m == 0) ? sqrt(n + 1.0) : sqrt(2.0*(n + 1.0));
+    }
+
+    for(int s = 0; s <= (n - term.abs_m)/2; s++){
+        const double c = factorial(n - s)/(factorial(s)*factorial((n + term.abs_m)/2 - s)*factorial((n - term.abs_m)/2 - s));
+        term.radial_coefs.push_back(norm*((s % 2 == 0) ? c : -c));
+    }
+
+    return term;
+}
+
+std::shared_ptr<const Basis> create_basis(const BasisKey& key, const PupilSampling& sampling)
+{
+    auto basis = std::make_shared<Basis>();
+
+    for(int j = 0; j < key.nx; j++){
+        for(int i = 0; i < key.ny; i++){
+            if(key.mask[j*key.ny + i]){
+                basis->sample_index.push_back(j*key.ny + i);
+            }
+        }
+    }
+
+    const int num_samples = basis->sample_index.size();
+    basis->mat.resize(num_samples, key.num_terms);
+
+    for(int s = 0; s < num_samples; s++){
+        const int i = basis->sample_index[s] % key.ny;
+        const int j = basis->sample_index[s] / key.ny;
+        const Eigen::Vector2d pupil = sampling.PupilCoordinate(i, j);
+        const double rho = pupil.norm();
+        const double theta = atan2(pupil(1), pupil(0));
+
+        for(int t = 0; t < key.num_terms; t++){
+            basis->mat(s, t) = Zernike::Value(t + 1, static_cast<Zernike::Ordering>(key.ordering), rho, theta);
+        }
+    }
+
+    basis->qr.compute(basis->mat);
+
+    return basis;
+}
+
+}
+
+bool Zernike::Index(int j, Ordering ordering, int &n, int &m)
+{
+    n = 0;
+    m = 0;
+
+    if(j < 1 || (ordering == Fringe && j > 37)){
+        return false;
+    }
+
+    if(ordering == Fringe){
+        // the 12th order spherical term closes the set instead of starting the group k = 6
+        if(j == 37){
+            n = 12;
+            return true;
+        }
+
+        // the group k = (n + |m|)/2 starts at k^2 + 1, in descending |m| with the cosine term first
+        const int k = static_cast<int>(sqrt(static_cast<double>(j - 1)));
+        const int r = j - 1 - k*k;
+        const int abs_m = k - r/2;
+        n = 2*k - abs_m;
+        m = (r % 2 == 0) ? abs_m : -abs_m;
+    }else{
+        // the degree n holds n + 1 terms in ascending |m|, with the cosine terms at even j
+        n = static_cast<int>((sqrt(8.0*j - 7.0) - 1.0)/2.0);
+        const int k = j - n*(n + 1)/2 - 1;
+        const int abs_m = (n % 2 == 0) ? 2*((k + 1)/2) : 2*(k/2) + 1;
+        m = (abs_m == 0 || j % 2 == 0) ? abs_m : -abs_m;
+    }
+
+    return true;
+}
+
+double Zernike::Value(int j, Ordering ordering, double rho, double theta)
+{
+    int n, m;
+    if( !Index(j, ordering, n, m) ){
+        return NAN;
+    }
+
+    const int abs_m = std::abs(m);
+    double val = radial(n, abs_m, rho);
+
+    if(m > 0){
+        val *= cos(abs_m*theta);
+    }else if(m < 0){
+        val *= sin(abs_m*theta);
+    }
+
+    if(ordering == Noll){
+        val *= (m == 0) ? sqrt(n + 1.0) : sqrt(2.0*(n + 1.0));
+    }
+
+    return val;
+}
+
+ZernikeFit::ZernikeFit(OpticalSystem *opt_sys) :
+    WaveAberration(opt_sys),
+    ordering_(Zernike::Fringe),
+    num_terms_(37)
+{
+
+}
+
+ZernikeFit::~ZernikeFit()
+{
+
+}
+
+ZernikeCoefficients ZernikeFit::Fit(const Field *fld, double wvl, int nrd)
+{
+    const PupilSampling sampling = PupilSampling::Grid(nrd);
+    auto wf = pupil_wavefront(fld, wvl, sampling);
+
+    const double convert_to_waves = 1.0/(wvl*1.0e-6);
+
+    return fit(sampling, wf->mask, wf->opd*convert_to_waves);
+}
+
+ZernikeCoefficients ZernikeFit::Fit(const Eigen::MatrixXd &opd) const
+{
+    const Eigen::Array<bool, Eigen::Dynamic, Eigen::Dynamic> mask = opd.array().isFinite();
+
+    return fit(PupilSampling::Grid(opd.cols()), mask, opd);
+}
+
+ZernikeCoefficients ZernikeFit::fit(const PupilSampling &sampling, const Eigen::Array<bool, Eigen::Dynamic, Eigen::Dynamic> &mask, const Eigen::MatrixXd &opd) const
+{
+    ZernikeCoefficients result;
+    result.ordering = ordering_;
+    result.rms = 0.0;
+    result.pv = 0.0;
+    result.fit_rms = 0.0;
+    result.num_samples = 0;
+
+    int n, m;
+    if( !Zernike::Index(num_terms_, ordering_, n, m) ){
+        std::cerr << "ZernikeFit: " << num_terms_ << " terms are out of the ordering" << std::endl;
+        return result;
+    }
+
+    result.coefs.assign(num_terms_, 0.0);
+
+    BasisKey key;
+    key.ordering = ordering_;
+    key.num_terms = num_terms_;
+    key.nx = sampling.nx;
+    key.ny = sampling.ny;
+    key.grid = {sampling.start_x, sampling.step_x, sampling.start_y, sampling.step_y};
+    key.mask.resize(mask.size());
+
+    int num_samples = 0;
+    for(Eigen::Index k = 0; k < mask.size(); k++){
+        key.mask[k] = mask(k) && std::isfinite(opd(k));
+        num_samples += key.mask[k];
+    }
+
+    if(num_samples < num_terms_){
+        std::cerr << "ZernikeFit: " << num_samples << " samples are too few for " << num_terms_ << " terms" << std::endl;
+        return result;
+    }
+
+    std::shared_ptr<const Basis> basis;
+    {
+        std::lock_guard<std::mutex> lock(basis_mutex);
+        auto it = basis_entries.find(key);
+        if(it != basis_entries.end()){
+            it->second.last_access = ++access_count;
+            basis = it->second.basis;
+        }
+    }
+
+    if( !basis ){
+        basis = create_basis(key, sampling);
+
+        std::lock_guard<std::mutex> lock(basis_mutex);
+        auto inserted = basis_entries.emplace(key, BasisEntry{basis, 0});
+        inserted.first->second.last_access = ++access_count;
+        basis = inserted.first->second.basis;
+        evict();
+    }
+
+    Eigen::VectorXd w(num_samples);
+    for(int s = 0; s < num_samples; s++){
+        w(s) = opd(basis->sample_index[s]);
+    }
+
+    const Eigen::VectorXd coefs = basis->qr.solve(w);
+    const Eigen::VectorXd residual = w - basis->mat*coefs;
+
+    for(int t = 0; t < num_terms_; t++){
+        result.coefs[t] = coefs(t);
+    }
+
+    result.rms = sqrt((w.array() - w.mean()).square().mean());
+    result.pv = w.maxCoeff() - w.minCoeff();
+    result.fit_rms = sqrt(residual.squaredNorm()/num_samples);
+    result.num_samples = num_samples;
+
+    return result;
+}
+
+Eigen::MatrixXd ZernikeFit::Evaluate(const ZernikeCoefficients &coefs, const PupilSampling &sampling)
+{
+    Eigen::MatrixXd opd = Eigen::MatrixXd::Constant(sampling.ny, sampling.nx, NAN);
+
+    const int num_terms = coefs.coefs.size();
+    std::vector<Term> terms;
+    int max_n = 0;
+    int n, m;
+    if(num_terms > 0 && !Zernike::Index(num_terms, coefs.ordering, n, m)){
+        std::cerr << "ZernikeFit: " << num_terms << " terms are out of the ordering" << std::endl;
+        return opd;
+    }
+
+    for(int t = 0; t < num_terms; t++){
+        terms.push_back(make_term(t + 1, coefs.ordering));
+        max_n = std::max(max_n, terms.back().n);
+    }
+
+    Parallel::For(0, sampling.ny, [&](int i){
+        std::vector<double> rho_pow(max_n + 1);
+        std::vector<double> cos_m(max_n + 1), sin_m(max_n + 1);
+
+        for(int j = 0; j < sampling.nx; j++){
+            const Eigen::Vector2d pupil = sampling.PupilCoordinate(i, j);
+            const double rho = pupil.norm();
+            if(rho > 1.0){
+                continue;
+            }
+
+            // cos(p*theta) and sin(p*theta) by the powers of the unit complex number
+            const double c = (rho > 0.0) ? pupil(0)/rho : 1.0;
+            const double s = (rho > 0.0) ? pupil(1)/rho : 0.0;
+
+            rho_pow[0] = 1.0;
+            cos_m[0] = 1.0;
+            sin_m[0] = 0.0;
+            for(int p = 1; p <= max_n; p++){
+                rho_pow[p] = rho_pow[p - 1]*rho;
+                cos_m[p] = cos_m[p - 1]*c - sin_m[p - 1]*s;
+                sin_m[p] = sin_m[p - 1]*c + cos_m[p - 1]*s;
+            }
+
+            double val = 0.0;
+            for(int t = 0; t < num_terms; t++){
+                const Term& term = terms[t];
+
+                double r = 0.0;
+                for(size_t k = 0; k < term.radial_coefs.size(); k++){
+                    r += term.radial_coefs[k]*rho_pow[term.n - 2*k];
+                }
+
+                if(term.sign_m > 0){
+                    r *= cos_m[term.abs_m];
+                }else if(term.sign_m < 0){
+                    r *= sin_m[term.abs_m];
+                }
+
+                val += coefs.coefs[t]*r;
+            }
+
+            opd(i, j) = val;
+        }
+    });
+
+    return opd;
+}
+
+void ZernikeFit::SetCacheCapacity(int n)
+{
+    std::lock_guard<std::mutex> lock(basis_mutex);
+    capacity = std::max(0, n);
+    evict();
+}
+
+int ZernikeFit::NumberOfCachedBases()
+{
+    std::lock_guard<std::mutex> lock(basis_mutex);
+    return basis_entries.size();
+}
+
+void ZernikeFit::ClearCache()
+{
+    std::lock_guard<std::mutex> lock(basis_mutex);
+    basis_entries.clear();
+}
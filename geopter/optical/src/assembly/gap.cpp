@@ -46,6 +46,16 @@ Gap::Gap(double t, std::shared_ptr<Material> m){
     solve_ = std::make_unique<FixedSolve>();
 }
 
+Gap::Gap(const Gap &other) :
+    thi_(other.thi_),
+    material_(other.material_),
+    gap_index_(other.gap_index_)
+{
+    if(other.solve_){
+        solve_ = other.solve_->Clone();
+    }
+}
+
 Gap::~Gap()
 {
     material_ = nullptr;
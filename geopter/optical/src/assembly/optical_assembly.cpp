@@ -62,17 +62,20 @@ void OpticalAssembly::UpdateTransforms()
 void OpticalAssembly::UpdateSolve()
 {
     const int num_srfs = interfaces_.size();
+    const int num_gaps = gaps_.size();
 
     // update gap index
-    for(int i = 0; i < num_gaps_; i++){
-        gaps_[i]->SetGapIndex(i);
+    for(int i = 0; i < num_gaps; i++){
+        if(gaps_[i]->GetGapIndex() != i){
+            this->GetGap(i)->SetGapIndex(i);
+        }
     }
 
     for(int i = 0; i < num_srfs; i++){
-        if(this->GetSurface(i)->HasSolve()){
+        if(interfaces_[i]->HasSolve()){
             this->GetSurface(i)->GetSolve()->Apply(parent_);
         }
-        if(this->GetGap(i)->HasSolve()){
+        if(gaps_[i]->HasSolve()){
             this->GetGap(i)->GetSolve()->Apply(parent_);
         }
     }
@@ -87,10 +90,8 @@ void OpticalAssembly::UpdateSemiDiameters()
     constexpr int num_ref_rays = 5;
 
 
-    // initialize all surface
-    for(int si = 0; si < num_surfs_; si++) {
-        this->GetSurface(si)->SetSemiDiameter(0.0);
-    }
+    // computed in a local array, so that the surfaces whose semi-diameter does not change are left shared
+    std::vector<double> semi_diameters(num_surfs_, 0.0);
 
     // update semi diameter
     std::vector< std::shared_ptr<Ray> > ref_rays;
@@ -132,16 +133,20 @@ void OpticalAssembly::UpdateSemiDiameters()
 
             double ray_ht_for_cur_fld = *std::max_element(ray_ht_list.begin(), ray_ht_list.end());
 
-            double current_sd = this->GetSurface(si)->SemiDiameter();
-
-            if(current_sd < ray_ht_for_cur_fld) {
-                this->GetSurface(si)->SetSemiDiameter(ray_ht_for_cur_fld);
+            if(semi_diameters[si] < ray_ht_for_cur_fld) {
+                semi_diameters[si] = ray_ht_for_cur_fld;
             }
 
         }
 
     }
 
+    for(int si = 0; si < num_surfs_; si++) {
+        if(interfaces_[si]->SemiDiameter() != semi_diameters[si]){
+            this->GetSurface(si)->SetSemiDiameter(semi_diameters[si]);
+        }
+    }
+
     delete tracer;
 }
 
@@ -171,29 +176,29 @@ void OpticalAssembly::CreateMinimumAssembly()
     Clear();
 
     // add object interface and gap
-    auto s_obj = std::make_unique<Surface>();
+    auto s_obj = std::make_shared<Surface>();
     interfaces_.push_back(std::move(s_obj));
 
     //auto air = std::make_shared<Air>();
     auto air = MaterialLibrary::GetAir();
-    auto g = std::make_unique<Gap>(0.0, air);
+    auto g = std::make_shared<Gap>(0.0, air);
     gaps_.push_back(std::move(g));
 
     // add stop interface and gap
-    auto s_stop = std::make_unique<Surface>();
+    auto s_stop = std::make_shared<Surface>();
     interfaces_.push_back(std::move(s_stop));
 
-    auto g_stop = std::make_unique<Gap>(0.0, air);
+    auto g_stop = std::make_shared<Gap>(0.0, air);
     gaps_.push_back(std::move(g_stop));
 
     stop_index_ = 1;
 
 
     // add image interface and dummy gap
-    auto s_img = std::make_unique<Surface>();
+    auto s_img = std::make_shared<Surface>();
     interfaces_.push_back(std::move(s_img));
 
-    auto g_img = std::make_unique<Gap>(0.0, air);
+    auto g_img = std::make_shared<Gap>(0.0, air);
     gaps_.push_back(std::move(g_img));
 
     current_surface_index_ = 2;
@@ -202,7 +207,18 @@ void OpticalAssembly::CreateMinimumAssembly()
 }
 
 
-Gap* OpticalAssembly::ImageSpaceGap() const
+Gap* OpticalAssembly::ImageSpaceGap()
+{
+    if(gaps_.empty()){
+        return nullptr;
+    }else{
+        int num_gaps = gaps_.size();
+        return this->GetGap(num_gaps-1-1);
+    }
+
+}
+
+const Gap* OpticalAssembly::ImageSpaceGap() const
 {
     if(gaps_.empty()){
         return nullptr;
@@ -213,13 +229,35 @@ Gap* OpticalAssembly::ImageSpaceGap() const
 
 }
 
+void OpticalAssembly::CopyFrom(const OpticalAssembly &other)
+{
+    interfaces_ = other.interfaces_;
+    gaps_       = other.gaps_;
+
+    stop_index_            = other.stop_index_;
+    current_surface_index_ = other.current_surface_index_;
+    num_surfs_             = other.num_surfs_;
+}
+
+int OpticalAssembly::NumberOfSharedComponents() const
+{
+    int count = 0;
+    for(auto& s : interfaces_){
+        if(s.use_count() > 1) count++;
+    }
+    for(auto& g : gaps_){
+        if(g.use_count() > 1) count++;
+    }
+    return count;
+}
+
 void OpticalAssembly::Insert(int i)
 {
     if( i < 0){ //append
-        auto s = std::make_unique<Surface>();
+        auto s = std::make_shared<Surface>();
         interfaces_.push_back(std::move(s));
 
-        auto g = std::make_unique<Gap>();
+        auto g = std::make_shared<Gap>();
         gaps_.push_back(std::move(g));
 
         current_surface_index_ = interfaces_.size() -1;
@@ -253,7 +291,7 @@ void OpticalAssembly::Insert(int i, double r, double t, const std::string &mat_n
     }
 
     // insert the surface
-    auto s = std::make_unique<Surface>();
+    auto s = std::make_shared<Surface>();
     s->Profile<Spherical>()->SetRadius(r);
 
     if(is_appending){
@@ -269,7 +307,7 @@ void OpticalAssembly::Insert(int i, double r, double t, const std::string &mat_n
     auto m = MaterialLibrary::Find(mat_name);
 
     // insert the gap
-    auto g = std::make_unique<Gap>(t,m);
+    auto g = std::make_shared<Gap>(t,m);
 
     if(is_appending){
         gaps_.push_back(std::move(g));
@@ -326,7 +364,11 @@ void OpticalAssembly::SetLocalTransforms()
         t(2) = gaps_[i]->Thickness();
         tfrm.rotation = r;
         tfrm.transfer = t;
-        interfaces_[i]->SetLocalTransform(tfrm);
+
+        const Transformation& cur = interfaces_[i]->LocalTransform();
+        if(cur.rotation != tfrm.rotation || cur.transfer != tfrm.transfer){
+            this->GetSurface(i)->SetLocalTransform(tfrm);
+        }
     }
 }
 
@@ -342,7 +384,7 @@ void OpticalAssembly::SetGlobalTransforms(int ref_srf)
     // ref
     tfrm.rotation = Eigen::Matrix3d::Identity(3,3);
     tfrm.transfer = Eigen::Vector3d::Zero(3);
-    interfaces_[ref_srf]->SetGlobalTransform(tfrm);
+    set_global_transform(ref_srf, tfrm);
 
     // s0..ref-1
     for (int i = 0; i < ref_srf; i++) {
@@ -356,7 +398,7 @@ void OpticalAssembly::SetGlobalTransforms(int ref_srf)
 
         tfrm.rotation = global_rot;
         tfrm.transfer = transfer_ref_to_cur;
-        interfaces_[i]->SetGlobalTransform(tfrm);
+        set_global_transform(i, tfrm);
     }
 
     // ref+1..last
@@ -370,12 +412,20 @@ void OpticalAssembly::SetGlobalTransforms(int ref_srf)
         }
         tfrm.rotation = global_rot;
         tfrm.transfer = transfer_ref_to_cur;
-        interfaces_[i]->SetGlobalTransform(tfrm);
+        set_global_transform(i, tfrm);
+    }
+}
+
+void OpticalAssembly::set_global_transform(int i, const Transformation &tfrm)
+{
+    const Transformation& cur = interfaces_[i]->GlobalTransform();
+    if(cur.rotation != tfrm.rotation || cur.transfer != tfrm.transfer){
+        this->GetSurface(i)->SetGlobalTransform(tfrm);
     }
 }
 
 
-double OpticalAssembly::OverallLength(int start, int end)
+double OpticalAssembly::OverallLength(int start, int end) const
 {
     assert(start <= end);
 
@@ -34,6 +34,7 @@ Surface::Surface()
 {
     label_ = "";
     interact_mode_ = "Transmit";
+    semi_diameter_ = 0.0;
     lcl_tfrm_.rotation = Eigen::Matrix3d::Identity(3,3);
     lcl_tfrm_.transfer = Eigen::Vector3d::Zero(3);
 
@@ -47,6 +48,23 @@ Surface::Surface()
     decenter_ = nullptr;
 }
 
+Surface::Surface(const Surface& other) :
+    label_(other.label_),
+    interact_mode_(other.interact_mode_),
+    semi_diameter_(other.semi_diameter_),
+    profile_(other.profile_),
+    clear_aperture_(other.clear_aperture_),
+    lcl_tfrm_(other.lcl_tfrm_),
+    gbl_tfrm_(other.gbl_tfrm_)
+{
+    if(other.decenter_){
+        decenter_ = std::make_unique<DecenterData>(*other.decenter_);
+    }
+    if(other.solve_){
+        solve_ = other.solve_->Clone();
+    }
+}
+
 
 Surface::~Surface()
 {
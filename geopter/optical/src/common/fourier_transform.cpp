@@ -0,0 +1,319 @@
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "common/fourier_transform.h"
+#include "common/parallel.h"
+#include "unsupported/Eigen/FFT"
+
+using namespace geopter;
+
+namespace {
+
+/** Precomputed tables of a power of two size */
+struct Plan
+{
+    int n;
+    std::vector<int> bit_reversed;
+
+    /** exp(-2*pi*i*k/n) for k < n/2 */
+    std::vector<double> twiddle_re;
+    std::vector<double> twiddle_im;
+};
+
+using PlanPtr = std::shared_ptr<const Plan>;
+
+std::mutex plan_mutex;
+std::unordered_map<int, PlanPtr> plans;
+
+PlanPtr create_plan(int n)
+{
+    auto plan = std::make_shared<Plan>();
+    plan->n = n;
+
+    int num_bits = 0;
+    while((1 << num_bits) < n){
+        num_bits++;
+    }
+
+    plan->bit_reversed.resize(n);
+    for(int i = 0; i < n; i++){
+        int r = 0;
+        for(int b = 0; b < num_bits; b++){
+            r |= ((i >> b) & 1) << (num_bits - 1 - b);
+        }
+        plan->bit_reversed[i] = r;
+    }
+
+    plan->twiddle_re.resize(n/2);
+    plan->twiddle_im.resize(n/2);
+    for(int k = 0; k < n/2; k++){
+        const double phi = -2.0*M_PI*k/n;
+        plan->twiddle_re[k] = cos(phi);
+        plan->twiddle_im[k] = sin(phi);
+    }
+
+    return plan;
+}
+
+/** Cached plan of power of two size, or null for other sizes */
+PlanPtr get_plan(int n)
+{
+    if( !FourierTransform::IsPowerOfTwo(n) ){
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(plan_mutex);
+    auto it = plans.find(n);
+    if(it != plans.end()){
+        return it->second;
+    }
+
+    PlanPtr plan = create_plan(n);
+    plans[n] = plan;
+    return plan;
+}
+
+void radix2(std::complex<double>* data, const Plan& plan, bool inverse)
+{
+    const int n = plan.n;
+
+    for(int i = 0; i < n; i++){
+        const int j = plan.bit_reversed[i];
+        if(i < j){
+            std::swap(data[i], data[j]);
+        }
+    }
+
+    // std::complex is layout compatible with double[2]; the products are written out to avoid the NaN checks of operator*
+    double* a = reinterpret_cast<double*>(data);
+    const double sign = inverse ? -1.0 : 1.0;
+
+    for(int len = 2; len <= n; len <<= 1){
+        const int half = len >> 1;
+        const int step = n/len;
+
+        for(int i = 0; i < n; i += len){
+            for(int k = 0; k < half; k++){
+                const double wr = plan.twiddle_re[k*step];
+                const double wi = sign*plan.twiddle_im[k*step];
+
+                double* u = a + 2*(i + k);
+                double* v = a + 2*(i + k + half);
+
+                const double tr = v[0]*wr - v[1]*wi;
+                const double ti = v[0]*wi + v[1]*wr;
+
+                v[0] = u[0] - tr;
+                v[1] = u[1] - ti;
+                u[0] += tr;
+                u[1] += ti;
+            }
+        }
+    }
+}
+
+/** Unscaled transform, by the cached plan if available */
+void transform(std::complex<double>* data, int n, const Plan* plan, bool inverse)
+{
+    if(plan){
+        radix2(data, *plan, inverse);
+        return;
+    }
+
+    // Eigen::FFT keeps its own plans, but is not thread safe
+    thread_local Eigen::FFT<double> fft;
+    fft.SetFlag(Eigen::FFT<double>::Unscaled);
+
+    std::vector< std::complex<double> > src(data, data + n);
+    if(inverse){
+        fft.inv(data, src.data(), n);
+    }else{
+        fft.fwd(data, src.data(), n);
+    }
+}
+
+int resolve_threads(int num_threads, Eigen::Index size)
+{
+    if(num_threads > 0){
+        return num_threads;
+    }
+
+    // thread start up costs more than small transforms
+    constexpr Eigen::Index min_parallel_size = 128*128;
+    return (size >= min_parallel_size) ? Parallel::NumberOfThreads() : 1;
+}
+
+/** Number of rows or columns handed to a thread at once */
+constexpr int chunk_size = 8;
+
+void transform_columns(Eigen::MatrixXcd& mat, Eigen::Index col_begin, bool inverse, int num_threads)
+{
+    const int rows = mat.rows();
+    const int num_cols = mat.cols() - col_begin;
+    const PlanPtr plan = get_plan(rows);
+
+    const int num_chunks = (num_cols + chunk_size - 1)/chunk_size;
+
+    Parallel::For(0, num_chunks, [&](int ci){
+        const int end = std::min(num_cols, (ci + 1)*chunk_size);
+        for(int c = ci*chunk_size; c < end; c++){
+            transform(mat.col(col_begin + c).data(), rows, plan.get(), inverse);
+        }
+    }, num_threads);
+}
+
+void transform_rows(Eigen::MatrixXcd& mat, bool inverse, int num_threads)
+{
+    const int rows = mat.rows();
+    const int cols = mat.cols();
+    const PlanPtr plan = get_plan(cols);
+
+    const int num_chunks = (rows + chunk_size - 1)/chunk_size;
+
+    Parallel::For(0, num_chunks, [&](int ci){
+        const int row_begin = ci*chunk_size;
+        const int num_rows = std::min(rows - row_begin, chunk_size);
+
+        // rows are strided in the column major storage, so a block of them is gathered column by column
+        std::vector< std::complex<double> > buf(num_rows*cols);
+
+        for(int c = 0; c < cols; c++){
+            for(int r = 0; r < num_rows; r++){
+                buf[r*cols + c] = mat(row_begin + r, c);
+            }
+        }
+
+        for(int r = 0; r < num_rows; r++){
+            transform(buf.data() + r*cols, cols, plan.get(), inverse);
+        }
+
+        for(int c = 0; c < cols; c++){
+            for(int r = 0; r < num_rows; r++){
+                mat(row_begin + r, c) = buf[r*cols + c];
+            }
+        }
+    }, num_threads);
+}
+
+}
+
+void FourierTransform::Forward(std::complex<double> *data, int n)
+{
+    const PlanPtr plan = get_plan(n);
+    transform(data, n, plan.get(), false);
+}
+
+void FourierTransform::Inverse(std::complex<double> *data, int n)
+{
+    const PlanPtr plan = get_plan(n);
+    transform(data, n, plan.get(), true);
+
+    const double scale = 1.0/n;
+    for(int i = 0; i < n; i++){
+        data[i] *= scale;
+    }
+}
+
+void FourierTransform::Forward2(Eigen::MatrixXcd &mat, int num_threads)
+{
+    num_threads = resolve_threads(num_threads, mat.size());
+    transform_columns(mat, 0, false, num_threads);
+    transform_rows(mat, false, num_threads);
+}
+
+void FourierTransform::Inverse2(Eigen::MatrixXcd &mat, int num_threads)
+{
+    num_threads = resolve_threads(num_threads, mat.size());
+    transform_columns(mat, 0, true, num_threads);
+    transform_rows(mat, true, num_threads);
+    mat /= static_cast<double>(mat.size());
+}
+
+void FourierTransform::Forward2(Eigen::MatrixXcd &out, const Eigen::MatrixXd &in, int num_threads)
+{
+    const int rows = in.rows();
+    const int cols = in.cols();
+
+    out.resize(rows, cols);
+    num_threads = resolve_threads(num_threads, in.size());
+
+    const PlanPtr plan = get_plan(rows);
+    const int num_pairs = cols/2;
+
+    // z = x + iy has Z(k) = X(k) + iY(k), and X, Y are recovered from the hermitian symmetry of real input
+    Parallel::For(0, (num_pairs + chunk_size - 1)/chunk_size, [&](int ci){
+        std::vector< std::complex<double> > z(rows);
+        const int end = std::min(num_pairs, (ci + 1)*chunk_size);
+
+        for(int p = ci*chunk_size; p < end; p++){
+            const int cx = 2*p;
+            const int cy = 2*p + 1;
+
+            for(int r = 0; r < rows; r++){
+                z[r] = std::complex<double>(in(r, cx), in(r, cy));
+            }
+
+            transform(z.data(), rows, plan.get(), false);
+
+            for(int k = 0; k < rows; k++){
+                const std::complex<double> zk = z[k];
+                const std::complex<double> zc = std::conj(z[(rows - k) % rows]);
+                out(k, cx) = 0.5*(zk + zc);
+                out(k, cy) = std::complex<double>(0.0, -0.5)*(zk - zc);
+            }
+        }
+    }, num_threads);
+
+    // the last column of odd width has no partner
+    if(cols % 2 == 1){
+        out.col(cols - 1) = in.col(cols - 1).cast< std::complex<double> >();
+        transform_columns(out, cols - 1, false, 1);
+    }
+
+    transform_rows(out, false, num_threads);
+}
+
+void FourierTransform::Matrix2(Eigen::MatrixXcd &out, const Eigen::MatrixXcd &in, const Eigen::VectorXd &freq_x, const Eigen::VectorXd &freq_y, int num_threads)
+{
+    const int rows = in.rows();
+    const int cols = in.cols();
+    const double ci = 0.5*(rows - 1);
+    const double cj = 0.5*(cols - 1);
+
+    // kernels, with the column kernel transposed for the right product
+    Eigen::MatrixXcd ey(freq_y.size(), rows);
+    for(int i = 0; i < rows; i++){
+        for(int m = 0; m < freq_y.size(); m++){
+            ey(m, i) = std::polar(1.0, -2.0*M_PI*freq_y(m)*(i - ci));
+        }
+    }
+
+    Eigen::MatrixXcd ex_t(cols, freq_x.size());
+    for(int n = 0; n < freq_x.size(); n++){
+        for(int j = 0; j < cols; j++){
+            ex_t(j, n) = std::polar(1.0, -2.0*M_PI*freq_x(n)*(j - cj));
+        }
+    }
+
+    out.resize(freq_y.size(), freq_x.size());
+    num_threads = resolve_threads(num_threads, out.size());
+
+    const int num_out_rows = out.rows();
+    const int num_chunks = (num_out_rows + chunk_size - 1)/chunk_size;
+
+    Parallel::For(0, num_chunks, [&](int chunk){
+        const int row_begin = chunk*chunk_size;
+        const int num_rows = std::min(num_out_rows - row_begin, chunk_size);
+        out.middleRows(row_begin, num_rows).noalias() = (ey.middleRows(row_begin, num_rows)*in)*ex_t;
+    }, num_threads);
+}
+
+void FourierTransform::ClearPlans()
+{
+    std::lock_guard<std::mutex> lock(plan_mutex);
+    plans.clear();
+}
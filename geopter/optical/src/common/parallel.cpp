@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "common/parallel.h"
+
+using namespace geopter;
+
+int Parallel::NumberOfThreads()
+{
+    return std::max(1, (int)std::thread::hardware_concurrency());
+}
+
+void Parallel::For(int begin, int end, const std::function<void(int)>& func, int num_threads)
+{
+    if(end <= begin){
+        return;
+    }
+
+    if(num_threads <= 0){
+        num_threads = NumberOfThreads();
+    }
+    num_threads = std::min(num_threads, end - begin);
+
+    if(num_threads == 1){
+        for(int i = begin; i < end; i++){
+            func(i);
+        }
+        return;
+    }
+
+    std::atomic<int> next(begin);
+
+    auto worker = [&](){
+        int i;
+        while( (i = next.fetch_add(1)) < end ){
+            func(i);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads - 1);
+    for(int ti = 0; ti < num_threads - 1; ti++){
+        threads.emplace_back(worker);
+    }
+
+    worker(); // calling thread takes part as well
+
+    for(auto& t : threads){
+        t.join();
+    }
+}
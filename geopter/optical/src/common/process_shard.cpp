@@ -0,0 +1,294 @@
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "common/process_shard.h"
+#include "common/parallel.h"
+
+using namespace geopter;
+
+namespace {
+
+const char* checkpoint_header = "# geopter process shard checkpoint";
+
+}
+
+ProcessShard::ProcessShard(int result_size) :
+    result_size_(result_size),
+    num_processes_(0),
+    num_threads_(0)
+{
+
+}
+
+ProcessShard::~ProcessShard()
+{
+
+}
+
+std::string ProcessShard::header(int num_jobs) const
+{
+    // "# geopter process shard checkpoint <num_jobs> <result_size> <fingerprint>"
+    std::ostringstream oss;
+    oss << checkpoint_header << " " << num_jobs << " " << result_size_ << " " << (fingerprint_.empty() ? "-" : fingerprint_);
+    return oss.str();
+}
+
+bool ProcessShard::read_checkpoint(std::vector<double> &results, std::vector<bool> &done, int num_jobs) const
+{
+    std::ifstream ifs(checkpoint_path_);
+    if(!ifs){
+        return false;
+    }
+
+    std::string line;
+    if( !std::getline(ifs, line) ){
+        return false;
+    }
+
+    if(line != header(num_jobs)){
+        std::cerr << "ProcessShard: checkpoint " << checkpoint_path_ << " belongs to another run, starting over" << std::endl;
+        return false;
+    }
+
+    while(std::getline(ifs, line)){
+        // a partially written last line has no line end
+        if(ifs.eof()){
+            break;
+        }
+
+        std::istringstream iss(line);
+        int job_index;
+        if( !(iss >> job_index) || job_index < 0 || job_index >= num_jobs ){
+            continue;
+        }
+
+        // strtod accepts inf and nan, which the stream extraction does not
+        std::vector<double> vals;
+        std::string token;
+        while(iss >> token){
+            vals.push_back(std::strtod(token.c_str(), nullptr));
+        }
+
+        if((int)vals.size() != result_size_){
+            continue;
+        }
+
+        std::copy(vals.begin(), vals.end(), results.begin() + job_index*result_size_);
+        done[job_index] = true;
+    }
+
+    return true;
+}
+
+void ProcessShard::write_record(std::ostream &os, int job_index, const double *result) const
+{
+    os << job_index;
+    for(int k = 0; k < result_size_; k++){
+        os << " " << std::setprecision(17) << result[k];
+    }
+    os << "\n";
+}
+
+int ProcessShard::Run(std::vector<double> &results, int num_jobs, const Job &job)
+{
+    results.assign(num_jobs*result_size_, NAN);
+    std::vector<bool> done(num_jobs, false);
+
+    std::ofstream checkpoint;
+    if( !checkpoint_path_.empty() ){
+        if( !read_checkpoint(results, done, num_jobs) ){
+            std::fill(results.begin(), results.end(), NAN);
+            std::fill(done.begin(), done.end(), false);
+        }
+
+        // rewritten with the restored records, which drops a partially written line
+        checkpoint.open(checkpoint_path_, std::ios::trunc);
+        if( !checkpoint ){
+            std::cerr << "ProcessShard: failed to open checkpoint " << checkpoint_path_ << std::endl;
+        }else{
+            checkpoint << header(num_jobs) << "\n";
+            for(int i = 0; i < num_jobs; i++){
+                if(done[i]){
+                    write_record(checkpoint, i, results.data() + i*result_size_);
+                }
+            }
+            checkpoint.flush();
+        }
+    }
+
+    std::vector<int> pending;
+    for(int i = 0; i < num_jobs; i++){
+        if( !done[i] ){
+            pending.push_back(i);
+        }
+    }
+
+    int num_done = num_jobs - pending.size();
+
+    std::mutex store_mutex;
+    auto store = [&](int job_index, const double* result){
+        std::lock_guard<std::mutex> lock(store_mutex);
+        std::copy(result, result + result_size_, results.begin() + job_index*result_size_);
+        if(checkpoint.is_open()){
+            write_record(checkpoint, job_index, result);
+            checkpoint.flush();
+        }
+        done[job_index] = true;
+        num_done++;
+    };
+
+    int num_procs = (num_processes_ <= 0) ? Parallel::NumberOfThreads() : num_processes_;
+    num_procs = std::min(num_procs, (int)pending.size());
+
+    // pending jobs from this position are run in the calling process
+    int local_begin = 0;
+
+#ifdef __linux__
+    if(num_procs > 1){
+        // record: job index followed by the result values
+        const size_t record_size = sizeof(int) + result_size_*sizeof(double);
+
+        struct Worker{
+            pid_t pid;
+            int fd;
+            std::vector<char> buffer;
+        };
+        std::vector<Worker> workers;
+
+        const int num_pending = pending.size();
+
+        for(int w = 0; w < num_procs; w++){
+            const int begin = (long)num_pending*w/num_procs;
+            const int end   = (long)num_pending*(w+1)/num_procs;
+
+            int fds[2];
+            if(pipe(fds) != 0){
+                std::cerr << "ProcessShard: failed to create pipe" << std::endl;
+                break;
+            }
+
+            pid_t pid = fork();
+            if(pid < 0){
+                std::cerr << "ProcessShard: failed to fork worker " << w << std::endl;
+                close(fds[0]);
+                close(fds[1]);
+                break;
+            }
+
+            if(pid == 0){
+                // worker
+                close(fds[0]);
+                for(auto& other : workers){
+                    close(other.fd);
+                }
+
+                std::vector<char> record(record_size);
+                std::vector<double> result(result_size_);
+                for(int k = begin; k < end; k++){
+                    const int job_index = pending[k];
+                    std::fill(result.begin(), result.end(), NAN);
+                    job(job_index, result.data());
+
+                    memcpy(record.data(), &job_index, sizeof(int));
+                    memcpy(record.data() + sizeof(int), result.data(), result_size_*sizeof(double));
+
+                    size_t written = 0;
+                    while(written < record_size){
+                        ssize_t n = write(fds[1], record.data() + written, record_size - written);
+                        if(n <= 0){
+                            _exit(1);
+                        }
+                        written += n;
+                    }
+                }
+                close(fds[1]);
+
+                // skip destructors and atexit handlers of the copied process state
+                _exit(0);
+            }
+
+            close(fds[1]);
+            workers.push_back(Worker{pid, fds[0], std::vector<char>()});
+            local_begin = end;
+        }
+
+        // collect results until all the pipes are closed
+        std::vector<char> chunk(64*record_size);
+        std::vector<double> result(result_size_);
+        int num_open = workers.size();
+
+        while(num_open > 0){
+            std::vector<pollfd> pfds;
+            std::vector<int> worker_indices;
+            for(int w = 0; w < (int)workers.size(); w++){
+                if(workers[w].fd >= 0){
+                    pfds.push_back(pollfd{workers[w].fd, POLLIN, 0});
+                    worker_indices.push_back(w);
+                }
+            }
+
+            if(poll(pfds.data(), pfds.size(), -1) < 0){
+                continue; // interrupted
+            }
+
+            for(int pi = 0; pi < (int)pfds.size(); pi++){
+                if( !(pfds[pi].revents & (POLLIN | POLLHUP | POLLERR)) ){
+                    continue;
+                }
+
+                Worker& worker = workers[worker_indices[pi]];
+                ssize_t n = read(worker.fd, chunk.data(), chunk.size());
+                if(n <= 0){
+                    close(worker.fd);
+                    worker.fd = -1;
+                    num_open--;
+                    continue;
+                }
+
+                worker.buffer.insert(worker.buffer.end(), chunk.begin(), chunk.begin() + n);
+
+                size_t offset = 0;
+                while(worker.buffer.size() - offset >= record_size){
+                    int job_index;
+                    memcpy(&job_index, worker.buffer.data() + offset, sizeof(int));
+                    memcpy(result.data(), worker.buffer.data() + offset + sizeof(int), result_size_*sizeof(double));
+                    store(job_index, result.data());
+                    offset += record_size;
+                }
+                worker.buffer.erase(worker.buffer.begin(), worker.buffer.begin() + offset);
+            }
+        }
+
+        for(auto& worker : workers){
+            int status = 0;
+            waitpid(worker.pid, &status, 0);
+            if( !WIFEXITED(status) || WEXITSTATUS(status) != 0 ){
+                std::cerr << "ProcessShard: worker " << worker.pid << " terminated abnormally" << std::endl;
+            }
+        }
+    }
+#endif
+
+    // remaining jobs, i.e. all of them with a single process or when no worker could be started
+    Parallel::For(local_begin, pending.size(), [&](int k){
+        std::vector<double> result(result_size_, NAN);
+        job(pending[k], result.data());
+        store(pending[k], result.data());
+    }, num_threads_);
+
+    done_ = done;
+
+    return num_done;
+}
@@ -48,14 +48,14 @@ std::shared_ptr<Air> MaterialLibrary::air_;
 
 MaterialLibrary::MaterialLibrary()
 {
-    air_ = std::make_shared<Air>();
-
+    if(!air_){
+        air_ = std::make_shared<Air>();
+    }
 }
 
 MaterialLibrary::~MaterialLibrary()
 {
-    air_.reset();
-    clear();
+    // catalogs are static and shared with cloned systems, keep them alive
 }
 
 void MaterialLibrary::clear()
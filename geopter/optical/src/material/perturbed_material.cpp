@@ -0,0 +1,27 @@
+#include "material/perturbed_material.h"
+
+using namespace geopter;
+
+PerturbedMaterial::PerturbedMaterial(std::shared_ptr<Material> base, double delta_nd, double abbe_scale) :
+    base_(base),
+    delta_nd_(delta_nd),
+    abbe_scale_(abbe_scale)
+{
+    n_ = base_->RefractiveIndex(SpectralLine::d) + delta_nd_;
+}
+
+PerturbedMaterial::~PerturbedMaterial()
+{
+
+}
+
+double PerturbedMaterial::RefractiveIndex(double wv_nm) const
+{
+    double nd = base_->RefractiveIndex(SpectralLine::d);
+    return n_ + (base_->RefractiveIndex(wv_nm) - nd)/abbe_scale_;
+}
+
+std::string PerturbedMaterial::Name() const
+{
+    return base_->Name();
+}
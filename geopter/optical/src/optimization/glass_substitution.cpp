@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "optimization/glass_substitution.h"
+#include "system/optical_system.h"
+#include "material/material_library.h"
+#include "material/glass_catalog.h"
+#include "paraxial/paraxial_trace.h"
+#include "spec/spectral_line.h"
+#include "common/parallel.h"
+
+using namespace geopter;
+
+GlassSubstitution::GlassSubstitution(const MeritFunction *merit, const LocalOptimizer *local_optimizer) :
+    merit_(merit),
+    local_optimizer_(local_optimizer),
+    max_candidates_(10),
+    nd_scale_(0.1),
+    vd_scale_(10.0),
+    efl_tolerance_(0.2),
+    axial_color_tolerance_(std::numeric_limits<double>::infinity()),
+    do_refocus_(true),
+    num_threads_(0)
+{
+
+}
+
+void GlassSubstitution::AddSubstitutableGap(int gap_index)
+{
+    gaps_.push_back(gap_index);
+}
+
+std::vector<GlassTrial> GlassSubstitution::Candidates(const OpticalSystem *opt_sys, int gap_index) const
+{
+    std::vector<GlassTrial> candidates;
+
+    const OpticalAssembly* assembly = opt_sys->GetOpticalAssembly();
+    Material* cur_mat = assembly->GetGap(gap_index)->GetMaterial();
+    const double nd0 = cur_mat->RefractiveIndex(SpectralLine::d);
+    const double vd0 = cur_mat->Abbe_d();
+
+    MaterialLibrary* material_lib = opt_sys->GetMaterialLib();
+    const int num_catalogs = material_lib->NumberOfCatalogs();
+
+    for(int ci = 0; ci < num_catalogs; ci++){
+        GlassCatalog* catalog = MaterialLibrary::GetGlassCatalog(ci);
+        const int num_glasses = catalog->NumberOfGlasses();
+
+        for(int gi = 0; gi < num_glasses; gi++){
+            std::shared_ptr<Glass> glass = catalog->GetGlass(gi);
+            if(glass->Name() == cur_mat->Name()){
+                continue;
+            }
+
+            double dn = (glass->RefractiveIndex(SpectralLine::d) - nd0)/nd_scale_;
+            double dv = (glass->Abbe_d() - vd0)/vd_scale_;
+            if(!std::isfinite(dn) || !std::isfinite(dv)){
+                continue;
+            }
+
+            GlassTrial trial;
+            trial.gap_index = gap_index;
+            trial.material = glass;
+            trial.distance = sqrt(dn*dn + dv*dv);
+            trial.merit = std::numeric_limits<double>::infinity();
+            trial.rejected = false;
+            candidates.push_back(trial);
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const GlassTrial& a, const GlassTrial& b){
+        return a.distance < b.distance;
+    });
+
+    if((int)candidates.size() > max_candidates_){
+        candidates.resize(max_candidates_);
+    }
+
+    return candidates;
+}
+
+std::vector<GlassTrial> GlassSubstitution::Run(const OpticalSystem *opt_sys) const
+{
+    std::vector<GlassTrial> trials;
+    for(int gi : gaps_){
+        auto candidates = Candidates(opt_sys, gi);
+        trials.insert(trials.end(), candidates.begin(), candidates.end());
+    }
+
+    // nominal values for the screening
+    auto nominal_sys = opt_sys->Clone();
+    const double efl0 = nominal_sys->GetFirstOrderData()->effective_focal_length;
+    const double axial_color0 = AxialColor(nominal_sys.get());
+
+    Parallel::For(0, trials.size(), [&](int i){
+        evaluate(trials[i], opt_sys, efl0, axial_color0);
+    }, num_threads_);
+
+    std::stable_sort(trials.begin(), trials.end(), [](const GlassTrial& a, const GlassTrial& b){
+        return a.merit < b.merit;
+    });
+
+    return trials;
+}
+
+void GlassSubstitution::evaluate(GlassTrial &trial, const OpticalSystem *opt_sys, double efl0, double axial_color0) const
+{
+    auto trial_sys = opt_sys->Clone();
+    trial_sys->GetOpticalAssembly()->GetGap(trial.gap_index)->SetMaterial(trial.material);
+    trial_sys->UpdateModel();
+
+    // cheap paraxial screening before any real ray is traced
+    if( !screen(trial_sys.get(), efl0, axial_color0) ){
+        trial.rejected = true;
+        return;
+    }
+
+    if(do_refocus_){
+        Refocus(trial_sys.get());
+    }
+
+    if(local_optimizer_){
+        trial.merit = local_optimizer_->Run(trial_sys.get());
+    }else{
+        trial.merit = merit_->Value(trial_sys.get());
+    }
+}
+
+bool GlassSubstitution::screen(OpticalSystem *opt_sys, double efl0, double axial_color0) const
+{
+    const double efl = opt_sys->GetFirstOrderData()->effective_focal_length;
+    if( !std::isfinite(efl) || fabs(efl/efl0 - 1.0) > efl_tolerance_ ){
+        return false;
+    }
+
+    if(std::isfinite(axial_color_tolerance_)){
+        double axial_color = AxialColor(opt_sys);
+        if( !std::isfinite(axial_color) || fabs(axial_color) - fabs(axial_color0) > axial_color_tolerance_ ){
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void GlassSubstitution::Apply(OpticalSystem *opt_sys, const GlassTrial &trial) const
+{
+    opt_sys->GetOpticalAssembly()->GetGap(trial.gap_index)->SetMaterial(trial.material);
+    opt_sys->UpdateModel();
+
+    if(do_refocus_){
+        Refocus(opt_sys);
+    }
+
+    if(local_optimizer_){
+        local_optimizer_->Run(opt_sys);
+    }
+}
+
+double GlassSubstitution::AxialColor(OpticalSystem *opt_sys)
+{
+    WavelengthSpec* wvl_spec = opt_sys->GetOpticalSpec()->GetWavelengthSpec();
+    FirstOrderData* fod = opt_sys->GetFirstOrderData();
+
+    ParaxialTrace prx_tracer(opt_sys);
+
+    // paraxial focus position measured from the last surface
+    auto focus = [&](double wvl){
+        auto ax_ray = prx_tracer.TraceParaxialRayFromObject(fod->reference_y0, fod->reference_u0, wvl);
+        const ParaxialRaySegment& seg = ax_ray->AtBeforeImage();
+        return -seg.y/seg.u_prime;
+    };
+
+    return focus(wvl_spec->LowerWavelength()) - focus(wvl_spec->HigherWavelength());
+}
+
+void GlassSubstitution::Refocus(OpticalSystem *opt_sys)
+{
+    const double ref_wvl = opt_sys->GetOpticalSpec()->GetWavelengthSpec()->ReferenceWavelength();
+    FirstOrderData* fod = opt_sys->GetFirstOrderData();
+
+    ParaxialTrace prx_tracer(opt_sys);
+    auto ax_ray = prx_tracer.TraceParaxialRayFromObject(fod->reference_y0, fod->reference_u0, ref_wvl);
+
+    const double u_prime = ax_ray->AtBeforeImage().u_prime;
+    if(fabs(u_prime) < std::numeric_limits<double>::epsilon()){
+        return;
+    }
+
+    const double defocus = -ax_ray->Back().y/u_prime;
+
+    Gap* img_gap = opt_sys->GetOpticalAssembly()->ImageSpaceGap();
+    img_gap->SetThickness(img_gap->Thickness() + defocus);
+    opt_sys->UpdateModel();
+}
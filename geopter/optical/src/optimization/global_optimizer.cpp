@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <iomanip>
+
+#include "optimization/global_optimizer.h"
+#include "system/optical_system.h"
+#include "material/material_library.h"
+#include "spec/spectral_line.h"
+#include "common/parallel.h"
+
+using namespace geopter;
+
+GlobalOptimizer::GlobalOptimizer(const LocalOptimizer *local_optimizer) :
+    local_optimizer_(local_optimizer),
+    seed_(0),
+    num_starts_(16),
+    num_hops_(4),
+    step_(0.1),
+    temperature_(0.1),
+    num_threads_(0),
+    max_results_(20)
+{
+
+}
+
+void GlobalOptimizer::AddGlassVariable(int gap_index)
+{
+    glass_gaps_.push_back(gap_index);
+}
+
+void GlobalOptimizer::Run(const OpticalSystem *opt_sys)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        results_.clear();
+    }
+
+    Parallel::For(0, num_starts_, [&](int start_index){
+        run_start(opt_sys, start_index);
+    }, num_threads_);
+}
+
+void GlobalOptimizer::run_start(const OpticalSystem *opt_sys, int start_index)
+{
+    std::seed_seq seq{seed_, (unsigned int)start_index};
+    std::mt19937_64 rng(seq);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    auto cur_sys = opt_sys->Clone();
+
+    // the first start descends from the given system as it is
+    if(start_index > 0){
+        perturb(cur_sys.get(), rng);
+    }
+
+    double cur_merit = local_optimizer_->Run(cur_sys.get());
+    if(std::isfinite(cur_merit)){
+        submit(make_result(cur_sys.get(), cur_merit, start_index));
+    }
+
+    for(int hop = 0; hop < num_hops_; hop++){
+        auto trial_sys = cur_sys->Clone();
+        perturb(trial_sys.get(), rng);
+
+        double trial_merit = local_optimizer_->Run(trial_sys.get());
+        if( !std::isfinite(trial_merit) ){
+            continue;
+        }
+
+        submit(make_result(trial_sys.get(), trial_merit, start_index));
+
+        bool accept = false;
+        if( !std::isfinite(cur_merit) || trial_merit < cur_merit ){
+            accept = true;
+        }else if(temperature_ > 0.0){
+            double t = temperature_*std::max(cur_merit, std::numeric_limits<double>::min());
+            accept = ( uniform(rng) < exp(-(trial_merit - cur_merit)/t) );
+        }
+
+        if(accept){
+            cur_sys = std::move(trial_sys);
+            cur_merit = trial_merit;
+        }
+    }
+}
+
+void GlobalOptimizer::perturb(OpticalSystem *opt_sys, std::mt19937_64 &rng) const
+{
+    std::normal_distribution<double> normal(0.0, 1.0);
+
+    const std::vector<SystemParameter>& vars = local_optimizer_->Variables();
+    const int num_vars = vars.size();
+
+    for(int i = 0; i < num_vars; i++){
+        double x = vars[i].Value(opt_sys);
+        double scale;
+
+        switch (vars[i].GetType()) {
+        case SystemParameter::Curvature:
+            scale = std::max(fabs(x), 1.0e-2);
+            break;
+        case SystemParameter::Thickness:
+            scale = std::max(fabs(x), 1.0);
+            break;
+        default:
+            scale = std::max(fabs(x), 1.0e-1);
+            break;
+        }
+
+        double lower = local_optimizer_->LowerBound(i);
+        double upper = local_optimizer_->UpperBound(i);
+        double x_new = x + step_*scale*normal(rng);
+        x_new = std::min(std::max(x_new, lower), upper);
+
+        vars[i].SetValue(opt_sys, x_new);
+    }
+
+    // model glasses
+    for(int gi : glass_gaps_){
+        Gap* gap = opt_sys->GetOpticalAssembly()->GetGap(gi);
+        double nd = gap->GetMaterial()->RefractiveIndex(SpectralLine::d);
+        double nF = gap->GetMaterial()->RefractiveIndex(SpectralLine::F);
+        double nC = gap->GetMaterial()->RefractiveIndex(SpectralLine::C);
+        double vd = (nd - 1.0)/(nF - nC);
+
+        nd = std::min(std::max(nd + step_*0.1*normal(rng), 1.45), 2.0);
+        vd = std::min(std::max(vd + step_*15.0*normal(rng), 20.0), 95.0);
+
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(5) << nd << ":" << std::setprecision(2) << vd;
+        gap->SetMaterial(MaterialLibrary::Find(oss.str()));
+    }
+
+    opt_sys->UpdateModel();
+}
+
+OptimizationResult GlobalOptimizer::make_result(OpticalSystem *opt_sys, double merit, int start_index) const
+{
+    OptimizationResult result;
+    result.merit = merit;
+    result.values = local_optimizer_->GetValues(opt_sys);
+    const OpticalAssembly* assembly = opt_sys->GetOpticalAssembly();
+    for(int gi : glass_gaps_){
+        result.glasses.push_back(assembly->GetGap(gi)->GetMaterial()->Name());
+    }
+    result.fingerprint = fingerprint(result.values, result.glasses);
+    result.start_index = start_index;
+
+    return result;
+}
+
+std::string GlobalOptimizer::fingerprint(const Eigen::VectorXd &values, const std::vector<std::string> &glasses) const
+{
+    std::ostringstream oss;
+    oss << std::setprecision(4);
+    for(int i = 0; i < values.size(); i++){
+        // avoid "-0" and "0" being different
+        double v = (fabs(values(i)) < 1.0e-12) ? 0.0 : values(i);
+        oss << v << ";";
+    }
+    for(auto& g : glasses){
+        oss << g << ";";
+    }
+    return oss.str();
+}
+
+void GlobalOptimizer::submit(const OptimizationResult &result)
+{
+    auto better = [](const OptimizationResult& a, const OptimizationResult& b){
+        if(a.merit != b.merit) return a.merit < b.merit;
+        return a.start_index < b.start_index;
+    };
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto itr = std::find_if(results_.begin(), results_.end(), [&](const OptimizationResult& r){
+        return r.fingerprint == result.fingerprint;
+    });
+
+    if(itr != results_.end()){
+        if( better(result, *itr) ){
+            *itr = result;
+        }else{
+            return;
+        }
+    }else{
+        results_.push_back(result);
+    }
+
+    std::sort(results_.begin(), results_.end(), better);
+
+    if((int)results_.size() > max_results_){
+        results_.resize(max_results_);
+    }
+}
+
+OptimizationResult GlobalOptimizer::Best() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if(results_.empty()){
+        OptimizationResult empty;
+        empty.merit = std::numeric_limits<double>::infinity();
+        empty.start_index = -1;
+        return empty;
+    }
+    return results_.front();
+}
+
+std::vector<OptimizationResult> GlobalOptimizer::Results() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return results_;
+}
+
+void GlobalOptimizer::Apply(OpticalSystem *opt_sys, const OptimizationResult &result) const
+{
+    const int num_glasses = std::min(glass_gaps_.size(), result.glasses.size());
+    for(int i = 0; i < num_glasses; i++){
+        auto mat = MaterialLibrary::Find(result.glasses[i]);
+        if(mat){
+            opt_sys->GetOpticalAssembly()->GetGap(glass_gaps_[i])->SetMaterial(mat);
+        }
+    }
+
+    local_optimizer_->SetValues(opt_sys, result.values);
+}
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Eigen/Dense"
+
+#include "optimization/local_optimizer.h"
+#include "system/optical_system.h"
+
+using namespace geopter;
+
+LocalOptimizer::LocalOptimizer(const MeritFunction *merit, const std::vector<SystemParameter> &variables) :
+    merit_(merit),
+    variables_(variables),
+    max_iter_(50)
+{
+    const int num_vars = variables_.size();
+    lower_.resize(num_vars, -std::numeric_limits<double>::infinity());
+    upper_.resize(num_vars,  std::numeric_limits<double>::infinity());
+
+    for(int i = 0; i < num_vars; i++){
+        if(variables_[i].GetType() == SystemParameter::Thickness){
+            lower_[i] = 0.0;
+        }
+    }
+}
+
+void LocalOptimizer::SetBounds(int i, double lower, double upper)
+{
+    lower_[i] = lower;
+    upper_[i] = upper;
+}
+
+Eigen::VectorXd LocalOptimizer::GetValues(const OpticalSystem *opt_sys) const
+{
+    const int num_vars = variables_.size();
+    Eigen::VectorXd x(num_vars);
+    for(int i = 0; i < num_vars; i++){
+        x(i) = variables_[i].Value(opt_sys);
+    }
+    return x;
+}
+
+void LocalOptimizer::SetValues(OpticalSystem *opt_sys, const Eigen::VectorXd &x) const
+{
+    const int num_vars = variables_.size();
+    for(int i = 0; i < num_vars; i++){
+        variables_[i].SetValue(opt_sys, x(i));
+    }
+    opt_sys->UpdateModel();
+}
+
+bool LocalOptimizer::compute_jacobian(Eigen::MatrixXd &J, OpticalSystem *opt_sys, const Eigen::VectorXd &x, const Eigen::VectorXd &r) const
+{
+    const int num_vars = variables_.size();
+    J.resize(r.size(), num_vars);
+
+    Eigen::VectorXd x_delta = x;
+    Eigen::VectorXd r_delta;
+
+    for(int j = 0; j < num_vars; j++){
+        double h = 1.0e-6*(1.0 + fabs(x(j)));
+
+        // step backward at the upper bound
+        if(x(j) + h > upper_[j]){
+            h = -h;
+        }
+
+        x_delta(j) = x(j) + h;
+        SetValues(opt_sys, x_delta);
+        x_delta(j) = x(j);
+
+        if( !merit_->Evaluate(r_delta, opt_sys) || r_delta.size() != r.size() ){
+            SetValues(opt_sys, x);
+            return false;
+        }
+
+        J.col(j) = (r_delta - r)/h;
+    }
+
+    SetValues(opt_sys, x);
+
+    return true;
+}
+
+double LocalOptimizer::Run(OpticalSystem *opt_sys) const
+{
+    const int num_vars = variables_.size();
+
+    Eigen::VectorXd x = GetValues(opt_sys);
+    Eigen::VectorXd r;
+
+    if( !merit_->Evaluate(r, opt_sys) ){
+        return std::numeric_limits<double>::infinity();
+    }
+    double f = r.squaredNorm();
+
+    if(num_vars == 0){
+        return f;
+    }
+
+    constexpr double ftol = 1.0e-10;
+    constexpr double max_damping = 1.0e+10;
+    double damping = 1.0e-3;
+
+    Eigen::MatrixXd J;
+    Eigen::VectorXd r_new;
+
+    for(int iter = 0; iter < max_iter_; iter++){
+        if( !compute_jacobian(J, opt_sys, x, r) ){
+            break;
+        }
+
+        Eigen::MatrixXd A = J.transpose()*J;
+        Eigen::VectorXd g = J.transpose()*r;
+        Eigen::VectorXd A_diag = A.diagonal().cwiseMax(1.0e-12);
+
+        bool improved = false;
+
+        while(damping < max_damping){
+            Eigen::MatrixXd A_damped = A;
+            A_damped.diagonal() += damping*A_diag;
+
+            Eigen::VectorXd dx = A_damped.ldlt().solve(-g);
+            Eigen::VectorXd x_new = x + dx;
+            for(int i = 0; i < num_vars; i++){
+                x_new(i) = std::min(std::max(x_new(i), lower_[i]), upper_[i]);
+            }
+
+            SetValues(opt_sys, x_new);
+
+            if( merit_->Evaluate(r_new, opt_sys) ){
+                double f_new = r_new.squaredNorm();
+                if(f_new < f){
+                    bool converged = (f - f_new) < ftol*(1.0 + f);
+                    x = x_new;
+                    r = r_new;
+                    f = f_new;
+                    damping = std::max(damping*0.1, 1.0e-12);
+                    improved = !converged;
+                    break;
+                }
+            }
+
+            damping *= 10.0;
+        }
+
+        if( !improved ){
+            break;
+        }
+    }
+
+    SetValues(opt_sys, x);
+
+    return f;
+}
@@ -0,0 +1,14 @@
+#include <limits>
+
+#include "optimization/merit_function.h"
+
+using namespace geopter;
+
+double MeritFunction::Value(OpticalSystem *opt_sys) const
+{
+    Eigen::VectorXd residuals;
+    if( !Evaluate(residuals, opt_sys) ){
+        return std::numeric_limits<double>::infinity();
+    }
+    return residuals.squaredNorm();
+}
@@ -0,0 +1,62 @@
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+#include "optimization/mtf_merit_function.h"
+#include "system/optical_system.h"
+#include "analysis/diffractive_mtf.h"
+
+using namespace geopter;
+
+MtfMeritFunction::MtfMeritFunction(const std::vector<double> &freqs, int nrd) :
+    freqs_(freqs),
+    nrd_(nrd)
+{
+
+}
+
+bool MtfMeritFunction::Evaluate(Eigen::VectorXd &residuals, OpticalSystem *opt_sys) const
+{
+    const int num_flds = opt_sys->GetOpticalSpec()->GetFieldSpec()->NumberOfFields();
+    const int num_wvls = opt_sys->GetOpticalSpec()->GetWavelengthSpec()->NumberOfWavelengths();
+    const int num_freqs = freqs_.size();
+
+    double total_weight = 0.0;
+    for(int fi = 0; fi < num_flds; fi++){
+        for(int wi = 0; wi < num_wvls; wi++){
+            total_weight += opt_sys->GetOpticalSpec()->GetFieldSpec()->GetField(fi)->Weight() *
+                            opt_sys->GetOpticalSpec()->GetWavelengthSpec()->GetWavelength(wi)->Weight();
+        }
+    }
+    if(total_weight <= 0.0 || num_freqs == 0){
+        return false;
+    }
+
+    residuals.resize(num_flds*num_wvls*2*num_freqs);
+
+    DiffractiveMTF mtf(opt_sys);
+
+    int k = 0;
+    for(int fi = 0; fi < num_flds; fi++){
+        const Field* fld = opt_sys->GetOpticalSpec()->GetFieldSpec()->GetField(fi);
+
+        for(int wi = 0; wi < num_wvls; wi++){
+            double wvl = opt_sys->GetOpticalSpec()->GetWavelengthSpec()->GetWavelength(wi)->Value();
+            double wt  = fld->Weight() * opt_sys->GetOpticalSpec()->GetWavelengthSpec()->GetWavelength(wi)->Weight();
+
+            // each of the 2*num_freqs residuals of the field and wavelength shares its weight
+            const double scale = sqrt(wt/(total_weight*2*num_freqs));
+
+            for(double azimuth : {0.0, M_PI/2.0}){
+                auto otf = mtf.ComputeOTF(fld, wvl, freqs_, azimuth, nrd_);
+                for(int j = 0; j < num_freqs; j++){
+                    if( !std::isfinite(std::abs(otf[j])) ){
+                        return false;
+                    }
+                    residuals(k++) = scale*(1.0 - std::abs(otf[j]));
+                }
+            }
+        }
+    }
+
+    return true;
+}
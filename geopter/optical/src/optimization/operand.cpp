@@ -0,0 +1,30 @@
+#include "optimization/operand.h"
+
+using namespace geopter;
+
+OperandContext::OperandContext(OpticalSystem *opt_sys) :
+    opt_sys_(opt_sys),
+    ray_index_(nullptr),
+    ax_ray_(nullptr),
+    pr_ray_(nullptr)
+{
+
+}
+
+const Ray* OperandContext::GetRay(const RayRequest &request) const
+{
+    if( !ray_index_ ){
+        return nullptr;
+    }
+
+    auto itr = ray_index_->find(MakeKey(request));
+    if(itr == ray_index_->end()){
+        return nullptr;
+    }
+
+    int i = itr->second;
+    if( !ray_valid_[i] ){
+        return nullptr;
+    }
+    return rays_[i].get();
+}
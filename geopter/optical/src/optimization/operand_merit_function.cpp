@@ -0,0 +1,157 @@
+#include <iostream>
+
+#include "optimization/operand_merit_function.h"
+#include "system/optical_system.h"
+#include "sequential/sequential_trace.h"
+#include "paraxial/paraxial_trace.h"
+
+using namespace geopter;
+
+OperandMeritFunction::OperandMeritFunction() :
+    needs_paraxial_(false)
+{
+
+}
+
+void OperandMeritFunction::AddOperand(OperandPtr op)
+{
+    operands_.push_back(op);
+    build_plan();
+}
+
+void OperandMeritFunction::Clear()
+{
+    operands_.clear();
+    build_plan();
+}
+
+void OperandMeritFunction::build_plan()
+{
+    groups_.clear();
+    ray_index_.clear();
+    needs_paraxial_ = false;
+
+    std::map<std::pair<int,int>, int> group_index;
+    std::vector<RayRequest> requests;
+
+    for(auto& op : operands_){
+        if(op->NeedsParaxialTrace()){
+            needs_paraxial_ = true;
+        }
+
+        requests.clear();
+        op->RequestRays(requests);
+
+        for(auto& req : requests){
+            auto key = OperandContext::MakeKey(req);
+            if(ray_index_.find(key) != ray_index_.end()){
+                continue; // already in the plan
+            }
+
+            int ray_idx = ray_index_.size();
+            ray_index_[key] = ray_idx;
+
+            auto fw = std::make_pair(req.field_index, req.wvl_index);
+            auto itr = group_index.find(fw);
+            if(itr == group_index.end()){
+                RayGroup grp;
+                grp.field_index = req.field_index;
+                grp.wvl_index = req.wvl_index;
+                groups_.push_back(grp);
+                itr = group_index.insert(std::make_pair(fw, (int)groups_.size() - 1)).first;
+            }
+
+            groups_[itr->second].pupils.push_back(req.pupil);
+            groups_[itr->second].ray_indices.push_back(ray_idx);
+        }
+    }
+}
+
+bool OperandMeritFunction::trace_plan(OperandContext &ctx) const
+{
+    OpticalSystem* opt_sys = ctx.GetOpticalSystem();
+
+    const int num_flds = opt_sys->GetOpticalSpec()->GetFieldSpec()->NumberOfFields();
+    const int num_wvls = opt_sys->GetOpticalSpec()->GetWavelengthSpec()->NumberOfWavelengths();
+    const int num_rays = ray_index_.size();
+
+    ctx.ray_index_ = &ray_index_;
+    ctx.rays_.resize(num_rays);
+    ctx.ray_valid_.assign(num_rays, false);
+
+    SequentialTrace tracer(opt_sys);
+
+    // one sequential path per wavelength
+    std::vector<SequentialPath> seq_paths(num_wvls);
+    std::vector<bool> path_created(num_wvls, false);
+
+    for(auto& grp : groups_){
+        if(grp.field_index < 0 || grp.field_index >= num_flds || grp.wvl_index < 0 || grp.wvl_index >= num_wvls){
+            std::cerr << "OperandMeritFunction: field or wavelength index out of range" << std::endl;
+            return false;
+        }
+
+        const Field* fld = opt_sys->GetOpticalSpec()->GetFieldSpec()->GetField(grp.field_index);
+        double wvl = opt_sys->GetOpticalSpec()->GetWavelengthSpec()->GetWavelength(grp.wvl_index)->Value();
+
+        if( !path_created[grp.wvl_index] ){
+            seq_paths[grp.wvl_index] = tracer.CreateSequentialPath(wvl);
+            path_created[grp.wvl_index] = true;
+        }
+        const SequentialPath& seq_path = seq_paths[grp.wvl_index];
+
+        const int num_pupils = grp.pupils.size();
+        for(int pi = 0; pi < num_pupils; pi++){
+            int ray_idx = grp.ray_indices[pi];
+            auto ray = std::make_shared<Ray>(seq_path.Size());
+            ctx.ray_valid_[ray_idx] = (TRACE_SUCCESS == tracer.TracePupilRay(ray, seq_path, grp.pupils[pi], fld, wvl));
+            ctx.rays_[ray_idx] = ray;
+        }
+    }
+
+    if(needs_paraxial_){
+        ParaxialTrace prx_tracer(opt_sys);
+        auto fod = opt_sys->GetFirstOrderData();
+        double ref_wvl = opt_sys->GetOpticalSpec()->GetWavelengthSpec()->ReferenceWavelength();
+        ctx.ax_ray_ = prx_tracer.TraceParaxialRayFromObject(fod->reference_y0, fod->reference_u0, ref_wvl);
+        ctx.pr_ray_ = prx_tracer.TraceParaxialRayFromObject(fod->reference_ybar0, fod->reference_ubar0, ref_wvl);
+    }
+
+    return true;
+}
+
+bool OperandMeritFunction::ComputeValues(std::vector<double> &values, OpticalSystem *opt_sys) const
+{
+    OperandContext ctx(opt_sys);
+    if( !trace_plan(ctx) ){
+        return false;
+    }
+
+    const int num_operands = operands_.size();
+    values.resize(num_operands);
+
+    for(int i = 0; i < num_operands; i++){
+        if( !operands_[i]->Compute(values[i], ctx) ){
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool OperandMeritFunction::Evaluate(Eigen::VectorXd &residuals, OpticalSystem *opt_sys) const
+{
+    std::vector<double> values;
+    if( !ComputeValues(values, opt_sys) ){
+        return false;
+    }
+
+    const int num_operands = operands_.size();
+    residuals.resize(num_operands);
+
+    for(int i = 0; i < num_operands; i++){
+        residuals(i) = operands_[i]->Weight()*(values[i] - operands_[i]->Target());
+    }
+
+    return true;
+}
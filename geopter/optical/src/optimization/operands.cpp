@@ -0,0 +1,177 @@
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+#include "optimization/operands.h"
+#include "system/optical_system.h"
+
+using namespace geopter;
+
+
+EffectiveFocalLengthOperand::EffectiveFocalLengthOperand(double target, double weight) :
+    Operand(target, weight)
+{
+
+}
+
+bool EffectiveFocalLengthOperand::Compute(double &value, const OperandContext &ctx) const
+{
+    value = ctx.GetOpticalSystem()->GetFirstOrderData()->effective_focal_length;
+    return std::isfinite(value);
+}
+
+
+SpotRmsOperand::SpotRmsOperand(int fi, int wi, int num_rings, double target, double weight) :
+    Operand(target, weight),
+    field_index_(fi),
+    wvl_index_(wi)
+{
+    pupils_.push_back(Eigen::Vector2d::Zero());
+    for(int ri = 1; ri <= num_rings; ri++){
+        double r = (double)ri/(double)num_rings;
+        int num_arms = 6*ri;
+        for(int ai = 0; ai < num_arms; ai++){
+            double t = 2.0*M_PI*(double)ai/(double)num_arms;
+            pupils_.push_back(Eigen::Vector2d(r*cos(t), r*sin(t)));
+        }
+    }
+}
+
+void SpotRmsOperand::RequestRays(std::vector<RayRequest> &requests) const
+{
+    for(auto& pupil : pupils_){
+        requests.emplace_back(field_index_, wvl_index_, pupil);
+    }
+}
+
+bool SpotRmsOperand::Compute(double &value, const OperandContext &ctx) const
+{
+    const int num_pupils = pupils_.size();
+    std::vector<Eigen::Vector2d> pts(num_pupils);
+    Eigen::Vector2d centroid = Eigen::Vector2d::Zero();
+
+    for(int pi = 0; pi < num_pupils; pi++){
+        const Ray* ray = ctx.GetRay(RayRequest(field_index_, wvl_index_, pupils_[pi]));
+        if( !ray ){
+            return false;
+        }
+        pts[pi] = Eigen::Vector2d(ray->GetBack()->X(), ray->GetBack()->Y());
+        centroid += pts[pi];
+    }
+    centroid /= (double)num_pupils;
+
+    double sum_sq = 0.0;
+    for(auto& p : pts){
+        sum_sq += (p - centroid).squaredNorm();
+    }
+
+    value = sqrt(sum_sq/(double)num_pupils);
+    return true;
+}
+
+
+RayHeightOperand::RayHeightOperand(int srf, int fi, int wi, const Eigen::Vector2d &pupil, int axis, double target, double weight) :
+    Operand(target, weight),
+    surface_index_(srf),
+    field_index_(fi),
+    wvl_index_(wi),
+    pupil_(pupil),
+    axis_(axis)
+{
+
+}
+
+void RayHeightOperand::RequestRays(std::vector<RayRequest> &requests) const
+{
+    requests.emplace_back(field_index_, wvl_index_, pupil_);
+}
+
+bool RayHeightOperand::Compute(double &value, const OperandContext &ctx) const
+{
+    const Ray* ray = ctx.GetRay(RayRequest(field_index_, wvl_index_, pupil_));
+    if( !ray || surface_index_ < 0 || surface_index_ >= ray->NumberOfSegments() ){
+        return false;
+    }
+
+    value = (axis_ == 0) ? ray->GetSegmentAt(surface_index_)->X() : ray->GetSegmentAt(surface_index_)->Y();
+    return true;
+}
+
+
+DistortionOperand::DistortionOperand(int fi, int wi, double target, double weight) :
+    Operand(target, weight),
+    field_index_(fi),
+    wvl_index_(wi)
+{
+
+}
+
+void DistortionOperand::RequestRays(std::vector<RayRequest> &requests) const
+{
+    requests.emplace_back(field_index_, wvl_index_, Eigen::Vector2d::Zero());
+}
+
+bool DistortionOperand::Compute(double &value, const OperandContext &ctx) const
+{
+    const Ray* chief_ray = ctx.GetRay(RayRequest(field_index_, wvl_index_, Eigen::Vector2d::Zero()));
+    ParaxialRay* prx_chief_ray = ctx.GetParaxialChiefRay();
+    if( !chief_ray || !prx_chief_ray ){
+        return false;
+    }
+
+    // scale the paraxial chief ray of the maximum field to this field
+    OpticalSystem* opt_sys = ctx.GetOpticalSystem();
+    FieldSpec* fov = opt_sys->GetOpticalSpec()->GetFieldSpec();
+    double max_fld = fov->MaxField();
+    double fld_y = fov->GetField(field_index_)->Y();
+
+    double ratio;
+    if(fov->FieldType() == FieldType::OBJ_ANG){
+        ratio = tan(fld_y*M_PI/180.0)/tan(max_fld*M_PI/180.0);
+    }else{
+        ratio = fld_y/max_fld;
+    }
+
+    double y_prx = ratio*prx_chief_ray->Back().y;
+    double y_real = chief_ray->GetBack()->Y();
+
+    if(fabs(y_prx) < std::numeric_limits<double>::epsilon()){
+        value = 0.0;
+    }else{
+        value = 100.0*(y_real - y_prx)/y_prx;
+    }
+    return true;
+}
+
+
+EdgeThicknessOperand::EdgeThicknessOperand(int gi, double height, double target, double weight) :
+    Operand(target, weight),
+    gap_index_(gi),
+    height_(height)
+{
+
+}
+
+bool EdgeThicknessOperand::Compute(double &value, const OperandContext &ctx) const
+{
+    const OpticalAssembly* assembly = ctx.GetOpticalSystem()->GetOpticalAssembly();
+    if(gap_index_ < 0 || gap_index_ + 1 >= assembly->NumberOfSurfaces()){
+        return false;
+    }
+
+    const Surface* s1 = assembly->GetSurface(gap_index_);
+    const Surface* s2 = assembly->GetSurface(gap_index_ + 1);
+
+    double h = height_;
+    if(h < 0.0){
+        h = std::max(s1->SemiDiameter(), s2->SemiDiameter());
+    }
+
+    double sag1 = s1->Sag(0.0, h);
+    double sag2 = s2->Sag(0.0, h);
+    double thi = assembly->GetGap(gap_index_)->Thickness();
+
+    value = -sag1 + thi + sag2;
+    return std::isfinite(value);
+}
@@ -0,0 +1,94 @@
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+#include "optimization/spot_merit_function.h"
+#include "system/optical_system.h"
+#include "sequential/sequential_trace.h"
+
+using namespace geopter;
+
+SpotMeritFunction::SpotMeritFunction(int num_rings) :
+    num_rings_(num_rings),
+    use_efl_target_(false),
+    efl_target_(0.0),
+    efl_weight_(0.0)
+{
+
+}
+
+void SpotMeritFunction::SetFocalLengthTarget(double efl, double weight)
+{
+    use_efl_target_ = true;
+    efl_target_ = efl;
+    efl_weight_ = weight;
+}
+
+bool SpotMeritFunction::Evaluate(Eigen::VectorXd &residuals, OpticalSystem *opt_sys) const
+{
+    // hexapolar pupil samples, center ray included
+    std::vector<Eigen::Vector2d> pupils;
+    pupils.push_back(Eigen::Vector2d::Zero());
+    for(int ri = 1; ri <= num_rings_; ri++){
+        double r = (double)ri/(double)num_rings_;
+        int num_arms = 6*ri;
+        for(int ai = 0; ai < num_arms; ai++){
+            double t = 2.0*M_PI*(double)ai/(double)num_arms;
+            pupils.push_back(Eigen::Vector2d(r*cos(t), r*sin(t)));
+        }
+    }
+    const int num_pupils = pupils.size();
+
+    const int num_flds = opt_sys->GetOpticalSpec()->GetFieldSpec()->NumberOfFields();
+    const int num_wvls = opt_sys->GetOpticalSpec()->GetWavelengthSpec()->NumberOfWavelengths();
+    const double ref_wvl = opt_sys->GetOpticalSpec()->GetWavelengthSpec()->ReferenceWavelength();
+
+    double total_weight = 0.0;
+    for(int fi = 0; fi < num_flds; fi++){
+        for(int wi = 0; wi < num_wvls; wi++){
+            total_weight += opt_sys->GetOpticalSpec()->GetFieldSpec()->GetField(fi)->Weight() *
+                            opt_sys->GetOpticalSpec()->GetWavelengthSpec()->GetWavelength(wi)->Weight();
+        }
+    }
+    if(total_weight <= 0.0){
+        return false;
+    }
+
+    residuals.resize(2*num_flds*num_wvls*num_pupils + (use_efl_target_ ? 1 : 0));
+
+    SequentialTrace tracer(opt_sys);
+    SequentialPath ref_path = tracer.CreateSequentialPath(ref_wvl);
+    auto ray = std::make_shared<Ray>(ref_path.Size());
+
+    int k = 0;
+    for(int fi = 0; fi < num_flds; fi++){
+        const Field* fld = opt_sys->GetOpticalSpec()->GetFieldSpec()->GetField(fi);
+
+        if(TRACE_SUCCESS != tracer.TracePupilRay(ray, ref_path, Eigen::Vector2d::Zero(), fld, ref_wvl)){
+            return false;
+        }
+        double x_ref = ray->GetBack()->X();
+        double y_ref = ray->GetBack()->Y();
+
+        for(int wi = 0; wi < num_wvls; wi++){
+            double wvl = opt_sys->GetOpticalSpec()->GetWavelengthSpec()->GetWavelength(wi)->Value();
+            double wt  = fld->Weight() * opt_sys->GetOpticalSpec()->GetWavelengthSpec()->GetWavelength(wi)->Weight();
+            double scale = sqrt(wt/(total_weight*num_pupils));
+
+            SequentialPath seq_path = tracer.CreateSequentialPath(wvl);
+
+            for(int pi = 0; pi < num_pupils; pi++){
+                if(TRACE_SUCCESS != tracer.TracePupilRay(ray, seq_path, pupils[pi], fld, wvl)){
+                    return false;
+                }
+                residuals(k++) = scale*(ray->GetBack()->X() - x_ref);
+                residuals(k++) = scale*(ray->GetBack()->Y() - y_ref);
+            }
+        }
+    }
+
+    if(use_efl_target_){
+        residuals(k++) = efl_weight_*(opt_sys->GetFirstOrderData()->effective_focal_length - efl_target_);
+    }
+
+    return true;
+}
@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <cmath>
+
+#include "optimization/wavefront_merit_function.h"
+#include "system/optical_system.h"
+#include "analysis/wavefront.h"
+
+using namespace geopter;
+
+WavefrontMeritFunction::WavefrontMeritFunction(int ndim) :
+    ndim_(ndim)
+{
+
+}
+
+bool WavefrontMeritFunction::Evaluate(Eigen::VectorXd &residuals, OpticalSystem *opt_sys) const
+{
+    const int num_flds = opt_sys->GetOpticalSpec()->GetFieldSpec()->NumberOfFields();
+    const int num_wvls = opt_sys->GetOpticalSpec()->GetWavelengthSpec()->NumberOfWavelengths();
+
+    double total_weight = 0.0;
+    for(int fi = 0; fi < num_flds; fi++){
+        for(int wi = 0; wi < num_wvls; wi++){
+            total_weight += opt_sys->GetOpticalSpec()->GetFieldSpec()->GetField(fi)->Weight() *
+                            opt_sys->GetOpticalSpec()->GetWavelengthSpec()->GetWavelength(wi)->Weight();
+        }
+    }
+    if(total_weight <= 0.0){
+        return false;
+    }
+
+    residuals.resize(num_flds*num_wvls);
+
+    WavefrontMap wavefront(opt_sys);
+
+    int k = 0;
+    for(int fi = 0; fi < num_flds; fi++){
+        const Field* fld = opt_sys->GetOpticalSpec()->GetFieldSpec()->GetField(fi);
+
+        for(int wi = 0; wi < num_wvls; wi++){
+            double wvl = opt_sys->GetOpticalSpec()->GetWavelengthSpec()->GetWavelength(wi)->Value();
+            double wt  = fld->Weight() * opt_sys->GetOpticalSpec()->GetWavelengthSpec()->GetWavelength(wi)->Weight();
+
+            auto grid = wavefront.Create(fld, wvl, ndim_);
+            const Eigen::MatrixXd& opd = grid->ValueData();
+
+            double sum = 0.0, sum_sq = 0.0;
+            int count = 0;
+            for(int i = 0; i < opd.rows(); i++){
+                for(int j = 0; j < opd.cols(); j++){
+                    double w = opd(i, j);
+                    if(std::isfinite(w)){
+                        sum += w;
+                        sum_sq += w*w;
+                        count++;
+                    }
+                }
+            }
+            if(count == 0){
+                return false;
+            }
+
+            double mean = sum/count;
+            double rms = sqrt(std::max(sum_sq/count - mean*mean, 0.0));
+
+            residuals(k++) = sqrt(wt/total_weight)*rms;
+        }
+    }
+
+    return true;
+}
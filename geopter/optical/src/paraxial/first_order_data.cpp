@@ -16,17 +16,25 @@ FirstOrderData::~FirstOrderData()
     parent_ = nullptr;
 }
 
+void FirstOrderData::CopyFrom(const FirstOrderData &other)
+{
+    OpticalSystem* parent = parent_;
+    *this = other;
+    parent_ = parent;
+}
+
 
 void FirstOrderData::Update()
 {
     ParaxialTrace tracer(parent_);
 
-    const int img = parent_->GetOpticalAssembly()->ImageIndex();
-    const int last_surf = parent_->GetOpticalAssembly()->ImageIndex() -1;
-    const int stop = parent_->GetOpticalAssembly()->StopIndex();
+    const OpticalAssembly* assembly = parent_->GetOpticalAssembly();
+    const int img = assembly->ImageIndex();
+    const int last_surf = assembly->ImageIndex() -1;
+    const int stop = assembly->StopIndex();
     const double ref_wvl = parent_->GetOpticalSpec()->GetWavelengthSpec()->ReferenceWavelength();
-    const double n_0 = parent_->GetOpticalAssembly()->GetGap(0)->GetMaterial()->RefractiveIndex(ref_wvl);
-    const double n_k = parent_->GetOpticalAssembly()->ImageSpaceGap()->GetMaterial()->RefractiveIndex(ref_wvl);
+    const double n_0 = assembly->GetGap(0)->GetMaterial()->RefractiveIndex(ref_wvl);
+    const double n_k = assembly->ImageSpaceGap()->GetMaterial()->RefractiveIndex(ref_wvl);
 
 
     /**************************************
@@ -51,7 +59,7 @@ void FirstOrderData::Update()
     double ck1 = y_nuk_p(1);
     double dk1 = y_nuk_q(1);
 
-    const double thi0 = parent_->GetOpticalAssembly()->GetGap(0)->Thickness();
+    const double thi0 = assembly->GetGap(0)->Thickness();
     object_distance = thi0;
     reduction = dk1 + thi0*ck1;
 
@@ -137,7 +145,7 @@ void FirstOrderData::Update()
     fno = -1.0/(2.0*n_k*ax_ray->At(img).u_prime);
 
     //obj_dist = parent_->GetOpticalAssembly()->gap(0)->thi();
-    image_distance = parent_->GetOpticalAssembly()->ImageSpaceGap()->Thickness();
+    image_distance = assembly->ImageSpaceGap()->Thickness();
 
     //red = dk1 + ck1*obj_dist;
 
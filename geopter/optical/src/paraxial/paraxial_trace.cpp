@@ -55,43 +55,18 @@ std::shared_ptr<ParaxialRay> ParaxialTrace::TraceParaxialRayFromObject(double y0
         return par_ray; // empty
     }
 
-    // object surface
-    double c0 = par_path.At(0).curvature;
-    double u0_prime = u0;
-    double i0 = y0*c0 + u0;
-    double n0 = par_path.At(0).refractive_index;
-    double n0_prime = n0;
-    par_ray->Append(y0, u0_prime, i0, n0_prime);
-
-    if(path_size == 1) {
-        return par_ray;
+    std::vector<double> c(path_size), t(path_size), n(path_size);
+    for(int k = 0; k < path_size; k++) {
+        c[k] = par_path.At(k).curvature;
+        t[k] = par_path.At(k).thickness;
+        n[k] = par_path.At(k).refractive_index;
     }
 
+    std::vector<double> y, u_prime, i;
+    TraceParaxialRay<double>(y, u_prime, i, c, t, n, y0, u0);
 
-    // trace the rest
-    double d = par_path.At(0).thickness;
-    double y = y0 + d*u0_prime;
-    double u = u0_prime;
-    double c;
-    double i, i_prime;
-    double n = n0;
-    double n_prime;
-    double u_prime;
-    
-    for(int k = 1; k < path_size; k++) {
-        c = par_path.At(k).curvature;
-        n_prime = par_path.At(k).refractive_index;
-        i = u + y*c;
-        i_prime = i*(n/n_prime);
-        u_prime = i_prime - y*c;
-
-        par_ray->Append(y, u_prime, i, n_prime);
-
-        // transfer to next
-        d = par_path.At(k).thickness;
-        y = y + d*u_prime;
-        u = u_prime;
-        n = n_prime;
+    for(int k = 0; k < path_size; k++) {
+        par_ray->Append(y[k], u_prime[k], i[k], n[k]);
     }
 
     return par_ray;
@@ -127,17 +102,19 @@ ParaxialPath ParaxialTrace::CreateForwardParaxialPath(int start, int end, double
 {
     assert(start <= end);
 
-    int num_gaps = opt_sys_->GetOpticalAssembly()->NumberOfGaps();
+    const OpticalAssembly* assembly = opt_sys_->GetOpticalAssembly();
+
+    int num_gaps = assembly->NumberOfGaps();
 
     ParaxialPathComponent par_path_comp;
     ParaxialPath par_path;
 
     for(int i = start; i <= end; i++) {
-        par_path_comp.curvature = opt_sys_->GetOpticalAssembly()->GetSurface(i)->Curvature();
+        par_path_comp.curvature = assembly->GetSurface(i)->Curvature();
 
         if( i < num_gaps ){
-            par_path_comp.thickness = opt_sys_->GetOpticalAssembly()->GetGap(i)->Thickness();
-            par_path_comp.refractive_index = opt_sys_->GetOpticalAssembly()->GetGap(i)->GetMaterial()->RefractiveIndex(wvl);
+            par_path_comp.thickness = assembly->GetGap(i)->Thickness();
+            par_path_comp.refractive_index = assembly->GetGap(i)->GetMaterial()->RefractiveIndex(wvl);
         }else{
             par_path_comp.thickness = 0.0;
             par_path_comp.refractive_index = 1.0;
@@ -153,15 +130,17 @@ ParaxialPath ParaxialTrace::CreateReverseParaxialPath(int start, int end, double
 {
     assert(start >= end);
 
+    const OpticalAssembly* assembly = opt_sys_->GetOpticalAssembly();
+
     ParaxialPathComponent par_path_comp;
     ParaxialPath par_path;
 
     for(int i = start; i >= end; i--) {
-        par_path_comp.curvature  = - opt_sys_->GetOpticalAssembly()->GetSurface(i)->Curvature();
+        par_path_comp.curvature  = - assembly->GetSurface(i)->Curvature();
 
         if( i > 0 ){
-            par_path_comp.thickness = opt_sys_->GetOpticalAssembly()->GetGap(i-1)->Thickness();
-            par_path_comp.refractive_index = opt_sys_->GetOpticalAssembly()->GetGap(i-1)->GetMaterial()->RefractiveIndex(wvl);
+            par_path_comp.thickness = assembly->GetGap(i-1)->Thickness();
+            par_path_comp.refractive_index = assembly->GetGap(i-1)->GetMaterial()->RefractiveIndex(wvl);
         }else{
             par_path_comp.thickness = 0.0;
             par_path_comp.refractive_index = 1.0;
@@ -190,10 +169,11 @@ Eigen::Matrix2d ParaxialTrace::SystemMatrix(int s1, int s2, double wvl) const
 
     double n, n_prime;
 
+    const OpticalAssembly* assembly = opt_sys_->GetOpticalAssembly();
     if( s1 > 0){
-        n = opt_sys_->GetOpticalAssembly()->GetGap(s1-1)->GetMaterial()->RefractiveIndex(wvl);
+        n = assembly->GetGap(s1-1)->GetMaterial()->RefractiveIndex(wvl);
     }else{
-        n = opt_sys_->GetOpticalAssembly()->GetGap(0)->GetMaterial()->RefractiveIndex(wvl);
+        n = assembly->GetGap(0)->GetMaterial()->RefractiveIndex(wvl);
     }
 
     for(int i = 0; i < path.Size()-1; i++) {
@@ -233,23 +213,25 @@ Eigen::Matrix2d ParaxialTrace::SystemMatrix(OpticalSystem* opt_sys, int s1, int
 
     double n, n_prime;
 
+    const OpticalAssembly* assembly = opt_sys->GetOpticalAssembly();
+
     if( s1 > 0){
-        n = opt_sys->GetOpticalAssembly()->GetGap(s1-1)->GetMaterial()->RefractiveIndex(wvl);
+        n = assembly->GetGap(s1-1)->GetMaterial()->RefractiveIndex(wvl);
     }else{
-        n = opt_sys->GetOpticalAssembly()->GetGap(0)->GetMaterial()->RefractiveIndex(wvl);
+        n = assembly->GetGap(0)->GetMaterial()->RefractiveIndex(wvl);
     }
 
     for(int i = s1; i < s2; i++) {
-        n_prime = opt_sys->GetOpticalAssembly()->GetGap(i)->GetMaterial()->RefractiveIndex(wvl);
+        n_prime = assembly->GetGap(i)->GetMaterial()->RefractiveIndex(wvl);
 
         // refract
-        double c = opt_sys->GetOpticalAssembly()->GetSurface(i)->Curvature();
+        double c = assembly->GetSurface(i)->Curvature();
         double phi = (n_prime - n) * c;
         R(1,0) = -phi;
         M = R*M;
 
         // transfer
-        double t = opt_sys->GetOpticalAssembly()->GetGap(i)->Thickness();
+        double t = assembly->GetGap(i)->Thickness();
         T(0,1) = t/n_prime;
         M = T*M;
 
@@ -257,8 +239,8 @@ Eigen::Matrix2d ParaxialTrace::SystemMatrix(OpticalSystem* opt_sys, int s1, int
     }
 
     // refract at s2
-    n_prime = opt_sys->GetOpticalAssembly()->GetGap(s2)->GetMaterial()->RefractiveIndex(wvl);
-    double c_s2 = opt_sys->GetOpticalAssembly()->GetSurface(s2)->Curvature();
+    n_prime = assembly->GetGap(s2)->GetMaterial()->RefractiveIndex(wvl);
+    double c_s2 = assembly->GetSurface(s2)->Curvature();
     R(1,0) = -( (n_prime - n) * c_s2 );
     M = R*M;
 
@@ -60,34 +60,7 @@ EvenPolynomial::~EvenPolynomial()
 
 bool EvenPolynomial::Intersect(Eigen::Vector3d& pt, double& distance, const Eigen::Vector3d& p0, const Eigen::Vector3d& dir)
 {
-    // Spencer's method
-
-    Eigen::Vector3d p = p0;
-    double s1 = -f(p)/dir.dot(df(p));
-    double s2;
-    double delta = fabs(s1);
-    constexpr int max_iter = 50;
-    int iter = 0;
-
-    while(delta > eps_)
-    {
-        p = p0 + s1*dir;
-        s2 = s1 - f(p)/dir.dot(df(p));
-        delta = fabs(s2-s1);
-        s1 = s2;
-        iter++;
-
-        if(iter > max_iter){
-            pt = p;
-            distance = s1;
-            return false;
-        }
-    }
-
-    pt = p;
-    distance = s1;
-
-    return true;
+    return Intersect<double>(pt, distance, p0, dir, cv_, conic_, terms_, eps_);
 }
 
 double EvenPolynomial::GetNthTerm(int i) const
@@ -119,64 +92,21 @@ void EvenPolynomial::SetTerms(const std::vector<double>& coefs)
 
 double EvenPolynomial::Sag(double x, double y) const
 {
-    double r2 = x*x + y*y;
-
-    // sphere + conic contribution
-    double z = 0.0;
-    double inside_sqrt = 1.0 - (conic_+1.0)*cv_*cv_*r2;
-    if(inside_sqrt < 0.0){
+    double z = Sag<double>(x, y, cv_, conic_, terms_);
+    if(std::isnan(z)){
         std::cout << "TraceMissedSurface EvenPolynomial::sag()" << std::endl;
-        return NAN;
-    }
-    else{
-        z = cv_*r2 / ( 1.0 + sqrt( inside_sqrt ) );
     }
-
-    // polynomial contribution
-    double z_asp = 0.0;
-    double r_pow = r2;
-
-    //Ar4 + Br6 + Cr8...
-    for(int i = 0; i < num_terms_; i++){
-        r_pow *= r2;
-        z_asp += terms_[i]*r_pow;
-    }
-
-    return (z + z_asp);
+    return z;
 }
 
 double EvenPolynomial::f(const Eigen::Vector3d& p) const
 {
-    return ( p(2) - this->Sag(p(0), p(1)) );
+    return f<double>(p, cv_, conic_, terms_);
 }
 
 Eigen::Vector3d EvenPolynomial::df(const Eigen::Vector3d& p) const
 {
-    //sphere + conic contribution
-    double r2 = p(0)*p(0) + p(1)*p(1);
-    double ec = conic_ + 1.0;
-
-    double e = cv_ / sqrt( 1.0 - ec*cv_*cv_*r2 );
-
-    //polynomial asphere contribution
-    double r_pow = 1.0;
-    double e_asp = 0.0;
-    double c_coef = 2.0;
-
-    c_coef += 2.0;
-    r_pow *= r2;
-
-    for(int i = 0; i < num_terms_; i++){
-        e_asp += c_coef*terms_[i]*r_pow;
-        c_coef += 2.0;
-        r_pow *= r2;
-    }
-
-    double e_tot = e + e_asp;
-
-    Eigen::Vector3d df({-e_tot*p(0), -e_tot*p(1), 1.0});
-    return df;
-
+    return df<double>(p, cv_, conic_, terms_);
 }
 
 
@@ -55,34 +55,7 @@ OddPolynomial::~OddPolynomial()
 
 bool OddPolynomial::Intersect(Eigen::Vector3d& pt, double& distance, const Eigen::Vector3d& p0, const Eigen::Vector3d& dir)
 {
-    // Spencer's method
-
-    Eigen::Vector3d p = p0;
-    double s1 = -f(p)/dir.dot(df(p));
-    double s2;
-    double delta = fabs(s1);
-    constexpr int max_iter = 30;
-    int iter = 0;
-
-    while(delta > eps_)
-    {
-        p = p0 + s1*dir;
-        s2 = s1 - f(p)/dir.dot(df(p));
-        delta = fabs(s2-s1);
-        s1 = s2;
-        iter++;
-
-        if(iter > max_iter){
-            pt = p;
-            distance = s1;
-            return false;
-        }
-    }
-
-    pt = p;
-    distance = s1;
-
-    return true;
+    return Intersect<double>(pt, distance, p0, dir, cv_, conic_, terms_, eps_);
 }
 
 
@@ -116,54 +89,17 @@ double OddPolynomial::GetNthTerm(int i) const
 
 double OddPolynomial::Sag(double x, double y) const
 {
-    double r2 = x*x + y*y;
-    double r = sqrt(r2);
-
-    // conic contribution
-    double z_conic = cv_*r2/( 1.0 + sqrt( 1.0 - cv_*cv_*r2*(conic_+1.0) ) );
-
-    // polynomial contribution
-    double z_pol = 0.0;
-    double r_pow = r2*r;
-
-    for(int i = 0; i < num_terms_; i++) {
-        z_pol += terms_[i] * r_pow;
-        r_pow *= r;
-    }
-
-    return (z_conic + z_pol);
+    return Sag<double>(x, y, cv_, conic_, terms_);
 }
 
-double OddPolynomial::f(const Eigen::Vector3d &p) const
+double OddPolynomial::f(const Eigen::Vector3d& p) const
 {
-    return ( p(2) - this->Sag(p(0), p(1)) );
+    return f<double>(p, cv_, conic_, terms_);
 }
 
-Eigen::Vector3d OddPolynomial::df(const Eigen::Vector3d &p) const
+Eigen::Vector3d OddPolynomial::df(const Eigen::Vector3d& p) const
 {
-    double r2 = p(0)*p(0) + p(1)*p(1);
-    double r = sqrt(r2);
-    double t = sqrt( 1.0 - cv_*cv_*r2*(conic_ + 1.0) ); // common sqrt
-
-    // conic contribution
-    double conic_contrib_1 = 2*cv_/(t + 1.0);
-    double conic_contrib_2 = pow(cv_,3)*r2*(conic_+1.0)/( t*pow((t+1.0), 2) );
-
-    // polynomial contribution
-    double pol_contrib = 0.0;
-
-    double r_pow = r;
-    double num = 3.0;
-    for(int i = 0; i < num_terms_; i++){
-        pol_contrib += num*terms_[i]*r_pow;
-        num += 1.0;
-        r_pow *= r;
-    }
-
-    double e_tot = conic_contrib_1 + conic_contrib_2 + pol_contrib;
-
-    Eigen::Vector3d df_ret({-e_tot*p(0), -e_tot*p(1), 1.0});
-    return df_ret;
+    return df<double>(p, cv_, conic_, terms_);
 }
 
 double OddPolynomial::deriv_1st(double h) const
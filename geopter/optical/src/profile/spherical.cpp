@@ -56,21 +56,5 @@ double Spherical::Sag(double x, double y) const
 
 bool Spherical::Intersect(Eigen::Vector3d &pt, double &distance, const Eigen::Vector3d& p0, const Eigen::Vector3d& dir)
 {
-    constexpr double z_dir = 1.0; // z direction, currently reflection is not supported
-
-    double ax2 = cv_;
-    double cx2 = cv_*(p0.dot(p0)) - 2*p0(2);
-    double b = cv_*(dir.dot(p0)) - dir(2);
-
-    double inside_sqrt = b*b - ax2*cx2;
-
-    if(inside_sqrt < 0.0){
-        return false;
-    }
-    else{
-        distance = cx2/(z_dir*sqrt(inside_sqrt) -b );
-        pt = p0 + distance*dir;
-    }
-
-    return true;
+    return Intersect<double>(pt, distance, p0, dir, cv_);
 }
@@ -0,0 +1,372 @@
+#include <algorithm>
+#include <iostream>
+
+#include "sequential/batched_trace.h"
+#include "sequential/sequential_trace.h"
+#include "material/perturbed_material.h"
+#include "system/system_parameter.h"
+
+using namespace geopter;
+
+BatchedTrace::BatchedTrace(OpticalSystem* opt_sys) :
+    opt_sys_(opt_sys),
+    do_aperture_check_(false)
+{
+
+}
+
+BatchedTrace::~BatchedTrace()
+{
+    opt_sys_ = nullptr;
+}
+
+int BatchedTrace::AddVariant(const std::vector<PathPerturbation> &perturbations)
+{
+    variants_.push_back(perturbations);
+    return variants_.size();
+}
+
+void BatchedTrace::ClearVariants()
+{
+    variants_.clear();
+}
+
+void BatchedTrace::apply(SurfaceRecord &rec, const PathPerturbation &p)
+{
+    switch (p.type) {
+    case PathPerturbation::Curvature:
+        rec.cv += p.delta;
+        break;
+    case PathPerturbation::Thickness:
+        rec.thickness += p.delta;
+        break;
+    case PathPerturbation::Conic:
+        if(rec.profile == 0){
+            // conic sphere is handled as an even polynomial without terms
+            rec.profile = 1;
+            rec.eps = 1.0e-8;
+        }
+        rec.conic += p.delta;
+        break;
+    case PathPerturbation::RefractiveIndex:
+        rec.refractive_index += p.delta;
+        break;
+    }
+}
+
+void BatchedTrace::apply(OpticalSystem *opt_sys, const PathPerturbation &p)
+{
+    switch (p.type) {
+    case PathPerturbation::Curvature:
+    {
+        SystemParameter cv(SystemParameter::Curvature, p.index);
+        cv.SetValue(opt_sys, cv.Value(opt_sys) + p.delta);
+        break;
+    }
+    case PathPerturbation::Thickness:
+    {
+        SystemParameter t(SystemParameter::Thickness, p.index);
+        t.SetValue(opt_sys, t.Value(opt_sys) + p.delta);
+        break;
+    }
+    case PathPerturbation::Conic:
+        // paraxial data, and so the launch, do not depend on the conic
+        break;
+    case PathPerturbation::RefractiveIndex:
+    {
+        // the material may be shared with other systems, so create a new one instead of modifying it
+        Gap* gap = opt_sys->GetOpticalAssembly()->GetGap(p.index);
+        gap->SetMaterial(std::make_shared<PerturbedMaterial>(gap->GetSharedMaterial(), p.delta));
+        break;
+    }
+    }
+}
+
+void BatchedTrace::Compile(double wvl)
+{
+    const OpticalAssembly* assembly = opt_sys_->GetOpticalAssembly();
+    const int img = assembly->ImageIndex();
+    const int num_gap = assembly->NumberOfGaps();
+    const int num_variants = NumberOfVariants();
+
+    path_.clear();
+    path_.resize(img+1);
+
+    for(int i = 0; i <= img; i++) {
+        const Surface* srf = assembly->GetSurface(i);
+        SurfaceRecord& rec = path_[i].nominal;
+
+        rec.cv = srf->Curvature();
+        rec.conic = 0.0;
+        rec.eps = 0.0;
+        rec.terms.clear();
+
+        if(srf->IsProfile<EvenPolynomial>()){
+            auto prf = srf->Profile<EvenPolynomial>();
+            rec.profile = 1;
+            rec.eps = prf->Tolerance();
+            rec.conic = prf->Conic();
+            for(int ti = 0; ti < prf->NumberOfTerms(); ti++){
+                rec.terms.push_back(prf->GetNthTerm(ti));
+            }
+        }else if(srf->IsProfile<OddPolynomial>()){
+            auto prf = srf->Profile<OddPolynomial>();
+            rec.profile = 2;
+            rec.eps = prf->Tolerance();
+            rec.conic = prf->Conic();
+            for(int ti = 0; ti < prf->NumberOfTerms(); ti++){
+                rec.terms.push_back(prf->GetNthTerm(ti));
+            }
+        }else{
+            rec.profile = 0;
+        }
+
+        if( i < num_gap ) {
+            rec.thickness        = assembly->GetGap(i)->Thickness();
+            rec.refractive_index = assembly->GetGap(i)->GetMaterial()->RefractiveIndex(wvl);
+        }else{
+            rec.thickness        = 0.0;
+            rec.refractive_index = 1.0;
+        }
+    }
+
+    // alternative records for perturbed surfaces only
+    fork_index_.assign(num_variants, 1);
+
+    for(int vi = 1; vi < num_variants; vi++){
+        int fork = img + 1;
+
+        for(const PathPerturbation& p : variants_[vi-1]){
+            if(p.index < 0 || p.index > img){
+                std::cerr << "BatchedTrace: index out of range: " << p.index << std::endl;
+                continue;
+            }
+
+            CompiledSurface& cs = path_[p.index];
+            if(cs.slot.empty()){
+                cs.slot.assign(num_variants, -1);
+            }
+            if(cs.slot[vi] < 0){
+                cs.slot[vi] = cs.perturbed.size();
+                cs.perturbed.push_back(cs.nominal);
+            }
+            apply(cs.perturbed[cs.slot[vi]], p);
+
+            // thickness changes the transfer to the next surface
+            int first_affected = (p.type == PathPerturbation::Thickness) ? p.index + 1 : p.index;
+            fork = std::min(fork, std::max(first_affected, 1));
+        }
+
+        fork_index_[vi] = fork;
+    }
+
+    variant_systems_.clear();
+    variant_systems_.resize(num_variants);
+
+    for(int vi = 1; vi < num_variants; vi++){
+        variant_systems_[vi] = opt_sys_->Clone();
+        for(const PathPerturbation& p : variants_[vi-1]){
+            if(p.index >= 0 && p.index <= img){
+                apply(variant_systems_[vi].get(), p);
+            }
+        }
+        variant_systems_[vi]->UpdateModel();
+    }
+}
+
+bool BatchedTrace::step(LaneState &lane, int srf_idx, int variant) const
+{
+    const SurfaceRecord& prev = path_[srf_idx-1].Record(variant);
+    const SurfaceRecord& rec  = path_[srf_idx].Record(variant);
+
+    // decenter is not supported, so the transform to the current surface is a translation along z
+    Eigen::Vector3d rel_before_pt = lane.pt;
+    rel_before_pt(2) -= prev.thickness;
+
+    double dist_from_before_to_perpendicular = -rel_before_pt.dot(lane.dir);
+    Eigen::Vector3d foot_of_perpendicular_pt = rel_before_pt + dist_from_before_to_perpendicular*lane.dir;
+
+    Eigen::Vector3d intersect_pt, srf_normal, after_dir;
+    double dist_from_perpendicular_to_intersect_pt;
+    bool intersected = false;
+
+    switch (rec.profile) {
+    case 1:
+        intersected = EvenPolynomial::Intersect<double>(intersect_pt, dist_from_perpendicular_to_intersect_pt, foot_of_perpendicular_pt, lane.dir, rec.cv, rec.conic, rec.terms, rec.eps);
+        srf_normal = EvenPolynomial::df<double>(intersect_pt, rec.cv, rec.conic, rec.terms);
+        break;
+    case 2:
+        intersected = OddPolynomial::Intersect<double>(intersect_pt, dist_from_perpendicular_to_intersect_pt, foot_of_perpendicular_pt, lane.dir, rec.cv, rec.conic, rec.terms, rec.eps);
+        srf_normal = OddPolynomial::df<double>(intersect_pt, rec.cv, rec.conic, rec.terms);
+        break;
+    default:
+        intersected = Spherical::Intersect<double>(intersect_pt, dist_from_perpendicular_to_intersect_pt, foot_of_perpendicular_pt, lane.dir, rec.cv);
+        srf_normal = Spherical::df<double>(intersect_pt, rec.cv);
+    }
+
+    if( !intersected ){
+        lane.status = TRACE_MISSEDSURFACE_ERROR;
+        return false;
+    }
+
+    srf_normal.normalize();
+
+    double distance_from_before = dist_from_before_to_perpendicular + dist_from_perpendicular_to_intersect_pt;
+
+    if( !SequentialTrace::Bend<double>(after_dir, lane.dir, srf_normal, lane.n_in, rec.refractive_index) ){
+        lane.status = TRACE_TIR_ERROR;
+        return false;
+    }
+
+    if(do_aperture_check_){
+        const OpticalAssembly* assembly = opt_sys_->GetOpticalAssembly();
+        if( !assembly->GetSurface(srf_idx)->PointInside(intersect_pt(0), intersect_pt(1)) ){
+            lane.status = TRACE_BLOCKED_ERROR;
+            return false;
+        }
+    }
+
+    // same range as Ray::OpticalPathLength()
+    const int img = path_.size() - 1;
+    if(srf_idx >= 2 && srf_idx < img){
+        lane.opl += lane.n_in*distance_from_before;
+    }
+
+    lane.pt   = intersect_pt;
+    lane.dir  = after_dir;
+    lane.n_in = rec.refractive_index;
+
+    return true;
+}
+
+void BatchedTrace::TraceBundle(BundleResult &result, const std::vector<Eigen::Vector3d> &pt0, const std::vector<Eigen::Vector3d> &dir0) const
+{
+    trace(result, pt0, dir0, {}, {});
+}
+
+void BatchedTrace::trace(BundleResult &result, const std::vector<Eigen::Vector3d> &pt0, const std::vector<Eigen::Vector3d> &dir0,
+                         const std::vector< std::vector<Eigen::Vector3d> > &variant_pt0, const std::vector< std::vector<Eigen::Vector3d> > &variant_dir0) const
+{
+    const int num_rays = std::min(pt0.size(), dir0.size());
+    const int num_variants = NumberOfVariants();
+    const int num_lanes = num_rays*num_variants;
+    const int path_size = path_.size();
+
+    result.num_rays = num_rays;
+    result.num_variants = num_variants;
+    result.intersect_pts.resize(num_lanes);
+    result.directions.resize(num_lanes);
+    result.opls.resize(num_lanes);
+    result.status.resize(num_lanes);
+
+    if(path_size < 2 || (int)fork_index_.size() != num_variants){
+        std::cerr << "BatchedTrace: path is not compiled" << std::endl;
+        std::fill(result.status.begin(), result.status.end(), TRACE_NOT_REACHED_ERROR);
+        return;
+    }
+
+    std::vector<LaneState> lanes(num_lanes);
+
+    // nominal lanes start from the object
+    for(int ri = 0; ri < num_rays; ri++){
+        LaneState& lane = lanes[ri];
+        lane.pt = pt0[ri];
+        lane.dir = dir0[ri];
+        lane.n_in = path_[0].nominal.refractive_index;
+        lane.opl = 0.0;
+        lane.status = TRACE_SUCCESS;
+    }
+
+    // variants with their own launch start from the object as well
+    std::vector<int> start_index(fork_index_);
+    std::vector<bool> own_launch(num_variants, false);
+    for(int vi = 1; vi < num_variants; vi++){
+        if(vi >= (int)variant_pt0.size() || variant_pt0[vi].empty()){
+            continue;
+        }
+        start_index[vi] = 1;
+        own_launch[vi] = true;
+        for(int ri = 0; ri < num_rays; ri++){
+            LaneState& lane = lanes[vi*num_rays + ri];
+            lane.pt = variant_pt0[vi][ri];
+            lane.dir = variant_dir0[vi][ri];
+            lane.n_in = path_[0].Record(vi).refractive_index;
+            lane.opl = 0.0;
+            lane.status = TRACE_SUCCESS;
+        }
+    }
+
+    auto fork = [&](int vi){
+        for(int ri = 0; ri < num_rays; ri++){
+            LaneState& lane = lanes[vi*num_rays + ri];
+            lane = lanes[ri];
+            lane.n_in = path_[std::min(fork_index_[vi], path_size) - 1].Record(vi).refractive_index;
+        }
+    };
+
+    // sweep surface by surface, so the records of a surface are reused by all lanes
+    for(int si = 1; si < path_size; si++){
+        for(int vi = 1; vi < num_variants; vi++){
+            if(fork_index_[vi] == si && !own_launch[vi]){
+                fork(vi);
+            }
+        }
+
+        for(int vi = 0; vi < num_variants; vi++){
+            if(start_index[vi] > si){
+                continue;
+            }
+            for(int ri = 0; ri < num_rays; ri++){
+                LaneState& lane = lanes[vi*num_rays + ri];
+                if(TRACE_SUCCESS == lane.status){
+                    step(lane, si, vi);
+                }
+            }
+        }
+    }
+
+    // variants identical to the nominal
+    for(int vi = 1; vi < num_variants; vi++){
+        if(fork_index_[vi] >= path_size && !own_launch[vi]){
+            fork(vi);
+        }
+    }
+
+    for(int li = 0; li < num_lanes; li++){
+        result.intersect_pts[li] = lanes[li].pt;
+        result.directions[li] = lanes[li].dir.normalized();
+        result.opls[li] = lanes[li].opl;
+        result.status[li] = lanes[li].status;
+    }
+}
+
+void BatchedTrace::TracePupilBundle(BundleResult &result, const std::vector<Eigen::Vector2d> &pupil_crds, const Field *fld) const
+{
+    const int num_rays = pupil_crds.size();
+    std::vector<Eigen::Vector3d> pt0(num_rays), dir0(num_rays);
+
+    SequentialTrace tracer(opt_sys_);
+    for(int ri = 0; ri < num_rays; ri++){
+        tracer.ConvertCoordinatePupilToObj(pt0[ri], dir0[ri], pupil_crds[ri], fld);
+    }
+
+    // launch from each perturbed system, kept only where it differs from the nominal so that the prefix is still shared
+    const int num_variants = NumberOfVariants();
+    std::vector< std::vector<Eigen::Vector3d> > variant_pt0(num_variants), variant_dir0(num_variants);
+
+    for(int vi = 1; vi < num_variants && vi < (int)variant_systems_.size(); vi++){
+        SequentialTrace variant_tracer(variant_systems_[vi].get());
+        std::vector<Eigen::Vector3d> vpt0(num_rays), vdir0(num_rays);
+        bool same = true;
+        for(int ri = 0; ri < num_rays; ri++){
+            variant_tracer.ConvertCoordinatePupilToObj(vpt0[ri], vdir0[ri], pupil_crds[ri], fld);
+            same = same && (vpt0[ri] == pt0[ri]) && (vdir0[ri] == dir0[ri]);
+        }
+        if( !same ){
+            variant_pt0[vi] = std::move(vpt0);
+            variant_dir0[vi] = std::move(vdir0);
+        }
+    }
+
+    trace(result, pt0, dir0, variant_pt0, variant_dir0);
+}
@@ -0,0 +1,412 @@
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+#include "sequential/differentiable_trace.h"
+#include "sequential/sequential_trace.h"
+#include "paraxial/paraxial_trace.h"
+
+using namespace geopter;
+
+DifferentiableTrace::DifferentiableTrace(OpticalSystem* opt_sys, const std::vector<SystemParameter>& params) :
+    opt_sys_(opt_sys),
+    params_(params)
+{
+
+}
+
+DifferentiableTrace::~DifferentiableTrace()
+{
+    opt_sys_ = nullptr;
+}
+
+int DifferentiableTrace::number_of_chunks() const
+{
+    const int num_params = params_.size();
+    return std::max(1, (num_params + ChunkSize - 1)/ChunkSize);
+}
+
+std::vector<DifferentiableTrace::PathRecord> DifferentiableTrace::compile_path(int chunk, double wvl) const
+{
+    const OpticalAssembly* assembly = opt_sys_->GetOpticalAssembly();
+    const int img = assembly->ImageIndex();
+    const int num_gap = assembly->NumberOfGaps();
+
+    std::vector<PathRecord> path(img+1);
+
+    for(int i = 0; i <= img; i++) {
+        const Surface* srf = assembly->GetSurface(i);
+        PathRecord& rec = path[i];
+
+        rec.cv = Scalar(srf->Curvature());
+        rec.conic = Scalar(0.0);
+        rec.eps = 0.0;
+        rec.terms.clear();
+
+        if(srf->IsProfile<EvenPolynomial>()){
+            auto prf = srf->Profile<EvenPolynomial>();
+            rec.profile = 1;
+            rec.eps = prf->Tolerance();
+            rec.conic = Scalar(prf->Conic());
+            for(int ti = 0; ti < prf->NumberOfTerms(); ti++){
+                rec.terms.push_back(Scalar(prf->GetNthTerm(ti)));
+            }
+        }else if(srf->IsProfile<OddPolynomial>()){
+            auto prf = srf->Profile<OddPolynomial>();
+            rec.profile = 2;
+            rec.eps = prf->Tolerance();
+            rec.conic = Scalar(prf->Conic());
+            for(int ti = 0; ti < prf->NumberOfTerms(); ti++){
+                rec.terms.push_back(Scalar(prf->GetNthTerm(ti)));
+            }
+        }else{
+            rec.profile = 0;
+        }
+
+        if( i < num_gap ) {
+            rec.thickness        = Scalar(assembly->GetGap(i)->Thickness());
+            rec.refractive_index = Scalar(assembly->GetGap(i)->GetMaterial()->RefractiveIndex(wvl));
+        }else{
+            rec.thickness        = Scalar(0.0);
+            rec.refractive_index = Scalar(1.0);
+        }
+    }
+
+    // seed parameters in the chunk
+    const int num_params = params_.size();
+    for(int j = 0; j < ChunkSize; j++){
+        int pi = chunk*ChunkSize + j;
+        if(pi >= num_params){
+            break;
+        }
+
+        const SystemParameter& prm = params_[pi];
+        int idx = prm.Index();
+        if(idx < 0 || idx > img){
+            continue;
+        }
+
+        double val = prm.Value(opt_sys_);
+
+        switch (prm.GetType()) {
+        case SystemParameter::Curvature:
+            path[idx].cv = Scalar::Variable(val, j);
+            break;
+        case SystemParameter::Thickness:
+            path[idx].thickness = Scalar::Variable(val, j);
+            break;
+        case SystemParameter::Conic:
+            if(path[idx].profile != 0){
+                path[idx].conic = Scalar::Variable(val, j);
+            }
+            break;
+        }
+    }
+
+    return path;
+}
+
+TraceError DifferentiableTrace::trace_path(std::vector<Vector3>& pts, std::vector<Vector3>& dirs, std::vector<Scalar>& opls,
+                                           const std::vector<PathRecord>& path, const Eigen::Vector3d& pt0, const Eigen::Vector3d& dir0) const
+{
+    using std::sqrt;
+
+    const int path_size = path.size();
+
+    pts.resize(path_size);
+    dirs.resize(path_size);
+    opls.resize(path_size);
+
+    Vector3 before_pt  = pt0.cast<Scalar>();
+    Vector3 before_dir = dir0.cast<Scalar>();
+    Vector3 intersect_pt, after_dir, rel_before_pt, foot_of_perpendicular_pt, srf_normal;
+    Scalar n_in = path[0].refractive_index;
+    Scalar n_out;
+    Scalar transfer_z = path[0].thickness;
+
+    pts[0]  = before_pt;
+    dirs[0] = before_dir;
+    opls[0] = Scalar(0.0);
+
+    for(int cur_srf_idx = 1; cur_srf_idx < path_size; cur_srf_idx++) {
+        const PathRecord& rec = path[cur_srf_idx];
+
+        // decenter is not supported, so the transform to the current surface is a translation along z
+        rel_before_pt = before_pt;
+        rel_before_pt(2) -= transfer_z;
+
+        Scalar dist_from_before_to_perpendicular = -rel_before_pt.dot(before_dir);
+        foot_of_perpendicular_pt = rel_before_pt + dist_from_before_to_perpendicular*before_dir;
+
+        Scalar dist_from_perpendicular_to_intersect_pt;
+        bool intersected = false;
+
+        switch (rec.profile) {
+        case 1:
+            intersected = EvenPolynomial::Intersect<Scalar>(intersect_pt, dist_from_perpendicular_to_intersect_pt, foot_of_perpendicular_pt, before_dir, rec.cv, rec.conic, rec.terms, rec.eps);
+            srf_normal = EvenPolynomial::df<Scalar>(intersect_pt, rec.cv, rec.conic, rec.terms);
+            break;
+        case 2:
+            intersected = OddPolynomial::Intersect<Scalar>(intersect_pt, dist_from_perpendicular_to_intersect_pt, foot_of_perpendicular_pt, before_dir, rec.cv, rec.conic, rec.terms, rec.eps);
+            srf_normal = OddPolynomial::df<Scalar>(intersect_pt, rec.cv, rec.conic, rec.terms);
+            break;
+        default:
+            intersected = Spherical::Intersect<Scalar>(intersect_pt, dist_from_perpendicular_to_intersect_pt, foot_of_perpendicular_pt, before_dir, rec.cv);
+            srf_normal = Spherical::df<Scalar>(intersect_pt, rec.cv);
+        }
+
+        if( !intersected ){
+            return TRACE_MISSEDSURFACE_ERROR;
+        }
+
+        srf_normal /= sqrt(srf_normal.dot(srf_normal));
+
+        Scalar distance_from_before = dist_from_before_to_perpendicular + dist_from_perpendicular_to_intersect_pt;
+
+        n_out = rec.refractive_index;
+        if( !SequentialTrace::Bend<Scalar>(after_dir, before_dir, srf_normal, n_in, n_out) ){
+            return TRACE_TIR_ERROR;
+        }
+
+        pts[cur_srf_idx]  = intersect_pt;
+        dirs[cur_srf_idx] = after_dir/sqrt(after_dir.dot(after_dir));
+        opls[cur_srf_idx] = n_in*distance_from_before;
+
+        before_pt  = intersect_pt;
+        before_dir = after_dir;
+        n_in       = n_out;
+        transfer_z = rec.thickness;
+    }
+
+    return TRACE_SUCCESS;
+}
+
+TraceError DifferentiableTrace::TraceRay(RayDerivative &result, const Eigen::Vector3d &pt0, const Eigen::Vector3d &dir0, double wvl)
+{
+    const int num_params = params_.size();
+    const int num_chunks = number_of_chunks();
+
+    result.intersect_pt_grad.resize(3, num_params);
+    result.direction_grad.resize(3, num_params);
+    result.opl_grad.resize(num_params);
+
+    std::vector<Vector3> pts, dirs;
+    std::vector<Scalar> opls;
+
+    for(int chunk = 0; chunk < num_chunks; chunk++){
+        std::vector<PathRecord> path = compile_path(chunk, wvl);
+
+        TraceError trace_result = trace_path(pts, dirs, opls, path, pt0, dir0);
+        if(TRACE_SUCCESS != trace_result){
+            return trace_result;
+        }
+
+        // same range as Ray::OpticalPathLength()
+        const int last = pts.size() - 1;
+        Scalar opl(0.0);
+        for(int i = 2; i < last; i++){
+            opl += opls[i];
+        }
+
+        if(chunk == 0){
+            for(int c = 0; c < 3; c++){
+                result.intersect_pt(c) = pts[last](c).a;
+                result.direction(c) = dirs[last](c).a;
+            }
+            result.opl = opl.a;
+        }
+
+        for(int j = 0; j < ChunkSize; j++){
+            int pi = chunk*ChunkSize + j;
+            if(pi >= num_params){
+                break;
+            }
+            for(int c = 0; c < 3; c++){
+                result.intersect_pt_grad(c, pi) = pts[last](c).v(j);
+                result.direction_grad(c, pi) = dirs[last](c).v(j);
+            }
+            result.opl_grad(pi) = opl.v(j);
+        }
+    }
+
+    return TRACE_SUCCESS;
+}
+
+TraceError DifferentiableTrace::TracePupilRay(RayDerivative &result, const Eigen::Vector2d &pupil_crd, const Field *fld, double wvl)
+{
+    Eigen::Vector3d pt0, dir0;
+
+    SequentialTrace tracer(opt_sys_);
+    tracer.ConvertCoordinatePupilToObj(pt0, dir0, pupil_crd, fld);
+
+    return TraceRay(result, pt0, dir0, wvl);
+}
+
+TraceError DifferentiableTrace::WavefrontAberration(double &opd, Eigen::RowVectorXd &opd_grad, const Eigen::Vector2d &pupil_crd, const Field *fld, double wvl)
+{
+    using std::sqrt;
+
+    const int num_params = params_.size();
+    const int num_chunks = number_of_chunks();
+
+    opd = NAN;
+    opd_grad.resize(num_params);
+
+    Eigen::Vector3d pt0, dir0, chief_pt0, chief_dir0;
+
+    SequentialTrace tracer(opt_sys_);
+    tracer.ConvertCoordinatePupilToObj(pt0, dir0, pupil_crd, fld);
+    tracer.ConvertCoordinatePupilToObj(chief_pt0, chief_dir0, Eigen::Vector2d::Zero(), fld);
+
+    const OpticalAssembly* assembly = opt_sys_->GetOpticalAssembly();
+    const int img = assembly->ImageIndex();
+    const int k = img - 1;
+    const double exp_dist_parax = opt_sys_->GetFirstOrderData()->exit_pupil_distance;
+    const double img_dist = opt_sys_->GetFirstOrderData()->image_distance;
+
+    const double ref_wvl_val = opt_sys_->GetOpticalSpec()->GetWavelengthSpec()->ReferenceWavelength();
+    const double n_img = fabs(assembly->ImageSpaceGap()->GetMaterial()->RefractiveIndex(ref_wvl_val));
+    const double n_obj = fabs(assembly->GetGap(0)->GetMaterial()->RefractiveIndex(ref_wvl_val));
+
+    auto eic_distance = [](const Vector3& p, const Vector3& d, const Vector3& p0, const Vector3& d0){
+        return Scalar( (d + d0).dot(p - p0) / ( 1.0 + d.dot(d0) ) );
+    };
+
+    std::vector<Vector3> pts, dirs, chief_pts, chief_dirs;
+    std::vector<Scalar> opls, chief_opls;
+
+    for(int chunk = 0; chunk < num_chunks; chunk++){
+        std::vector<PathRecord> path = compile_path(chunk, wvl);
+
+        TraceError trace_result = trace_path(chief_pts, chief_dirs, chief_opls, path, chief_pt0, chief_dir0);
+        if(TRACE_SUCCESS != trace_result){
+            return trace_result;
+        }
+
+        trace_result = trace_path(pts, dirs, opls, path, pt0, dir0);
+        if(TRACE_SUCCESS != trace_result){
+            return trace_result;
+        }
+
+        // chief ray intersection with exit pupil
+        Scalar h = chief_pts[k](1);
+        Scalar u = chief_dirs[k](1);
+        constexpr double eps = 1.0e-14;
+
+        Scalar cr_exp_dist;
+        if(fabs(u.a) < eps){
+            cr_exp_dist = Scalar(exp_dist_parax);
+        }else{
+            cr_exp_dist = -h/u;
+        }
+        Vector3 cr_exp_pt = chief_pts[k] + cr_exp_dist*chief_dirs[k];
+
+        // reference sphere centered at the chief ray image point
+        // the image distance is taken from the first order data as in WaveAberration, so that a solve on the image gap is
+        // respected, while the derivative is kept in case the image gap is a variable
+        Scalar img_gap = path[img-1].thickness;
+        img_gap.a = img_dist;
+
+        Vector3 img_pt = chief_pts[img];
+        img_pt(2) += img_gap;
+
+        Vector3 ref_sphere_vec = img_pt - cr_exp_pt;
+        Scalar ref_sphere_radius = sqrt(ref_sphere_vec.dot(ref_sphere_vec));
+        Vector3 ref_dir = ref_sphere_vec/ref_sphere_radius;
+
+        // opd
+        Scalar e1  = eic_distance(pts[1], dirs[0], chief_pts[1], chief_dirs[0]);
+        Scalar ekp = eic_distance(pts[k], dirs[k], chief_pts[k], chief_dirs[k]);
+
+        Scalar dst = ekp - cr_exp_dist;
+        Vector3 eic_exp_pt = pts[k] - dst*dirs[k];
+        Vector3 p_coord = eic_exp_pt - cr_exp_pt;
+
+        Scalar F = ref_dir.dot(dirs[k]) - dirs[k].dot(p_coord)/ref_sphere_radius;
+        Scalar J = p_coord.dot(p_coord)/ref_sphere_radius - 2.0*ref_dir.dot(p_coord);
+
+        double soln = ref_dir(2).a*chief_dirs[img](2).a;
+        double sign_soln = (soln > 0.0) - (soln < 0.0);
+        Scalar denom = F + sign_soln*sqrt( F*F + J/ref_sphere_radius );
+        Scalar ep;
+        if(fabs(denom.a) < std::numeric_limits<double>::epsilon()){
+            ep = Scalar(0.0);
+        }else{
+            ep = J/denom;
+        }
+
+        const int last = img;
+        Scalar ray_op(0.0), chief_ray_op(0.0);
+        for(int i = 2; i < last; i++){
+            ray_op += opls[i];
+            chief_ray_op += chief_opls[i];
+        }
+
+        Scalar opd_chunk = -n_obj*e1 - ray_op + n_img*ekp + chief_ray_op - n_img*ep;
+
+        if(chunk == 0){
+            opd = opd_chunk.a;
+        }
+
+        for(int j = 0; j < ChunkSize; j++){
+            int pi = chunk*ChunkSize + j;
+            if(pi >= num_params){
+                break;
+            }
+            opd_grad(pi) = opd_chunk.v(j);
+        }
+    }
+
+    return TRACE_SUCCESS;
+}
+
+bool DifferentiableTrace::EffectiveFocalLength(double &efl, Eigen::RowVectorXd &efl_grad)
+{
+    const int num_params = params_.size();
+    const int num_chunks = number_of_chunks();
+    const double ref_wvl = opt_sys_->GetOpticalSpec()->GetWavelengthSpec()->ReferenceWavelength();
+    const int img = opt_sys_->GetOpticalAssembly()->ImageIndex();
+
+    efl = NAN;
+    efl_grad.resize(num_params);
+
+    for(int chunk = 0; chunk < num_chunks; chunk++){
+        std::vector<PathRecord> path = compile_path(chunk, ref_wvl);
+
+        const int path_size = path.size();
+        std::vector<Scalar> c(path_size), t(path_size), n(path_size);
+        for(int i = 0; i < path_size; i++){
+            c[i] = path[i].cv;
+            t[i] = path[i].thickness;
+            n[i] = path[i].refractive_index;
+        }
+
+        // parallel ray of unit height entering the first surface
+        t[0] = Scalar(0.0);
+
+        std::vector<Scalar> y, u_prime, i;
+        ParaxialTrace::TraceParaxialRay<Scalar>(y, u_prime, i, c, t, n, Scalar(1.0), Scalar(0.0));
+
+        Scalar ck1 = n[img-1]*u_prime[img-1];
+        if(fabs(ck1.a) < std::numeric_limits<double>::epsilon()){
+            std::cerr << "DifferentiableTrace: afocal system" << std::endl;
+            return false;
+        }
+
+        Scalar efl_chunk = -1.0/ck1;
+
+        if(chunk == 0){
+            efl = efl_chunk.a;
+        }
+
+        for(int j = 0; j < ChunkSize; j++){
+            int pi = chunk*ChunkSize + j;
+            if(pi >= num_params){
+                break;
+            }
+            efl_grad(pi) = efl_chunk.v(j);
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,21 @@
+#include "sequential/ray_snapshot.h"
+
+using namespace geopter;
+
+RaySnapshot::RaySnapshot() :
+    surface_index_(0),
+    wvl_(0.0)
+{
+
+}
+
+RaySnapshot::~RaySnapshot()
+{
+    Clear();
+}
+
+void RaySnapshot::Clear()
+{
+    states_.clear();
+    upstream_rays_.clear();
+}
@@ -62,7 +62,7 @@ void SequentialPath::Append(SequentialPathComponent seq_path_comp)
     array_size_ += 1;
 }
 
-void SequentialPath::Append(Surface *s, double thi, double n)
+void SequentialPath::Append(const Surface *s, double thi, double n)
 {
     seq_path_comps_.emplace_back( SequentialPathComponent(s, thi, n) );
     array_size_ += 1;
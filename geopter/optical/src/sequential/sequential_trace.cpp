@@ -58,7 +58,7 @@ void SequentialTrace::ConvertCoordinatePupilToObj(Eigen::Vector3d& pt0, Eigen::V
     double eprad = opt_sys_->GetFirstOrderData()->entrance_pupil_radius;
     Eigen::Vector2d aim_pt = fld->AimPt();
 
-    double obj_dist = opt_sys_->GetOpticalAssembly()->GetGap(0)->Thickness();
+    double obj_dist = assembly()->GetGap(0)->Thickness();
     double enp_dist = opt_sys_->GetFirstOrderData()->entrance_pupil_distance;
 
     pt0 = this->GetDefaultObjectPt(fld);
@@ -94,9 +94,86 @@ RayPtr SequentialTrace::CreatePupilRay(const Eigen::Vector2d &pupil_crd, const F
     return ray;
 }
 
+void SequentialTrace::CaptureSnapshot(RaySnapshot &snapshot, int srf_idx, const std::vector<Eigen::Vector2d> &pupils, const Field *fld, double wvl)
+{
+    SequentialPath upstream_path = CreateSequentialPath(0, srf_idx, wvl);
+    const int num_rays = pupils.size();
+
+    snapshot.Clear();
+    snapshot.surface_index_ = srf_idx;
+    snapshot.wvl_ = wvl;
+    snapshot.states_.resize(num_rays);
+    snapshot.upstream_rays_.resize(num_rays);
+
+    for(int i = 0; i < num_rays; i++){
+        auto ray = std::make_shared<Ray>(upstream_path.Size());
+        RayState& state = snapshot.states_[i];
+
+        state.status = TracePupilRay(ray, upstream_path, pupils[i], fld, wvl);
+
+        const RaySegment* seg = ray->GetBack();
+        state.intersect_pt = seg->IntersectPt();
+        state.direction = seg->Direction();
+        state.refractive_index = upstream_path.At(upstream_path.Size()-1).refractive_index;
+
+        state.opl = 0.0;
+        for(int si = 2; si <= srf_idx; si++){
+            state.opl += ray->GetSegmentAt(si)->OpticalPathLength();
+        }
+
+        snapshot.upstream_rays_[i] = ray;
+    }
+}
+
+TraceError SequentialTrace::ResumeRay(RayPtr ray, const SequentialPath &downstream_path, const RaySnapshot &snapshot, int i)
+{
+    const int srf_idx = snapshot.SurfaceIndex();
+    const int num_segs = srf_idx + downstream_path.Size();
+
+    if(ray->NumberOfSegments() != num_segs){
+        ray->Allocate(num_segs);
+    }
+
+    const Ray* upstream_ray = snapshot.UpstreamRay(i);
+    ray->SetPupilCoordinate(upstream_ray->PupilCoordinate());
+    ray->SetWavelength(upstream_ray->Wavelength());
+
+    for(int si = 0; si <= srf_idx; si++){
+        const RaySegment* src = upstream_ray->GetSegmentAt(si);
+        RaySegment* dst = ray->GetSegmentAt(si);
+        dst->SetData(src->IntersectPt(), src->SurfaceNormal(), src->Direction(), src->PathLength(), src->OpticalPathLength());
+        dst->SetStatus(src->Status());
+    }
+
+    const RayState& state = snapshot.StateAt(i);
+    if(state.status != TRACE_SUCCESS){
+        ray->SetStatus(state.status);
+        ray->SetReachedSurfaceIndex(upstream_ray->GetReachedSurfaceIndex());
+        return state.status;
+    }
+
+    return trace_from(ray, downstream_path, srf_idx, state.intersect_pt, state.direction);
+}
+
+void SequentialTrace::ResumeFromSnapshot(std::vector<RayPtr> &rays, const RaySnapshot &snapshot)
+{
+    const int img = assembly()->ImageIndex();
+    SequentialPath downstream_path = CreateSequentialPath(snapshot.SurfaceIndex(), img, snapshot.Wavelength());
+
+    const int num_rays = snapshot.NumberOfRays();
+    rays.resize(num_rays);
+
+    for(int i = 0; i < num_rays; i++){
+        if(!rays[i]){
+            rays[i] = std::make_shared<Ray>(img+1);
+        }
+        ResumeRay(rays[i], downstream_path, snapshot, i);
+    }
+}
+
 bool SequentialTrace::TraceReferenceRays(std::vector<RayPtr> &ref_rays, const Field *fld, double wvl)
 {
-    const int num_srfs = opt_sys_->GetOpticalAssembly()->NumberOfSurfaces();
+    const int num_srfs = assembly()->NumberOfSurfaces();
 
     SequentialPath seq_path = CreateSequentialPath(wvl);
 
@@ -131,8 +208,20 @@ TraceError SequentialTrace::TraceRayThroughoutPath(RayPtr ray, const SequentialP
         ray->Allocate(path_size);
     }
 
-    Eigen::Vector3d before_pt  = pt0;
-    Eigen::Vector3d before_dir = dir0;
+    // first surface
+    Eigen::Vector3d srf_normal_1st = seq_path.At(0).surface->Normal(pt0);
+    ray->GetSegmentAt(0)->SetData(pt0, srf_normal_1st, dir0, 0.0, 0.0);
+
+    return trace_from(ray, seq_path, 0, pt0, dir0);
+}
+
+
+TraceError SequentialTrace::trace_from(RayPtr ray, const SequentialPath &seq_path, int seg_offset, const Eigen::Vector3d &pt, const Eigen::Vector3d &dir)
+{
+    const int path_size = seq_path.Size();
+
+    Eigen::Vector3d before_pt  = pt;
+    Eigen::Vector3d before_dir = dir;
     Eigen::Vector3d intersect_pt;
     Eigen::Vector3d after_dir;
     double distance_from_before = 0.0;
@@ -145,11 +234,6 @@ TraceError SequentialTrace::TraceRayThroughoutPath(RayPtr ray, const SequentialP
     //constexpr double z_dir = 1.0; // used for reflection, not yet implemented
 
 
-    // first surface
-    Eigen::Vector3d srf_normal_1st = seq_path.At(0).surface->Normal(pt0);
-    ray->GetSegmentAt(0)->SetData(pt0, srf_normal_1st, dir0, 0.0, 0.0);
-
-
     // trace ray throughout the path till the image
     Eigen::Matrix3d rt;
     Eigen::Vector3d t, rel_before_pt, rel_before_dir, foot_of_perpendicular_pt, srf_normal;
@@ -166,13 +250,13 @@ TraceError SequentialTrace::TraceRayThroughoutPath(RayPtr ray, const SequentialP
         double dist_from_before_to_perpendicular = -rel_before_pt.dot(rel_before_dir); // distance from previous point to foot of perpendicular
         foot_of_perpendicular_pt = rel_before_pt + dist_from_before_to_perpendicular*rel_before_dir; // foot of perpendicular from the current surface apex to the incident ray line
 
-        Surface* cur_srf = seq_path.At(cur_srf_idx).surface;
+        const Surface* cur_srf = seq_path.At(cur_srf_idx).surface;
         double dist_from_perpendicular_to_intersect_pt; // distance from the foot of perpendicular to the intersect point
 
         if( ! cur_srf->Intersect(intersect_pt, dist_from_perpendicular_to_intersect_pt, foot_of_perpendicular_pt, rel_before_dir) ){
             ray->SetStatus(TRACE_MISSEDSURFACE_ERROR);
-            ray->SetReachedSurfaceIndex(cur_srf_idx - 1);
-            ray->GetSegmentAt(cur_srf_idx)->SetStatus(TRACE_MISSEDSURFACE_ERROR);
+            ray->SetReachedSurfaceIndex(seg_offset + cur_srf_idx - 1);
+            ray->GetSegmentAt(seg_offset + cur_srf_idx)->SetStatus(TRACE_MISSEDSURFACE_ERROR);
             return TRACE_MISSEDSURFACE_ERROR;
         }
 
@@ -182,22 +266,22 @@ TraceError SequentialTrace::TraceRayThroughoutPath(RayPtr ray, const SequentialP
         srf_normal = cur_srf->Normal(intersect_pt); // surface normal at the intersect point
         if( ! Bend(after_dir ,before_dir, srf_normal, n_in, n_out) ){
             ray->SetStatus(TRACE_TIR_ERROR);
-            ray->SetReachedSurfaceIndex(cur_srf_idx);
-            ray->GetSegmentAt(cur_srf_idx)->SetData(intersect_pt, srf_normal, after_dir.normalized(),distance_from_before, opl);
-            ray->GetSegmentAt(cur_srf_idx)->SetStatus(TRACE_TIR_ERROR);
+            ray->SetReachedSurfaceIndex(seg_offset + cur_srf_idx);
+            ray->GetSegmentAt(seg_offset + cur_srf_idx)->SetData(intersect_pt, srf_normal, after_dir.normalized(),distance_from_before, opl);
+            ray->GetSegmentAt(seg_offset + cur_srf_idx)->SetStatus(TRACE_TIR_ERROR);
             return TRACE_TIR_ERROR;
         }
 
         opl = n_in * distance_from_before;
 
-        ray->GetSegmentAt(cur_srf_idx)->SetData(intersect_pt, srf_normal, after_dir.normalized(),distance_from_before, opl);
-        ray->GetSegmentAt(cur_srf_idx)->SetStatus(TRACE_SUCCESS);
+        ray->GetSegmentAt(seg_offset + cur_srf_idx)->SetData(intersect_pt, srf_normal, after_dir.normalized(),distance_from_before, opl);
+        ray->GetSegmentAt(seg_offset + cur_srf_idx)->SetStatus(TRACE_SUCCESS);
 
         if(do_aperture_check_) {
             if( !cur_srf->PointInside(intersect_pt(0),intersect_pt(1)) ){
                 ray->SetStatus(TRACE_BLOCKED_ERROR);
-                ray->SetReachedSurfaceIndex(cur_srf_idx);
-                ray->GetSegmentAt(cur_srf_idx)->SetStatus(TRACE_BLOCKED_ERROR);
+                ray->SetReachedSurfaceIndex(seg_offset + cur_srf_idx);
+                ray->GetSegmentAt(seg_offset + cur_srf_idx)->SetStatus(TRACE_BLOCKED_ERROR);
                 return TRACE_BLOCKED_ERROR;
             }
         }
@@ -211,8 +295,8 @@ TraceError SequentialTrace::TraceRayThroughoutPath(RayPtr ray, const SequentialP
     //op_delta += opl;
 
     ray->SetStatus(TRACE_SUCCESS);
-    ray->SetReachedSurfaceIndex(path_size-1);
-    ray->GetSegmentAt(path_size-1)->SetStatus(TRACE_SUCCESS);
+    ray->SetReachedSurfaceIndex(seg_offset + path_size-1);
+    ray->GetSegmentAt(seg_offset + path_size-1)->SetStatus(TRACE_SUCCESS);
 
     return TRACE_SUCCESS;
 }
@@ -266,7 +350,7 @@ bool SequentialTrace::TraceCoddington(Eigen::Vector2d &s_t, const std::shared_pt
         cosU_prime = ray->GetSegmentAt(i)->N();
         double sinU = sqrt(1.0 - cosU*cosU);
 
-        Surface* surf = path.At(i).surface;
+        const Surface* surf = path.At(i).surface;
         if (surf->IsProfile<Spherical>()) {
             double c = surf->Curvature();
             obl_pwr_s = c*(n_after*cosI_prime - n_before*cosI);
@@ -316,7 +400,7 @@ bool SequentialTrace::TraceCoddington(Eigen::Vector2d &s_t, const std::shared_pt
 
 
     // Closing Equation
-    double img_dist = opt_sys_->GetOpticalAssembly()->ImageSpaceGap()->Thickness();
+    double img_dist = assembly()->ImageSpaceGap()->Thickness();
 
     double z = ray->GetSegmentAt(ray->NumberOfSegments()-1-1)->Z();
 
@@ -331,33 +415,33 @@ bool SequentialTrace::TraceCoddington(Eigen::Vector2d &s_t, const std::shared_pt
 
 SequentialPath SequentialTrace::CreateSequentialPath(double wvl)
 {
-    const int img = opt_sys_->GetOpticalAssembly()->ImageIndex();
+    const int img = assembly()->ImageIndex();
     return CreateSequentialPath(0, img, wvl);
 }
 
 SequentialPath SequentialTrace::CreateSequentialPath(int start, int end, double wvl)
 {
-    const int img = opt_sys_->GetOpticalAssembly()->ImageIndex();
+    [[maybe_unused]] const int img = assembly()->ImageIndex();
 
     assert(end <= img);
 
     SequentialPath path;
     SequentialPathComponent path_comp;
 
-    const int num_srf = opt_sys_->GetOpticalAssembly()->NumberOfSurfaces();
+    const int num_srf = assembly()->NumberOfSurfaces();
     const int num_gap = num_srf -1;
 
     for(int i = start; i <= end; i++)
     {
         if ( i < num_srf ) {
-            path_comp.surface = opt_sys_->GetOpticalAssembly()->GetSurface(i);
+            path_comp.surface = assembly()->GetSurface(i);
         }else{
             path_comp.surface = nullptr;
         }
 
         if( i < num_gap ) {
-            path_comp.distance         = opt_sys_->GetOpticalAssembly()->GetGap(i)->Thickness();
-            path_comp.refractive_index = opt_sys_->GetOpticalAssembly()->GetGap(i)->GetMaterial()->RefractiveIndex(wvl);
+            path_comp.distance         = assembly()->GetGap(i)->Thickness();
+            path_comp.refractive_index = assembly()->GetGap(i)->GetMaterial()->RefractiveIndex(wvl);
         }else {
             path_comp.distance         = 0.0;
             path_comp.refractive_index = 1.0;
@@ -373,7 +457,7 @@ SequentialPath SequentialTrace::CreateSequentialPath(int start, int end, double
 
 bool SequentialTrace::AimChiefRay(Eigen::Vector2d& aim_pt, Eigen::Vector3d& obj_pt, const Field *fld, double wvl)
 {
-    int stop = opt_sys_->GetOpticalAssembly()->StopIndex();
+    int stop = assembly()->StopIndex();
     Eigen::Vector2d xy_target({0.0, 0.0});
 
     SequentialPath seq_path = CreateSequentialPath(wvl);
@@ -398,7 +482,7 @@ bool SequentialTrace::SearchRayAimingAtSurface(RayPtr ray, Eigen::Vector2d& aim_
     //const int fld_type = opt_sys_->optical_spec()->field_of_view()->field_type();
     double ref_wvl = opt_sys_->GetOpticalSpec()->GetWavelengthSpec()->ReferenceWavelength();
 
-    double obj_dist = opt_sys_->GetOpticalAssembly()->GetGap(0)->Thickness();
+    double obj_dist = assembly()->GetGap(0)->Thickness();
     double enp_dist = opt_sys_->GetFirstOrderData()->entrance_pupil_distance;
 
     SequentialPath seq_path = CreateSequentialPath(ref_wvl);
@@ -503,23 +587,7 @@ bool SequentialTrace::SearchRayAimingAtSurface(RayPtr ray, Eigen::Vector2d& aim_
 
 bool SequentialTrace::Bend(Eigen::Vector3d& d_out, const Eigen::Vector3d& d_in, const Eigen::Vector3d& normal, double n_in, double n_out)
 {
-
-    double normal_len = normal.norm();
-    double cosI = d_in.dot(normal)/normal_len;
-    double sinI_sqr = 1.0 - cosI*cosI;
-
-    double inside_sqrt = n_out*n_out - n_in*n_in*sinI_sqr;
-    if(inside_sqrt < 0.0){
-        return false;
-    }
-
-    double cosI_sgn = (cosI > 0.0) - (cosI < 0.0);
-    //double n_cosIp = sqrt(n_out*n_out - n_in*n_in*sinI_sqr) * cosI_sgn;
-    double n_cosIp = sqrt( inside_sqrt ) * cosI_sgn;
-    double alpha = n_cosIp - n_in*cosI;
-    d_out = (n_in*d_in + alpha*normal)/n_out;
-
-    return true;
+    return Bend<double>(d_out, d_in, normal, n_in, n_out);
 }
 
 Eigen::Vector3d SequentialTrace::GetDefaultObjectPt(const Field* fld)
@@ -574,10 +642,10 @@ std::vector<double> SequentialTrace::ComputeVignettingFactors(const Field& fld)
     std::vector<double> vig_factors = std::vector<double>( {vuy, vly, vux, vlx} );
 
     // check whether optical system has apertures
-    const int img = opt_sys_->GetOpticalAssembly()->NumberOfSurfaces() - 1;
+    const int img = assembly()->NumberOfSurfaces() - 1;
     bool has_aperture = false;
     for(int i = 0; i < img-1; i++){
-        if( ! opt_sys_->GetOpticalAssembly()->GetSurface(i)->IsAperture<NoneAperture>()){
+        if( ! assembly()->GetSurface(i)->IsAperture<NoneAperture>()){
             has_aperture = true;
             break;
         }
@@ -618,8 +686,8 @@ double SequentialTrace::ComputeVignettingFactorForPupil(const Eigen::Vector2d& f
     constexpr double eps = 1.0e-5;
     constexpr int max_loop_cnt = 30;
 
-    const int stop_index = opt_sys_->GetOpticalAssembly()->StopIndex();
-    const double stop_radius = opt_sys_->GetOpticalAssembly()->GetSurface(stop_index)->MaxAperture();
+    const int stop_index = assembly()->StopIndex();
+    const double stop_radius = assembly()->GetSurface(stop_index)->MaxAperture();
 
     const double ref_wvl = opt_sys_->GetOpticalSpec()->GetWavelengthSpec()->ReferenceWavelength();
     SequentialPath path = CreateSequentialPath(ref_wvl);
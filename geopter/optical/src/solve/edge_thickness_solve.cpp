@@ -54,8 +54,9 @@ void EdgeThicknessSolve::Apply(OpticalSystem* opt_sys)
 {
     int s1 = gap_index_;
     int s2 = s1+1;
-    double sag1 = opt_sys->GetOpticalAssembly()->GetSurface(s1)->Sag(0.0, radial_height_);
-    double sag2 = opt_sys->GetOpticalAssembly()->GetSurface(s2)->Sag(0.0, radial_height_);
+    const OpticalAssembly* assembly = opt_sys->GetOpticalAssembly();
+    double sag1 = assembly->GetSurface(s1)->Sag(0.0, radial_height_);
+    double sag2 = assembly->GetSurface(s2)->Sag(0.0, radial_height_);
 
     double thi = thickness_ - ( -sag1 + sag2); //et = -sag1 + thi + sag2;
 
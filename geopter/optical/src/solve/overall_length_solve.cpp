@@ -57,8 +57,9 @@ bool OverallLengthSolve::Check(const OpticalSystem *opt_sys)
 
 void OverallLengthSolve::Apply(OpticalSystem *opt_sys)
 {
-    double cur_oal = opt_sys->GetOpticalAssembly()->OverallLength(surface1_, surface2_);
-    double cur_thi = opt_sys->GetOpticalAssembly()->GetGap(gap_index_)->Thickness();
+    const OpticalAssembly* assembly = opt_sys->GetOpticalAssembly();
+    double cur_oal = assembly->OverallLength(surface1_, surface2_);
+    double cur_thi = assembly->GetGap(gap_index_)->Thickness();
     double new_thi = (value_ - cur_oal) + cur_thi;
 
     opt_sys->GetOpticalAssembly()->GetGap(gap_index_)->SetThickness(new_thi);
@@ -75,6 +76,6 @@ void OverallLengthSolve::GetParameters(double *param1, double *param2, double *p
 {
     *param1 = static_cast<double>(surface1_);
     *param2 = static_cast<double>(surface2_);
-    param3 = nullptr;
+    *param3 = value_;
     param4 = nullptr;
 }
@@ -17,17 +17,22 @@ If not, see <https://www.gnu.org/licenses/>.
 
 using namespace geopter;
 
-PickupSolve::PickupSolve(Gap* gap)
+PickupSolve::PickupSolve(int gi)
 {
-    gap_ = gap;
     solve_type_ = Solve::SolveType::Pickup;
+    gap_index_ = gi;
+    from_gap_index_ = 0;
+    scale_ = 1.0;
+    offset_ = 0.0;
 }
 
 void PickupSolve::Apply(OpticalSystem *opt_sys)
 {
-    double from_thi = opt_sys->GetOpticalAssembly()->GetGap(from_gap_index_)->Thickness();
+    // the gap is looked up by index, so that a clone of the solve applies to the system it is applied to
+    const OpticalAssembly* assembly = opt_sys->GetOpticalAssembly();
+    double from_thi = assembly->GetGap(from_gap_index_)->Thickness();
     double dst_thi = from_thi*scale_ + offset_;
-    gap_->SetThickness(dst_thi);
+    opt_sys->GetOpticalAssembly()->GetGap(gap_index_)->SetThickness(dst_thi);
 }
 
 void PickupSolve::SetParameters(double param1, double param2, double param3, double /*param4*/)
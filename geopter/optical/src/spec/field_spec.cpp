@@ -105,6 +105,20 @@ void FieldSpec::clear()
     max_field_ = 0.0;
 }
 
+void FieldSpec::CopyFrom(const FieldSpec &other)
+{
+    field_type_ = other.field_type_;
+
+    fields_.clear();
+    fields_.reserve(other.fields_.size());
+    for(auto& f : other.fields_){
+        fields_.push_back(std::make_unique<Field>(*f));
+    }
+
+    max_field_  = other.max_field_;
+    num_fields_ = other.num_fields_;
+}
+
 
 void FieldSpec::print()
 {
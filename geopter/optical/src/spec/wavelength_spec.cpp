@@ -115,6 +115,21 @@ void WavelengthSpec::clear()
     max_weight_ = 1.0;
 }
 
+void WavelengthSpec::CopyFrom(const WavelengthSpec &other)
+{
+    wvls_.clear();
+    wvls_.reserve(other.wvls_.size());
+    for(auto& w : other.wvls_){
+        wvls_.push_back(std::make_unique<Wavelength>(*w));
+    }
+
+    reference_index_ = other.reference_index_;
+    higher_          = other.higher_;
+    lower_           = other.lower_;
+    max_weight_      = other.max_weight_;
+    num_wvls_        = other.num_wvls_;
+}
+
 void WavelengthSpec::update()
 {
     assert( !wvls_.empty());
@@ -32,6 +32,7 @@
 #include <fstream>
 #include <filesystem>
 #include <iomanip>
+#include <atomic>
 
 #include "Eigen/Dense"
 #include "nlohmann/json.hpp"
@@ -43,10 +44,17 @@
 
 using namespace geopter;
 
+namespace {
+
+std::atomic<unsigned long long> last_revision(0);
+
+}
+
 
 OpticalSystem::OpticalSystem() :
     title_(""),
-    note_("")
+    note_(""),
+    revision_(++last_revision)
 {
     opt_spec_     = std::make_unique<OpticalSpec>(this);
     opt_assembly_ = std::make_unique<OpticalAssembly>(this);
@@ -88,6 +96,8 @@ void OpticalSystem::UpdateModel()
     fod_->Update();
     opt_spec_->update();
     opt_assembly_->UpdateSemiDiameters();
+
+    revision_ = ++last_revision;
 }
 
 
@@ -114,6 +124,25 @@ void OpticalSystem::SetVignettingFactors()
 }
 
 
+std::unique_ptr<OpticalSystem> OpticalSystem::Clone() const
+{
+    auto sys = std::make_unique<OpticalSystem>();
+
+    sys->title_ = title_;
+    sys->note_  = note_;
+
+    sys->opt_spec_->CopyFrom(*opt_spec_);
+
+    // surfaces and gaps are shared until either system modifies them
+    sys->opt_assembly_->CopyFrom(*opt_assembly_);
+
+    // the model is already up to date, so derived data is copied rather than recomputed
+    sys->fod_->CopyFrom(*fod_);
+
+    return sys;
+}
+
+
 void OpticalSystem::SaveToFile(const std::string &filepath)
 {
     nlohmann::json json_data;
@@ -0,0 +1,86 @@
+#include <iostream>
+
+#include "system/system_parameter.h"
+#include "system/optical_system.h"
+
+using namespace geopter;
+
+SystemParameter::SystemParameter(Type type, int index) :
+    type_(type),
+    index_(index)
+{
+
+}
+
+double SystemParameter::Value(const OpticalSystem *opt_sys) const
+{
+    const OpticalAssembly* assembly = opt_sys->GetOpticalAssembly();
+
+    switch (type_) {
+    case Curvature:
+        return assembly->GetSurface(index_)->Curvature();
+    case Thickness:
+        return assembly->GetGap(index_)->Thickness();
+    case Conic:
+    {
+        const Surface* srf = assembly->GetSurface(index_);
+        if(srf->IsProfile<EvenPolynomial>()){
+            return srf->Profile<EvenPolynomial>()->Conic();
+        }else if(srf->IsProfile<OddPolynomial>()){
+            return srf->Profile<OddPolynomial>()->Conic();
+        }
+        return 0.0;
+    }
+    }
+
+    return 0.0;
+}
+
+void SystemParameter::SetValue(OpticalSystem *opt_sys, double val) const
+{
+    OpticalAssembly* assembly = opt_sys->GetOpticalAssembly();
+
+    switch (type_) {
+    case Curvature:
+    {
+        Surface* srf = assembly->GetSurface(index_);
+        if(srf->IsProfile<Spherical>()){
+            srf->Profile<Spherical>()->SetCurvature(val);
+        }else if(srf->IsProfile<EvenPolynomial>()){
+            srf->Profile<EvenPolynomial>()->SetCurvature(val);
+        }else if(srf->IsProfile<OddPolynomial>()){
+            srf->Profile<OddPolynomial>()->SetCurvature(val);
+        }
+        break;
+    }
+    case Thickness:
+        assembly->GetGap(index_)->SetThickness(val);
+        break;
+    case Conic:
+    {
+        Surface* srf = assembly->GetSurface(index_);
+        if(srf->IsProfile<EvenPolynomial>()){
+            srf->Profile<EvenPolynomial>()->SetConic(val);
+        }else if(srf->IsProfile<OddPolynomial>()){
+            srf->Profile<OddPolynomial>()->SetConic(val);
+        }else{
+            std::cerr << "SystemParameter: conic is not available on spherical surface " << index_ << std::endl;
+        }
+        break;
+    }
+    }
+}
+
+std::string SystemParameter::Name() const
+{
+    switch (type_) {
+    case Curvature:
+        return "C" + std::to_string(index_);
+    case Thickness:
+        return "T" + std::to_string(index_);
+    case Conic:
+        return "K" + std::to_string(index_);
+    }
+
+    return "";
+}
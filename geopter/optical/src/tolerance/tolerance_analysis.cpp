@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+#include "tolerance/tolerance_analysis.h"
+#include "optimization/glass_substitution.h"
+#include "system/optical_system.h"
+#include "common/parallel.h"
+#include "common/process_shard.h"
+
+using namespace geopter;
+
+ToleranceAnalysis::ToleranceAnalysis(const MeritFunction *criterion) :
+    criterion_(criterion),
+    do_refocus_(false),
+    comp_iterations_(10),
+    seed_(0),
+    num_threads_(0),
+    num_processes_(1),
+    yield_threshold_(std::numeric_limits<double>::infinity())
+{
+
+}
+
+ToleranceAnalysis::~ToleranceAnalysis()
+{
+
+}
+
+void ToleranceAnalysis::AddOperand(const ToleranceOperand &op)
+{
+    operands_.push_back(op);
+}
+
+void ToleranceAnalysis::AddCompensator(const SystemParameter &prm)
+{
+    compensators_.push_back(prm);
+    comp_optimizer_ = std::make_unique<LocalOptimizer>(criterion_, compensators_);
+    comp_optimizer_->SetMaxIterations(comp_iterations_);
+}
+
+void ToleranceAnalysis::SetCompensatorIterations(int n)
+{
+    comp_iterations_ = n;
+    if(comp_optimizer_){
+        comp_optimizer_->SetMaxIterations(n);
+    }
+}
+
+void ToleranceAnalysis::compensate(OpticalSystem *opt_sys) const
+{
+    if(do_refocus_){
+        GlassSubstitution::Refocus(opt_sys);
+    }
+
+    // the optimizer is shared by the parallel trials, and Run() does not modify it
+    if(comp_optimizer_){
+        comp_optimizer_->Run(opt_sys);
+    }
+}
+
+void ToleranceAnalysis::Apply(OpticalSystem *opt_sys, const std::vector<double> &values) const
+{
+    const int num_ops = std::min(operands_.size(), values.size());
+    for(int i = 0; i < num_ops; i++){
+        operands_[i].Apply(opt_sys, values[i]);
+    }
+    opt_sys->UpdateModel();
+
+    compensate(opt_sys);
+}
+
+double ToleranceAnalysis::evaluate(const OpticalSystem *opt_sys, const std::vector<double> &values) const
+{
+    auto trial_sys = opt_sys->Clone();
+    Apply(trial_sys.get(), values);
+
+    return sqrt(criterion_->Value(trial_sys.get()));
+}
+
+std::string ToleranceAnalysis::fingerprint(const OpticalSystem *opt_sys, int num_trials) const
+{
+    // model revisions are renewed in every process, so the prescription itself is written out
+    std::ostringstream oss;
+    oss << std::setprecision(17);
+    oss << seed_ << ";" << num_trials << ";" << do_refocus_ << ";" << comp_iterations_ << ";";
+
+    for(auto& op : operands_){
+        oss << op.Name() << "," << op.GetDistribution() << "," << op.Min() << "," << op.Max() << ";";
+    }
+    for(auto& prm : compensators_){
+        oss << prm.Name() << ";";
+    }
+
+    const OpticalAssembly* assembly = opt_sys->GetOpticalAssembly();
+    OpticalSpec* spec = opt_sys->GetOpticalSpec();
+    const int num_wvls = spec->GetWavelengthSpec()->NumberOfWavelengths();
+
+    oss << assembly->StopIndex() << ";";
+    for(int i = 0; i < assembly->NumberOfSurfaces(); i++){
+        oss << SystemParameter(SystemParameter::Curvature, i).Value(opt_sys) << ","
+            << SystemParameter(SystemParameter::Conic, i).Value(opt_sys) << ",";
+        if(i < assembly->NumberOfGaps()){
+            const Gap* gap = assembly->GetGap(i);
+            oss << gap->Thickness() << "," << gap->GetMaterial()->Name();
+            for(int wi = 0; wi < num_wvls; wi++){
+                oss << "," << gap->GetMaterial()->RefractiveIndex(spec->GetWavelengthSpec()->GetWavelength(wi)->Value());
+            }
+        }
+        oss << ";";
+    }
+
+    oss << spec->GetPupilSpec()->PupilType() << "," << spec->GetPupilSpec()->Value() << ";";
+    for(int fi = 0; fi < spec->GetFieldSpec()->NumberOfFields(); fi++){
+        const Field* fld = spec->GetFieldSpec()->GetField(fi);
+        oss << fld->X() << "," << fld->Y() << ";";
+    }
+    for(int wi = 0; wi < num_wvls; wi++){
+        const Wavelength* wvl = spec->GetWavelengthSpec()->GetWavelength(wi);
+        oss << wvl->Value() << "," << wvl->Weight() << ";";
+    }
+
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for(unsigned char c : oss.str()){
+        hash = (hash ^ c)*1099511628211ULL;
+    }
+
+    std::ostringstream hex;
+    hex << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return hex.str();
+}
+
+double ToleranceAnalysis::Nominal(const OpticalSystem *opt_sys) const
+{
+    return evaluate(opt_sys, std::vector<double>());
+}
+
+std::vector<SensitivityResult> ToleranceAnalysis::Sensitivity(const OpticalSystem *opt_sys) const
+{
+    const int num_ops = operands_.size();
+    const double nominal = Nominal(opt_sys);
+
+    auto limit_value = [&](int k){
+        return (k % 2 == 0) ? operands_[k/2].Min() : operands_[k/2].Max();
+    };
+
+    auto job = [&](int k, double* result){
+        std::vector<double> values(num_ops, 0.0);
+        values[k/2] = limit_value(k);
+        result[0] = evaluate(opt_sys, values);
+    };
+
+    std::vector<double> criteria(2*num_ops, NAN);
+
+    // the same criterion as the trials, sharded over the worker processes likewise
+    if(num_processes_ == 1){
+        Parallel::For(0, 2*num_ops, [&](int k){
+            job(k, &criteria[k]);
+        }, num_threads_);
+    }else{
+        ProcessShard shard(1);
+        shard.SetNumberOfProcesses(num_processes_);
+        shard.SetNumberOfThreads(num_threads_);
+        shard.Run(criteria, 2*num_ops, job);
+    }
+
+    std::vector<SensitivityResult> results(2*num_ops);
+    for(int k = 0; k < 2*num_ops; k++){
+        SensitivityResult& r = results[k];
+        r.operand_index = k/2;
+        r.value = limit_value(k);
+        r.criterion = criteria[k];
+        r.change = r.criterion - nominal;
+    }
+
+    return results;
+}
+
+ToleranceStatistics ToleranceAnalysis::MonteCarlo(const OpticalSystem *opt_sys, int num_trials)
+{
+    const int num_ops = operands_.size();
+
+    trials_.clear();
+    trials_.resize(num_trials);
+
+    // every trial has its own stream, independent of the thread or process that runs it
+    for(int ti = 0; ti < num_trials; ti++){
+        std::seed_seq seq{seed_, (unsigned int)ti};
+        std::mt19937_64 rng(seq);
+
+        ToleranceTrial& trial = trials_[ti];
+        trial.trial_index = ti;
+        trial.values.resize(num_ops);
+        for(int oi = 0; oi < num_ops; oi++){
+            trial.values[oi] = operands_[oi].Sample(rng);
+        }
+        trial.criterion = NAN;
+        trial.completed = true;
+    }
+
+    if(num_processes_ == 1 && checkpoint_path_.empty()){
+        Parallel::For(0, num_trials, [&](int ti){
+            trials_[ti].criterion = evaluate(opt_sys, trials_[ti].values);
+        }, num_threads_);
+    }else{
+        ProcessShard shard(1);
+        shard.SetNumberOfProcesses(num_processes_);
+        shard.SetNumberOfThreads(num_threads_);
+        shard.SetCheckpointFile(checkpoint_path_);
+        shard.SetFingerprint(fingerprint(opt_sys, num_trials));
+
+        std::vector<double> criteria;
+        shard.Run(criteria, num_trials, [&](int ti, double* result){
+            result[0] = evaluate(opt_sys, trials_[ti].values);
+        });
+
+        for(int ti = 0; ti < num_trials; ti++){
+            trials_[ti].criterion = criteria[ti];
+            trials_[ti].completed = shard.IsCompleted(ti);
+        }
+    }
+
+    ToleranceStatistics stats;
+    stats.num_trials = num_trials;
+    stats.num_failed = 0;
+    stats.num_incomplete = 0;
+    stats.nominal = Nominal(opt_sys);
+    stats.mean = NAN;
+    stats.std_dev = NAN;
+    stats.min = NAN;
+    stats.max = NAN;
+    stats.yield = 0.0;
+
+    std::vector<double> criteria;
+    criteria.reserve(num_trials);
+    double sum = 0.0, sum_sq = 0.0;
+    int num_passed = 0;
+
+    for(auto& trial : trials_){
+        if( !trial.completed ){
+            stats.num_incomplete++;
+            continue;
+        }
+        double c = trial.criterion;
+        if( !std::isfinite(c) ){
+            stats.num_failed++;
+            criteria.push_back(std::numeric_limits<double>::infinity());
+            continue;
+        }
+        criteria.push_back(c);
+        sum += c;
+        sum_sq += c*c;
+        if(c <= yield_threshold_){
+            num_passed++;
+        }
+    }
+
+    const int num_completed = num_trials - stats.num_incomplete;
+    const int num_valid = num_completed - stats.num_failed;
+    if(num_valid > 0){
+        stats.mean = sum/num_valid;
+        stats.std_dev = sqrt(std::max(sum_sq/num_valid - stats.mean*stats.mean, 0.0));
+    }
+    if(num_completed > 0){
+        stats.yield = (double)num_passed/(double)num_completed;
+    }
+
+    if(stats.num_incomplete > 0){
+        std::cerr << "ToleranceAnalysis: " << stats.num_incomplete << " trials were not completed" << std::endl;
+    }
+
+    // failed trials are counted as the worst
+    std::sort(criteria.begin(), criteria.end());
+    if( !criteria.empty() ){
+        stats.min = criteria.front();
+        stats.max = criteria.back();
+    }
+
+    for(double p : {0.5, 0.8, 0.9, 0.95, 0.98}){
+        if(criteria.empty()){
+            stats.percentiles.push_back(NAN);
+        }else{
+            int rank = std::max(0, (int)ceil(p*criteria.size()) - 1);
+            stats.percentiles.push_back(criteria[rank]);
+        }
+    }
+
+    return stats;
+}
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <cmath>
+
+#include "tolerance/tolerance_operand.h"
+#include "system/optical_system.h"
+#include "system/system_parameter.h"
+#include "material/perturbed_material.h"
+
+using namespace geopter;
+
+ToleranceOperand::ToleranceOperand(Type type, int index, double min, double max, Distribution dist) :
+    type_(type),
+    index_(index),
+    min_(std::min(min, max)),
+    max_(std::max(min, max)),
+    dist_(dist)
+{
+
+}
+
+std::string ToleranceOperand::Name() const
+{
+    switch (type_) {
+    case Radius:
+        return "TRAD " + std::to_string(index_);
+    case Thickness:
+        return "TTHI " + std::to_string(index_);
+    case RefractiveIndex:
+        return "TIND " + std::to_string(index_);
+    case Abbe:
+        return "TABB " + std::to_string(index_);
+    }
+
+    return "";
+}
+
+double ToleranceOperand::Sample(std::mt19937_64 &rng) const
+{
+    const double center = 0.5*(min_ + max_);
+    const double half_range = 0.5*(max_ - min_);
+
+    switch (dist_) {
+    case Normal:
+    {
+        std::normal_distribution<double> normal(0.0, 0.5);
+        double t;
+        do{
+            t = normal(rng);
+        }while(fabs(t) > 1.0);
+        return center + half_range*t;
+    }
+    case EndPoint:
+    {
+        std::bernoulli_distribution coin(0.5);
+        return coin(rng) ? max_ : min_;
+    }
+    default:
+    {
+        std::uniform_real_distribution<double> uniform(min_, max_);
+        return uniform(rng);
+    }
+    }
+}
+
+void ToleranceOperand::Apply(OpticalSystem *opt_sys, double value) const
+{
+    OpticalAssembly* assembly = opt_sys->GetOpticalAssembly();
+
+    switch (type_) {
+    case Radius:
+    {
+        SystemParameter cv(SystemParameter::Curvature, index_);
+        double c = cv.Value(opt_sys);
+        if(c != 0.0){
+            cv.SetValue(opt_sys, 1.0/(1.0/c + value));
+        }
+        break;
+    }
+    case Thickness:
+    {
+        Gap* gap = assembly->GetGap(index_);
+        gap->SetThickness(gap->Thickness() + value);
+        break;
+    }
+    case RefractiveIndex:
+    case Abbe:
+    {
+        // the material may be shared with other systems, so create a new one instead of modifying it
+        Gap* gap = assembly->GetGap(index_);
+        std::shared_ptr<Material> base = gap->GetSharedMaterial();
+        double delta_nd = 0.0;
+        double abbe_scale = 1.0;
+
+        auto perturbed = std::dynamic_pointer_cast<PerturbedMaterial>(base);
+        if(perturbed){
+            base = perturbed->Base();
+            delta_nd = perturbed->DeltaNd();
+            abbe_scale = perturbed->AbbeScale();
+        }
+
+        if(type_ == RefractiveIndex){
+            delta_nd += value;
+        }else{
+            abbe_scale *= (1.0 + value);
+        }
+
+        gap->SetMaterial(std::make_shared<PerturbedMaterial>(base, delta_nd, abbe_scale));
+        break;
+    }
+    }
+}
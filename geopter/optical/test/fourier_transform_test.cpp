@@ -0,0 +1,162 @@
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <complex>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "common/fourier_transform.h"
+
+using namespace geopter;
+
+namespace {
+
+int num_failures = 0;
+
+void check(bool cond, const std::string& what)
+{
+    if( !cond ){
+        std::cerr << "FAILED: " << what << std::endl;
+        num_failures++;
+    }
+}
+
+std::vector< std::complex<double> > naive_dft(const std::vector< std::complex<double> >& x, double sign)
+{
+    const int n = x.size();
+    std::vector< std::complex<double> > y(n);
+    for(int k = 0; k < n; k++){
+        std::complex<double> sum(0.0, 0.0);
+        for(int j = 0; j < n; j++){
+            sum += x[j]*std::polar(1.0, sign*2.0*M_PI*((long long)j*k % n)/n);
+        }
+        y[k] = sum;
+    }
+    return y;
+}
+
+Eigen::MatrixXcd naive_dft2(const Eigen::MatrixXcd& x)
+{
+    Eigen::MatrixXcd y(x.rows(), x.cols());
+    for(int m = 0; m < x.rows(); m++){
+        for(int n = 0; n < x.cols(); n++){
+            std::complex<double> sum(0.0, 0.0);
+            for(int i = 0; i < x.rows(); i++){
+                for(int j = 0; j < x.cols(); j++){
+                    sum += x(i, j)*std::polar(1.0, -2.0*M_PI*((double)(i*m % x.rows())/x.rows() + (double)(j*n % x.cols())/x.cols()));
+                }
+            }
+            y(m, n) = sum;
+        }
+    }
+    return y;
+}
+
+double max_diff(const std::vector< std::complex<double> >& a, const std::vector< std::complex<double> >& b)
+{
+    double d = 0.0;
+    for(size_t k = 0; k < a.size(); k++){
+        d = std::max(d, std::abs(a[k] - b[k]));
+    }
+    return d;
+}
+
+void test_1d(std::mt19937& rng)
+{
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+    // power of two sizes take the radix-2 path, the others Eigen::FFT
+    for(int n : {1, 2, 4, 8, 64, 256, 3, 12, 15, 100}){
+        std::vector< std::complex<double> > x(n);
+        for(auto& v : x){
+            v = std::complex<double>(dist(rng), dist(rng));
+        }
+
+        const double tol = 1.0e-10*n;
+
+        std::vector< std::complex<double> > y = x;
+        FourierTransform::Forward(y.data(), n);
+        check(max_diff(y, naive_dft(x, -1.0)) < tol, "Forward n=" + std::to_string(n));
+
+        // a second call reuses the cached plan
+        std::vector< std::complex<double> > y2 = x;
+        FourierTransform::Forward(y2.data(), n);
+        check(max_diff(y, y2) == 0.0, "Forward with cached plan n=" + std::to_string(n));
+
+        FourierTransform::Inverse(y.data(), n);
+        check(max_diff(y, x) < tol, "Inverse n=" + std::to_string(n));
+    }
+}
+
+void test_2d(std::mt19937& rng)
+{
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+    const std::vector< std::pair<int, int> > sizes({ {8, 16}, {16, 16}, {6, 10}, {7, 9}, {1, 8}, {5, 1} });
+
+    for(auto& s : sizes){
+        const std::string size_str = std::to_string(s.first) + "x" + std::to_string(s.second);
+        const double tol = 1.0e-10*s.first*s.second;
+
+        Eigen::MatrixXcd x(s.first, s.second);
+        Eigen::MatrixXd re(s.first, s.second);
+        for(int i = 0; i < s.first; i++){
+            for(int j = 0; j < s.second; j++){
+                x(i, j) = std::complex<double>(dist(rng), dist(rng));
+                re(i, j) = dist(rng);
+            }
+        }
+
+        const Eigen::MatrixXcd expected = naive_dft2(x);
+
+        Eigen::MatrixXcd y = x;
+        FourierTransform::Forward2(y, 2);
+        check((y - expected).cwiseAbs().maxCoeff() < tol, "Forward2 " + size_str);
+
+        FourierTransform::Inverse2(y, 2);
+        check((y - x).cwiseAbs().maxCoeff() < tol, "Inverse2 " + size_str);
+
+        // real input, with an odd number of columns leaving one column unpaired
+        Eigen::MatrixXcd y_real;
+        FourierTransform::Forward2(y_real, re, 2);
+        check((y_real - naive_dft2(re.cast< std::complex<double> >())).cwiseAbs().maxCoeff() < tol, "Forward2 real " + size_str);
+
+        // the matrix transform at the DFT frequencies is the DFT referenced to the center of the input
+        Eigen::VectorXd freq_x(s.second), freq_y(s.first);
+        for(int n = 0; n < s.second; n++) freq_x(n) = (double)n/s.second;
+        for(int m = 0; m < s.first; m++)  freq_y(m) = (double)m/s.first;
+
+        Eigen::MatrixXcd y_mft;
+        FourierTransform::Matrix2(y_mft, x, freq_x, freq_y, 2);
+
+        const double ci = 0.5*(s.first - 1);
+        const double cj = 0.5*(s.second - 1);
+        Eigen::MatrixXcd shifted = expected;
+        for(int m = 0; m < s.first; m++){
+            for(int n = 0; n < s.second; n++){
+                shifted(m, n) *= std::polar(1.0, 2.0*M_PI*(freq_y(m)*ci + freq_x(n)*cj));
+            }
+        }
+        check((y_mft - shifted).cwiseAbs().maxCoeff() < tol, "Matrix2 " + size_str);
+    }
+}
+
+}
+
+int main()
+{
+    std::mt19937 rng(1);
+
+    test_1d(rng);
+    test_2d(rng);
+
+    FourierTransform::ClearPlans();
+
+    if(num_failures > 0){
+        std::cerr << num_failures << " checks failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "fourier_transform_test passed" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+#include <cmath>
+#include <iostream>
+
+#include "optical.h"
+
+using namespace geopter;
+
+namespace {
+
+int num_failures = 0;
+
+void check(bool cond, const std::string& what)
+{
+    if( !cond ){
+        std::cerr << "FAILED: " << what << std::endl;
+        num_failures++;
+    }
+}
+
+/** Cooke triplet f/8 */
+std::unique_ptr<OpticalSystem> create_triplet()
+{
+    auto opt_sys = std::make_unique<OpticalSystem>();
+    opt_sys->Initialize();
+
+    auto opt_spec = opt_sys->GetOpticalSpec();
+    opt_spec->GetPupilSpec()->SetPupilType(PupilType::EPD);
+    opt_spec->GetPupilSpec()->SetValue(6.25);
+
+    opt_spec->GetFieldSpec()->clear();
+    opt_spec->GetFieldSpec()->SetFieldType(FieldType::OBJ_ANG);
+    opt_spec->GetFieldSpec()->AddField(0.0, 0.0, 1.0, rgb_black);
+    opt_spec->GetFieldSpec()->AddField(0.0, 14.0, 1.0, rgb_red);
+
+    opt_spec->GetWavelengthSpec()->clear();
+    opt_spec->GetWavelengthSpec()->AddWavelength(SpectralLine::C, 1.0, rgb_red);
+    opt_spec->GetWavelengthSpec()->AddWavelength(SpectralLine::d, 1.0, rgb_black);
+    opt_spec->GetWavelengthSpec()->AddWavelength(SpectralLine::F, 1.0, rgb_cyan);
+    opt_spec->GetWavelengthSpec()->SetReferenceIndex(1);
+
+    auto assembly = opt_sys->GetOpticalAssembly();
+    assembly->SetupFromText("1,   23.7130,  4.8310, 1.69100:54.71",
+                            "2, 7331.2880,  5.8600",
+                            "3,  -24.4560,  0.9750, 1.67271:32.25",
+                            "4,   21.8960,  4.8220",
+                            "5,   86.7590,  3.1270, 1.69100:54.71",
+                            "6,  -20.4942, 41.2365" );
+    assembly->GetGap(0)->SetThickness(1.0e+10);
+    assembly->SetStop(3);
+
+    opt_sys->UpdateModel();
+
+    return opt_sys;
+}
+
+/** The matrix transform over an offset window agrees with the direct Huygens integration on the same image points */
+void test_against_huygens(OpticalSystem* opt_sys)
+{
+    const double wvl = opt_sys->GetOpticalSpec()->GetWavelengthSpec()->ReferenceWavelength();
+    const int nrd = 64;
+    const int ndim = 32;
+    const double pitch = 0.0015;
+    const double cx = 0.002;
+    const double cy = -0.003;
+
+    for(int fi = 0; fi < opt_sys->GetOpticalSpec()->GetFieldSpec()->NumberOfFields(); fi++){
+        const Field* fld = opt_sys->GetOpticalSpec()->GetFieldSpec()->GetField(fi);
+
+        HuygensPSF huygens(opt_sys);
+        huygens.SetImageOffset(cx, cy);
+        auto expected = huygens.Create(fld, wvl, nrd, ndim, pitch);
+
+        DiffractivePSF psf(opt_sys);
+        auto mft = psf.CreateByMatrixFourier(fld, wvl, nrd, ndim, pitch, cx, cy);
+
+        check(mft->ValueData().rows() == ndim && mft->ValueData().cols() == ndim, "window size on F" + std::to_string(fi));
+        check(fabs(mft->ValueData().maxCoeff() - 1.0) < 1.0e-12, "normalized to the peak on F" + std::to_string(fi));
+
+        // the Fraunhofer approximation of the transform differs slightly off axis from the spherical waves of Huygens
+        const double diff = (mft->ValueData() - expected->ValueData()).cwiseAbs().maxCoeff();
+        check(diff < 2.0e-2, "agrees with HuygensPSF on F" + std::to_string(fi) + ", max difference " + std::to_string(diff));
+    }
+}
+
+/** The on-axis polychromatic PSF peaks at the chief ray for a centered window */
+void test_polychromatic(OpticalSystem* opt_sys)
+{
+    const Field* fld = opt_sys->GetOpticalSpec()->GetFieldSpec()->GetField(0);
+    const int ndim = 33;
+
+    DiffractivePSF psf(opt_sys);
+    auto poly = psf.CreatePolychromatic(fld, 64, ndim, 0.0015);
+
+    Eigen::Index r, c;
+    poly->ValueData().maxCoeff(&r, &c);
+    check(r == ndim/2 && c == ndim/2, "polychromatic peak at the center, found at " + std::to_string(r) + ", " + std::to_string(c));
+}
+
+}
+
+int main()
+{
+    auto opt_sys = create_triplet();
+
+    test_against_huygens(opt_sys.get());
+    test_polychromatic(opt_sys.get());
+
+    if(num_failures > 0){
+        std::cerr << num_failures << " checks failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "matrix_fourier_psf_test passed" << std::endl;
+    return EXIT_SUCCESS;
+}
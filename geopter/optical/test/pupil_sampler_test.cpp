@@ -0,0 +1,165 @@
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "analysis/pupil_sampler.h"
+
+using namespace geopter;
+
+namespace {
+
+int num_failures = 0;
+
+void check(bool cond, const std::string& what)
+{
+    if( !cond ){
+        std::cerr << "FAILED: " << what << std::endl;
+        num_failures++;
+    }
+}
+
+typedef std::function<double(double, double)> Integrand;
+
+/** Polynomials with their mean over the unit circle */
+struct Moment
+{
+    std::string name;
+    Integrand f;
+    double mean;
+};
+
+const std::vector<Moment>& moments()
+{
+    static const std::vector<Moment> m({
+        {"1",      [](double, double){ return 1.0; },                                   1.0},
+        {"x",      [](double x, double){ return x; },                                   0.0},
+        {"x^2",    [](double x, double){ return x*x; },                                 1.0/4.0},
+        {"y^2",    [](double, double y){ return y*y; },                                 1.0/4.0},
+        {"rho^4",  [](double x, double y){ return pow(x*x + y*y, 2); },                 1.0/3.0},
+        {"x^4",    [](double x, double){ return pow(x, 4); },                           1.0/8.0},
+        {"x^2y^2", [](double x, double y){ return x*x*y*y; },                           1.0/24.0},
+        {"rho^6",  [](double x, double y){ return pow(x*x + y*y, 3); },                 1.0/4.0},
+        {"rho^8",  [](double x, double y){ return pow(x*x + y*y, 4); },                 1.0/5.0},
+        {"x^3y",   [](double x, double y){ return x*x*x*y; },                           0.0}
+    });
+    return m;
+}
+
+double weighted_mean(const PupilSampleSet& samples, const Integrand& f)
+{
+    double sum = 0.0;
+    double sum_w = 0.0;
+    for(int k = 0; k < samples.Size(); k++){
+        sum += samples.weights[k]*f(samples.points[k](0), samples.points[k](1));
+        sum_w += samples.weights[k];
+    }
+    return sum/sum_w;
+}
+
+void check_in_circle(const PupilSampleSet& samples, const std::string& name)
+{
+    bool inside = true;
+    for(auto& pt : samples.points){
+        inside = inside && (pt.norm() <= 1.0 + 1.0e-12);
+    }
+    check(inside, name + " points inside the unit circle");
+}
+
+void check_weight_sum(const PupilSampleSet& samples, const std::string& name)
+{
+    double sum_w = 0.0;
+    for(double w : samples.weights){
+        sum_w += w;
+    }
+    check(fabs(sum_w - 1.0) < 1.0e-12, name + " weights sum to 1");
+}
+
+/** n rings integrate rho^(4n-2) and 2n + 1 arms the harmonics below 2n + 1 exactly, so 3 rings hold all moments above */
+void test_gaussian()
+{
+    for(int n : {3, 4, 6}){
+        const std::string name = "Gaussian " + std::to_string(n);
+        auto samples = PupilSampler::Create(PupilSampler::Gaussian, n);
+
+        check(samples->Size() == n*(2*n + 1), name + " size");
+        check_in_circle(*samples, name);
+        check_weight_sum(*samples, name);
+
+        for(auto& mo : moments()){
+            check(fabs(weighted_mean(*samples, mo.f) - mo.mean) < 1.0e-12, name + " mean of " + mo.name);
+        }
+    }
+}
+
+void test_sobol()
+{
+    auto samples = PupilSampler::Create(PupilSampler::Sobol, 4096);
+    check(samples->Size() > 0, "Sobol size");
+    check_in_circle(*samples, "Sobol");
+    check_weight_sum(*samples, "Sobol");
+
+    for(auto& mo : moments()){
+        check(fabs(weighted_mean(*samples, mo.f) - mo.mean) < 5.0e-3, "Sobol mean of " + mo.name);
+    }
+
+    // the estimates of independent scramblings spread around the mean, and accumulate over consecutive ranges
+    const Integrand f = moments()[4].f;
+    double mean_over_seeds = 0.0;
+    for(uint32_t seed = 1; seed <= 8; seed++){
+        const PupilSampleSet first = PupilSampler::ScrambledSobol(seed, 0, 1024);
+        const PupilSampleSet second = PupilSampler::ScrambledSobol(seed, 1024, 2048);
+        check_in_circle(first, "ScrambledSobol");
+        check_in_circle(second, "ScrambledSobol");
+
+        PupilSampleSet both = first;
+        both.points.insert(both.points.end(), second.points.begin(), second.points.end());
+        both.weights.insert(both.weights.end(), second.weights.begin(), second.weights.end());
+
+        const double est = weighted_mean(both, f);
+        check(fabs(est - 1.0/3.0) < 1.0e-2, "ScrambledSobol mean of rho^4 with seed " + std::to_string(seed));
+        mean_over_seeds += est/8.0;
+    }
+    check(fabs(mean_over_seeds - 1.0/3.0) < 2.0e-3, "ScrambledSobol mean of rho^4 over seeds");
+}
+
+void test_others()
+{
+    const std::vector< std::pair<PupilSampler::Pattern, int> > patterns({
+        {PupilSampler::Grid, 32}, {PupilSampler::Hexapolar, 16}, {PupilSampler::Random, 4096}
+    });
+
+    for(auto& p : patterns){
+        const std::string name = "pattern " + std::to_string(static_cast<int>(p.first));
+        auto samples = PupilSampler::Create(p.first, p.second);
+
+        check(samples->Size() > 0, name + " size");
+        check_in_circle(*samples, name);
+        check_weight_sum(*samples, name);
+        check(fabs(weighted_mean(*samples, moments()[2].f) - 0.25) < 2.0e-2, name + " mean of x^2");
+    }
+
+    // a second request returns the shared set
+    check(PupilSampler::Create(PupilSampler::Gaussian, 3) == PupilSampler::Create(PupilSampler::Gaussian, 3), "Gaussian set is shared");
+}
+
+}
+
+int main()
+{
+    test_gaussian();
+    test_sobol();
+    test_others();
+
+    PupilSampler::ClearCache();
+
+    if(num_failures > 0){
+        std::cerr << num_failures << " checks failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "pupil_sampler_test passed" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,94 @@
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "analysis/zernike_fit.h"
+
+using namespace geopter;
+
+namespace {
+
+int num_failures = 0;
+
+void check(bool cond, const std::string& what)
+{
+    if( !cond ){
+        std::cerr << "FAILED: " << what << std::endl;
+        num_failures++;
+    }
+}
+
+void check_table(Zernike::Ordering ordering, const std::string& name, const std::vector< std::pair<int, int> >& table)
+{
+    for(size_t t = 0; t < table.size(); t++){
+        const int j = t + 1;
+        int n, m;
+        const bool valid = Zernike::Index(j, ordering, n, m);
+        check(valid && n == table[t].first && m == table[t].second,
+              name + " Z" + std::to_string(j) + " is (" + std::to_string(n) + ", " + std::to_string(m) + ")");
+    }
+}
+
+/** (n, m) of the Fringe terms 1 to 37, m negative for the sine terms */
+void test_fringe()
+{
+    const std::vector< std::pair<int, int> > fringe({
+        {0, 0},
+        {1, 1}, {1, -1}, {2, 0},
+        {2, 2}, {2, -2}, {3, 1}, {3, -1}, {4, 0},
+        {3, 3}, {3, -3}, {4, 2}, {4, -2}, {5, 1}, {5, -1}, {6, 0},
+        {4, 4}, {4, -4}, {5, 3}, {5, -3}, {6, 2}, {6, -2}, {7, 1}, {7, -1}, {8, 0},
+        {5, 5}, {5, -5}, {6, 4}, {6, -4}, {7, 3}, {7, -3}, {8, 2}, {8, -2}, {9, 1}, {9, -1}, {10, 0},
+        {12, 0}
+    });
+
+    check_table(Zernike::Fringe, "Fringe", fringe);
+
+    int n, m;
+    check( !Zernike::Index(0, Zernike::Fringe, n, m), "Fringe Z0 is rejected");
+    check( !Zernike::Index(38, Zernike::Fringe, n, m), "Fringe Z38 is rejected");
+    check(std::isnan(Zernike::Value(38, Zernike::Fringe, 0.5, 0.0)), "Fringe Z38 has no value");
+
+    // Z37 = 924rho^12 - 2772rho^10 + 3150rho^8 - 1680rho^6 + 420rho^4 - 42rho^2 + 1
+    const double rho = 0.7;
+    const double z37 = ((((((924.0*rho*rho - 2772.0)*rho*rho + 3150.0)*rho*rho - 1680.0)*rho*rho + 420.0)*rho*rho - 42.0)*rho*rho + 1.0);
+    check(fabs(Zernike::Value(37, Zernike::Fringe, rho, 0.3) - z37) < 1.0e-12, "Fringe Z37 value");
+}
+
+/** (n, m) of the Noll terms 1 to 28, with the cosine terms at even j */
+void test_noll()
+{
+    const std::vector< std::pair<int, int> > noll({
+        {0, 0},
+        {1, 1}, {1, -1},
+        {2, 0}, {2, -2}, {2, 2},
+        {3, -1}, {3, 1}, {3, -3}, {3, 3},
+        {4, 0}, {4, 2}, {4, -2}, {4, 4}, {4, -4},
+        {5, 1}, {5, -1}, {5, 3}, {5, -3}, {5, 5}, {5, -5},
+        {6, 0}, {6, -2}, {6, 2}, {6, -4}, {6, 4}, {6, -6}, {6, 6}
+    });
+
+    check_table(Zernike::Noll, "Noll", noll);
+
+    int n, m;
+    check( !Zernike::Index(0, Zernike::Noll, n, m), "Noll Z0 is rejected");
+    check(Zernike::Index(66, Zernike::Noll, n, m) && n == 10 && m == 10, "Noll Z66 is (10, 10)");
+}
+
+}
+
+int main()
+{
+    test_fringe();
+    test_noll();
+
+    if(num_failures > 0){
+        std::cerr << num_failures << " checks failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "zernike_index_test passed" << std::endl;
+    return EXIT_SUCCESS;
+}